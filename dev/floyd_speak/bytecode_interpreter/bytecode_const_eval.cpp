@@ -0,0 +1,310 @@
+//
+//  bytecode_const_eval.cpp
+//  FloydSpeak
+//
+
+#include "bytecode_const_eval.h"
+
+#include "bytecode_interpreter.h"
+#include "bytecode_generator.h"
+#include "floyd_interpreter.h"
+#include "host_functions.h"
+#include "pass3.h"
+#include "ast_value.h"
+
+#include <set>
+
+namespace floyd {
+
+
+static bool reads_only_constants(const ast_t& ast, const body_t& body, std::set<int>& function_ids);
+
+//	True if the function is pure and its body, and every function it can call, only reads globals that are constants.
+//	function_ids holds the functions already checked or being checked.
+static bool is_constant_function(const ast_t& ast, int function_id, std::set<int>& function_ids){
+	if(function_ids.insert(function_id).second == false){
+		return true;
+	}
+	const auto& function_def = *ast._function_defs[function_id];
+	if(function_def._function_type.get_function_pure() != epure::pure){
+		return false;
+	}
+	//	print() is pure but its output must happen at runtime.
+	if(function_def._host_function_id != 0){
+		return function_def._host_function_id != get_host_function_signatures().at("print")._function_id;
+	}
+	return reads_only_constants(ast, *function_def._body, function_ids);
+}
+
+static bool reads_only_constants(const ast_t& ast, const expression_t& e, std::set<int>& function_ids){
+	const auto op = e.get_operation();
+	if(e._function_def || op == expression_type::k_load){
+		return false;
+	}
+	if(op == expression_type::k_load2 && e._address._parent_steps == -1){
+		const auto function_id = get_global_function_id(ast, e._address._index);
+		if(function_id != -1){
+			if(is_constant_function(ast, function_id, function_ids) == false){
+				return false;
+			}
+		}
+		else if(ast._globals._symbols._symbols[e._address._index].second._const_value.is_undefined()){
+			return false;
+		}
+	}
+	if(op == expression_type::k_literal && e.get_literal().is_function()){
+		if(is_constant_function(ast, e.get_literal().get_function_value(), function_ids) == false){
+			return false;
+		}
+	}
+	for(const auto& input: e._input_exprs){
+		if(reads_only_constants(ast, input, function_ids) == false){
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool reads_only_constants(const ast_t& ast, const body_t& body, std::set<int>& function_ids){
+	for(const auto& s: body._statements){
+		bool ok = false;
+		if(const auto ret = std::get_if<statement_t::return_statement_t>(&s._contents)){
+			ok = reads_only_constants(ast, ret->_expression, function_ids);
+		}
+		else if(const auto store = std::get_if<statement_t::store2_t>(&s._contents)){
+			ok = store->_dest_variable._parent_steps != -1 && reads_only_constants(ast, store->_expression, function_ids);
+		}
+		else if(const auto block = std::get_if<statement_t::block_statement_t>(&s._contents)){
+			ok = reads_only_constants(ast, block->_body, function_ids);
+		}
+		else if(const auto ifelse = std::get_if<statement_t::ifelse_statement_t>(&s._contents)){
+			ok = reads_only_constants(ast, ifelse->_condition, function_ids)
+				&& reads_only_constants(ast, ifelse->_then_body, function_ids)
+				&& reads_only_constants(ast, ifelse->_else_body, function_ids);
+		}
+		else if(const auto for_loop = std::get_if<statement_t::for_statement_t>(&s._contents)){
+			ok = reads_only_constants(ast, for_loop->_start_expression, function_ids)
+				&& reads_only_constants(ast, for_loop->_end_expression, function_ids)
+				&& reads_only_constants(ast, for_loop->_body, function_ids);
+		}
+		else if(const auto while_loop = std::get_if<statement_t::while_statement_t>(&s._contents)){
+			ok = reads_only_constants(ast, while_loop->_condition, function_ids)
+				&& reads_only_constants(ast, while_loop->_body, function_ids);
+		}
+		else if(const auto expression_statement = std::get_if<statement_t::expression_statement_t>(&s._contents)){
+			ok = reads_only_constants(ast, expression_statement->_expression, function_ids);
+		}
+		if(ok == false){
+			return false;
+		}
+	}
+	return true;
+}
+
+//	Returns the function id if the global statement is a store of a call we can evaluate at compile time, else -1.
+static int get_constant_call(const ast_t& ast, const statement_t& statement){
+	const auto store = std::get_if<statement_t::store2_t>(&statement._contents);
+	if(store == nullptr || store->_expression.get_operation() != expression_type::k_call){
+		return -1;
+	}
+	const auto& callee = store->_expression._input_exprs[0];
+	if(callee.get_operation() != expression_type::k_load2 || callee._address._parent_steps != -1){
+		return -1;
+	}
+	const auto function_id = get_global_function_id(ast, callee._address._index);
+	if(function_id == -1){
+		return -1;
+	}
+	const auto& function_def = *ast._function_defs[function_id];
+	if(function_def._host_function_id != 0 || function_def._function_type.get_function_return().is_void()){
+		return -1;
+	}
+
+	std::set<int> function_ids;
+	for(auto it = store->_expression._input_exprs.begin() + 1 ; it != store->_expression._input_exprs.end() ; it++){
+		if(it->is_literal() == false || reads_only_constants(ast, *it, function_ids) == false){
+			return -1;
+		}
+	}
+	return is_constant_function(ast, function_id, function_ids) ? function_id : -1;
+}
+
+semantic_ast_t evaluate_constant_calls(const semantic_ast_t& ast){
+	QUARK_ASSERT(ast.check_invariant());
+
+	const auto& container_def = ast._checked_ast._container_def;
+	const auto step_limit = container_def._const_eval_steps >= 0 ? container_def._const_eval_steps : k_default_const_eval_steps;
+	if(step_limit == 0){
+		return ast;
+	}
+
+	std::vector<std::pair<int, int>> calls;
+	const auto& statements = ast._checked_ast._globals._statements;
+	for(int index = 0 ; index < static_cast<int>(statements.size()) ; index++){
+		const auto function_id = get_constant_call(ast._checked_ast, statements[index]);
+		if(function_id != -1){
+			calls.push_back({ index, function_id });
+		}
+	}
+	if(calls.empty()){
+		return ast;
+	}
+
+	const auto program = generate_bytecode(ast);
+	auto config = make_interpreter_config(program._container_def);
+	config._jit = false;
+	config._memoize.clear();
+	config._step_limit = step_limit;
+	config._run_global_instructions = false;
+
+	auto result = ast;
+	for(const auto& call: calls){
+		auto& store = std::get<statement_t::store2_t>(result._checked_ast._globals._statements[call.first]._contents);
+		const auto& function_def = *ast._checked_ast._function_defs[call.second];
+
+		std::vector<value_t> args;
+		for(auto it = store._expression._input_exprs.begin() + 1 ; it != store._expression._input_exprs.end() ; it++){
+			args.push_back(it->get_literal());
+		}
+
+		//	Errors, including the step limit, are left for runtime to report.
+		try {
+			interpreter_t sandbox(program, nullptr, config);
+			const auto value = call_function(sandbox, value_t::make_function_value(function_def._function_type, call.second), args);
+			if(value.get_type() == store._expression.get_output_type()){
+				store._expression = expression_t::make_literal(value);
+			}
+		}
+		catch(const std::exception&){
+		}
+	}
+	return result;
+}
+
+
+//////////////////////////////////////		TESTS
+
+
+static int count_global_calls(const bc_program_t& program){
+	const auto& instrs = program._globals._instructions;
+	return static_cast<int>(std::count_if(instrs.begin(), instrs.end(), [](const bc_instruction_t& i){ return i._opcode == bc_opcode::k_call; }));
+}
+
+QUARK_UNIT_TEST("bytecode_const_eval", "evaluate_constant_calls()", "lookup table is built at compile time", ""){
+	const auto program = compile_to_bytecode(R"(
+
+		container-def {
+			"name": "", "tech": "", "desc": "", "clocks": {},
+			"inline_budget": 0
+		}
+
+		let COUNT = 10
+		struct entry_t { int index string name }
+
+		func [entry_t] make_table(int n, string prefix){
+			mutable [entry_t] result = []
+			for(i in 0 ..< n){
+				result = push_back(result, entry_t(i * i, prefix + to_string(i)))
+			}
+			return result
+		}
+
+		let TABLE = make_table(COUNT, "e")
+		let SMALL = make_table(2, "s")
+
+	)", "");
+
+	QUARK_UT_VERIFY(count_global_calls(program) == 0);
+
+	interpreter_t vm(program);
+	const auto table = get_global(vm, "TABLE").get_vector_value();
+	QUARK_UT_VERIFY(table.size() == 10);
+	QUARK_UT_VERIFY(table[9].get_struct_value()->_member_values[0] == value_t::make_int(81));
+	QUARK_UT_VERIFY(table[9].get_struct_value()->_member_values[1] == value_t::make_string("e9"));
+	QUARK_UT_VERIFY(get_global(vm, "SMALL").get_vector_value().size() == 2);
+}
+
+QUARK_UNIT_TEST("bytecode_const_eval", "evaluate_constant_calls()", "calls over the step limit run at runtime", ""){
+	const auto program = compile_to_bytecode(R"(
+
+		container-def {
+			"name": "", "tech": "", "desc": "", "clocks": {},
+			"inline_budget": 0,
+			"const_eval_steps": 1000
+		}
+
+		func int spin(int n){
+			mutable x = 0
+			while(x < n){
+				x = x + 1
+			}
+			return x
+		}
+
+		let a = spin(10)
+		let b = spin(100000)
+
+	)", "");
+
+	QUARK_UT_VERIFY(count_global_calls(program) == 1);
+
+	interpreter_t vm(program);
+	QUARK_UT_VERIFY(get_global(vm, "a") == value_t::make_int(10));
+	QUARK_UT_VERIFY(get_global(vm, "b") == value_t::make_int(100000));
+}
+
+QUARK_UNIT_TEST("bytecode_const_eval", "evaluate_constant_calls()", "functions reading non-constant globals run at runtime", ""){
+	const auto program = compile_to_bytecode(R"(
+
+		container-def {
+			"name": "", "tech": "", "desc": "", "clocks": {},
+			"inline_budget": 0
+		}
+
+		let weights = [ 1, 2, 3 ]
+		func int weight(int i){
+			return weights[i]
+		}
+		func int twice_weight(int i){
+			return weight(i) * 2
+		}
+
+		let a = twice_weight(2)
+
+	)", "");
+
+	QUARK_UT_VERIFY(count_global_calls(program) == 1);
+
+	interpreter_t vm(program);
+	QUARK_UT_VERIFY(get_global(vm, "a") == value_t::make_int(6));
+}
+
+QUARK_UNIT_TEST("bytecode_const_eval", "evaluate_constant_calls()", "runtime errors are still reported at runtime", ""){
+	const auto program = compile_to_bytecode(R"(
+
+		container-def {
+			"name": "", "tech": "", "desc": "", "clocks": {},
+			"inline_budget": 0
+		}
+
+		func int get(int i){
+			let v = [ 10, 20 ]
+			return v[i]
+		}
+
+		let a = get(5)
+
+	)", "");
+
+	QUARK_UT_VERIFY(count_global_calls(program) == 1);
+	try{
+		interpreter_t vm(program);
+		QUARK_UT_VERIFY(false);
+	}
+	catch(const std::runtime_error& e){
+		QUARK_UT_VERIFY(std::string(e.what()) == "Lookup in vector: out of bounds.");
+	}
+}
+
+
+} //	floyd
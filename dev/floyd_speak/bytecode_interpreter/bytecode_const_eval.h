@@ -0,0 +1,37 @@
+//
+//  bytecode_const_eval.h
+//  FloydSpeak
+//
+
+#ifndef bytecode_const_eval_h
+#define bytecode_const_eval_h
+
+/*
+	Compile-time evaluation of global calls to pure functions with constant arguments:
+
+		let SQUARES = make_squares(1000)
+
+	make_squares() runs once, during compilation, and the call is replaced by a literal of its result. Each process'
+	interpreter then only copies the constant instead of running the call again.
+
+	The call runs in a sandbox interpreter that doesn't run the global instructions. So the function -- and every
+	function it can call -- may only read globals that are constants, and may not print(). Each call has a step limit (loop iterations +
+	calls), "const_eval_steps" in the container-def. Calls that hit the limit or throw are left as they are and
+	run normally at runtime.
+*/
+
+#include <cstdint>
+
+namespace floyd {
+
+struct semantic_ast_t;
+
+
+const int64_t k_default_const_eval_steps = 10 * 1000 * 1000;
+
+semantic_ast_t evaluate_constant_calls(const semantic_ast_t& ast);
+
+
+} //	floyd
+
+#endif /* bytecode_const_eval_h */
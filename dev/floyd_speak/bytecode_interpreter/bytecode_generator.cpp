@@ -14,6 +14,8 @@
 #include <cmath>
 #include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include <map>
 
 
 namespace floyd {
@@ -105,6 +107,20 @@ struct bcgen_environment_t {
 	MUTABLE
 */
 
+/*
+	A vector lookup that can't go out of bounds: the iterator of "for(i in 0 ..< size(v))" indexing v.
+	Registers are identified by the level of their environment in _call_stack, counted from the bottom, and their index.
+*/
+struct bcgen_safe_lookup_t {
+	int _vector_level;
+	int _vector_index;
+	int _iterator_level;
+	int _iterator_index;
+};
+
+//	Default for bcgenerator_t::_inline_budget, in instructions. Enough for accessors and small math helpers.
+const int k_default_inline_budget = 16;
+
 struct bcgenerator_t {
 	public: explicit bcgenerator_t(const semantic_ast_t& ast);
 	public: bcgenerator_t(const bcgenerator_t& other);
@@ -122,6 +138,25 @@ struct bcgenerator_t {
 	public: std::vector<bcgen_environment_t> _call_stack;
 
 	public: std::vector<typeid_t> _types;
+	public: std::vector<double> _double_constants;
+
+	//	Function whose body is being generated, -1 for the globals.
+	public: int _current_function_id;
+
+	//	Max instructions in a pure function's body for calls to it to be inlined. 0 = no inlining.
+	public: int _inline_budget;
+
+	//	Bodies ready to be inlined, by function id. nullptr = that function is never inlined.
+	public: std::map<int, std::shared_ptr<const bcgen_body_t>> _inline_bodies;
+
+	//	Functions whose bodies are being generated for inlining, innermost last.
+	public: std::vector<int> _inline_stack;
+
+	//	Set when a body generated for inlining calls a function on _inline_stack.
+	public: bool _inline_recursion;
+
+	//	For-loops being generated whose vector lookups need no bounds check, innermost last.
+	public: std::vector<bcgen_safe_lookup_t> _safe_lookups;
 };
 
 
@@ -148,6 +183,12 @@ struct expression_gen_t {
 expression_gen_t bcgen_expression(bcgenerator_t& vm, const variable_address_t& target_reg, const expression_t& e, const bcgen_body_t& body);
 bcgen_body_t bcgen_body_top(bcgenerator_t& vm, const body_t& body);
 bcgen_body_t bcgen_body_block(bcgenerator_t& vm, const body_t& body);
+bool is_tail_call(bcgenerator_t& vm, const expression_t& e);
+bcgen_body_t bcgen_tail_call(bcgenerator_t& vm, const expression_t& e, const bcgen_body_t& body);
+std::shared_ptr<const bcgen_body_t> get_inline_body(bcgenerator_t& vm, const expression_t& e);
+expression_gen_t bcgen_inline_call(bcgenerator_t& vm, const variable_address_t& target_reg, const expression_t& e, const bcgen_body_t& callee_body, const bcgen_body_t& body);
+int get_host_function_id(bcgenerator_t& vm, const expression_t& e);
+int get_environment_level(const bcgenerator_t& vm, const variable_address_t& reg);
 
 
 
@@ -184,6 +225,160 @@ bc_typeid_t intern_type(bcgenerator_t& vm, const typeid_t& type){
 	QUARK_ASSERT(vm.check_invariant());
 }
 
+//	Returns index into bc_program_t::_double_constants, or -1 if the pool is full.
+int intern_double_constant(bcgenerator_t& vm, double value){
+	QUARK_ASSERT(vm.check_invariant());
+
+	//	Compare bits: 0.0 and -0.0 are different constants.
+	const auto it = std::find_if(vm._double_constants.begin(), vm._double_constants.end(), [&value](double e) { return std::memcmp(&e, &value, sizeof(double)) == 0; });
+	if(it != vm._double_constants.end()){
+		return static_cast<int>(it - vm._double_constants.begin());
+	}
+	else if(vm._double_constants.size() < INT32_MAX){
+		vm._double_constants.push_back(value);
+		return static_cast<int>(vm._double_constants.size() - 1);
+	}
+	else{
+		return -1;
+	}
+}
+
+//	Int literals that fit in an instruction's register field.
+bool is_small_int_literal(const expression_t& e){
+	if(e.get_operation() == expression_type::k_literal && e.get_output_type().is_int()){
+		const auto value = e.get_literal().get_int_value();
+		return value >= INT16_MIN && value <= INT16_MAX;
+	}
+	else{
+		return false;
+	}
+}
+
+bool is_double_literal(const expression_t& e){
+	return e.get_operation() == expression_type::k_literal && e.get_output_type().is_double();
+}
+
+//	a < b is the same as b > a etc.
+expression_type flip_comparison(expression_type op){
+	if(op == expression_type::k_comparison_smaller__2){
+		return expression_type::k_comparison_larger__2;
+	}
+	else if(op == expression_type::k_comparison_smaller_or_equal__2){
+		return expression_type::k_comparison_larger_or_equal__2;
+	}
+	else if(op == expression_type::k_comparison_larger__2){
+		return expression_type::k_comparison_smaller__2;
+	}
+	else if(op == expression_type::k_comparison_larger_or_equal__2){
+		return expression_type::k_comparison_smaller_or_equal__2;
+	}
+	else{
+		QUARK_ASSERT(op == expression_type::k_logical_equal__2 || op == expression_type::k_logical_nonequal__2);
+		return op;
+	}
+}
+
+//	An instruction with one register operand and one immediate operand, replacing a two-register instruction
+//	where one operand is a literal. _opcode is k_nop if there is no such instruction.
+struct imm_operand_t {
+	bc_opcode _opcode;
+
+	//	Which of the expression's two inputs goes in a register.
+	int _reg_input;
+
+	//	The immediate: a small int or an index into bc_program_t::_double_constants.
+	int _imm;
+};
+
+imm_operand_t convert_arithmetic_to_imm_opcode(bcgenerator_t& vm, const expression_t& e){
+	const auto op = e.get_operation();
+	const auto& left = e._input_exprs[0];
+	const auto& right = e._input_exprs[1];
+	const auto type = left.get_output_type();
+	const bool commutative = op == expression_type::k_arithmetic_add__2 || op == expression_type::k_arithmetic_multiply__2;
+
+	if(type.is_int()){
+		static const std::map<expression_type, bc_opcode> conv_opcode = {
+			{ expression_type::k_arithmetic_add__2, bc_opcode::k_add_int_imm },
+			{ expression_type::k_arithmetic_subtract__2, bc_opcode::k_subtract_int_imm },
+			{ expression_type::k_arithmetic_multiply__2, bc_opcode::k_multiply_int_imm }
+		};
+		const auto it = conv_opcode.find(op);
+		if(it != conv_opcode.end()){
+			if(is_small_int_literal(right)){
+				return { it->second, 0, static_cast<int>(right.get_literal().get_int_value()) };
+			}
+			else if(commutative && is_small_int_literal(left)){
+				return { it->second, 1, static_cast<int>(left.get_literal().get_int_value()) };
+			}
+		}
+	}
+	else if(type.is_double()){
+		static const std::map<expression_type, bc_opcode> conv_opcode = {
+			{ expression_type::k_arithmetic_add__2, bc_opcode::k_add_double_const },
+			{ expression_type::k_arithmetic_subtract__2, bc_opcode::k_subtract_double_const },
+			{ expression_type::k_arithmetic_multiply__2, bc_opcode::k_multiply_double_const },
+			{ expression_type::k_arithmetic_divide__2, bc_opcode::k_divide_double_const }
+		};
+		const auto it = conv_opcode.find(op);
+		if(it != conv_opcode.end()){
+			//	Division by a literal 0.0 keeps the register form, which throws at runtime.
+			if(is_double_literal(right) && (op != expression_type::k_arithmetic_divide__2 || right.get_literal().get_double_value() != 0.0)){
+				const auto index = intern_double_constant(vm, right.get_literal().get_double_value());
+				if(index != -1){
+					return { it->second, 0, index };
+				}
+			}
+			else if(commutative && is_double_literal(left)){
+				const auto index = intern_double_constant(vm, left.get_literal().get_double_value());
+				if(index != -1){
+					return { it->second, 1, index };
+				}
+			}
+		}
+	}
+	return { bc_opcode::k_nop, 0, 0 };
+}
+
+//	If branch_false is true: returns the compare-and-branch that branches when the comparison is FALSE.
+imm_operand_t convert_comparison_to_imm_opcode(const expression_t& e, bool branch_false){
+	const auto& left = e._input_exprs[0];
+	const auto& right = e._input_exprs[1];
+	if(left.get_output_type().is_int() == false){
+		return { bc_opcode::k_nop, 0, 0 };
+	}
+
+	static const std::map<expression_type, bc_opcode> conv_opcode = {
+		{ expression_type::k_comparison_smaller__2, bc_opcode::k_comparison_smaller_int_imm },
+		{ expression_type::k_comparison_smaller_or_equal__2, bc_opcode::k_comparison_smaller_or_equal_int_imm },
+		{ expression_type::k_comparison_larger__2, bc_opcode::k_comparison_larger_int_imm },
+		{ expression_type::k_comparison_larger_or_equal__2, bc_opcode::k_comparison_larger_or_equal_int_imm },
+		{ expression_type::k_logical_equal__2, bc_opcode::k_logical_equal_int_imm },
+		{ expression_type::k_logical_nonequal__2, bc_opcode::k_logical_nonequal_int_imm }
+	};
+
+	//	Branches on the negated comparison.
+	static const std::map<expression_type, bc_opcode> conv_opcode_branch_false = {
+		{ expression_type::k_comparison_smaller__2, bc_opcode::k_branch_larger_or_equal_int_imm },
+		{ expression_type::k_comparison_smaller_or_equal__2, bc_opcode::k_branch_larger_int_imm },
+		{ expression_type::k_comparison_larger__2, bc_opcode::k_branch_smaller_or_equal_int_imm },
+		{ expression_type::k_comparison_larger_or_equal__2, bc_opcode::k_branch_smaller_int_imm },
+		{ expression_type::k_logical_equal__2, bc_opcode::k_branch_nonequal_int_imm },
+		{ expression_type::k_logical_nonequal__2, bc_opcode::k_branch_equal_int_imm }
+	};
+
+	const auto& table = branch_false ? conv_opcode_branch_false : conv_opcode;
+	if(is_small_int_literal(right)){
+		return { table.at(e.get_operation()), 0, static_cast<int>(right.get_literal().get_int_value()) };
+	}
+	else if(is_small_int_literal(left)){
+		return { table.at(flip_comparison(e.get_operation())), 1, static_cast<int>(left.get_literal().get_int_value()) };
+	}
+	else{
+		return { bc_opcode::k_nop, 0, 0 };
+	}
+}
+
 reg_t flatten_reg(const reg_t& r, int offset){
 	QUARK_ASSERT(r.check_invariant());
 
@@ -387,33 +582,123 @@ bcgen_body_t bcgen_return_statement(bcgenerator_t& vm, const statement_t::return
 	QUARK_ASSERT(body.check_invariant());
 
 	auto body_acc = body;
+
+	//	A callee that gets inlined is cheaper than a tail call.
+	if(is_tail_call(vm, statement._expression) && get_inline_body(vm, statement._expression) == nullptr){
+		return bcgen_tail_call(vm, statement._expression, body_acc);
+	}
 	const auto expr = bcgen_expression(vm, {}, statement._expression, body);
 	body_acc = expr._body;
 	body_acc._instrs.push_back(bcgen_instruction_t(bc_opcode::k_return, expr._out, {}, {}));
 	return body_acc;
 }
 
-bcgen_body_t bcgen_ifelse_statement(bcgenerator_t& vm, const statement_t::ifelse_statement_t& statement, const bcgen_body_t& body){
+//	Returns the compare-and-branch opcode that branches when the comparison is FALSE, or k_nop if the type has none.
+//	Bool tells if to flip left / right.
+std::pair<bool, bc_opcode> convert_comparison_to_branch_false_opcode(const typeid_t& type, expression_type op){
+	struct branch_opcodes_t {
+		bc_opcode _smaller;
+		bc_opcode _smaller_or_equal;
+		bc_opcode _equal;
+		bc_opcode _nonequal;
+	};
+
+	const auto opcodes = [&type]{
+		if(type.is_int()){
+			return branch_opcodes_t{ bc_opcode::k_branch_smaller_int, bc_opcode::k_branch_smaller_or_equal_int, bc_opcode::k_branch_equal_int, bc_opcode::k_branch_nonequal_int };
+		}
+		else if(type.is_double()){
+			return branch_opcodes_t{ bc_opcode::k_branch_smaller_double, bc_opcode::k_branch_smaller_or_equal_double, bc_opcode::k_branch_equal_double, bc_opcode::k_branch_nonequal_double };
+		}
+		else if(type.is_string()){
+			return branch_opcodes_t{ bc_opcode::k_branch_smaller_string, bc_opcode::k_branch_smaller_or_equal_string, bc_opcode::k_branch_equal_string, bc_opcode::k_branch_nonequal_string };
+		}
+		else if(type.is_bool()){
+			return branch_opcodes_t{ bc_opcode::k_branch_smaller_bool, bc_opcode::k_branch_smaller_or_equal_bool, bc_opcode::k_branch_equal_bool, bc_opcode::k_branch_nonequal_bool };
+		}
+		else{
+			return branch_opcodes_t{ bc_opcode::k_nop, bc_opcode::k_nop, bc_opcode::k_nop, bc_opcode::k_nop };
+		}
+	}();
+
+	//	The orderings are total (doubles compare like bc_compare_value_true_deep()): not (a < b) is (b <= a).
+	if(op == expression_type::k_comparison_smaller__2){
+		return { true, opcodes._smaller_or_equal };
+	}
+	else if(op == expression_type::k_comparison_smaller_or_equal__2){
+		return { true, opcodes._smaller };
+	}
+	else if(op == expression_type::k_comparison_larger__2){
+		return { false, opcodes._smaller_or_equal };
+	}
+	else if(op == expression_type::k_comparison_larger_or_equal__2){
+		return { false, opcodes._smaller };
+	}
+	else if(op == expression_type::k_logical_equal__2){
+		return { false, opcodes._nonequal };
+	}
+	else if(op == expression_type::k_logical_nonequal__2){
+		return { false, opcodes._equal };
+	}
+	else{
+		return { false, bc_opcode::k_nop };
+	}
+}
+
+//	Evaluates the condition and branches offset instructions if it's false. The branch is the last instruction.
+//	A comparison of ints, doubles, strings or bools becomes a single compare-and-branch instruction.
+bcgen_body_t bcgen_branch_false(bcgenerator_t& vm, const expression_t& condition, int offset, const bcgen_body_t& body){
 	QUARK_ASSERT(vm.check_invariant());
-	QUARK_ASSERT(body.check_invariant());
+	QUARK_ASSERT(condition.check_invariant());
+	QUARK_ASSERT(condition.get_output_type().is_bool());
 
 	auto body_acc = body;
 
-	const auto condition_expr = bcgen_expression(vm, {}, statement._condition, body_acc);
+	const auto op = condition.get_operation();
+	if(is_comparison_expression(op)){
+		const auto imm = convert_comparison_to_imm_opcode(condition, true);
+		if(imm._opcode != bc_opcode::k_nop){
+			const auto& reg_expr = bcgen_expression(vm, {}, condition._input_exprs[imm._reg_input], body_acc);
+			body_acc = reg_expr._body;
+			body_acc._instrs.push_back(bcgen_instruction_t(imm._opcode, reg_expr._out, make_imm_int(imm._imm), make_imm_int(offset)));
+			return body_acc;
+		}
+
+		const auto branch = convert_comparison_to_branch_false_opcode(condition._input_exprs[0].get_output_type(), op);
+		if(branch.second != bc_opcode::k_nop){
+			const auto& left_expr = bcgen_expression(vm, {}, condition._input_exprs[0], body_acc);
+			body_acc = left_expr._body;
+
+			const auto& right_expr = bcgen_expression(vm, {}, condition._input_exprs[1], body_acc);
+			body_acc = right_expr._body;
+
+			if(branch.first == false){
+				body_acc._instrs.push_back(bcgen_instruction_t(branch.second, left_expr._out, right_expr._out, make_imm_int(offset)));
+			}
+			else{
+				body_acc._instrs.push_back(bcgen_instruction_t(branch.second, right_expr._out, left_expr._out, make_imm_int(offset)));
+			}
+			return body_acc;
+		}
+	}
+
+	const auto condition_expr = bcgen_expression(vm, {}, condition, body_acc);
 	body_acc = condition_expr._body;
+	body_acc._instrs.push_back(bcgen_instruction_t(bc_opcode::k_branch_false_bool, condition_expr._out, make_imm_int(offset), {}));
+	return body_acc;
+}
+
+bcgen_body_t bcgen_ifelse_statement(bcgenerator_t& vm, const statement_t::ifelse_statement_t& statement, const bcgen_body_t& body){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(body.check_invariant());
 	QUARK_ASSERT(statement._condition.get_output_type().is_bool());
 
+	auto body_acc = body;
+
 	const auto& then_expr = bcgen_body_block(vm, statement._then_body);
 	const auto& else_expr = bcgen_body_block(vm, statement._else_body);
 
-	body_acc._instrs.push_back(
-		bcgen_instruction_t(
-			bc_opcode::k_branch_false_bool,
-			condition_expr._out,
-			make_imm_int(static_cast<int>(then_expr._instrs.size()) + 2),
-			{}
-		)
-	);
+	body_acc = bcgen_branch_false(vm, statement._condition, static_cast<int>(then_expr._instrs.size()) + 2, body_acc);
 	body_acc = flatten_body(vm, body_acc, then_expr);
 	body_acc._instrs.push_back(
 		bcgen_instruction_t(
@@ -436,7 +721,7 @@ bcgen_body_t bcgen_ifelse_statement(bcgenerator_t& vm, const statement_t::ifelse
 
 	BODY
 
-	k_add_int
+	k_add_int_imm
 	k_branch_smaller_or_equal_int / k_branch_smaller_int, B TRUE
 	A:
 */
@@ -444,6 +729,83 @@ int get_count(const std::vector<bcgen_instruction_t>& instructions){
 	return static_cast<int>(instructions.size());
 }
 
+//	Does any store2 in body, or its nested bodies, write reg? reg is relative to body's own environment.
+bool is_stored_in_body(const body_t& body, const variable_address_t& reg){
+	const auto outer_reg = variable_address_t::make_variable_address(reg._parent_steps + 1, reg._index);
+	for(const auto& s: body._statements){
+		if(const auto store = std::get_if<statement_t::store2_t>(&s._contents)){
+			if(store->_dest_variable == reg){
+				return true;
+			}
+		}
+		else if(const auto block = std::get_if<statement_t::block_statement_t>(&s._contents)){
+			if(is_stored_in_body(block->_body, outer_reg)){
+				return true;
+			}
+		}
+		else if(const auto ifelse = std::get_if<statement_t::ifelse_statement_t>(&s._contents)){
+			if(is_stored_in_body(ifelse->_then_body, outer_reg) || is_stored_in_body(ifelse->_else_body, outer_reg)){
+				return true;
+			}
+		}
+		else if(const auto for_loop = std::get_if<statement_t::for_statement_t>(&s._contents)){
+			if(is_stored_in_body(for_loop->_body, outer_reg)){
+				return true;
+			}
+		}
+		else if(const auto while_loop = std::get_if<statement_t::while_statement_t>(&s._contents)){
+			if(is_stored_in_body(while_loop->_body, outer_reg)){
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+/*
+	Recognizes "for(i in 0 ..< size(v))" where the body never stores to v: then v[i] is always in bounds.
+	v must be a local (or an outer block's local) so no function call can replace it behind our back.
+*/
+std::vector<bcgen_safe_lookup_t> get_safe_lookups(bcgenerator_t& vm, const statement_t::for_statement_t& statement){
+	const auto& start = statement._start_expression;
+	const auto& end = statement._end_expression;
+	if(
+		statement._range_type != statement_t::for_statement_t::k_open_range
+		|| start.get_operation() != expression_type::k_literal
+		|| start.get_output_type().is_int() == false
+		|| start.get_literal().get_int_value() < 0
+		|| end.get_operation() != expression_type::k_call
+		|| end._input_exprs.size() != 2
+		|| end._input_exprs[0].get_operation() != expression_type::k_load2
+		|| get_host_function_id(vm, end) != 1007
+	){
+		return {};
+	}
+	const auto& vector_expr = end._input_exprs[1];
+	if(
+		vector_expr.get_operation() != expression_type::k_load2
+		|| vector_expr._address._parent_steps < 0
+		|| vector_expr.get_output_type().is_vector() == false
+	){
+		return {};
+	}
+
+	//	The loop body is one environment deeper than the for-statement.
+	const auto body_vector_reg = variable_address_t::make_variable_address(vector_expr._address._parent_steps + 1, vector_expr._address._index);
+	const auto body_iterator_reg = variable_address_t::make_variable_address(0, 0);
+	if(is_stored_in_body(statement._body, body_vector_reg) || is_stored_in_body(statement._body, body_iterator_reg)){
+		return {};
+	}
+	return {
+		bcgen_safe_lookup_t{
+			get_environment_level(vm, vector_expr._address),
+			vector_expr._address._index,
+			static_cast<int>(vm._call_stack.size()),
+			0
+		}
+	};
+}
+
 bcgen_body_t bcgen_for_statement(bcgenerator_t& vm, const statement_t::for_statement_t& statement, const bcgen_body_t& body){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(body.check_invariant());
@@ -456,9 +818,10 @@ bcgen_body_t bcgen_for_statement(bcgenerator_t& vm, const statement_t::for_state
 	const auto end_expr = bcgen_expression(vm, {}, statement._end_expression, body_acc);
 	body_acc = end_expr._body;
 
-	const auto const1_reg = add_local_const(body_acc, value_t::make_int(1), "integer 1, to decrement with");
-
-	const auto& loop_body = bcgen_body_block(vm, statement._body);
+	const auto safe_lookups = get_safe_lookups(vm, statement);
+	vm._safe_lookups.insert(vm._safe_lookups.end(), safe_lookups.begin(), safe_lookups.end());
+	const auto loop_body = bcgen_body_block(vm, statement._body);
+	vm._safe_lookups.resize(vm._safe_lookups.size() - safe_lookups.size());
 	int body_instr_count = get_count(loop_body._instrs);
 
 	QUARK_ASSERT(
@@ -467,19 +830,23 @@ bcgen_body_t bcgen_for_statement(bcgenerator_t& vm, const statement_t::for_state
 	);
 	const auto condition_opcode = statement._range_type == statement_t::for_statement_t::k_closed_range ? bc_opcode::k_branch_smaller_or_equal_int : bc_opcode::k_branch_smaller_int;
 
+	//	Leaves before the first iteration if the range is empty: end < start for closed ranges, end <= start for open ranges.
+	const auto leave_opcode = statement._range_type == statement_t::for_statement_t::k_closed_range ? bc_opcode::k_branch_smaller_int : bc_opcode::k_branch_smaller_or_equal_int;
+
 	//	IMPORTANT: Iterator register is the FIRST symbol of the loop body's symbol table.
 	const auto counter_reg = variable_address_t::make_variable_address(0, static_cast<int>(body_acc._symbols._symbols.size()));
 	body_acc._instrs.push_back(bcgen_instruction_t(bc_opcode::k_copy_reg_inplace_value, counter_reg, start_expr._out, {}));
 
 	// Reuse start value as our counter.
 	// Notice: we need to store iterator value in body's first register.
-	int leave_pc = 1 + body_instr_count + 2;
-	body_acc._instrs.push_back(bcgen_instruction_t(condition_opcode, end_expr._out, counter_reg, make_imm_int(leave_pc - get_count(body_acc._instrs))));
+	//	Skips the check itself, the body, the increment and the backward branch.
+	const int leave_offset = 1 + body_instr_count + 2;
+	body_acc._instrs.push_back(bcgen_instruction_t(leave_opcode, end_expr._out, counter_reg, make_imm_int(leave_offset)));
 
 	int body_start_pc = get_count(body_acc._instrs);
 
 	body_acc = flatten_body(vm, body_acc, loop_body);
-	body_acc._instrs.push_back(bcgen_instruction_t(bc_opcode::k_add_int, counter_reg, counter_reg, const1_reg));
+	body_acc._instrs.push_back(bcgen_instruction_t(bc_opcode::k_add_int_imm, counter_reg, counter_reg, make_imm_int(1)));
 	body_acc._instrs.push_back(bcgen_instruction_t(condition_opcode, counter_reg, end_expr._out, make_imm_int(body_start_pc - get_count(body_acc._instrs))));
 
 	QUARK_ASSERT(body_acc.check_invariant());
@@ -496,9 +863,7 @@ bcgen_body_t bcgen_while_statement(bcgenerator_t& vm, const statement_t::while_s
 	int body_instr_count = static_cast<int>(loop_body._instrs.size());
 	const auto condition_pc = static_cast<int>(body_acc._instrs.size());
 
-	const auto condition_expr = bcgen_expression(vm, {}, statement._condition, body_acc);
-	body_acc = condition_expr._body;
-	body_acc._instrs.push_back(bcgen_instruction_t(bc_opcode::k_branch_false_bool, condition_expr._out, make_imm_int(body_instr_count + 2), {}));
+	body_acc = bcgen_branch_false(vm, statement._condition, body_instr_count + 2, body_acc);
 	body_acc = flatten_body(vm, body_acc, loop_body);
 	const auto body_end_pc = static_cast<int>(body_acc._instrs.size());
 	body_acc._instrs.push_back(bcgen_instruction_t(bc_opcode::k_branch_always, make_imm_int(condition_pc - body_end_pc), {}, {} ));
@@ -602,7 +967,7 @@ bcgen_body_t bcgen_body_top(bcgenerator_t& vm, const body_t& body){
 	auto body_acc = bcgen_body_block(vm, body);
 
 	//	Append a stop to make sure execution doesn't leave instruction vector.
-	if(body_acc._instrs.empty() == true || body_acc._instrs.back()._opcode != bc_opcode::k_return){
+	if(body_acc._instrs.empty() == true || (body_acc._instrs.back()._opcode != bc_opcode::k_return && body_acc._instrs.back()._opcode != bc_opcode::k_tail_call)){
 		body_acc._instrs.push_back(bcgen_instruction_t(bc_opcode::k_stop, {}, {}, {}));
 	}
 
@@ -640,6 +1005,36 @@ expression_gen_t bcgen_resolve_member_expression(bcgenerator_t& vm, const variab
 	return { body_acc, target_reg2, intern_type(vm, *e._output_type) };
 }
 
+//	Level in _call_stack of the environment a local register lives in.
+int get_environment_level(const bcgenerator_t& vm, const variable_address_t& reg){
+	QUARK_ASSERT(reg._parent_steps >= 0);
+	return static_cast<int>(vm._call_stack.size()) - 1 - reg._parent_steps;
+}
+
+//	v[i] where a for-loop being generated has proven i inside 0 ..< size(v).
+bool is_safe_lookup(const bcgenerator_t& vm, const expression_t& e){
+	const auto& parent = e._input_exprs[0];
+	const auto& key = e._input_exprs[1];
+	if(
+		parent.get_operation() != expression_type::k_load2
+		|| key.get_operation() != expression_type::k_load2
+		|| parent._address._parent_steps < 0
+		|| key._address._parent_steps < 0
+		|| parent.get_output_type().is_vector() == false
+	){
+		return false;
+	}
+	for(const auto& safe: vm._safe_lookups){
+		if(
+			safe._vector_level == get_environment_level(vm, parent._address) && safe._vector_index == parent._address._index
+			&& safe._iterator_level == get_environment_level(vm, key._address) && safe._iterator_index == key._address._index
+		){
+			return true;
+		}
+	}
+	return false;
+}
+
 expression_gen_t bcgen_lookup_element_expression(bcgenerator_t& vm, const variable_address_t& target_reg, const expression_t& e, const bcgen_body_t& body){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(e.check_invariant());
@@ -654,7 +1049,8 @@ expression_gen_t bcgen_lookup_element_expression(bcgenerator_t& vm, const variab
 	body_acc = key_expr._body;
 
 	const auto parent_type = vm._types[parent_expr._type];
-	const auto opcode = [&parent_type]{
+	const auto unchecked = is_safe_lookup(vm, e);
+	const auto opcode = [&parent_type, unchecked]{
 		if(parent_type.is_string()){
 			return bc_opcode::k_lookup_element_string;
 		}
@@ -663,10 +1059,10 @@ expression_gen_t bcgen_lookup_element_expression(bcgenerator_t& vm, const variab
 		}
 		else if(parent_type.is_vector()){
 			if(encode_as_vector_w_inplace_elements(parent_type)){
-				return bc_opcode::k_lookup_element_vector_w_inplace_elements;
+				return unchecked ? bc_opcode::k_lookup_element_vector_w_inplace_elements_unchecked : bc_opcode::k_lookup_element_vector_w_inplace_elements;
 			}
 			else{
-				return bc_opcode::k_lookup_element_vector_w_external_elements;
+				return unchecked ? bc_opcode::k_lookup_element_vector_w_external_elements_unchecked : bc_opcode::k_lookup_element_vector_w_external_elements;
 			}
 		}
 		else if(parent_type.is_dict()){
@@ -878,6 +1274,177 @@ bc_opcode convert_call_to_pushback_opcode(const typeid_t& arg1_type){
 	}
 }
 
+//	find(), exists(), erase(), update(), subset() and replace() use DYN-arguments which are resolved at runtime.
+//	When we make opcodes we need to check the types at compile time = now. Returns k_nop if types don't match: use the host function.
+bc_opcode convert_call_to_find_opcode(const typeid_t& arg1_type, const typeid_t& arg2_type){
+	QUARK_ASSERT(arg1_type.check_invariant());
+	QUARK_ASSERT(arg2_type.check_invariant());
+
+	if(arg1_type.is_string() && arg2_type.is_string()){
+		return bc_opcode::k_find_string;
+	}
+	else if(arg1_type.is_vector() && arg1_type.get_vector_element_type() == arg2_type){
+		if(encode_as_vector_w_inplace_elements(arg1_type)){
+			if(arg2_type.is_bool() || arg2_type.is_int() || arg2_type.is_double()){
+				return bc_opcode::k_find_vector_w_inplace_elements;
+			}
+			else{
+				return bc_opcode::k_nop;
+			}
+		}
+		else{
+			return bc_opcode::k_find_vector_w_external_elements;
+		}
+	}
+	else{
+		return bc_opcode::k_nop;
+	}
+}
+
+bc_opcode convert_call_to_exists_opcode(const typeid_t& arg1_type, const typeid_t& arg2_type){
+	QUARK_ASSERT(arg1_type.check_invariant());
+	QUARK_ASSERT(arg2_type.check_invariant());
+
+	if(arg1_type.is_dict() && arg2_type.is_string()){
+		if(encode_as_dict_w_inplace_values(arg1_type)){
+			return bc_opcode::k_exists_dict_w_inplace_values;
+		}
+		else{
+			return bc_opcode::k_exists_dict_w_external_values;
+		}
+	}
+	else{
+		return bc_opcode::k_nop;
+	}
+}
+
+bc_opcode convert_call_to_erase_opcode(const typeid_t& arg1_type, const typeid_t& arg2_type){
+	QUARK_ASSERT(arg1_type.check_invariant());
+	QUARK_ASSERT(arg2_type.check_invariant());
+
+	if(arg1_type.is_dict() && arg2_type.is_string()){
+		if(encode_as_dict_w_inplace_values(arg1_type)){
+			return bc_opcode::k_erase_dict_w_inplace_values;
+		}
+		else{
+			return bc_opcode::k_erase_dict_w_external_values;
+		}
+	}
+	else{
+		return bc_opcode::k_nop;
+	}
+}
+
+bc_opcode convert_call_to_subset_opcode(const typeid_t& arg1_type){
+	QUARK_ASSERT(arg1_type.check_invariant());
+
+	if(arg1_type.is_string()){
+		return bc_opcode::k_subset_string;
+	}
+	else if(arg1_type.is_vector()){
+		if(encode_as_vector_w_inplace_elements(arg1_type)){
+			return bc_opcode::k_subset_vector_w_inplace_elements;
+		}
+		else{
+			return bc_opcode::k_subset_vector_w_external_elements;
+		}
+	}
+	else{
+		return bc_opcode::k_nop;
+	}
+}
+
+bc_opcode convert_call_to_replace_opcode(const typeid_t& arg1_type, const typeid_t& arg4_type){
+	QUARK_ASSERT(arg1_type.check_invariant());
+	QUARK_ASSERT(arg4_type.check_invariant());
+
+	if(arg1_type != arg4_type){
+		return bc_opcode::k_nop;
+	}
+	else if(arg1_type.is_string()){
+		return bc_opcode::k_replace_string;
+	}
+	else if(arg1_type.is_vector()){
+		if(encode_as_vector_w_inplace_elements(arg1_type)){
+			return bc_opcode::k_replace_vector_w_inplace_elements;
+		}
+		else{
+			return bc_opcode::k_replace_vector_w_external_elements;
+		}
+	}
+	else{
+		return bc_opcode::k_nop;
+	}
+}
+
+bc_opcode convert_call_to_update_opcode(const typeid_t& arg1_type, const typeid_t& arg2_type, const typeid_t& arg3_type){
+	QUARK_ASSERT(arg1_type.check_invariant());
+	QUARK_ASSERT(arg2_type.check_invariant());
+	QUARK_ASSERT(arg3_type.check_invariant());
+
+	if(arg1_type.is_vector() && arg2_type.is_int() && arg1_type.get_vector_element_type() == arg3_type){
+		if(encode_as_vector_w_inplace_elements(arg1_type)){
+			return bc_opcode::k_update_vector_w_inplace_elements;
+		}
+		else{
+			return bc_opcode::k_update_vector_w_external_elements;
+		}
+	}
+	else if(arg1_type.is_dict() && arg2_type.is_string() && arg1_type.get_dict_value_type() == arg3_type){
+		if(encode_as_dict_w_inplace_values(arg1_type)){
+			return bc_opcode::k_update_dict_w_inplace_values;
+		}
+		else{
+			return bc_opcode::k_update_dict_w_external_values;
+		}
+	}
+	else{
+		return bc_opcode::k_nop;
+	}
+}
+
+//	Generates a = op(b, c) for a built-in that has an opcode.
+expression_gen_t bcgen_builtin_rr_opcode(bcgenerator_t& vm, bc_opcode opcode, const variable_address_t& target_reg, const expression_t& e, const bcgen_body_t& body){
+	auto body_acc = body;
+
+	const auto& arg1_expr = bcgen_expression(vm, {}, e._input_exprs[1], body_acc);
+	body_acc = arg1_expr._body;
+
+	const auto& arg2_expr = bcgen_expression(vm, {}, e._input_exprs[2], body_acc);
+	body_acc = arg2_expr._body;
+
+	const auto target_reg2 = target_reg.is_empty() ? add_local_temp(body_acc, e.get_output_type(), "temp: result for built-in opcode") : target_reg;
+	body_acc._instrs.push_back(bcgen_instruction_t(opcode, target_reg2, arg1_expr._out, arg2_expr._out));
+	QUARK_ASSERT(body_acc.check_invariant());
+	return { body_acc, target_reg2, intern_type(vm, e.get_output_type()) };
+}
+
+//	Generates a = op(b, c, c + 1, ...) for a built-in that has an opcode.
+//	Instructions only have 3 registers: the arguments after the first go into consecutive temps, C tells the first of them.
+expression_gen_t bcgen_builtin_rrange_opcode(bcgenerator_t& vm, bc_opcode opcode, const variable_address_t& target_reg, const expression_t& e, const bcgen_body_t& body){
+	auto body_acc = body;
+
+	const auto& arg1_expr = bcgen_expression(vm, {}, e._input_exprs[1], body_acc);
+	body_acc = arg1_expr._body;
+
+	const auto input_count = static_cast<int>(e._input_exprs.size());
+	std::vector<variable_address_t> range_regs;
+	for(int a = 2 ; a < input_count ; a++){
+		range_regs.push_back(add_local_temp(body_acc, e._input_exprs[a].get_output_type(), "temp: argument for built-in opcode"));
+		QUARK_ASSERT(range_regs.back()._index == range_regs.front()._index + a - 2);
+	}
+	for(int a = 2 ; a < input_count ; a++){
+		const auto& arg_expr = bcgen_expression(vm, range_regs[a - 2], e._input_exprs[a], body_acc);
+		body_acc = arg_expr._body;
+		QUARK_ASSERT(arg_expr._out == range_regs[a - 2]);
+	}
+
+	const auto target_reg2 = target_reg.is_empty() ? add_local_temp(body_acc, e.get_output_type(), "temp: result for built-in opcode") : target_reg;
+	body_acc._instrs.push_back(bcgen_instruction_t(opcode, target_reg2, arg1_expr._out, range_regs.front()));
+	QUARK_ASSERT(body_acc.check_invariant());
+	return { body_acc, target_reg2, intern_type(vm, e.get_output_type()) };
+}
+
 expression_gen_t bcgen_call_expression(bcgenerator_t& vm, const variable_address_t& target_reg, const expression_t& e, const bcgen_body_t& body){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(e.check_invariant());
@@ -944,13 +1511,67 @@ expression_gen_t bcgen_call_expression(bcgenerator_t& vm, const variable_address
 		}
 	}
 
+	//	a = find(b, c)
+	else if(host_function_id == 1008 && arg_count == 2){
+		const auto opcode = convert_call_to_find_opcode(e._input_exprs[1].get_output_type(), e._input_exprs[2].get_output_type());
+		if(opcode != bc_opcode::k_nop){
+			return bcgen_builtin_rr_opcode(vm, opcode, target_reg, e, body_acc);
+		}
+	}
 
-	//	Normal function call.
-	{
-		body_acc._instrs.push_back(bcgen_instruction_t(bc_opcode::k_push_frame_ptr, {}, {}, {} ));
-
-		const auto& callee_expr = bcgen_expression(vm, {}, e._input_exprs[0], body_acc);
-		body_acc = callee_expr._body;
+	//	a = exists(b, c)
+	else if(host_function_id == 1009 && arg_count == 2){
+		const auto opcode = convert_call_to_exists_opcode(e._input_exprs[1].get_output_type(), e._input_exprs[2].get_output_type());
+		if(opcode != bc_opcode::k_nop){
+			return bcgen_builtin_rr_opcode(vm, opcode, target_reg, e, body_acc);
+		}
+	}
+
+	//	a = erase(b, c)
+	else if(host_function_id == 1010 && arg_count == 2){
+		const auto opcode = convert_call_to_erase_opcode(e._input_exprs[1].get_output_type(), e._input_exprs[2].get_output_type());
+		if(opcode != bc_opcode::k_nop){
+			return bcgen_builtin_rr_opcode(vm, opcode, target_reg, e, body_acc);
+		}
+	}
+
+	//	a = update(b, key, value)
+	else if(host_function_id == 1006 && arg_count == 3){
+		const auto opcode = convert_call_to_update_opcode(e._input_exprs[1].get_output_type(), e._input_exprs[2].get_output_type(), e._input_exprs[3].get_output_type());
+		if(opcode != bc_opcode::k_nop){
+			return bcgen_builtin_rrange_opcode(vm, opcode, target_reg, e, body_acc);
+		}
+	}
+
+	//	a = subset(b, start, end)
+	else if(host_function_id == 1012 && arg_count == 3){
+		const auto opcode = convert_call_to_subset_opcode(e._input_exprs[1].get_output_type());
+		if(opcode != bc_opcode::k_nop){
+			return bcgen_builtin_rrange_opcode(vm, opcode, target_reg, e, body_acc);
+		}
+	}
+
+	//	a = replace(b, start, end, new_bits)
+	else if(host_function_id == 1013 && arg_count == 4){
+		const auto opcode = convert_call_to_replace_opcode(e._input_exprs[1].get_output_type(), e._input_exprs[4].get_output_type());
+		if(opcode != bc_opcode::k_nop){
+			return bcgen_builtin_rrange_opcode(vm, opcode, target_reg, e, body_acc);
+		}
+	}
+
+
+	//	Small pure Floyd function: splice its body in instead of calling it.
+	const auto inline_body = get_inline_body(vm, e);
+	if(inline_body){
+		return bcgen_inline_call(vm, target_reg, e, *inline_body, body_acc);
+	}
+
+	//	Normal function call.
+	{
+		body_acc._instrs.push_back(bcgen_instruction_t(bc_opcode::k_push_frame_ptr, {}, {}, {} ));
+
+		const auto& callee_expr = bcgen_expression(vm, {}, e._input_exprs[0], body_acc);
+		body_acc = callee_expr._body;
 
 		const auto call_setup = gen_call_setup(vm, function_def_arg_types, &e._input_exprs[1], callee_arg_count, body_acc);
 		body_acc = call_setup._body;
@@ -975,6 +1596,87 @@ expression_gen_t bcgen_call_expression(bcgenerator_t& vm, const variable_address
 	}
 }
 
+int get_global_function_id(const ast_t& ast, int global_index){
+	const auto& symbol = ast._globals._symbols._symbols[global_index].second;
+	if(symbol._const_value.is_function()){
+		return symbol._const_value.get_function_value();
+	}
+	else if(symbol._symbol_type != symbol_t::immutable_local){
+		return -1;
+	}
+
+	for(const auto& s: ast._globals._statements){
+		const auto store = std::get_if<statement_t::store2_t>(&s._contents);
+		if(
+			store != nullptr
+			&& store->_dest_variable._parent_steps == 0
+			&& store->_dest_variable._index == global_index
+			&& store->_expression.get_operation() == expression_type::k_literal
+			&& store->_expression.get_literal().is_function()
+		){
+			return store->_expression.get_literal().get_function_value();
+		}
+	}
+	return -1;
+}
+
+//	Function id of a callee that is a global bound straight to a function, see get_global_function_id() in the header. Else -1.
+int get_global_function_id(const bcgenerator_t& vm, const expression_t& callee){
+	if(callee._operation != expression_type::k_load2 || callee._address._parent_steps != -1){
+		return -1;
+	}
+	return get_global_function_id(vm._ast_imm->_checked_ast, callee._address._index);
+}
+
+//	"return f(...)" can reuse our frame if f is a Floyd function that stores its arguments and result the same way we do.
+bool is_tail_call(bcgenerator_t& vm, const expression_t& e){
+	if(vm._current_function_id == -1 || e.get_operation() != expression_type::k_call){
+		return false;
+	}
+	const auto function_id = get_global_function_id(vm, e._input_exprs[0]);
+	if(function_id == -1 || vm._ast_imm->_checked_ast._function_defs[function_id]->_host_function_id != 0){
+		return false;
+	}
+
+	const auto& own_type = vm._ast_imm->_checked_ast._function_defs[vm._current_function_id]->_function_type;
+	const auto& own_args = own_type.get_function_args();
+	const auto callee_args = e._input_exprs[0].get_output_type().get_function_args();
+	if(own_args.size() != callee_args.size() || own_type.get_function_return() != e.get_output_type()){
+		return false;
+	}
+	for(size_t i = 0 ; i < own_args.size() ; i++){
+		if(
+			own_args[i].is_internal_dynamic()
+			|| callee_args[i].is_internal_dynamic()
+			|| encode_as_external(own_args[i]) != encode_as_external(callee_args[i])
+		){
+			return false;
+		}
+	}
+	return true;
+}
+
+//	Like a normal call but without k_push_frame_ptr, the result register and the cleanup after the call: k_tail_call never comes back.
+bcgen_body_t bcgen_tail_call(bcgenerator_t& vm, const expression_t& e, const bcgen_body_t& body){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(e.check_invariant());
+	QUARK_ASSERT(body.check_invariant());
+
+	auto body_acc = body;
+	const auto callee_arg_count = static_cast<int>(e._input_exprs.size()) - 1;
+
+	const auto& callee_expr = bcgen_expression(vm, {}, e._input_exprs[0], body_acc);
+	body_acc = callee_expr._body;
+
+	const auto call_setup = gen_call_setup(vm, e._input_exprs[0].get_output_type().get_function_args(), &e._input_exprs[1], callee_arg_count, body_acc);
+	body_acc = call_setup._body;
+
+	body_acc._instrs.push_back(bcgen_instruction_t(bc_opcode::k_tail_call, callee_expr._out, make_imm_int(callee_arg_count), {}));
+
+	QUARK_ASSERT(body_acc.check_invariant());
+	return body_acc;
+}
+
 //??? Submit dest-register to all gen-functions = minimize temps.
 //??? Wrap itype in struct to make it typesafe.
 
@@ -1155,6 +1857,71 @@ expression_gen_t bcgen_conditional_operator_expression(bcgenerator_t& vm, const
 	return { body_acc, target_reg2, result_itype };
 }
 
+//	Returns the opcode that writes a bool for a comparison. Bool tells if to flip left / right.
+std::pair<bool, bc_opcode> convert_comparison_to_opcode(const typeid_t& type, expression_type op){
+	static const std::map<expression_type, std::pair<bool, bc_opcode>> conv_opcode_int = {
+		{ expression_type::k_comparison_smaller_or_equal__2,			{ false, bc_opcode::k_comparison_smaller_or_equal_int } },
+		{ expression_type::k_comparison_smaller__2,						{ false, bc_opcode::k_comparison_smaller_int } },
+		{ expression_type::k_comparison_larger_or_equal__2,				{ true, bc_opcode::k_comparison_smaller_or_equal_int } },
+		{ expression_type::k_comparison_larger__2,						{ true, bc_opcode::k_comparison_smaller_int } },
+
+		{ expression_type::k_logical_equal__2,							{ false, bc_opcode::k_logical_equal_int } },
+		{ expression_type::k_logical_nonequal__2,						{ false, bc_opcode::k_logical_nonequal_int } }
+	};
+	static const std::map<expression_type, std::pair<bool, bc_opcode>> conv_opcode_double = {
+		{ expression_type::k_comparison_smaller_or_equal__2,			{ false, bc_opcode::k_comparison_smaller_or_equal_double } },
+		{ expression_type::k_comparison_smaller__2,						{ false, bc_opcode::k_comparison_smaller_double } },
+		{ expression_type::k_comparison_larger_or_equal__2,				{ true, bc_opcode::k_comparison_smaller_or_equal_double } },
+		{ expression_type::k_comparison_larger__2,						{ true, bc_opcode::k_comparison_smaller_double } },
+
+		{ expression_type::k_logical_equal__2,							{ false, bc_opcode::k_logical_equal_double } },
+		{ expression_type::k_logical_nonequal__2,						{ false, bc_opcode::k_logical_nonequal_double } }
+	};
+	static const std::map<expression_type, std::pair<bool, bc_opcode>> conv_opcode_string = {
+		{ expression_type::k_comparison_smaller_or_equal__2,			{ false, bc_opcode::k_comparison_smaller_or_equal_string } },
+		{ expression_type::k_comparison_smaller__2,						{ false, bc_opcode::k_comparison_smaller_string } },
+		{ expression_type::k_comparison_larger_or_equal__2,				{ true, bc_opcode::k_comparison_smaller_or_equal_string } },
+		{ expression_type::k_comparison_larger__2,						{ true, bc_opcode::k_comparison_smaller_string } },
+
+		{ expression_type::k_logical_equal__2,							{ false, bc_opcode::k_logical_equal_string } },
+		{ expression_type::k_logical_nonequal__2,						{ false, bc_opcode::k_logical_nonequal_string } }
+	};
+	static const std::map<expression_type, std::pair<bool, bc_opcode>> conv_opcode_bool = {
+		{ expression_type::k_comparison_smaller_or_equal__2,			{ false, bc_opcode::k_comparison_smaller_or_equal_bool } },
+		{ expression_type::k_comparison_smaller__2,						{ false, bc_opcode::k_comparison_smaller_bool } },
+		{ expression_type::k_comparison_larger_or_equal__2,				{ true, bc_opcode::k_comparison_smaller_or_equal_bool } },
+		{ expression_type::k_comparison_larger__2,						{ true, bc_opcode::k_comparison_smaller_bool } },
+
+		{ expression_type::k_logical_equal__2,							{ false, bc_opcode::k_logical_equal_bool } },
+		{ expression_type::k_logical_nonequal__2,						{ false, bc_opcode::k_logical_nonequal_bool } }
+	};
+	static const std::map<expression_type, std::pair<bool, bc_opcode>> conv_opcode = {
+		{ expression_type::k_comparison_smaller_or_equal__2,			{ false, bc_opcode::k_comparison_smaller_or_equal } },
+		{ expression_type::k_comparison_smaller__2,						{ false, bc_opcode::k_comparison_smaller } },
+		{ expression_type::k_comparison_larger_or_equal__2,				{ true, bc_opcode::k_comparison_smaller_or_equal } },
+		{ expression_type::k_comparison_larger__2,						{ true, bc_opcode::k_comparison_smaller } },
+
+		{ expression_type::k_logical_equal__2,							{ false, bc_opcode::k_logical_equal } },
+		{ expression_type::k_logical_nonequal__2,						{ false, bc_opcode::k_logical_nonequal } }
+	};
+
+	if(type.is_int()){
+		return conv_opcode_int.at(op);
+	}
+	else if(type.is_double()){
+		return conv_opcode_double.at(op);
+	}
+	else if(type.is_string()){
+		return conv_opcode_string.at(op);
+	}
+	else if(type.is_bool()){
+		return conv_opcode_bool.at(op);
+	}
+	else{
+		return conv_opcode.at(op);
+	}
+}
+
 expression_gen_t bcgen_comparison_expression(bcgenerator_t& vm, const variable_address_t& target_reg, expression_type op, const expression_t& e, const bcgen_body_t& body){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(e.check_invariant());
@@ -1162,6 +1929,21 @@ expression_gen_t bcgen_comparison_expression(bcgenerator_t& vm, const variable_a
 
 	auto body_acc = body;
 
+	//	Output reg always a bool.
+	QUARK_ASSERT(e.get_output_type().is_bool());
+
+	//	Comparing an int with a literal: put it in the instruction instead of in a constant register.
+	const auto imm = convert_comparison_to_imm_opcode(e, false);
+	if(imm._opcode != bc_opcode::k_nop){
+		const auto& reg_expr = bcgen_expression(vm, {}, e._input_exprs[imm._reg_input], body_acc);
+		body_acc = reg_expr._body;
+
+		const auto target_reg2 = target_reg.is_empty() ? add_local_temp(body_acc, e.get_output_type(), "temp: comparison flag") : target_reg;
+		body_acc._instrs.push_back(bcgen_instruction_t(imm._opcode, target_reg2, reg_expr._out, make_imm_int(imm._imm)));
+		QUARK_ASSERT(body_acc.check_invariant());
+		return { body_acc, target_reg2, intern_type(vm, typeid_t::make_bool()) };
+	}
+
 	const auto& left_expr = bcgen_expression(vm, {}, e._input_exprs[0], body_acc);
 	body_acc = left_expr._body;
 
@@ -1176,47 +1958,13 @@ expression_gen_t bcgen_comparison_expression(bcgenerator_t& vm, const variable_a
 	QUARK_ASSERT(e.get_output_type().is_bool());
 	const auto target_reg2 = target_reg.is_empty() ? add_local_temp(body_acc, e.get_output_type(), "temp: comparison flag") : target_reg;
 
-	if(type.is_int()){
-
-		//	Bool tells if to flip left / right.
-		static const std::map<expression_type, std::pair<bool, bc_opcode>> conv_opcode_int = {
-			{ expression_type::k_comparison_smaller_or_equal__2,			{ false, bc_opcode::k_comparison_smaller_or_equal_int } },
-			{ expression_type::k_comparison_smaller__2,						{ false, bc_opcode::k_comparison_smaller_int } },
-			{ expression_type::k_comparison_larger_or_equal__2,				{ true, bc_opcode::k_comparison_smaller_or_equal_int } },
-			{ expression_type::k_comparison_larger__2,						{ true, bc_opcode::k_comparison_smaller_int } },
-
-			{ expression_type::k_logical_equal__2,							{ false, bc_opcode::k_logical_equal_int } },
-			{ expression_type::k_logical_nonequal__2,						{ false, bc_opcode::k_logical_nonequal_int } }
-		};
-
-		const auto result = conv_opcode_int.at(e._operation);
-		if(result.first == false){
-			body_acc._instrs.push_back(bcgen_instruction_t(result.second, target_reg2, left_expr._out, right_expr._out));
-		}
-		else{
-			body_acc._instrs.push_back(bcgen_instruction_t(result.second, target_reg2, right_expr._out, left_expr._out));
-		}
+	//	Bool tells if to flip left / right.
+	const auto result = convert_comparison_to_opcode(type, e._operation);
+	if(result.first == false){
+		body_acc._instrs.push_back(bcgen_instruction_t(result.second, target_reg2, left_expr._out, right_expr._out));
 	}
 	else{
-
-		//	Bool tells if to flip left / right.
-		static const std::map<expression_type, std::pair<bool, bc_opcode>> conv_opcode = {
-			{ expression_type::k_comparison_smaller_or_equal__2,			{ false, bc_opcode::k_comparison_smaller_or_equal } },
-			{ expression_type::k_comparison_smaller__2,						{ false, bc_opcode::k_comparison_smaller } },
-			{ expression_type::k_comparison_larger_or_equal__2,				{ true, bc_opcode::k_comparison_smaller_or_equal } },
-			{ expression_type::k_comparison_larger__2,						{ true, bc_opcode::k_comparison_smaller } },
-
-			{ expression_type::k_logical_equal__2,							{ false, bc_opcode::k_logical_equal } },
-			{ expression_type::k_logical_nonequal__2,						{ false, bc_opcode::k_logical_nonequal } }
-		};
-
-		const auto result = conv_opcode.at(e._operation);
-		if(result.first == false){
-			body_acc._instrs.push_back(bcgen_instruction_t(result.second, target_reg2, left_expr._out, right_expr._out));
-		}
-		else{
-			body_acc._instrs.push_back(bcgen_instruction_t(result.second, target_reg2, right_expr._out, left_expr._out));
-		}
+		body_acc._instrs.push_back(bcgen_instruction_t(result.second, target_reg2, right_expr._out, left_expr._out));
 	}
 
 	QUARK_ASSERT(body_acc.check_invariant());
@@ -1230,6 +1978,18 @@ expression_gen_t bcgen_arithmetic_expression(bcgenerator_t& vm, const variable_a
 
 	auto body_acc = body;
 
+	//	One operand is a literal: put it in the instruction instead of in a constant register.
+	const auto imm = convert_arithmetic_to_imm_opcode(vm, e);
+	if(imm._opcode != bc_opcode::k_nop){
+		const auto& reg_expr = bcgen_expression(vm, {}, e._input_exprs[imm._reg_input], body_acc);
+		body_acc = reg_expr._body;
+
+		const auto target_reg2 = target_reg.is_empty() ? add_local_temp(body_acc, e.get_output_type(), "temp: arithmetic output") : target_reg;
+		body_acc._instrs.push_back(bcgen_instruction_t(imm._opcode, target_reg2, reg_expr._out, make_imm_int(imm._imm)));
+		QUARK_ASSERT(body_acc.check_invariant());
+		return { body_acc, target_reg2, intern_type(vm, e.get_output_type()) };
+	}
+
 	const auto& left_expr = bcgen_expression(vm, {}, e._input_exprs[0], body_acc);
 	body_acc = left_expr._body;
 
@@ -1408,13 +2168,25 @@ bcgenerator_t::bcgenerator_t(const semantic_ast_t& ast){
 	QUARK_ASSERT(ast.check_invariant());
 
 	_ast_imm = std::make_shared<semantic_ast_t>(ast);
+	_current_function_id = -1;
+
+	const auto inline_budget = ast._checked_ast._container_def._inline_budget;
+	_inline_budget = inline_budget >= 0 ? static_cast<int>(inline_budget) : k_default_inline_budget;
+	_inline_recursion = false;
 	QUARK_ASSERT(check_invariant());
 }
 
 bcgenerator_t::bcgenerator_t(const bcgenerator_t& other) :
 	_ast_imm(other._ast_imm),
 	_call_stack(other._call_stack),
-	_types(other._types)
+	_types(other._types),
+	_double_constants(other._double_constants),
+	_current_function_id(other._current_function_id),
+	_inline_budget(other._inline_budget),
+	_inline_bodies(other._inline_bodies),
+	_inline_stack(other._inline_stack),
+	_inline_recursion(other._inline_recursion),
+	_safe_lookups(other._safe_lookups)
 {
 	QUARK_ASSERT(other.check_invariant());
 	QUARK_ASSERT(check_invariant());
@@ -1424,6 +2196,13 @@ void bcgenerator_t::swap(bcgenerator_t& other) throw(){
 	other._ast_imm.swap(this->_ast_imm);
 	_call_stack.swap(this->_call_stack);
 	_types.swap(this->_types);
+	other._double_constants.swap(this->_double_constants);
+	std::swap(other._current_function_id, this->_current_function_id);
+	std::swap(other._inline_budget, this->_inline_budget);
+	other._inline_bodies.swap(this->_inline_bodies);
+	other._inline_stack.swap(this->_inline_stack);
+	std::swap(other._inline_recursion, this->_inline_recursion);
+	other._safe_lookups.swap(this->_safe_lookups);
 }
 
 const bcgenerator_t& bcgenerator_t::operator=(const bcgenerator_t& other){
@@ -1443,13 +2222,24 @@ bool bcgenerator_t::check_invariant() const {
 //////////////////////////////////////		FREE
 
 
+bool fits_int16(int value){
+	return value >= INT16_MIN && value <= INT16_MAX;
+}
+
+//	True if all operands fit the compact instruction, without a k_wide prefix.
+bool is_compact(const bcgen_instruction_t& instruction){
+	return fits_int16(instruction._reg_a._index) && fits_int16(instruction._reg_b._index) && fits_int16(instruction._reg_c._index);
+}
+
+//	Never truncates: operands that don't fit must go through squeeze_instructions(), which adds k_wide prefixes.
 bc_instruction_t squeeze_instruction(const bcgen_instruction_t& instruction){
 	QUARK_ASSERT(instruction._reg_a._parent_steps == 0 || instruction._reg_a._parent_steps == -1 || instruction._reg_a._parent_steps == 666);
 	QUARK_ASSERT(instruction._reg_b._parent_steps == 0 || instruction._reg_b._parent_steps == -1 || instruction._reg_b._parent_steps == 666);
 	QUARK_ASSERT(instruction._reg_c._parent_steps == 0 || instruction._reg_c._parent_steps == -1 || instruction._reg_c._parent_steps == 666);
-	QUARK_ASSERT(instruction._reg_a._index >= INT16_MIN && instruction._reg_a._index <= INT16_MAX);
-	QUARK_ASSERT(instruction._reg_b._index >= INT16_MIN && instruction._reg_b._index <= INT16_MAX);
-	QUARK_ASSERT(instruction._reg_c._index >= INT16_MIN && instruction._reg_c._index <= INT16_MAX);
+
+	if(is_compact(instruction) == false){
+		quark::throw_runtime_error("Bytecode operand out of range for " + k_opcode_info.at(instruction._opcode)._as_text + ".");
+	}
 
 	const auto encoding = k_opcode_info.at(instruction._opcode)._encoding;
 	const auto reg_flags = encoding_to_reg_flags(encoding);
@@ -1468,14 +2258,946 @@ bc_instruction_t squeeze_instruction(const bcgen_instruction_t& instruction){
 	return result;
 }
 
-bc_static_frame_t make_frame(const bcgen_body_t& body, const std::vector<typeid_t>& args){
+
+//////////////////////////////////////		PEEPHOLE
+
+
+//	Which operand of a branch instruction holds its relative offset: 0 = not a branch, 1 = A, 2 = B, 3 = C.
+int get_branch_offset_operand(bc_opcode opcode){
+	if(opcode == bc_opcode::k_branch_always){
+		return 1;
+	}
+	else if(
+		opcode == bc_opcode::k_branch_false_bool
+		|| opcode == bc_opcode::k_branch_true_bool
+		|| opcode == bc_opcode::k_branch_zero_int
+		|| opcode == bc_opcode::k_branch_notzero_int
+	){
+		return 2;
+	}
+	else if(
+		opcode == bc_opcode::k_branch_smaller_int
+		|| opcode == bc_opcode::k_branch_smaller_or_equal_int
+		|| opcode == bc_opcode::k_branch_equal_int
+		|| opcode == bc_opcode::k_branch_nonequal_int
+		|| opcode == bc_opcode::k_branch_smaller_double
+		|| opcode == bc_opcode::k_branch_smaller_or_equal_double
+		|| opcode == bc_opcode::k_branch_equal_double
+		|| opcode == bc_opcode::k_branch_nonequal_double
+		|| opcode == bc_opcode::k_branch_smaller_string
+		|| opcode == bc_opcode::k_branch_smaller_or_equal_string
+		|| opcode == bc_opcode::k_branch_equal_string
+		|| opcode == bc_opcode::k_branch_nonequal_string
+		|| opcode == bc_opcode::k_branch_smaller_bool
+		|| opcode == bc_opcode::k_branch_smaller_or_equal_bool
+		|| opcode == bc_opcode::k_branch_equal_bool
+		|| opcode == bc_opcode::k_branch_nonequal_bool
+		|| opcode == bc_opcode::k_branch_smaller_int_imm
+		|| opcode == bc_opcode::k_branch_smaller_or_equal_int_imm
+		|| opcode == bc_opcode::k_branch_larger_int_imm
+		|| opcode == bc_opcode::k_branch_larger_or_equal_int_imm
+		|| opcode == bc_opcode::k_branch_equal_int_imm
+		|| opcode == bc_opcode::k_branch_nonequal_int_imm
+	){
+		return 3;
+	}
+	else{
+		return 0;
+	}
+}
+
+variable_address_t& get_operand(bcgen_instruction_t& instruction, int operand){
+	QUARK_ASSERT(operand >= 1 && operand <= 3);
+	return operand == 1 ? instruction._reg_a : (operand == 2 ? instruction._reg_b : instruction._reg_c);
+}
+
+int get_branch_target(const bcgen_instruction_t& instruction, int pc){
+	const auto operand = get_branch_offset_operand(instruction._opcode);
+	QUARK_ASSERT(operand != 0);
+	const auto& reg = operand == 1 ? instruction._reg_a : (operand == 2 ? instruction._reg_b : instruction._reg_c);
+	return pc + reg._index;
+}
+
+bool is_terminator(bc_opcode opcode){
+	return opcode == bc_opcode::k_return || opcode == bc_opcode::k_stop || opcode == bc_opcode::k_branch_always || opcode == bc_opcode::k_tail_call;
+}
+
+//	True if the instruction stores its result into register A. Returns, pushes and branches only read A.
+bool writes_reg_a(bc_opcode opcode){
+	const auto reg_flags = encoding_to_reg_flags(k_opcode_info.at(opcode)._encoding);
+	return reg_flags._a
+		&& opcode != bc_opcode::k_return
+		&& opcode != bc_opcode::k_tail_call
+		&& opcode != bc_opcode::k_release_external_value
+		&& opcode != bc_opcode::k_push_inplace_value
+		&& opcode != bc_opcode::k_push_external_value
+		&& get_branch_offset_operand(opcode) == 0;
+}
+
+//	Registers read by an instruction without being named by an operand: subset / update / replace read C + 1 and C + 2.
+int get_implicit_reg_count(bc_opcode opcode){
+	if(
+		opcode == bc_opcode::k_subset_string
+		|| opcode == bc_opcode::k_subset_vector_w_external_elements
+		|| opcode == bc_opcode::k_subset_vector_w_inplace_elements
+		|| opcode == bc_opcode::k_update_vector_w_external_elements
+		|| opcode == bc_opcode::k_update_vector_w_inplace_elements
+		|| opcode == bc_opcode::k_update_dict_w_external_values
+		|| opcode == bc_opcode::k_update_dict_w_inplace_values
+	){
+		return 1;
+	}
+	else if(
+		opcode == bc_opcode::k_replace_string
+		|| opcode == bc_opcode::k_replace_vector_w_external_elements
+		|| opcode == bc_opcode::k_replace_vector_w_inplace_elements
+	){
+		return 2;
+	}
+	else{
+		return 0;
+	}
+}
+
+bool is_local_reg(const variable_address_t& reg){
+	return reg._parent_steps == 0;
+}
+
+bool is_copy_reg(bc_opcode opcode){
+	return opcode == bc_opcode::k_copy_reg_inplace_value || opcode == bc_opcode::k_copy_reg_external_value;
+}
+
+/*
+	Checks a finished body before it's squeezed into a frame. Throws on the first problem.
+	- Every register operand is a global or a local register inside the symbol table, including implicit registers.
+	- Every branch lands inside the body.
+	- The last instruction doesn't fall off the end.
+*/
+void verify_body(const bcgen_body_t& body){
+	const auto count = static_cast<int>(body._instrs.size());
+	const auto symbol_count = static_cast<int>(body._symbols._symbols.size());
+	if(count == 0 || is_terminator(body._instrs.back()._opcode) == false){
+		quark::throw_runtime_error("Bytecode verifier: body doesn't end with return, stop or branch.");
+	}
+
+	for(int pc = 0 ; pc < count ; pc++){
+		const auto& instruction = body._instrs[pc];
+		const auto reg_flags = encoding_to_reg_flags(k_opcode_info.at(instruction._opcode)._encoding);
+		const bool flags[3] = { reg_flags._a, reg_flags._b, reg_flags._c };
+		const variable_address_t* regs[3] = { &instruction._reg_a, &instruction._reg_b, &instruction._reg_c };
+		for(int operand = 0 ; operand < 3 ; operand++){
+			if(flags[operand]){
+				const auto& reg = *regs[operand];
+				if(reg._parent_steps != -1 && (reg._parent_steps != 0 || reg._index < 0 || reg._index >= symbol_count)){
+					quark::throw_runtime_error("Bytecode verifier: register out of range.");
+				}
+			}
+		}
+		const auto implicit_count = get_implicit_reg_count(instruction._opcode);
+		if(implicit_count > 0 && (instruction._reg_c._parent_steps != 0 || instruction._reg_c._index + implicit_count >= symbol_count)){
+			quark::throw_runtime_error("Bytecode verifier: implicit register out of range.");
+		}
+		if(get_branch_offset_operand(instruction._opcode) != 0){
+			const auto target = get_branch_target(instruction, pc);
+			if(target < 0 || target >= count){
+				quark::throw_runtime_error("Bytecode verifier: branch target out of range.");
+			}
+		}
+	}
+}
+
+/*
+	One round of cleanup. Returns true if anything changed.
+
+	- Branches to k_branch_always are threaded to the final target.
+	- Unreachable instructions, k_nops and k_branch_always to the next instruction are removed.
+	- "op temp, ... ; copy_reg dest, temp" becomes "op dest, ..." when temp is read nowhere else and the copy isn't a branch target.
+*/
+bool peephole_round(bcgen_body_t& body){
+	auto& instrs = body._instrs;
+	const auto count = static_cast<int>(instrs.size());
+	bool changed = false;
+
+	//	Thread branch chains. Limit the hops: "while(true){}" is a k_branch_always to itself.
+	for(int pc = 0 ; pc < count ; pc++){
+		const auto operand = get_branch_offset_operand(instrs[pc]._opcode);
+		if(operand != 0){
+			int target = get_branch_target(instrs[pc], pc);
+			for(int hops = 0 ; hops < 8 && target >= 0 && target < count && target != pc && instrs[target]._opcode == bc_opcode::k_branch_always ; hops++){
+				target = get_branch_target(instrs[target], target);
+			}
+			if(target != get_branch_target(instrs[pc], pc)){
+				get_operand(instrs[pc], operand) = make_imm_int(target - pc);
+				changed = true;
+			}
+		}
+	}
+
+	std::vector<bool> reachable(count, false);
+	std::vector<bool> is_target(count + 1, false);
+	std::vector<int> work = { 0 };
+	while(work.empty() == false){
+		const auto pc = work.back();
+		work.pop_back();
+		if(pc < 0 || pc >= count || reachable[pc]){
+			continue;
+		}
+		reachable[pc] = true;
+		const auto opcode = instrs[pc]._opcode;
+		if(get_branch_offset_operand(opcode) != 0){
+			const auto target = get_branch_target(instrs[pc], pc);
+			if(target >= 0 && target <= count){
+				is_target[target] = true;
+			}
+			work.push_back(target);
+		}
+		if(is_terminator(opcode) == false){
+			work.push_back(pc + 1);
+		}
+	}
+
+	//	How many times each local register is used as an operand. Implicit registers are pinned.
+	std::vector<int> use_counts(body._symbols._symbols.size(), 0);
+	std::vector<bool> pinned(body._symbols._symbols.size(), false);
+	for(const auto& e: instrs){
+		const auto reg_flags = encoding_to_reg_flags(k_opcode_info.at(e._opcode)._encoding);
+		if(reg_flags._a && is_local_reg(e._reg_a)){ use_counts[e._reg_a._index]++; }
+		if(reg_flags._b && is_local_reg(e._reg_b)){ use_counts[e._reg_b._index]++; }
+		if(reg_flags._c && is_local_reg(e._reg_c)){ use_counts[e._reg_c._index]++; }
+		for(int j = 1 ; j <= get_implicit_reg_count(e._opcode) ; j++){
+			if(is_local_reg(e._reg_c) && e._reg_c._index + j < static_cast<int>(pinned.size())){
+				pinned[e._reg_c._index + j] = true;
+			}
+		}
+	}
+
+	//	The last instruction is always kept so the body still ends with a terminator.
+	std::vector<bool> keep(count, true);
+	for(int pc = 0 ; pc < count - 1 ; pc++){
+		const auto& e = instrs[pc];
+		if(reachable[pc] == false || e._opcode == bc_opcode::k_nop){
+			keep[pc] = false;
+		}
+		else if(e._opcode == bc_opcode::k_branch_always && get_branch_target(e, pc) == pc + 1){
+			keep[pc] = false;
+		}
+	}
+
+	for(int pc = 0 ; pc + 1 < count ; pc++){
+		auto& producer = instrs[pc];
+		const auto& copy = instrs[pc + 1];
+		if(
+			keep[pc] && keep[pc + 1]
+			&& is_copy_reg(copy._opcode)
+			&& is_target[pc + 1] == false
+			&& writes_reg_a(producer._opcode)
+			&& is_local_reg(producer._reg_a)
+			&& copy._reg_b == producer._reg_a
+			&& is_local_reg(copy._reg_a)
+		){
+			const auto temp = producer._reg_a._index;
+			const auto dest = copy._reg_a._index;
+			const auto reg_flags = encoding_to_reg_flags(k_opcode_info.at(producer._opcode)._encoding);
+			const bool reads_dest =
+				(reg_flags._b && producer._reg_b == copy._reg_a)
+				|| (reg_flags._c && producer._reg_c == copy._reg_a)
+				|| (get_implicit_reg_count(producer._opcode) > 0 && dest > producer._reg_c._index && dest <= producer._reg_c._index + get_implicit_reg_count(producer._opcode));
+			if(
+				use_counts[temp] == 2
+				&& pinned[temp] == false
+				&& pinned[dest] == false
+				&& reads_dest == false
+				&& body._symbols._symbols[temp].second._value_type == body._symbols._symbols[dest].second._value_type
+			){
+				producer._reg_a = copy._reg_a;
+				keep[pc + 1] = false;
+				use_counts[temp] = 0;
+			}
+		}
+	}
+
+	//	Compact and re-aim all branches. A branch to a removed instruction lands on the next kept one.
+	std::vector<int> new_pc(count + 1, 0);
+	for(int pc = 0 ; pc < count ; pc++){
+		new_pc[pc + 1] = new_pc[pc] + (keep[pc] ? 1 : 0);
+	}
+	if(new_pc[count] == count){
+		return changed;
+	}
+
+	std::vector<bcgen_instruction_t> result;
+	for(int pc = 0 ; pc < count ; pc++){
+		if(keep[pc]){
+			auto e = instrs[pc];
+			const auto operand = get_branch_offset_operand(e._opcode);
+			if(operand != 0){
+				const auto target = std::max(0, std::min(count, get_branch_target(e, pc)));
+				get_operand(e, operand) = make_imm_int(new_pc[target] - new_pc[pc]);
+			}
+			result.push_back(e);
+		}
+	}
+	instrs = result;
+	return true;
+}
+
+bool is_temp_symbol(const std::pair<std::string, symbol_t>& symbol){
+	return symbol.first.compare(0, 5, "temp:") == 0 && symbol.second._const_value.is_undefined();
+}
+
+/*
+	Live range of one temporary, as instruction indexes. Registers used as the implicit operands of
+	subset / replace are pinned: they must stay consecutive so they keep their own registers.
+*/
+struct temp_range_t {
+	int _first;
+	int _last;
+	bool _extended_by_loop;
+	bool _pinned;
+};
+
+/*
+	Maps temporaries with non-overlapping live ranges and the same type onto shared registers, then drops the unused
+	symbols from the frame. External temporaries are released right after their last use instead of lingering until
+	the frame closes.
+
+	share_registers = false keeps every register where it is and only adds the releases. Used for the global body:
+	functions address globals by index so the global frame keeps its layout.
+*/
+bcgen_body_t compact_registers(const bcgen_body_t& body, int arg_count, bool share_registers){
 	QUARK_ASSERT(body.check_invariant());
 
-	std::vector<bc_instruction_t> instrs2;
-	for(const auto& e: body._instrs){
-		instrs2.push_back(squeeze_instruction(e));
+	const auto& instrs = body._instrs;
+	const auto& symbols = body._symbols._symbols;
+	const auto count = static_cast<int>(instrs.size());
+	const auto symbol_count = static_cast<int>(symbols.size());
+
+	std::vector<temp_range_t> ranges(symbol_count, temp_range_t{ -1, -1, false, false });
+	for(int pc = 0 ; pc < count ; pc++){
+		const auto& e = instrs[pc];
+		const auto reg_flags = encoding_to_reg_flags(k_opcode_info.at(e._opcode)._encoding);
+		const bool flags[3] = { reg_flags._a, reg_flags._b, reg_flags._c };
+		const variable_address_t* regs[3] = { &e._reg_a, &e._reg_b, &e._reg_c };
+		for(int operand = 0 ; operand < 3 ; operand++){
+			if(flags[operand] && is_local_reg(*regs[operand])){
+				auto& range = ranges[regs[operand]->_index];
+				range._first = range._first == -1 ? pc : range._first;
+				range._last = pc;
+			}
+		}
+		const auto implicit_count = get_implicit_reg_count(e._opcode);
+		for(int j = 0 ; j <= implicit_count && implicit_count > 0 ; j++){
+			auto& range = ranges[e._reg_c._index + j];
+			range._pinned = true;
+			range._first = range._first == -1 ? pc : std::min(range._first, pc);
+			range._last = std::max(range._last, pc);
+		}
+	}
+
+	//	A temp that is live at the head of a loop stays live until the loop's backward branch.
+	for(bool changed = true ; changed ; ){
+		changed = false;
+		for(int pc = 0 ; pc < count ; pc++){
+			if(get_branch_offset_operand(instrs[pc]._opcode) != 0){
+				const auto target = get_branch_target(instrs[pc], pc);
+				if(target <= pc){
+					for(auto& range: ranges){
+						if(range._first != -1 && range._first < target && range._last >= target && range._last < pc){
+							range._last = pc;
+							range._extended_by_loop = true;
+							changed = true;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	//	Linear scan in order of definition. Slots are identified by the symbol of their first temp.
+	std::vector<int> order;
+	for(int reg = arg_count ; reg < symbol_count ; reg++){
+		if(is_temp_symbol(symbols[reg]) && ranges[reg]._first != -1){
+			order.push_back(reg);
+		}
+	}
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b){ return ranges[a]._first < ranges[b]._first; });
+
+	std::vector<int> slot_of(symbol_count, -1);
+	std::vector<int> slot_end(symbol_count, -1);
+	std::vector<int> slots;
+	for(const auto reg: order){
+		const auto& range = ranges[reg];
+		int slot = -1;
+		if(share_registers && range._pinned == false){
+			for(const auto s: slots){
+				if(slot_end[s] < range._first && ranges[s]._pinned == false && symbols[s].second._value_type == symbols[reg].second._value_type){
+					slot = s;
+					break;
+				}
+			}
+		}
+		if(slot == -1){
+			slot = reg;
+			slots.push_back(reg);
+		}
+		slot_of[reg] = slot;
+		slot_end[slot] = range._last;
+	}
+
+	//	Keep arguments, named locals, constants and one register per slot. Unused temps disappear.
+	std::vector<int> new_index(symbol_count, -1);
+	std::vector<std::pair<std::string, symbol_t>> symbols2;
+	for(int reg = 0 ; reg < symbol_count ; reg++){
+		if(share_registers == false || reg < arg_count || is_temp_symbol(symbols[reg]) == false || slot_of[reg] == reg){
+			new_index[reg] = static_cast<int>(symbols2.size());
+			symbols2.push_back(symbols[reg]);
+		}
+	}
+	for(int reg = 0 ; reg < symbol_count ; reg++){
+		if(new_index[reg] == -1 && slot_of[reg] != -1){
+			new_index[reg] = new_index[slot_of[reg]];
+		}
+	}
+
+	const auto remap = [&](const variable_address_t& reg, bool is_reg){
+		return is_reg && is_local_reg(reg) ? variable_address_t::make_variable_address(0, new_index[reg._index]) : reg;
+	};
+
+	//	Release an external temp after its last use, unless the frame ends right there or its slot is rewritten next.
+	std::vector<std::vector<int>> releases(count);
+	for(const auto reg: order){
+		const auto& range = ranges[reg];
+		const auto last = range._last;
+		if(
+			encode_as_external(symbols[reg].second._value_type)
+			&& range._extended_by_loop == false
+			&& range._pinned == false
+			&& get_branch_offset_operand(instrs[last]._opcode) == 0
+			&& is_terminator(instrs[last]._opcode) == false
+			&& last + 1 < count
+			&& is_terminator(instrs[last + 1]._opcode) == false
+		){
+			bool rewritten_next = false;
+			for(const auto other: order){
+				if(other != reg && slot_of[other] == slot_of[reg] && ranges[other]._first == last + 1){
+					rewritten_next = true;
+				}
+			}
+			if(rewritten_next == false){
+				releases[last].push_back(new_index[reg]);
+			}
+		}
+	}
+
+	//	Rebuild the instructions, with releases inserted, and re-aim branches.
+	std::vector<int> new_pc(count + 1, 0);
+	for(int pc = 0 ; pc < count ; pc++){
+		new_pc[pc + 1] = new_pc[pc] + 1 + static_cast<int>(releases[pc].size());
 	}
 
+	std::vector<bcgen_instruction_t> instrs2;
+	for(int pc = 0 ; pc < count ; pc++){
+		const auto& e = instrs[pc];
+		const auto reg_flags = encoding_to_reg_flags(k_opcode_info.at(e._opcode)._encoding);
+		auto e2 = bcgen_instruction_t(e._opcode, remap(e._reg_a, reg_flags._a), remap(e._reg_b, reg_flags._b), remap(e._reg_c, reg_flags._c));
+		const auto operand = get_branch_offset_operand(e._opcode);
+		if(operand != 0){
+			get_operand(e2, operand) = make_imm_int(new_pc[get_branch_target(e, pc)] - new_pc[pc]);
+		}
+		instrs2.push_back(e2);
+		for(const auto reg: releases[pc]){
+			instrs2.push_back(bcgen_instruction_t(bc_opcode::k_release_external_value, variable_address_t::make_variable_address(0, reg), {}, {}));
+		}
+	}
+
+	auto body_acc = bcgen_body_t(instrs2, body._symbols);
+	body_acc._symbols._symbols = symbols2;
+
+	QUARK_ASSERT(body_acc.check_invariant());
+	return body_acc;
+}
+
+//	Pure instructions that can't throw: safe to execute once before a loop instead of every iteration, even if the loop body never runs.
+bool is_hoistable(bc_opcode opcode){
+	return opcode == bc_opcode::k_load_global_external_value
+		|| opcode == bc_opcode::k_load_global_inplace_value
+		|| opcode == bc_opcode::k_get_struct_member
+		|| opcode == bc_opcode::k_get_size_vector_w_external_elements
+		|| opcode == bc_opcode::k_get_size_vector_w_inplace_elements
+		|| opcode == bc_opcode::k_get_size_dict_w_external_values
+		|| opcode == bc_opcode::k_get_size_dict_w_inplace_values
+		|| opcode == bc_opcode::k_get_size_string
+		|| opcode == bc_opcode::k_add_int
+		|| opcode == bc_opcode::k_add_double
+		|| opcode == bc_opcode::k_concat_strings
+		|| opcode == bc_opcode::k_subtract_int
+		|| opcode == bc_opcode::k_subtract_double
+		|| opcode == bc_opcode::k_multiply_int
+		|| opcode == bc_opcode::k_multiply_double
+		|| opcode == bc_opcode::k_add_int_imm
+		|| opcode == bc_opcode::k_subtract_int_imm
+		|| opcode == bc_opcode::k_multiply_int_imm
+		|| opcode == bc_opcode::k_add_double_const
+		|| opcode == bc_opcode::k_subtract_double_const
+		|| opcode == bc_opcode::k_multiply_double_const
+		|| opcode == bc_opcode::k_comparison_smaller_or_equal_int
+		|| opcode == bc_opcode::k_comparison_smaller_int
+		|| opcode == bc_opcode::k_logical_equal_int
+		|| opcode == bc_opcode::k_logical_nonequal_int
+		|| opcode == bc_opcode::k_comparison_smaller_or_equal_double
+		|| opcode == bc_opcode::k_comparison_smaller_double
+		|| opcode == bc_opcode::k_logical_equal_double
+		|| opcode == bc_opcode::k_logical_nonequal_double
+		|| opcode == bc_opcode::k_comparison_smaller_or_equal_string
+		|| opcode == bc_opcode::k_comparison_smaller_string
+		|| opcode == bc_opcode::k_logical_equal_string
+		|| opcode == bc_opcode::k_logical_nonequal_string
+		|| opcode == bc_opcode::k_comparison_smaller_or_equal_bool
+		|| opcode == bc_opcode::k_comparison_smaller_bool
+		|| opcode == bc_opcode::k_logical_equal_bool
+		|| opcode == bc_opcode::k_logical_nonequal_bool
+		|| opcode == bc_opcode::k_comparison_smaller_int_imm
+		|| opcode == bc_opcode::k_comparison_smaller_or_equal_int_imm
+		|| opcode == bc_opcode::k_comparison_larger_int_imm
+		|| opcode == bc_opcode::k_comparison_larger_or_equal_int_imm
+		|| opcode == bc_opcode::k_logical_equal_int_imm
+		|| opcode == bc_opcode::k_logical_nonequal_int_imm;
+}
+
+//	A loop is the instructions from a backward branch's target (the header) up to the last backward branch to it.
+struct bcgen_loop_t {
+	int _header;
+	int _end;
+};
+
+std::vector<bcgen_loop_t> find_loops(const std::vector<bcgen_instruction_t>& instrs){
+	const auto count = static_cast<int>(instrs.size());
+	std::map<int, int> ends;
+	for(int pc = 0 ; pc < count ; pc++){
+		if(get_branch_offset_operand(instrs[pc]._opcode) != 0){
+			const auto target = get_branch_target(instrs[pc], pc);
+			if(target >= 0 && target <= pc){
+				ends[target] = std::max(ends[target], pc);
+			}
+		}
+	}
+
+	//	Innermost loops first. Skip loops that can be entered other than through the header.
+	std::vector<bcgen_loop_t> result;
+	for(const auto& e: ends){
+		const auto loop = bcgen_loop_t{ e.first, e.second };
+		bool single_entry = true;
+		for(int pc = 0 ; pc < count && single_entry ; pc++){
+			if((pc < loop._header || pc > loop._end) && get_branch_offset_operand(instrs[pc]._opcode) != 0){
+				const auto target = get_branch_target(instrs[pc], pc);
+				single_entry = target <= loop._header || target > loop._end;
+			}
+		}
+		if(single_entry){
+			result.push_back(loop);
+		}
+	}
+	std::sort(result.begin(), result.end(), [](const bcgen_loop_t& a, const bcgen_loop_t& b){ return a._end - a._header < b._end - b._header; });
+	return result;
+}
+
+//	Returns the pc of an instruction in the loop that can move to its header, or -1.
+int find_loop_invariant(const bcgen_body_t& body, const std::vector<int>& write_counts, const bcgen_loop_t& loop){
+	const auto& instrs = body._instrs;
+
+	std::vector<bool> written(body._symbols._symbols.size(), false);
+	bool writes_globals = false;
+	for(int pc = loop._header ; pc <= loop._end ; pc++){
+		const auto& e = instrs[pc];
+		if(e._opcode == bc_opcode::k_tail_call){
+			return -1;
+		}
+		if(e._opcode == bc_opcode::k_call || e._opcode == bc_opcode::k_store_global_external_value || e._opcode == bc_opcode::k_store_global_inplace_value){
+			writes_globals = true;
+		}
+		if(writes_reg_a(e._opcode)){
+			if(is_local_reg(e._reg_a)){
+				written[e._reg_a._index] = true;
+			}
+			else if(e._reg_a._parent_steps == -1){
+				writes_globals = true;
+			}
+		}
+	}
+
+	for(int pc = loop._header ; pc <= loop._end ; pc++){
+		const auto& e = instrs[pc];
+		if(
+			is_hoistable(e._opcode)
+			&& is_local_reg(e._reg_a)
+			&& is_temp_symbol(body._symbols._symbols[e._reg_a._index])
+			&& write_counts[e._reg_a._index] == 1
+		){
+			const auto reg_flags = encoding_to_reg_flags(k_opcode_info.at(e._opcode)._encoding);
+			const auto is_invariant = [&](bool flag, const variable_address_t& reg){
+				if(flag == false){
+					return true;
+				}
+				else if(is_local_reg(reg)){
+					return written[reg._index] == false;
+				}
+				else{
+					return reg._parent_steps == -1 && writes_globals == false;
+				}
+			};
+			const bool is_global_load = e._opcode == bc_opcode::k_load_global_external_value || e._opcode == bc_opcode::k_load_global_inplace_value;
+			if(
+				is_invariant(reg_flags._b, e._reg_b)
+				&& is_invariant(reg_flags._c, e._reg_c)
+				&& (is_global_load == false || writes_globals == false)
+			){
+				return pc;
+			}
+		}
+	}
+	return -1;
+}
+
+/*
+	Moves the instruction at pc from into the header position of loop, just before the old header.
+	Backward branches inside the loop skip it, entries from outside the loop run it.
+*/
+void hoist_instruction(std::vector<bcgen_instruction_t>& instrs, const bcgen_loop_t& loop, int from){
+	QUARK_ASSERT(from >= loop._header && from <= loop._end);
+
+	const auto count = static_cast<int>(instrs.size());
+	const auto header = loop._header;
+	const auto new_pc = [&](int pc){
+		if(pc < header || pc > from){
+			return pc;
+		}
+		else if(pc == from){
+			return header;
+		}
+		else{
+			return pc + 1;
+		}
+	};
+
+	std::vector<bcgen_instruction_t> result;
+	result.reserve(count);
+	for(int pc = 0 ; pc < count ; pc++){
+		if(pc == header){
+			result.push_back(instrs[from]);
+		}
+		if(pc != from){
+			auto e = instrs[pc];
+			const auto operand = get_branch_offset_operand(e._opcode);
+			if(operand != 0){
+				const auto target = get_branch_target(e, pc);
+				const bool inside = pc >= header && pc <= loop._end;
+				const auto new_target =
+					(target == header && inside) ? header + 1
+					: (target == header) ? header
+					: (target == from) ? new_pc(from + 1)
+					: new_pc(target);
+				get_operand(e, operand) = make_imm_int(new_target - new_pc(pc));
+			}
+			result.push_back(e);
+		}
+	}
+	instrs = result;
+}
+
+/*
+	Loop-invariant code motion: pure, non-throwing instructions whose inputs the loop never changes are moved in front
+	of the loop. Only temporaries written exactly once are moved so no other definition can reach their uses.
+	Repeats so chains of invariant instructions and nested loops move out one step at a time.
+*/
+int hoist_loop_invariants(bcgen_body_t& body){
+	int hoisted_count = 0;
+	for(int round = 0 ; round < 256 ; round++){
+		std::vector<int> write_counts(body._symbols._symbols.size(), 0);
+		for(const auto& e: body._instrs){
+			if(writes_reg_a(e._opcode) && is_local_reg(e._reg_a)){
+				write_counts[e._reg_a._index]++;
+			}
+		}
+
+		bool moved = false;
+		for(const auto& loop: find_loops(body._instrs)){
+			const auto pc = find_loop_invariant(body, write_counts, loop);
+			if(pc != -1){
+				hoist_instruction(body._instrs, loop, pc);
+				hoisted_count++;
+				moved = true;
+				break;
+			}
+		}
+		if(moved == false){
+			break;
+		}
+	}
+	return hoisted_count;
+}
+
+/*
+	Cleans up a finished body before make_frame(). Function bodies also get their registers compacted, the global
+	body only gets its temps released early. arg_count is -1 for the globals.
+*/
+bcgen_body_t peephole_body(const bcgen_body_t& body, int arg_count, bc_peephole_stats_t& stats){
+	QUARK_ASSERT(body.check_invariant());
+
+	auto body_acc = body;
+	for(int round = 0 ; round < 8 && peephole_round(body_acc) ; round++){
+	}
+	stats._hoisted_count += hoist_loop_invariants(body_acc);
+	body_acc = compact_registers(body_acc, std::max(arg_count, 0), arg_count >= 0);
+	verify_body(body_acc);
+
+	stats._instruction_count_before += static_cast<int>(body._instrs.size());
+	stats._instruction_count_after += static_cast<int>(body_acc._instrs.size());
+	stats._register_count_before += static_cast<int>(body._symbols._symbols.size());
+	stats._register_count_after += static_cast<int>(body_acc._symbols._symbols.size());
+
+	QUARK_ASSERT(body_acc.check_invariant());
+	return body_acc;
+}
+
+
+//////////////////////////////////////		INLINER
+
+/*
+	Returns the body to splice in for a call to a small pure Floyd function, or nullptr to make a normal call.
+	The body is generated once per function, the way generate_bytecode() would generate it, and cleaned up by the
+	peephole rounds. It qualifies if it fits the budget, ends with k_return, has no k_stop and doesn't recurse.
+*/
+std::shared_ptr<const bcgen_body_t> get_inline_body(bcgenerator_t& vm, const expression_t& e){
+	QUARK_ASSERT(vm.check_invariant());
+
+	const auto function_id = vm._inline_budget > 0 ? get_global_function_id(vm, e._input_exprs[0]) : -1;
+	if(function_id == -1 || function_id == vm._current_function_id){
+		return nullptr;
+	}
+	if(std::find(vm._inline_stack.begin(), vm._inline_stack.end(), function_id) != vm._inline_stack.end()){
+		vm._inline_recursion = true;
+		return nullptr;
+	}
+	const auto it = vm._inline_bodies.find(function_id);
+	if(it != vm._inline_bodies.end()){
+		return it->second;
+	}
+
+	const auto& function_def = *vm._ast_imm->_checked_ast._function_defs[function_id];
+	const auto& args = function_def._function_type.get_function_args();
+
+	//	Memoized functions stay calls: the interpreter caches their results.
+	const auto& memoize = vm._ast_imm->_checked_ast._container_def._memoize;
+	const auto& callee_name = vm._call_stack[0]._body_ptr->_symbols._symbols[e._input_exprs[0]._address._index].first;
+	if(
+		function_def._host_function_id != 0
+		|| std::find(memoize.begin(), memoize.end(), callee_name) != memoize.end()
+		|| function_def._body == nullptr
+		|| function_def._function_type.get_function_pure() != epure::pure
+		|| std::find_if(args.begin(), args.end(), [](const typeid_t& t){ return t.is_internal_dynamic(); }) != args.end()
+	){
+		vm._inline_bodies[function_id] = nullptr;
+		return nullptr;
+	}
+
+	//	Generate as if the callee's frame sat on top of the globals. No tail calls: they would replace the caller's frame.
+	const auto call_stack = vm._call_stack;
+	const auto current_function_id = vm._current_function_id;
+	const auto inline_recursion = vm._inline_recursion;
+	const auto safe_lookups = vm._safe_lookups;
+	vm._call_stack.resize(1);
+	vm._current_function_id = -1;
+	vm._inline_stack.push_back(function_id);
+	vm._inline_recursion = false;
+	vm._safe_lookups.clear();
+
+	auto body = bcgen_body_block(vm, *function_def._body);
+	for(int round = 0 ; round < 8 && peephole_round(body) ; round++){
+	}
+	const auto recursive = vm._inline_recursion;
+
+	vm._call_stack = call_stack;
+	vm._current_function_id = current_function_id;
+	vm._inline_stack.pop_back();
+	vm._inline_recursion = inline_recursion;
+	vm._safe_lookups = safe_lookups;
+
+	const auto& instrs = body._instrs;
+	const auto fits = recursive == false
+		&& instrs.empty() == false
+		&& static_cast<int>(instrs.size()) <= vm._inline_budget
+		&& instrs.back()._opcode == bc_opcode::k_return
+		&& std::find_if(instrs.begin(), instrs.end(), [](const bcgen_instruction_t& i){ return i._opcode == bc_opcode::k_stop; }) == instrs.end();
+
+	const auto result = fits ? std::make_shared<const bcgen_body_t>(body) : nullptr;
+	vm._inline_bodies[function_id] = result;
+	return result;
+}
+
+/*
+	Splices the callee's body into ours. Its registers are renumbered to follow ours, the arguments are evaluated
+	straight into its argument registers and each k_return becomes a copy to the result + a branch to the end.
+	The callee's arguments and named locals become temps of ours: the "temp: " prefix keeps them from shadowing globals
+	when inlined into the global body, and compact_registers() releases them after their last use. Inside functions it
+	also shares their registers.
+*/
+expression_gen_t bcgen_inline_call(bcgenerator_t& vm, const variable_address_t& target_reg, const expression_t& e, const bcgen_body_t& callee_body, const bcgen_body_t& body){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(e.check_invariant());
+	QUARK_ASSERT(callee_body.check_invariant());
+	QUARK_ASSERT(body.check_invariant());
+
+	auto body_acc = body;
+	const auto return_type = e.get_output_type();
+	const auto arg_count = static_cast<int>(e._input_exprs.size()) - 1;
+
+	const auto base = static_cast<int>(body_acc._symbols._symbols.size());
+	for(const auto& symbol: callee_body._symbols._symbols){
+		const auto name = is_temp_symbol(symbol) ? symbol.first : "temp: inline " + symbol.first;
+		body_acc._symbols._symbols.push_back({ name, symbol.second });
+	}
+
+	for(int i = 0 ; i < arg_count ; i++){
+		const auto arg_reg = variable_address_t::make_variable_address(0, base + i);
+		const auto& arg_expr = bcgen_expression(vm, arg_reg, e._input_exprs[i + 1], body_acc);
+		body_acc = arg_expr._body;
+		if(!(arg_expr._out == arg_reg)){
+			body_acc = copy_value(vm, e._input_exprs[i + 1].get_output_type(), arg_reg, arg_expr._out, body_acc);
+		}
+	}
+
+	const auto target_reg2 = target_reg.is_empty() ? add_local_temp(body_acc, return_type, "temp: inline result") : target_reg;
+
+	//	Where each callee instruction lands: a k_return takes two.
+	const auto count = static_cast<int>(callee_body._instrs.size());
+	std::vector<int> pos(count + 1, 0);
+	for(int pc = 0 ; pc < count ; pc++){
+		pos[pc + 1] = pos[pc] + (callee_body._instrs[pc]._opcode == bc_opcode::k_return ? 2 : 1);
+	}
+
+	for(int pc = 0 ; pc < count ; pc++){
+		const auto& s = callee_body._instrs[pc];
+		if(s._opcode == bc_opcode::k_return){
+			body_acc = copy_value(vm, return_type, target_reg2, flatten_reg(s._reg_a, base), body_acc);
+			body_acc._instrs.push_back(bcgen_instruction_t(bc_opcode::k_branch_always, make_imm_int(pos[count] - (pos[pc] + 1)), {}, {}));
+		}
+		else{
+			const auto reg_flags = encoding_to_reg_flags(k_opcode_info.at(s._opcode)._encoding);
+			auto s2 = bcgen_instruction_t(
+				s._opcode,
+				reg_flags._a ? flatten_reg(s._reg_a, base) : s._reg_a,
+				reg_flags._b ? flatten_reg(s._reg_b, base) : s._reg_b,
+				reg_flags._c ? flatten_reg(s._reg_c, base) : s._reg_c
+			);
+			const auto operand = get_branch_offset_operand(s._opcode);
+			if(operand != 0){
+				get_operand(s2, operand) = make_imm_int(pos[get_branch_target(s, pc)] - pos[pc]);
+			}
+			body_acc._instrs.push_back(s2);
+		}
+	}
+
+	QUARK_ASSERT(body_acc.check_invariant());
+	return { body_acc, target_reg2, intern_type(vm, return_type) };
+}
+
+
+/*
+	Squeezes the instructions into the 64-bit format. An instruction with an operand outside 16 bits -- register,
+	type, constant index or branch offset -- gets a k_wide prefix with the high halves. Prefixes move instructions,
+	so branch offsets are recomputed until no more instructions need to become wide.
+*/
+std::vector<bc_instruction_t> squeeze_instructions(const std::vector<bcgen_instruction_t>& instrs){
+	const auto count = static_cast<int>(instrs.size());
+
+	std::vector<bool> wide(count, false);
+	std::vector<int> pos(count + 1, 0);
+	std::vector<bcgen_instruction_t> instrs2;
+	for(bool changed = true ; changed ; ){
+		changed = false;
+
+		//	Where each instruction starts, at its prefix if it has one.
+		for(int pc = 0 ; pc < count ; pc++){
+			pos[pc + 1] = pos[pc] + (wide[pc] ? 2 : 1);
+		}
+
+		instrs2 = instrs;
+		for(int pc = 0 ; pc < count ; pc++){
+			const auto operand = get_branch_offset_operand(instrs[pc]._opcode);
+			if(operand != 0){
+				const auto target = get_branch_target(instrs[pc], pc);
+				QUARK_ASSERT(target >= 0 && target <= count);
+
+				//	Offsets are relative to the instruction itself, which sits after its prefix.
+				const auto executed_pos = pos[pc] + (wide[pc] ? 1 : 0);
+				get_operand(instrs2[pc], operand) = make_imm_int(pos[target] - executed_pos);
+			}
+			if(wide[pc] == false && is_compact(instrs2[pc]) == false){
+				wide[pc] = true;
+				changed = true;
+			}
+		}
+	}
+
+	std::vector<bc_instruction_t> result;
+	for(int pc = 0 ; pc < count ; pc++){
+		auto e = instrs2[pc];
+		if(wide[pc]){
+			result.push_back(bc_instruction_t(
+				bc_opcode::k_wide,
+				static_cast<int16_t>(e._reg_a._index >> 16),
+				static_cast<int16_t>(e._reg_b._index >> 16),
+				static_cast<int16_t>(e._reg_c._index >> 16)
+			));
+			e._reg_a._index = static_cast<int16_t>(e._reg_a._index & 0xffff);
+			e._reg_b._index = static_cast<int16_t>(e._reg_b._index & 0xffff);
+			e._reg_c._index = static_cast<int16_t>(e._reg_c._index & 0xffff);
+		}
+		result.push_back(squeeze_instruction(e));
+	}
+	return result;
+}
+
+QUARK_UNIT_TEST("bytecode_generator", "squeeze_instructions()", "registers and branches beyond int16", "k_wide prefixes"){
+	const int register_count = 40000;
+	const int nop_count = 40000;
+
+	symbol_table_t symbols;
+	for(int i = 0 ; i < register_count ; i++){
+		symbols._symbols.push_back({ "r" + std::to_string(i), symbol_t::make_mutable_local(typeid_t::make_int()) });
+	}
+	const auto last_reg = variable_address_t::make_variable_address(0, register_count - 1);
+
+	//	r39999 += 5, then branch over 40000 instructions, one of which would add 100.
+	std::vector<bcgen_instruction_t> instrs = {
+		bcgen_instruction_t(bc_opcode::k_add_int_imm, last_reg, last_reg, make_imm_int(5)),
+		bcgen_instruction_t(bc_opcode::k_branch_always, make_imm_int(nop_count + 1), {}, {}),
+		bcgen_instruction_t(bc_opcode::k_add_int_imm, last_reg, last_reg, make_imm_int(100))
+	};
+	for(int i = 1 ; i < nop_count ; i++){
+		instrs.push_back(bcgen_instruction_t(bc_opcode::k_nop, {}, {}, {}));
+	}
+	instrs.push_back(bcgen_instruction_t(bc_opcode::k_stop, {}, {}, {}));
+
+	const auto squeezed = squeeze_instructions(instrs);
+	QUARK_UT_VERIFY(squeezed.size() == instrs.size() + 3);
+	QUARK_UT_VERIFY(squeezed[0]._opcode == bc_opcode::k_wide);
+	QUARK_UT_VERIFY(make_wide_operand(squeezed[0]._a, squeezed[1]._a) == register_count - 1);
+	QUARK_UT_VERIFY(squeezed[2]._opcode == bc_opcode::k_wide);
+	QUARK_UT_VERIFY(squeezed[3]._opcode == bc_opcode::k_branch_always);
+	QUARK_UT_VERIFY(3 + make_wide_operand(squeezed[2]._a, squeezed[3]._a) == static_cast<int>(squeezed.size()) - 1);
+
+	const auto globals = make_frame(bcgen_body_t(instrs, symbols), {});
+	const auto program = bc_program_t{ globals, {}, { typeid_t::make_int() }, {}, {}, {}, {} };
+	interpreter_t vm(program);
+	QUARK_UT_VERIFY(vm._stack.load_intq(k_frame_overhead + register_count - 1) == 5);
+}
+
+bc_static_frame_t make_frame(const bcgen_body_t& body, const std::vector<typeid_t>& args){
+	QUARK_ASSERT(body.check_invariant());
+
+	const auto instrs2 = squeeze_instructions(body._instrs);
+
 	std::vector<std::pair<std::string, bc_symbol_t>> symbols2;
 	for(const auto& e: body._symbols._symbols){
 		const auto e2 = std::pair<std::string, bc_symbol_t>{
@@ -1500,7 +3222,8 @@ bc_program_t generate_bytecode(const semantic_ast_t& ast){
 
 	bcgenerator_t a(ast._checked_ast);
 
-	const auto global_body = bcgen_body_top(a, a._ast_imm->_checked_ast._globals);
+	bc_peephole_stats_t peephole_stats = { 0, 0, 0, 0, 0 };
+	const auto global_body = peephole_body(bcgen_body_top(a, a._ast_imm->_checked_ast._globals), -1, peephole_stats);
 	const auto globals2 = make_frame(global_body, {});
 	a._call_stack.push_back(bcgen_environment_t{ &global_body });
 
@@ -1518,7 +3241,8 @@ bc_program_t generate_bytecode(const semantic_ast_t& ast){
 			function_defs2.push_back(function_def2);
 		}
 		else{
-			const auto body2 = function_def._body ? bcgen_body_top(a, *function_def._body) : bcgen_body_t({});
+			a._current_function_id = function_id;
+			const auto body2 = function_def._body ? peephole_body(bcgen_body_top(a, *function_def._body), static_cast<int>(function_def._args.size()), peephole_stats) : bcgen_body_t({});
 			const auto frame = make_frame(body2, function_def._function_type.get_function_args());
 			const auto function_def2 = bc_function_definition_t{
 				function_def._function_type,
@@ -1530,7 +3254,7 @@ bc_program_t generate_bytecode(const semantic_ast_t& ast){
 		}
 	}
 
-	const auto result = bc_program_t{ globals2, function_defs2, a._types, ast._checked_ast._software_system, ast._checked_ast._container_def };
+	const auto result = bc_program_t{ globals2, function_defs2, a._types, ast._checked_ast._software_system, ast._checked_ast._container_def, a._double_constants, peephole_stats };
 
 //	QUARK_TRACE_SS("OUTPUT: " << json_to_pretty_string(bcprogram_to_json(result)));
 
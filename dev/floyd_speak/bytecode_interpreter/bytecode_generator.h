@@ -17,6 +17,7 @@
 
 namespace floyd {
 struct semantic_ast_t;
+struct ast_t;
 struct bc_program_t;
 
 
@@ -27,6 +28,12 @@ struct bc_program_t;
 */
 bc_program_t generate_bytecode(const semantic_ast_t& ast);
 
+/*
+	Function id of the global at global_index if it is an immutable global bound straight to a function, like a
+	top-level "func int f(){}". Else -1.
+*/
+int get_global_function_id(const ast_t& ast, int global_index);
+
 
 } //	floyd
 
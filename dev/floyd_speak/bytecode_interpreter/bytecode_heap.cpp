@@ -0,0 +1,374 @@
+//
+//  bytecode_heap.cpp
+//  FloydSpeak
+//
+
+#include "bytecode_heap.h"
+
+#include "json_support.h"
+#include "quark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace floyd {
+
+
+const std::size_t k_size_class_count = k_bc_heap_max_block_size / k_bc_heap_granularity;
+
+//	Number of blocks moved between a thread's free list and the shared free list at a time.
+const int k_batch_blocks = 32;
+
+//	A thread's free list of one size class never holds more blocks than this.
+const int k_max_thread_blocks = 4 * k_batch_blocks;
+
+
+static std::size_t get_size_class(std::size_t size){
+	QUARK_ASSERT(size > 0 && size <= k_bc_heap_max_block_size);
+
+	return (size - 1) / k_bc_heap_granularity;
+}
+
+static std::size_t get_block_size(std::size_t size_class){
+	return (size_class + 1) * k_bc_heap_granularity;
+}
+
+
+//////////////////////////////////////		free_list_t
+
+
+struct free_block_t {
+	free_block_t* _next;
+};
+
+//	Free blocks of one size class, linked through their first bytes.
+struct free_list_t {
+	void push(free_block_t* block){
+		block->_next = _head;
+		_head = block;
+		_count++;
+	}
+
+	free_block_t* pop(){
+		QUARK_ASSERT(_head != nullptr);
+
+		auto block = _head;
+		_head = block->_next;
+		_count--;
+		return block;
+	}
+
+	//	Moves up to count blocks to dest.
+	void move_to(free_list_t& dest, int count){
+		while(count > 0 && _head != nullptr){
+			dest.push(pop());
+			count--;
+		}
+	}
+
+
+	//////////////////////////////////////		STATE
+	free_block_t* _head = nullptr;
+	int _count = 0;
+};
+
+
+//////////////////////////////////////		counters
+
+
+//	Only the owning thread writes the counters, get_bc_heap_stats() reads them from any thread.
+struct thread_counters_t {
+	std::atomic<int64_t> _alloc_count { 0 };
+	std::atomic<int64_t> _free_count { 0 };
+	std::atomic<int64_t> _large_alloc_count { 0 };
+	std::atomic<int64_t> _refill_count { 0 };
+	std::atomic<int64_t> _live_bytes { 0 };
+};
+
+//	Single writer: no need for a locked read-modify-write.
+static void bump(std::atomic<int64_t>& counter, int64_t delta){
+	counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+static void add_counters(bc_heap_stats_t& acc, const thread_counters_t& counters){
+	acc._alloc_count += counters._alloc_count.load(std::memory_order_relaxed);
+	acc._free_count += counters._free_count.load(std::memory_order_relaxed);
+	acc._large_alloc_count += counters._large_alloc_count.load(std::memory_order_relaxed);
+	acc._refill_count += counters._refill_count.load(std::memory_order_relaxed);
+	acc._live_bytes += counters._live_bytes.load(std::memory_order_relaxed);
+}
+
+
+//////////////////////////////////////		shared_heap_t
+
+
+struct shared_heap_t {
+	std::mutex _list_mutexes[k_size_class_count];
+	free_list_t _lists[k_size_class_count];
+
+	std::mutex _slab_mutex;
+	char* _slab_pos = nullptr;
+	char* _slab_end = nullptr;
+	int64_t _slab_count = 0;
+
+	std::mutex _threads_mutex;
+	std::vector<const thread_counters_t*> _threads;
+
+	//	Counters of threads that have exited, and of frees that happen while a thread exits.
+	//	Many writers, updates use _threads_mutex.
+	thread_counters_t _retired;
+};
+
+static shared_heap_t& get_shared_heap(){
+	//	Never destroyed: static destructors can release values after main() returns.
+	static shared_heap_t* heap = new shared_heap_t();
+	return *heap;
+}
+
+//	Carves count new blocks of size_class out of the slabs.
+static void carve_blocks(shared_heap_t& shared, std::size_t size_class, int count, free_list_t& dest){
+	const auto block_size = get_block_size(size_class);
+
+	std::lock_guard<std::mutex> lock(shared._slab_mutex);
+	for(int i = 0 ; i < count ; i++){
+		if(shared._slab_pos + block_size > shared._slab_end){
+			//	The rest of the old slab is lost, at most one block.
+			auto slab = static_cast<char*>(std::malloc(k_bc_heap_slab_size));
+			if(slab == nullptr){
+				throw std::bad_alloc();
+			}
+			shared._slab_pos = slab;
+			shared._slab_end = slab + k_bc_heap_slab_size;
+			shared._slab_count++;
+		}
+		dest.push(reinterpret_cast<free_block_t*>(shared._slab_pos));
+		shared._slab_pos += block_size;
+	}
+}
+
+static void move_to_shared(shared_heap_t& shared, std::size_t size_class, free_list_t& source, int count){
+	std::lock_guard<std::mutex> lock(shared._list_mutexes[size_class]);
+	source.move_to(shared._lists[size_class], count);
+}
+
+
+//////////////////////////////////////		thread_cache_t
+
+
+struct thread_cache_t {
+	thread_cache_t(){
+		auto& shared = get_shared_heap();
+		std::lock_guard<std::mutex> lock(shared._threads_mutex);
+		shared._threads.push_back(&_counters);
+	}
+
+	~thread_cache_t();
+
+	free_list_t _lists[k_size_class_count];
+	thread_counters_t _counters;
+};
+
+//	Set when the thread's cache has been destroyed. Blocks freed after that go straight to the shared lists.
+static thread_local bool t_thread_cache_gone = false;
+
+thread_cache_t::~thread_cache_t(){
+	auto& shared = get_shared_heap();
+	for(std::size_t size_class = 0 ; size_class < k_size_class_count ; size_class++){
+		move_to_shared(shared, size_class, _lists[size_class], _lists[size_class]._count);
+	}
+
+	std::lock_guard<std::mutex> lock(shared._threads_mutex);
+	bc_heap_stats_t acc = { 0, 0, 0, 0, 0, 0, 0 };
+	add_counters(acc, _counters);
+	bump(shared._retired._alloc_count, acc._alloc_count);
+	bump(shared._retired._free_count, acc._free_count);
+	bump(shared._retired._large_alloc_count, acc._large_alloc_count);
+	bump(shared._retired._refill_count, acc._refill_count);
+	bump(shared._retired._live_bytes, acc._live_bytes);
+	shared._threads.erase(std::find(shared._threads.begin(), shared._threads.end(), &_counters));
+
+	t_thread_cache_gone = true;
+}
+
+static thread_cache_t* get_thread_cache(){
+	if(t_thread_cache_gone){
+		return nullptr;
+	}
+	static thread_local thread_cache_t cache;
+	return &cache;
+}
+
+
+//////////////////////////////////////		allocate / deallocate
+
+
+//	Counts in the thread's counters, or in the retired counters if the thread's cache is gone.
+static void count_block(thread_cache_t* cache, bool alloc, bool large, int64_t bytes){
+	const auto f = [&](thread_counters_t& counters){
+		bump(alloc ? counters._alloc_count : counters._free_count, 1);
+		if(large && alloc){
+			bump(counters._large_alloc_count, 1);
+		}
+		bump(counters._live_bytes, alloc ? bytes : -bytes);
+	};
+
+	if(cache != nullptr){
+		f(cache->_counters);
+	}
+	else{
+		auto& shared = get_shared_heap();
+		std::lock_guard<std::mutex> lock(shared._threads_mutex);
+		f(shared._retired);
+	}
+}
+
+void* bc_heap_allocate(std::size_t size){
+	auto cache = get_thread_cache();
+	if(size > k_bc_heap_max_block_size){
+		count_block(cache, true, true, size);
+		return ::operator new(size);
+	}
+
+	const auto size_class = get_size_class(size);
+	count_block(cache, true, false, get_block_size(size_class));
+
+	auto& shared = get_shared_heap();
+	if(cache == nullptr){
+		std::lock_guard<std::mutex> lock(shared._list_mutexes[size_class]);
+		auto& list = shared._lists[size_class];
+		if(list._head == nullptr){
+			carve_blocks(shared, size_class, 1, list);
+		}
+		return list.pop();
+	}
+
+	auto& list = cache->_lists[size_class];
+	if(list._head == nullptr){
+		{
+			std::lock_guard<std::mutex> lock(shared._list_mutexes[size_class]);
+			shared._lists[size_class].move_to(list, k_batch_blocks);
+		}
+		if(list._head == nullptr){
+			carve_blocks(shared, size_class, k_batch_blocks, list);
+		}
+		bump(cache->_counters._refill_count, 1);
+	}
+	return list.pop();
+}
+
+void bc_heap_deallocate(std::size_t size, void* data){
+	if(data == nullptr){
+		return;
+	}
+
+	auto cache = get_thread_cache();
+	if(size > k_bc_heap_max_block_size){
+		count_block(cache, false, true, size);
+		::operator delete(data);
+		return;
+	}
+
+	const auto size_class = get_size_class(size);
+	count_block(cache, false, false, get_block_size(size_class));
+
+#if DEBUG
+	std::memset(data, 0xdd, get_block_size(size_class));
+#endif
+
+	const auto block = static_cast<free_block_t*>(data);
+	auto& shared = get_shared_heap();
+	if(cache == nullptr){
+		std::lock_guard<std::mutex> lock(shared._list_mutexes[size_class]);
+		shared._lists[size_class].push(block);
+		return;
+	}
+
+	auto& list = cache->_lists[size_class];
+	list.push(block);
+	if(list._count > k_max_thread_blocks){
+		move_to_shared(shared, size_class, list, k_max_thread_blocks / 2);
+	}
+}
+
+
+//////////////////////////////////////		stats
+
+
+bc_heap_stats_t get_bc_heap_stats(){
+	auto& shared = get_shared_heap();
+
+	bc_heap_stats_t result = { 0, 0, 0, 0, 0, 0, 0 };
+	{
+		std::lock_guard<std::mutex> lock(shared._threads_mutex);
+		for(const auto& e: shared._threads){
+			add_counters(result, *e);
+		}
+		add_counters(result, shared._retired);
+	}
+	{
+		std::lock_guard<std::mutex> lock(shared._slab_mutex);
+		result._slab_count = shared._slab_count;
+		result._slab_bytes = shared._slab_count * static_cast<int64_t>(k_bc_heap_slab_size);
+	}
+	return result;
+}
+
+json_t bc_heap_stats_to_json(const bc_heap_stats_t& stats){
+	return json_t::make_object({
+		{ "alloc_count", json_t(static_cast<double>(stats._alloc_count)) },
+		{ "free_count", json_t(static_cast<double>(stats._free_count)) },
+		{ "large_alloc_count", json_t(static_cast<double>(stats._large_alloc_count)) },
+		{ "refill_count", json_t(static_cast<double>(stats._refill_count)) },
+		{ "live_bytes", json_t(static_cast<double>(stats._live_bytes)) },
+		{ "slab_bytes", json_t(static_cast<double>(stats._slab_bytes)) },
+		{ "slab_count", json_t(static_cast<double>(stats._slab_count)) }
+	});
+}
+
+
+//////////////////////////////////////		TESTS
+
+
+QUARK_UNIT_TEST("bytecode_heap", "bc_heap_allocate()", "blocks are reused", ""){
+	const auto a = bc_heap_allocate(40);
+	bc_heap_deallocate(40, a);
+
+	//	Same size class, so this thread's free list hands back the same block.
+	const auto b = bc_heap_allocate(48);
+	QUARK_UT_VERIFY(b == a);
+	bc_heap_deallocate(48, b);
+}
+
+QUARK_UNIT_TEST("bytecode_heap", "get_bc_heap_stats()", "counts blocks freed on another thread", ""){
+	const auto before = get_bc_heap_stats();
+
+	std::vector<void*> blocks;
+	for(int i = 0 ; i < 1000 ; i++){
+		blocks.push_back(bc_heap_allocate(24));
+	}
+	blocks.push_back(bc_heap_allocate(k_bc_heap_max_block_size + 1));
+
+	std::thread other([&](){
+		for(int i = 0 ; i < 1000 ; i++){
+			bc_heap_deallocate(24, blocks[i]);
+		}
+		bc_heap_deallocate(k_bc_heap_max_block_size + 1, blocks[1000]);
+	});
+	other.join();
+
+	const auto after = get_bc_heap_stats();
+	QUARK_UT_VERIFY(after._alloc_count - before._alloc_count == 1001);
+	QUARK_UT_VERIFY(after._free_count - before._free_count == 1001);
+	QUARK_UT_VERIFY(after._large_alloc_count - before._large_alloc_count == 1);
+	QUARK_UT_VERIFY(after._live_bytes == before._live_bytes);
+	QUARK_UT_VERIFY(after._slab_bytes > 0);
+}
+
+
+} //	floyd
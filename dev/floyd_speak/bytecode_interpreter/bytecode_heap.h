@@ -0,0 +1,98 @@
+//
+//  bytecode_heap.h
+//  FloydSpeak
+//
+
+#ifndef bytecode_heap_h
+#define bytecode_heap_h
+
+/*
+	Pooled allocator for the interpreter's heap objects: the bc_external_value_t:s and the immer nodes under them.
+
+	Blocks are rounded up to size classes of k_bc_heap_granularity bytes, up to k_bc_heap_max_block_size. Each thread
+	keeps its own free list per size class and needs no locking. When a thread's list runs dry it takes a batch of blocks
+	from the shared free list of that size class, or carves new blocks out of a slab. When a list grows too long, half of
+	it goes back to the shared list. A block can be freed by another thread than the one that allocated it -- values are
+	sent between processes.
+
+	Slabs are never returned to the OS, freed blocks are reused by the same size class. Bigger blocks use operator new.
+*/
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "immer/memory_policy.hpp"
+#include "immer/vector.hpp"
+#include "immer/flex_vector.hpp"
+#include "immer/map.hpp"
+
+struct json_t;
+
+namespace floyd {
+
+
+const std::size_t k_bc_heap_granularity = 16;
+const std::size_t k_bc_heap_max_block_size = 512;
+const std::size_t k_bc_heap_slab_size = 64 * 1024;
+
+void* bc_heap_allocate(std::size_t size);
+
+//	size must be the same as when the block was allocated.
+void bc_heap_deallocate(std::size_t size, void* data);
+
+
+//////////////////////////////////////		bc_heap_stats_t
+
+//	Summed over all threads. Blocks and bytes are counted per size class, not per requested size.
+
+struct bc_heap_stats_t {
+	int64_t _alloc_count;
+	int64_t _free_count;
+
+	//	Allocations bigger than k_bc_heap_max_block_size, they went to operator new.
+	int64_t _large_alloc_count;
+
+	//	Allocations that had to lock the shared free lists.
+	int64_t _refill_count;
+
+	int64_t _live_bytes;
+	int64_t _slab_bytes;
+	int64_t _slab_count;
+};
+
+bc_heap_stats_t get_bc_heap_stats();
+json_t bc_heap_stats_to_json(const bc_heap_stats_t& stats);
+
+
+//////////////////////////////////////		immer
+
+
+//	Lets immer allocate its nodes from the pools.
+struct bc_immer_heap_t {
+	template <typename... Tags>
+	static void* allocate(std::size_t size, Tags...){
+		return bc_heap_allocate(size);
+	}
+
+	static void deallocate(std::size_t size, void* data){
+		bc_heap_deallocate(size, data);
+	}
+};
+
+typedef immer::memory_policy<immer::heap_policy<bc_immer_heap_t>, immer::default_refcount_policy> bc_memory_policy;
+
+template <typename T>
+using bc_immer_vector_t = immer::vector<T, bc_memory_policy>;
+
+template <typename T>
+using bc_immer_flex_vector_t = immer::flex_vector<T, bc_memory_policy>;
+
+template <typename K, typename T>
+using bc_immer_map_t = immer::map<K, T, std::hash<K>, std::equal_to<K>, bc_memory_policy>;
+
+
+} //	floyd
+
+#endif /* bytecode_heap_h */
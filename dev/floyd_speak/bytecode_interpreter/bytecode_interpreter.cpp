@@ -9,11 +9,18 @@
 #include "bytecode_interpreter.h"
 
 #include "host_functions.h"
+#include "bytecode_jit.h"
+#include "bytecode_memo.h"
 #include "text_parser.h"
 #include "ast_value.h"
 #include "ast_json.h"
+#include "immer/vector_transient.hpp"
+#include "immer/algorithm.hpp"
 #include <sys/time.h>
 #include <algorithm>
+#include <array>
+#include <limits>
+#include <mutex>
 
 
 namespace floyd {
@@ -22,19 +29,438 @@ namespace floyd {
 void release_pod_external(bc_pod_value_t& value){
 	QUARK_ASSERT(value._external != nullptr);
 
+	if(is_inline_string(value)){
+		return;
+	}
 	value._external->_rc--;
 	if(value._external->_rc == 0){
-		delete value._external;
+		delete_external_value(value._external);
 		value._external = nullptr;
 	}
 }
 
+////////////////////////////////////////////			inline strings
+
+
+bc_pod_value_t make_pod_string(const char s[], std::size_t size){
+	bc_pod_value_t result;
+	if(size <= k_inline_string_max_size){
+		result._external = nullptr;
+		result._inline_string[0] = static_cast<char>((size << 1) | 1);
+		std::memcpy(&result._inline_string[1], s, size);
+		QUARK_ASSERT(is_inline_string(result));
+	}
+	else if(size < k_rope_min_size){
+		result._external = new bc_external_string_t{ std::string(s, size) };
+	}
+	else{
+		result._external = new bc_external_rope_t{ bc_immer_flex_vector_t<char>(s, s + size) };
+	}
+	return result;
+}
+
+static bool is_rope(const bc_pod_value_t& value){
+	return is_inline_string(value) == false && value._external->_kind == bc_external_kind::k_rope;
+}
+
+//	Calls fn(first, last) for each run of contiguous characters in [start, end) of value, until fn returns false.
+//	A rope is walked chunk by chunk, other strings are a single run. Returns false if fn stopped the walk.
+template <typename F>
+static bool for_each_pod_string_chunk_p(const bc_pod_value_t& value, std::size_t start, std::size_t end, F&& fn){
+	QUARK_ASSERT(start <= end && end <= get_pod_string_size(value));
+
+	if(is_inline_string(value)){
+		return fn(&value._inline_string[1 + start], &value._inline_string[1 + end]);
+	}
+	else if(is_rope(value)){
+		const auto& chars = value._external->get_rope();
+		return immer::for_each_chunk_p(chars.begin() + start, chars.begin() + end, fn);
+	}
+	else{
+		const auto data = value._external->get_string().data();
+		return fn(data + start, data + end);
+	}
+}
+
+//	Appends characters [start, end) of value to dest.
+static void append_pod_substring(std::string& dest, const bc_pod_value_t& value, std::size_t start, std::size_t end){
+	dest.reserve(dest.size() + (end - start));
+	for_each_pod_string_chunk_p(
+		value,
+		start,
+		end,
+		[&](const char* first, const char* last){ dest.append(first, last); return true; }
+	);
+}
+
+const std::string& get_pod_string(const bc_pod_value_t& value, std::string& storage){
+	if(is_inline_string(value) || is_rope(value)){
+		storage.clear();
+		append_pod_substring(storage, value, 0, get_pod_string_size(value));
+		return storage;
+	}
+	else{
+		return value._external->get_string();
+	}
+}
+
+//	FNV-1a over the bytes, so the chunk boundaries don't matter.
+std::size_t hash_pod_string(const bc_pod_value_t& value){
+	uint64_t hash = 14695981039346656037ULL;
+	for_each_pod_string_chunk_p(
+		value,
+		0,
+		get_pod_string_size(value),
+		[&](const char* first, const char* last){
+			for(auto it = first ; it != last ; it++){
+				hash = (hash ^ static_cast<unsigned char>(*it)) * 1099511628211ULL;
+			}
+			return true;
+		}
+	);
+	return static_cast<std::size_t>(hash);
+}
+
+std::size_t get_pod_string_size(const bc_pod_value_t& value){
+	if(is_inline_string(value)){
+		return static_cast<unsigned char>(value._inline_string[0]) >> 1;
+	}
+	else if(is_rope(value)){
+		return value._external->get_rope().size();
+	}
+	else{
+		return value._external->get_string().size();
+	}
+}
+
+
+QUARK_UNIT_TEST("bc_value_t", "make_pod_string()", "short strings are inline", ""){
+	const auto a = bc_value_t::make_string("");
+	const auto b = bc_value_t::make_string("1234567");
+	const auto c = bc_value_t::make_string("12345678");
+
+	QUARK_UT_VERIFY(is_inline_string(a._pod));
+	QUARK_UT_VERIFY(is_inline_string(b._pod));
+	QUARK_UT_VERIFY(is_inline_string(c._pod) == false);
+	QUARK_UT_VERIFY(a.get_string_value() == "");
+	QUARK_UT_VERIFY(b.get_string_value() == "1234567");
+	QUARK_UT_VERIFY(c.get_string_value() == "12345678");
+	QUARK_UT_VERIFY(get_pod_string_size(b._pod) == 7);
+
+	//	Equal inline strings have equal bits.
+	const auto b2 = bc_value_t::make_string("1234567");
+	QUARK_UT_VERIFY(std::memcmp(&b._pod, &b2._pod, sizeof(bc_pod_value_t)) == 0);
+}
+
+
+
+////////////////////////////////////////////			rope strings
+
+
+char get_pod_string_char(const bc_pod_value_t& value, std::size_t index){
+	QUARK_ASSERT(index < get_pod_string_size(value));
+
+	if(is_inline_string(value)){
+		return value._inline_string[1 + index];
+	}
+	else if(is_rope(value)){
+		return value._external->get_rope()[index];
+	}
+	else{
+		return value._external->get_string()[index];
+	}
+}
+
+//	The characters of value as a flex_vector. Shares the chunks of a rope, copies a shorter string.
+static bc_immer_flex_vector_t<char> get_pod_string_chars(const bc_pod_value_t& value){
+	if(is_rope(value)){
+		return value._external->get_rope();
+	}
+	else{
+		std::string storage;
+		const auto& s = get_pod_string(value, storage);
+		return bc_immer_flex_vector_t<char>(s.begin(), s.end());
+	}
+}
+
+static bc_pod_value_t make_pod_rope(const bc_immer_flex_vector_t<char>& chars){
+	QUARK_ASSERT(chars.size() >= k_rope_min_size);
+
+	bc_pod_value_t result;
+	result._external = new bc_external_rope_t{ chars };
+	return result;
+}
+
+bc_pod_value_t replace_pod_string(const bc_pod_value_t& value, std::size_t start, std::size_t end, const bc_pod_value_t& new_bits){
+	const auto size = get_pod_string_size(value);
+	const auto new_bits_size = get_pod_string_size(new_bits);
+	QUARK_ASSERT(start <= size && end <= size);
+
+	const auto size2 = start + new_bits_size + (size - end);
+	if(size2 < k_rope_min_size){
+		std::string s;
+		s.reserve(size2);
+		append_pod_substring(s, value, 0, start);
+		append_pod_substring(s, new_bits, 0, new_bits_size);
+		append_pod_substring(s, value, end, size);
+		return make_pod_string(s.data(), s.size());
+	}
+	else{
+		const auto chars = get_pod_string_chars(value);
+		return make_pod_rope(chars.take(start) + get_pod_string_chars(new_bits) + chars.drop(end));
+	}
+}
+
+bc_pod_value_t concat_pod_strings(const bc_pod_value_t& left, const bc_pod_value_t& right){
+	const auto size = get_pod_string_size(left);
+	return replace_pod_string(left, size, size, right);
+}
+
+bc_pod_value_t subset_pod_string(const bc_pod_value_t& value, std::size_t start, std::size_t end){
+	QUARK_ASSERT(start <= end && end <= get_pod_string_size(value));
+
+	if(end - start < k_rope_min_size){
+		std::string s;
+		append_pod_substring(s, value, start, end);
+		return make_pod_string(s.data(), s.size());
+	}
+	else{
+		return make_pod_rope(value._external->get_rope().drop(start).take(end - start));
+	}
+}
+
+bc_pod_value_t update_pod_string_char(const bc_pod_value_t& value, std::size_t index, char ch){
+	QUARK_ASSERT(index < get_pod_string_size(value));
+
+	if(is_rope(value)){
+		return make_pod_rope(value._external->get_rope().set(index, ch));
+	}
+	else{
+		std::string storage;
+		auto s = get_pod_string(value, storage);
+		s[index] = ch;
+		return make_pod_string(s.data(), s.size());
+	}
+}
+
+QUARK_UNIT_TEST("bc_value_t", "replace_pod_string()", "long strings are ropes", ""){
+	std::string text;
+	for(int i = 0 ; i < 3000 ; i++){
+		text.push_back(static_cast<char>('a' + i % 26));
+	}
+	const auto x = make_pod_string("xyz", 3);
+	auto a = make_pod_string(text.data(), text.size());
+	auto b = subset_pod_string(a, 1000, 2500);
+	auto c = subset_pod_string(a, 1000, 1010);
+	auto d = replace_pod_string(a, 10, 2990, x);
+	auto e = replace_pod_string(a, 10, 20, x);
+	auto f = concat_pod_strings(b, c);
+	auto g = update_pod_string_char(a, 2000, '!');
+
+	QUARK_UT_VERIFY(is_rope(a) && is_rope(b) && is_rope(e) && is_rope(f) && is_rope(g));
+	QUARK_UT_VERIFY(is_rope(c) == false && is_rope(d) == false);
+
+	std::string storage;
+	QUARK_UT_VERIFY(get_pod_string(b, storage) == text.substr(1000, 1500));
+	QUARK_UT_VERIFY(get_pod_string(c, storage) == text.substr(1000, 10));
+	QUARK_UT_VERIFY(get_pod_string(d, storage) == text.substr(0, 10) + "xyz" + text.substr(2990));
+	QUARK_UT_VERIFY(get_pod_string(e, storage) == text.substr(0, 10) + "xyz" + text.substr(20));
+	QUARK_UT_VERIFY(get_pod_string(f, storage) == text.substr(1000, 1500) + text.substr(1000, 10));
+	QUARK_UT_VERIFY(get_pod_string_char(g, 2000) == '!');
+	QUARK_UT_VERIFY(get_pod_string_char(a, 2000) == text[2000]);
+
+	for(auto value: { &a, &b, &c, &d, &e, &f, &g }){
+		release_pod_external(*value);
+	}
+}
+
+
+
+////////////////////////////////////////////			bc_typeid_t interning
+
+
+struct bc_type_entry_t {
+	typeid_t _type = typeid_t::make_undefined();
+	bool _external = false;
+
+	//	Only structs: the interned type of each member.
+	std::vector<bc_typeid_t> _member_types;
+
+	//	Only vectors and dicts: the interned element / value type.
+	bc_typeid_t _element_type = k_bc_typeid_undefined;
+};
+
+/*
+	Entries live in fixed-size chunks that never move, so lookups can read them without the lock.
+	_count is published after the entry is written.
+*/
+struct bc_type_table_t {
+	static const int k_chunk_size = 1024;
+	static const int k_max_chunks = 1024;
+
+	bc_type_table_t() :
+		_count(0)
+	{
+		for(auto& chunk: _chunks){
+			chunk.store(nullptr);
+		}
+
+		//	The types without parts get the same id as their base_type.
+		const std::vector<typeid_t> fixed = {
+			typeid_t::make_undefined(),
+			typeid_t::make_internal_dynamic(),
+			typeid_t::make_void(),
+			typeid_t::make_bool(),
+			typeid_t::make_int(),
+			typeid_t::make_double(),
+			typeid_t::make_string(),
+			typeid_t::make_json_value(),
+			typeid_t::make_typeid()
+		};
+		for(const auto& type: fixed){
+			const auto id = add(type, {}, k_bc_typeid_undefined);
+			QUARK_ASSERT(id == static_cast<bc_typeid_t>(type.get_base_type()));
+			(void)id;
+		}
+	}
+
+	const bc_type_entry_t& lookup(bc_typeid_t type) const {
+		QUARK_ASSERT(type >= 0 && type < _count.load());
+
+		return _chunks[type / k_chunk_size].load(std::memory_order_acquire)[type % k_chunk_size];
+	}
+
+	bc_typeid_t intern(const typeid_t& type){
+		const auto key = typeid_to_compact_string(type);
+
+		//	Before locking: interning a part locks too.
+		std::vector<bc_typeid_t> member_types;
+		bc_typeid_t element_type = k_bc_typeid_undefined;
+		if(type.is_struct()){
+			for(const auto& member: type.get_struct()._members){
+				member_types.push_back(intern_bc_type(member._type));
+			}
+		}
+		else if(type.is_vector()){
+			element_type = intern_bc_type(type.get_vector_element_type());
+		}
+		else if(type.is_dict()){
+			element_type = intern_bc_type(type.get_dict_value_type());
+		}
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		const auto range = _index.equal_range(key);
+		for(auto it = range.first ; it != range.second ; it++){
+			if(lookup(it->second)._type == type){
+				return it->second;
+			}
+		}
+		const auto id = add(type, member_types, element_type);
+		_index.insert({ key, id });
+		return id;
+	}
+
+	//	Caller holds _mutex, or is the constructor.
+	bc_typeid_t add(const typeid_t& type, const std::vector<bc_typeid_t>& member_types, bc_typeid_t element_type){
+		const auto id = _count.load(std::memory_order_relaxed);
+		const auto chunk_index = id / k_chunk_size;
+		if(chunk_index >= k_max_chunks){
+			quark::throw_runtime_error("Too many types.");
+		}
+		if(_chunks[chunk_index].load(std::memory_order_relaxed) == nullptr){
+			_chunks[chunk_index].store(new bc_type_entry_t[k_chunk_size], std::memory_order_release);
+		}
+		_chunks[chunk_index].load(std::memory_order_relaxed)[id % k_chunk_size] = bc_type_entry_t{ type, encode_as_external(type), member_types, element_type };
+		_count.store(id + 1, std::memory_order_release);
+		return id;
+	}
+
+
+	std::atomic<bc_type_entry_t*> _chunks[k_max_chunks];
+	std::atomic<bc_typeid_t> _count;
+
+	std::mutex _mutex;
+	std::unordered_multimap<std::string, bc_typeid_t> _index;
+};
+
+//	Never destroyed: values in other static objects may still use it at exit.
+static bc_type_table_t& get_type_table(){
+	static auto table = new bc_type_table_t();
+	return *table;
+}
+
+bc_typeid_t intern_bc_type(const typeid_t& type){
+	QUARK_ASSERT(type.check_invariant());
+
+	const auto basetype = type.get_base_type();
+	if(static_cast<bc_typeid_t>(basetype) <= k_bc_typeid_typeid){
+		return static_cast<bc_typeid_t>(basetype);
+	}
+	else{
+		return get_type_table().intern(type);
+	}
+}
+
+std::vector<bc_typeid_t> intern_bc_types(const std::vector<typeid_t>& types){
+	std::vector<bc_typeid_t> result;
+	for(const auto& type: types){
+		result.push_back(intern_bc_type(type));
+	}
+	return result;
+}
+
+const typeid_t& lookup_bc_type(bc_typeid_t type){
+	return get_type_table().lookup(type)._type;
+}
+
+const std::vector<bc_typeid_t>& lookup_bc_struct_member_types(bc_typeid_t struct_type){
+	QUARK_ASSERT(lookup_bc_type(struct_type).is_struct());
+
+	return get_type_table().lookup(struct_type)._member_types;
+}
+
+bc_typeid_t lookup_bc_vector_element_type(bc_typeid_t vector_type){
+	QUARK_ASSERT(lookup_bc_type(vector_type).is_vector());
+
+	return get_type_table().lookup(vector_type)._element_type;
+}
+
+bc_typeid_t lookup_bc_dict_value_type(bc_typeid_t dict_type){
+	QUARK_ASSERT(lookup_bc_type(dict_type).is_dict());
+
+	return get_type_table().lookup(dict_type)._element_type;
+}
+
+bool is_bc_type_external_slow(bc_typeid_t type){
+	return get_type_table().lookup(type)._external;
+}
+
+QUARK_UNIT_TEST("bc_typeid_t", "intern_bc_type()", "", ""){
+	QUARK_UT_VERIFY(intern_bc_type(typeid_t::make_int()) == k_bc_typeid_int);
+	QUARK_UT_VERIFY(intern_bc_type(typeid_t::make_string()) == k_bc_typeid_string);
+	QUARK_UT_VERIFY(is_bc_type_external(k_bc_typeid_string));
+	QUARK_UT_VERIFY(is_bc_type_external(k_bc_typeid_double) == false);
+
+	const auto a = intern_bc_type(typeid_t::make_vector(typeid_t::make_int()));
+	const auto b = intern_bc_type(typeid_t::make_vector(typeid_t::make_int()));
+	const auto c = intern_bc_type(typeid_t::make_vector(typeid_t::make_string()));
+	QUARK_UT_VERIFY(a == b);
+	QUARK_UT_VERIFY(a != c);
+	QUARK_UT_VERIFY(lookup_bc_type(c) == typeid_t::make_vector(typeid_t::make_string()));
+	QUARK_UT_VERIFY(is_bc_type_external(c));
+	QUARK_UT_VERIFY(lookup_bc_vector_element_type(c) == k_bc_typeid_string);
+
+	const auto d = intern_bc_type(typeid_t::make_dict(typeid_t::make_vector(typeid_t::make_int())));
+	QUARK_UT_VERIFY(lookup_bc_dict_value_type(d) == a);
+}
+
+
 ////////////////////////////////////////////			bc_value_t
 
 
 
 bc_value_t::bc_value_t() :
-	_type(typeid_t::make_undefined())
+	_typeid(k_bc_typeid_undefined)
 {
 	_pod._external = nullptr;
 	QUARK_ASSERT(check_invariant());
@@ -43,19 +469,19 @@ bc_value_t::bc_value_t() :
 bc_value_t::~bc_value_t(){
 	QUARK_ASSERT(check_invariant());
 
-	if(encode_as_external(_type)){
+	if(is_bc_type_external(_typeid)){
 		release_pod_external(_pod);
 	}
 }
 
 bc_value_t::bc_value_t(const bc_value_t& other) :
-	_type(other._type),
+	_typeid(other._typeid),
 	_pod(other._pod)
 {
 	QUARK_ASSERT(other.check_invariant());
 
-	if(encode_as_external(_type)){
-		_pod._external->_rc++;
+	if(is_bc_type_external(_typeid)){
+		retain_external(_pod._external);
 	}
 
 	QUARK_ASSERT(check_invariant());
@@ -77,7 +503,7 @@ void bc_value_t::swap(bc_value_t& other){
 	QUARK_ASSERT(other.check_invariant());
 	QUARK_ASSERT(check_invariant());
 
-	std::swap(_type, other._type);
+	std::swap(_typeid, other._typeid);
 	std::swap(_pod, other._pod);
 
 	QUARK_ASSERT(other.check_invariant());
@@ -85,7 +511,7 @@ void bc_value_t::swap(bc_value_t& other){
 }
 
 bc_value_t::bc_value_t(const bc_static_frame_t* frame_ptr) :
-	_type(typeid_t::make_void())
+	_typeid(k_bc_typeid_void)
 {
 	_pod._inplace._frame_ptr = frame_ptr;
 	QUARK_ASSERT(check_invariant());
@@ -127,7 +553,7 @@ bool bc_value_t::get_bool_value() const {
 	return _pod._inplace._bool;
 }
 bc_value_t::bc_value_t(bool value) :
-	_type(typeid_t::make_bool())
+	_typeid(k_bc_typeid_bool)
 {
 	_pod._inplace._bool = value;
 	QUARK_ASSERT(check_invariant());
@@ -146,7 +572,7 @@ int64_t bc_value_t::get_int_value() const {
 	return _pod._inplace._int64;
 }
 bc_value_t::bc_value_t(int64_t value) :
-	_type(typeid_t::make_int())
+	_typeid(k_bc_typeid_int)
 {
 	_pod._inplace._int64 = value;
 	QUARK_ASSERT(check_invariant());
@@ -165,7 +591,7 @@ double bc_value_t::get_double_value() const {
 	return _pod._inplace._double;
 }
 bc_value_t::bc_value_t(double value) :
-	_type(typeid_t::make_double())
+	_typeid(k_bc_typeid_double)
 {
 	_pod._inplace._double = value;
 	QUARK_ASSERT(check_invariant());
@@ -178,15 +604,22 @@ bc_value_t::bc_value_t(double value) :
 bc_value_t bc_value_t::make_string(const std::string& v){
 	return bc_value_t{ v };
 }
+bc_value_t bc_value_t::adopt_string(const bc_pod_value_t& owned_string){
+	const auto result = bc_value_t(k_bc_typeid_string, owned_string);
+	auto temp = owned_string;
+	release_pod_external(temp);
+	return result;
+}
 std::string bc_value_t::get_string_value() const{
 	QUARK_ASSERT(check_invariant());
 
-	return _pod._external->_string;
+	std::string storage;
+	return get_pod_string(_pod, storage);
 }
 bc_value_t::bc_value_t(const std::string& value) :
-	_type(typeid_t::make_string())
+	_typeid(k_bc_typeid_string),
+	_pod(make_pod_string(value.c_str(), value.size()))
 {
-	_pod._external = new bc_external_value_t{value};
 	QUARK_ASSERT(check_invariant());
 }
 
@@ -200,15 +633,15 @@ bc_value_t bc_value_t::make_json_value(const json_t& v){
 json_t bc_value_t::get_json_value() const{
 	QUARK_ASSERT(check_invariant());
 
-	return *_pod._external->_json_value.get();
+	return *_pod._external->get_json_value().get();
 }
 bc_value_t::bc_value_t(const std::shared_ptr<json_t>& value) :
-	_type(typeid_t::make_json_value())
+	_typeid(k_bc_typeid_json_value)
 {
 	QUARK_ASSERT(value);
 	QUARK_ASSERT(value->check_invariant());
 
-	_pod._external = new bc_external_value_t{value};
+	_pod._external = new bc_external_json_value_t{value};
 
 	QUARK_ASSERT(check_invariant());
 }
@@ -223,14 +656,14 @@ bc_value_t bc_value_t::make_typeid_value(const typeid_t& type_id){
 typeid_t bc_value_t::get_typeid_value() const {
 	QUARK_ASSERT(check_invariant());
 
-	return _pod._external->_typeid_value;
+	return _pod._external->get_typeid_value();
 }
 bc_value_t::bc_value_t(const typeid_t& type_id) :
-	_type(typeid_t::make_typeid())
+	_typeid(k_bc_typeid_typeid)
 {
 	QUARK_ASSERT(type_id.check_invariant());
 
-	_pod._external = new bc_external_value_t{type_id};
+	_pod._external = new bc_external_typeid_t{type_id};
 
 	QUARK_ASSERT(check_invariant());
 }
@@ -241,25 +674,30 @@ bc_value_t::bc_value_t(const typeid_t& type_id) :
 
 
 bc_value_t bc_value_t::make_struct_value(const typeid_t& struct_type, const std::vector<bc_value_t>& values){
+	QUARK_ASSERT(struct_type.check_invariant());
+
+	return bc_value_t{ intern_bc_type(struct_type), values, true };
+}
+bc_value_t bc_value_t::make_struct_value(bc_typeid_t struct_type, const std::vector<bc_value_t>& values){
 	return bc_value_t{ struct_type, values, true };
 }
 const std::vector<bc_value_t>& bc_value_t::get_struct_value() const {
 	QUARK_ASSERT(check_invariant());
-	QUARK_ASSERT(_type.is_struct());
+	QUARK_ASSERT(get_type().is_struct());
 
-	return _pod._external->_struct_members;
+	return _pod._external->get_struct_members();
 }
-bc_value_t::bc_value_t(const typeid_t& struct_type, const std::vector<bc_value_t>& values, bool struct_tag) :
-	_type(struct_type)
+bc_value_t::bc_value_t(bc_typeid_t struct_type, const std::vector<bc_value_t>& values, bool struct_tag) :
+	_typeid(struct_type)
 {
-	QUARK_ASSERT(struct_type.check_invariant());
+	QUARK_ASSERT(get_type().is_struct());
 #if QUARK_ASSERT_ON
 	for(const auto& e: values) {
 		QUARK_ASSERT(e.check_invariant());
 	}
 #endif
 
-	_pod._external = new bc_external_value_t{ struct_type, values, true };
+	_pod._external = new bc_external_struct_t{ get_type(), values };
 	QUARK_ASSERT(check_invariant());
 }
 
@@ -276,7 +714,7 @@ int bc_value_t::get_function_value() const{
 	return _pod._inplace._function_id;
 }
 bc_value_t::bc_value_t(const typeid_t& function_type, int function_id, bool dummy) :
-	_type(function_type)
+	_typeid(intern_bc_type(function_type))
 {
 	_pod._inplace._function_id = function_id;
 	QUARK_ASSERT(check_invariant());
@@ -284,41 +722,39 @@ bc_value_t::bc_value_t(const typeid_t& function_type, int function_id, bool dumm
 
 
 
-bc_value_t::bc_value_t(const typeid_t& type, const bc_pod_value_t& internals) :
-	_type(type),
+bc_value_t::bc_value_t(bc_typeid_t type, const bc_pod_value_t& internals) :
+	_typeid(type),
 	_pod(internals)
 {
-	QUARK_ASSERT(type.check_invariant());
 #if QUARK_ASSERT_ON
-	if(encode_as_external(type)){
-		QUARK_ASSERT(check_external_deep(type, internals._external));
+	if(is_bc_type_external(type)){
+		QUARK_ASSERT(check_external_deep(get_type(), internals._external));
 	}
 #endif
 
-	if(encode_as_external(_type)){
-		_pod._external->_rc++;
+	if(is_bc_type_external(_typeid)){
+		retain_external(_pod._external);
 	}
 	QUARK_ASSERT(check_invariant());
 }
 
-bc_value_t::bc_value_t(const typeid_t& type, const bc_inplace_value_t& pod64) :
-	_type(type),
+bc_value_t::bc_value_t(bc_typeid_t type, const bc_inplace_value_t& pod64) :
+	_typeid(type),
 	_pod{._inplace = pod64}
 {
-	QUARK_ASSERT(type.check_invariant());
-	QUARK_ASSERT(encode_as_external(_type) == false);
+	QUARK_ASSERT(is_bc_type_external(_typeid) == false);
 
 	QUARK_ASSERT(check_invariant());
 }
 
-bc_value_t::bc_value_t(const typeid_t& type, const bc_external_handle_t& handle) :
-	_type(type),
+bc_value_t::bc_value_t(bc_typeid_t type, const bc_external_handle_t& handle) :
+	_typeid(type),
 	_pod{._external = handle._external}
 {
-	QUARK_ASSERT(type.check_invariant());
+	QUARK_ASSERT(is_bc_type_external(type));
 	QUARK_ASSERT(handle.check_invariant());
 
-	_pod._external->_rc++;
+	retain_external(_pod._external);
 
 	QUARK_ASSERT(check_invariant());
 }
@@ -327,9 +763,9 @@ bc_value_t::bc_value_t(const typeid_t& type, const bc_external_handle_t& handle)
 
 #if DEBUG
 bool bc_value_t::check_invariant() const {
-	QUARK_ASSERT(_type.check_invariant());
-	if(encode_as_external(_type)){
-		QUARK_ASSERT(check_external_deep(_type, _pod._external))
+	QUARK_ASSERT(get_type().check_invariant());
+	if(is_bc_type_external(_typeid)){
+		QUARK_ASSERT(check_external_deep(get_type(), _pod._external))
 	}
 
 	return true;
@@ -337,12 +773,12 @@ bool bc_value_t::check_invariant() const {
 #endif
 
 bc_value_t::bc_value_t(const typeid_t& type, mode mode) :
-	_type(type)
+	_typeid(intern_bc_type(type))
 {
 	QUARK_ASSERT(type.check_invariant());
 
 	//	Allocate a dummy external value.
-	auto temp = new bc_external_value_t{"UNWRITTEN EXT VALUE"};
+	auto temp = new bc_external_string_t{"UNWRITTEN EXT VALUE"};
 #if DEBUG
 	temp->_debug__is_unwritten_external_value = true;
 #endif
@@ -362,7 +798,7 @@ bc_external_handle_t::bc_external_handle_t(const bc_external_handle_t& other) :
 {
 	QUARK_ASSERT(other.check_invariant());
 
-	_external->_rc++;
+	retain_external(_external);
 
 	QUARK_ASSERT(check_invariant());
 }
@@ -372,7 +808,7 @@ bc_external_handle_t::bc_external_handle_t(const bc_external_value_t* ext) :
 {
 	QUARK_ASSERT(ext != nullptr);
 
-	_external->_rc++;
+	retain_external(_external);
 
 	QUARK_ASSERT(check_invariant());
 }
@@ -381,9 +817,9 @@ bc_external_handle_t::bc_external_handle_t(const bc_value_t& value) :
 	_external(value._pod._external)
 {
 	QUARK_ASSERT(value.check_invariant());
-	QUARK_ASSERT(encode_as_external(value._type));
+	QUARK_ASSERT(encode_as_external(value.get_type()));
 
-	_external->_rc++;
+	retain_external(_external);
 
 	QUARK_ASSERT(check_invariant());
 }
@@ -407,16 +843,19 @@ bc_external_handle_t& bc_external_handle_t::operator=(const bc_external_handle_t
 bc_external_handle_t::~bc_external_handle_t(){
 	QUARK_ASSERT(check_invariant());
 
+	if(is_inline_string(_external)){
+		return;
+	}
 	_external->_rc--;
 	if(_external->_rc == 0){
-		delete _external;
+		delete_external_value(_external);
 		_external = nullptr;
 	}
 }
 
 bool bc_external_handle_t::check_invariant() const {
 	QUARK_ASSERT(_external != nullptr);
-	QUARK_ASSERT(_external->check_invariant());
+	QUARK_ASSERT(is_inline_string(_external) || _external->check_invariant());
 	return true;
 }
 
@@ -523,90 +962,62 @@ bool encode_as_external(const typeid_t& type){
 		;
 }
 
+bc_external_value_t::bc_external_value_t(bc_external_kind kind, const typeid_t& debug_type) :
+	_rc(1),
+	_kind(kind)
+#if DEBUG
+	,
+	_debug_type(debug_type)
+#endif
+{
+}
+
 #if DEBUG
 bool bc_external_value_t::check_invariant() const{
 	QUARK_ASSERT(encode_as_external(_debug_type));
 	QUARK_ASSERT(_rc > 0);
 	QUARK_ASSERT(_debug_type.check_invariant());
-	QUARK_ASSERT(_typeid_value.check_invariant());
+
+	if(_debug__is_unwritten_external_value){
+		QUARK_ASSERT(_kind == bc_external_kind::k_string);
+		return true;
+	}
 
 	QUARK_ASSERT(check_external_deep(_debug_type, this));
 
 	const auto encoding = type_to_encoding(_debug_type);
 	if(encoding == value_encoding::k_external__string){
-//				QUARK_ASSERT(_string);
-		QUARK_ASSERT(_json_value == nullptr);
-		QUARK_ASSERT(_typeid_value == typeid_t::make_undefined());
-		QUARK_ASSERT(_struct_members.empty());
-		QUARK_ASSERT(_vector_w_external_elements.empty());
-		QUARK_ASSERT(_vector_w_inplace_elements.empty());
-		QUARK_ASSERT(_dict_w_external_values.size() == 0);
-		QUARK_ASSERT(_dict_w_inplace_values.size() == 0);
+		if(_kind == bc_external_kind::k_string){
+			QUARK_ASSERT(get_string().size() > k_inline_string_max_size && get_string().size() < k_rope_min_size);
+		}
+		else{
+			QUARK_ASSERT(_kind == bc_external_kind::k_rope);
+			QUARK_ASSERT(get_rope().size() >= k_rope_min_size);
+		}
 	}
 	else if(encoding == value_encoding::k_external__json_value){
-		QUARK_ASSERT(_string.empty());
-		QUARK_ASSERT(_json_value != nullptr);
-		QUARK_ASSERT(_typeid_value == typeid_t::make_undefined());
-		QUARK_ASSERT(_struct_members.empty());
-		QUARK_ASSERT(_vector_w_external_elements.empty());
-		QUARK_ASSERT(_vector_w_inplace_elements.empty());
-		QUARK_ASSERT(_dict_w_external_values.size() == 0);
-		QUARK_ASSERT(_dict_w_inplace_values.size() == 0);
-
-		QUARK_ASSERT(_json_value->check_invariant());
+		QUARK_ASSERT(_kind == bc_external_kind::k_json_value);
+		QUARK_ASSERT(get_json_value() != nullptr);
+		QUARK_ASSERT(get_json_value()->check_invariant());
 	}
 	else if(encoding == value_encoding::k_external__typeid){
-		QUARK_ASSERT(_string.empty());
-		QUARK_ASSERT(_json_value == nullptr);
-//		QUARK_ASSERT(_typeid_value != typeid_t::make_undefined());
-		QUARK_ASSERT(_struct_members.empty());
-		QUARK_ASSERT(_vector_w_external_elements.empty());
-		QUARK_ASSERT(_vector_w_inplace_elements.empty());
-		QUARK_ASSERT(_dict_w_external_values.size() == 0);
-		QUARK_ASSERT(_dict_w_inplace_values.size() == 0);
-
-		QUARK_ASSERT(_typeid_value.check_invariant());
+		QUARK_ASSERT(_kind == bc_external_kind::k_typeid);
+		QUARK_ASSERT(get_typeid_value().check_invariant());
 	}
 	else if(encoding == value_encoding::k_external__struct){
-		QUARK_ASSERT(_string.empty());
-		QUARK_ASSERT(_json_value == nullptr);
-		QUARK_ASSERT(_typeid_value == typeid_t::make_undefined());
-//				QUARK_ASSERT(_struct != nullptr);
-		QUARK_ASSERT(_vector_w_external_elements.empty());
-		QUARK_ASSERT(_vector_w_inplace_elements.empty());
-		QUARK_ASSERT(_dict_w_external_values.size() == 0);
-		QUARK_ASSERT(_dict_w_inplace_values.size() == 0);
-
-//				QUARK_ASSERT(_struct && _struct->check_invariant());
+		QUARK_ASSERT(_kind == bc_external_kind::k_struct);
 	}
 	else if(encoding == value_encoding::k_external__vector){
-		QUARK_ASSERT(_string.empty());
-		QUARK_ASSERT(_json_value == nullptr);
-		QUARK_ASSERT(_typeid_value == typeid_t::make_undefined());
-		QUARK_ASSERT(_struct_members.empty());
-//		QUARK_ASSERT(_vector_w_external_elements.empty());
-		QUARK_ASSERT(_vector_w_inplace_elements.empty());
-		QUARK_ASSERT(_dict_w_external_values.size() == 0);
-		QUARK_ASSERT(_dict_w_inplace_values.size() == 0);
+		QUARK_ASSERT(_kind == bc_external_kind::k_vector_w_external_elements);
 	}
 	else if(encoding == value_encoding::k_external__vector_pod64){
-		QUARK_ASSERT(_string.empty());
-		QUARK_ASSERT(_json_value == nullptr);
-		QUARK_ASSERT(_typeid_value == typeid_t::make_undefined());
-		QUARK_ASSERT(_struct_members.empty());
-		QUARK_ASSERT(_vector_w_external_elements.empty());
-		QUARK_ASSERT(_dict_w_external_values.size() == 0);
-		QUARK_ASSERT(_dict_w_inplace_values.size() == 0);
+		QUARK_ASSERT(_kind == bc_external_kind::k_vector_w_inplace_elements);
 	}
 	else if(encoding == value_encoding::k_external__dict){
-		QUARK_ASSERT(_string.empty());
-		QUARK_ASSERT(_json_value == nullptr);
-		QUARK_ASSERT(_typeid_value == typeid_t::make_undefined());
-		QUARK_ASSERT(_struct_members.empty());
-		QUARK_ASSERT(_vector_w_external_elements.empty());
-		QUARK_ASSERT(_vector_w_inplace_elements.empty());
-//				QUARK_ASSERT(_dict_w_external_values.size() == 0);
-//				QUARK_ASSERT(_dict_w_inplace_values.size() == 0);
+		QUARK_ASSERT(
+			_kind == bc_external_kind::k_dict_w_external_values
+			|| _kind == bc_external_kind::k_dict_w_inplace_values
+		);
 	}
 	else {
 		QUARK_ASSERT(false);
@@ -616,43 +1027,74 @@ bool bc_external_value_t::check_invariant() const{
 }
 #endif
 
-bc_external_value_t::bc_external_value_t(const std::string& s) :
-	_rc(1),
-#if DEBUG
-	_debug_type(typeid_t::make_string()),
-#endif
+void delete_external_value(const bc_external_value_t* ext){
+	QUARK_ASSERT(ext != nullptr);
+	QUARK_ASSERT(ext->_rc == 0);
+
+	switch(ext->_kind){
+		case bc_external_kind::k_string:
+			delete static_cast<const bc_external_string_t*>(ext);
+			return;
+		case bc_external_kind::k_rope:
+			delete static_cast<const bc_external_rope_t*>(ext);
+			return;
+		case bc_external_kind::k_json_value:
+			delete static_cast<const bc_external_json_value_t*>(ext);
+			return;
+		case bc_external_kind::k_typeid:
+			delete static_cast<const bc_external_typeid_t*>(ext);
+			return;
+		case bc_external_kind::k_struct:
+			delete static_cast<const bc_external_struct_t*>(ext);
+			return;
+		case bc_external_kind::k_vector_w_inplace_elements:
+			delete static_cast<const bc_external_vector_w_inplace_elements_t*>(ext);
+			return;
+		case bc_external_kind::k_vector_w_external_elements:
+			delete static_cast<const bc_external_vector_w_external_elements_t*>(ext);
+			return;
+		case bc_external_kind::k_dict_w_inplace_values:
+			delete static_cast<const bc_external_dict_w_inplace_values_t*>(ext);
+			return;
+		case bc_external_kind::k_dict_w_external_values:
+			delete static_cast<const bc_external_dict_w_external_values_t*>(ext);
+			return;
+	}
+	QUARK_ASSERT(false);
+}
+
+bc_external_string_t::bc_external_string_t(const std::string& s) :
+	bc_external_value_t(bc_external_kind::k_string, typeid_t::make_string()),
 	_string(s)
 {
 	QUARK_ASSERT(check_invariant());
 }
 
-bc_external_value_t::bc_external_value_t(const std::shared_ptr<json_t>& s) :
-	_rc(1),
-#if DEBUG
-	_debug_type(typeid_t::make_json_value()),
-#endif
+bc_external_rope_t::bc_external_rope_t(const bc_immer_flex_vector_t<char>& chars) :
+	bc_external_value_t(bc_external_kind::k_rope, typeid_t::make_string()),
+	_chars(chars)
+{
+	QUARK_ASSERT(check_invariant());
+}
+
+bc_external_json_value_t::bc_external_json_value_t(const std::shared_ptr<json_t>& s) :
+	bc_external_value_t(bc_external_kind::k_json_value, typeid_t::make_json_value()),
 	_json_value(s)
 {
 	QUARK_ASSERT(s->check_invariant());
 	QUARK_ASSERT(check_invariant());
 }
 
-bc_external_value_t::bc_external_value_t(const typeid_t& s) :
-	_rc(1),
-#if DEBUG
-	_debug_type(typeid_t::make_typeid()),
-#endif
+bc_external_typeid_t::bc_external_typeid_t(const typeid_t& s) :
+	bc_external_value_t(bc_external_kind::k_typeid, typeid_t::make_typeid()),
 	_typeid_value(s)
 {
 	QUARK_ASSERT(s.check_invariant());
 	QUARK_ASSERT(check_invariant());
 }
 
-bc_external_value_t::bc_external_value_t(const typeid_t& type, const std::vector<bc_value_t>& s, bool struct_tag) :
-		_rc(1),
-#if DEBUG
-	_debug_type(type),
-#endif
+bc_external_struct_t::bc_external_struct_t(const typeid_t& type, const std::vector<bc_value_t>& s) :
+	bc_external_value_t(bc_external_kind::k_struct, type),
 	_struct_members(s)
 {
 	QUARK_ASSERT(type.check_invariant());
@@ -663,12 +1105,10 @@ bc_external_value_t::bc_external_value_t(const typeid_t& type, const std::vector
 	#endif
 	QUARK_ASSERT(check_invariant());
 }
-bc_external_value_t::bc_external_value_t(const typeid_t& type, const immer::vector<bc_external_handle_t>& s) :
-	_rc(1),
-#if DEBUG
-	_debug_type(type),
-#endif
-	_vector_w_external_elements(s)
+
+bc_external_vector_w_external_elements_t::bc_external_vector_w_external_elements_t(const typeid_t& type, const bc_immer_vector_t<bc_external_handle_t>& s) :
+	bc_external_value_t(bc_external_kind::k_vector_w_external_elements, type),
+	_elements(s)
 {
 	QUARK_ASSERT(type.check_invariant());
 	#if QUARK_ASSERT_ON
@@ -678,22 +1118,18 @@ bc_external_value_t::bc_external_value_t(const typeid_t& type, const immer::vect
 	#endif
 	QUARK_ASSERT(check_invariant());
 }
-bc_external_value_t::bc_external_value_t(const typeid_t& type, const immer::vector<bc_inplace_value_t>& s) :
-	_rc(1),
-#if DEBUG
-	_debug_type(type),
-#endif
-	_vector_w_inplace_elements(s)
+
+bc_external_vector_w_inplace_elements_t::bc_external_vector_w_inplace_elements_t(const typeid_t& type, const bc_immer_vector_t<bc_inplace_value_t>& s) :
+	bc_external_value_t(bc_external_kind::k_vector_w_inplace_elements, type),
+	_elements(s)
 {
 	QUARK_ASSERT(type.check_invariant());
 	QUARK_ASSERT(check_invariant());
 }
-bc_external_value_t::bc_external_value_t(const typeid_t& type, const immer::map<std::string, bc_external_handle_t>& s) :
-	_rc(1),
-#if DEBUG
-	_debug_type(type),
-#endif
-	_dict_w_external_values(s)
+
+bc_external_dict_w_external_values_t::bc_external_dict_w_external_values_t(const typeid_t& type, const bc_immer_map_t<std::string, bc_external_handle_t>& s) :
+	bc_external_value_t(bc_external_kind::k_dict_w_external_values, type),
+	_entries(s)
 {
 	QUARK_ASSERT(type.check_invariant());
 	#if QUARK_ASSERT_ON
@@ -704,12 +1140,10 @@ bc_external_value_t::bc_external_value_t(const typeid_t& type, const immer::map<
 	#endif
 	QUARK_ASSERT(check_invariant());
 }
-bc_external_value_t::bc_external_value_t(const typeid_t& type, const immer::map<std::string, bc_inplace_value_t>& s) :
-	_rc(1),
-#if DEBUG
-	_debug_type(type),
-#endif
-	_dict_w_inplace_values(s)
+
+bc_external_dict_w_inplace_values_t::bc_external_dict_w_inplace_values_t(const typeid_t& type, const bc_immer_map_t<std::string, bc_inplace_value_t>& s) :
+	bc_external_value_t(bc_external_kind::k_dict_w_inplace_values, type),
+	_entries(s)
 {
 	QUARK_ASSERT(type.check_invariant());
 	#if QUARK_ASSERT_ON
@@ -726,12 +1160,25 @@ bool check_external_deep(const typeid_t& type, const bc_external_value_t* ext){
 	QUARK_ASSERT(type.check_invariant());
 	QUARK_ASSERT(encode_as_external(type));
 	QUARK_ASSERT(ext != nullptr);
+
+	if(is_inline_string(ext)){
+		QUARK_ASSERT(type.is_string());
+		return true;
+	}
+
 	QUARK_ASSERT(ext->_rc > 0);
 
+#if DEBUG
+	//	Placeholder for a local that isn't stored to yet, its kind doesn't match type.
+	if(ext->_debug__is_unwritten_external_value){
+		return true;
+	}
+#endif
+
 	const auto basetype = type.get_base_type();
 
 	if(basetype == base_type::k_struct){
-		for(const auto& e: ext->_struct_members){
+		for(const auto& e: ext->get_struct_members()){
 			QUARK_ASSERT(e.check_invariant());
 		}
 	}
@@ -742,7 +1189,7 @@ bool check_external_deep(const typeid_t& type, const bc_external_value_t* ext){
 	else if(basetype == base_type::k_vector){
 		const auto& element_type  = type.get_vector_element_type();
 		if(encode_as_external(element_type)){
-			for(const auto& e: ext->_vector_w_external_elements){
+			for(const auto& e: ext->get_vector_w_external_elements()){
 				QUARK_ASSERT(e.check_invariant());
 			}
 			return true;
@@ -754,8 +1201,8 @@ bool check_external_deep(const typeid_t& type, const bc_external_value_t* ext){
 	else if(basetype == base_type::k_dict){
 		const auto& element_type  = type.get_dict_value_type();
 		if(encode_as_external(element_type)){
-			for(const auto& e: ext->_vector_w_external_elements){
-				QUARK_ASSERT(e.check_invariant());
+			for(const auto& e: ext->get_dict_w_external_values()){
+				QUARK_ASSERT(e.second.check_invariant());
 			}
 			return true;
 		}
@@ -783,13 +1230,13 @@ bool check_external_deep(const typeid_t& type, const bc_external_value_t* ext){
 
 const immer::vector<bc_value_t> get_vector(const bc_value_t& value){
 	QUARK_ASSERT(value.check_invariant());
-	QUARK_ASSERT(value._type.is_vector());
+	QUARK_ASSERT(value.get_type().is_vector());
 
-	const auto element_type = value._type.get_vector_element_type();
+	const auto element_type = lookup_bc_vector_element_type(value._typeid);
 
-	if(encode_as_vector_w_inplace_elements(value._type)){
+	if(encode_as_vector_w_inplace_elements(value.get_type())){
 		immer::vector<bc_value_t> result;
-		for(const auto& e: value._pod._external->_vector_w_inplace_elements){
+		for(const auto& e: value._pod._external->get_vector_w_inplace_elements()){
 			bc_value_t temp(element_type, e);
 			result = result.push_back(temp);
 		}
@@ -797,7 +1244,7 @@ const immer::vector<bc_value_t> get_vector(const bc_value_t& value){
 	}
 	else{
 		immer::vector<bc_value_t> result;
-		for(const auto& e: value._pod._external->_vector_w_external_elements){
+		for(const auto& e: value._pod._external->get_vector_w_external_elements()){
 			bc_value_t temp(element_type, e);
 			result = result.push_back(temp);
 		}
@@ -807,98 +1254,83 @@ const immer::vector<bc_value_t> get_vector(const bc_value_t& value){
 
 
 
-const immer::vector<bc_external_handle_t>* get_vector_external_elements(const bc_value_t& value){
+const bc_immer_vector_t<bc_external_handle_t>* get_vector_external_elements(const bc_value_t& value){
 	QUARK_ASSERT(value.check_invariant());
-	QUARK_ASSERT(value._type.is_vector());
-	QUARK_ASSERT(encode_as_vector_w_inplace_elements(value._type) == false);
+	QUARK_ASSERT(value.get_type().is_vector());
+	QUARK_ASSERT(encode_as_vector_w_inplace_elements(value.get_type()) == false);
 
-	return &value._pod._external->_vector_w_external_elements;
+	return &value._pod._external->get_vector_w_external_elements();
 }
 
-const immer::vector<bc_inplace_value_t>* get_vector_inplace_elements(const bc_value_t& value){
+const bc_immer_vector_t<bc_inplace_value_t>* get_vector_inplace_elements(const bc_value_t& value){
 	QUARK_ASSERT(value.check_invariant());
-	QUARK_ASSERT(value._type.is_vector());
-	QUARK_ASSERT(encode_as_vector_w_inplace_elements(value._type) == true);
+	QUARK_ASSERT(value.get_type().is_vector());
+	QUARK_ASSERT(encode_as_vector_w_inplace_elements(value.get_type()) == true);
 
-	return &value._pod._external->_vector_w_inplace_elements;
+	return &value._pod._external->get_vector_w_inplace_elements();
 }
 
-bc_value_t make_vector(const typeid_t& element_type, const immer::vector<bc_value_t>& elements){
-	QUARK_ASSERT(element_type.check_invariant());
+bc_value_t make_vector(bc_typeid_t vector_type, const immer::vector<bc_value_t>& elements){
+	QUARK_ASSERT(lookup_bc_type(vector_type).is_vector());
 #if QUARK_ASSERT_ON
 	for(const auto& e: elements) {
 		QUARK_ASSERT(e.check_invariant());
 	}
 #endif
 
-	const auto vector_type = typeid_t::make_vector(element_type);
-	if(encode_as_vector_w_inplace_elements(vector_type)){
-		immer::vector<bc_inplace_value_t> elements2;
+	if(encode_as_vector_w_inplace_elements(lookup_bc_type(vector_type))){
+		bc_immer_vector_t<bc_inplace_value_t> elements2;
 		for(const auto& e: elements){
 			elements2 = elements2.push_back(e._pod._inplace);
 		}
-
-		bc_value_t temp;
-		temp._type = vector_type;
-		temp._pod._external = new bc_external_value_t{vector_type, elements2};
-		QUARK_ASSERT(temp.check_invariant());
-		return temp;
+		return make_vector(vector_type, elements2);
 	}
 	else{
-		immer::vector<bc_external_handle_t> elements2;
+		bc_immer_vector_t<bc_external_handle_t> elements2;
 		for(const auto& e: elements){
 			elements2 = elements2.push_back(bc_external_handle_t(e));
 		}
-
-		bc_value_t temp;
-		temp._type = vector_type;
-		temp._pod._external = new bc_external_value_t{vector_type, elements2};
-		QUARK_ASSERT(temp.check_invariant());
-		return temp;
+		return make_vector(vector_type, elements2);
 	}
 }
 
-bc_value_t make_vector(const typeid_t& element_type, const immer::vector<bc_external_handle_t>& elements){
-	QUARK_ASSERT(element_type.check_invariant());
+bc_value_t make_vector(bc_typeid_t vector_type, const bc_immer_vector_t<bc_external_handle_t>& elements){
+	QUARK_ASSERT(lookup_bc_type(vector_type).is_vector());
+	QUARK_ASSERT(encode_as_vector_w_inplace_elements(lookup_bc_type(vector_type)) == false);
 #if QUARK_ASSERT_ON
 	for(const auto& e: elements) {
 		QUARK_ASSERT(e.check_invariant());
 	}
 #endif
 
-	const auto vector_type = typeid_t::make_vector(element_type);
-	QUARK_ASSERT(encode_as_vector_w_inplace_elements(vector_type) == false);
-
 	bc_value_t temp;
-	temp._type = vector_type;
-	temp._pod._external = new bc_external_value_t{vector_type, elements};
+	temp._typeid = vector_type;
+	temp._pod._external = new bc_external_vector_w_external_elements_t{lookup_bc_type(vector_type), elements};
 	QUARK_ASSERT(temp.check_invariant());
 	return temp;
 }
 
-bc_value_t make_vector(const typeid_t& element_type, const immer::vector<bc_inplace_value_t>& elements){
-	QUARK_ASSERT(element_type.check_invariant());
-
-	const auto vector_type = typeid_t::make_vector(element_type);
-	QUARK_ASSERT(encode_as_vector_w_inplace_elements(vector_type) == true);
+bc_value_t make_vector(bc_typeid_t vector_type, const bc_immer_vector_t<bc_inplace_value_t>& elements){
+	QUARK_ASSERT(lookup_bc_type(vector_type).is_vector());
+	QUARK_ASSERT(encode_as_vector_w_inplace_elements(lookup_bc_type(vector_type)) == true);
 
 	bc_value_t temp;
-	temp._type = vector_type;
-	temp._pod._external = new bc_external_value_t{vector_type, elements};
+	temp._typeid = vector_type;
+	temp._pod._external = new bc_external_vector_w_inplace_elements_t{lookup_bc_type(vector_type), elements};
 	QUARK_ASSERT(temp.check_invariant());
 	return temp;
 }
 
 
 
-const immer::map<std::string, bc_external_handle_t>& get_dict_value(const bc_value_t& value){
+const bc_immer_map_t<std::string, bc_external_handle_t>& get_dict_value(const bc_value_t& value){
 	QUARK_ASSERT(value.check_invariant());
 
-	return value._pod._external->_dict_w_external_values;
+	return value._pod._external->get_dict_w_external_values();
 }
 
-bc_value_t make_dict(const typeid_t& value_type, const immer::map<std::string, bc_external_handle_t>& entries){
-	QUARK_ASSERT(value_type.check_invariant());
+bc_value_t make_dict(bc_typeid_t dict_type, const bc_immer_map_t<std::string, bc_external_handle_t>& entries){
+	QUARK_ASSERT(lookup_bc_type(dict_type).is_dict());
 #if QUARK_ASSERT_ON
 	for(const auto& e: entries) {
 		QUARK_ASSERT(e.first.size() > 0);
@@ -907,18 +1339,18 @@ bc_value_t make_dict(const typeid_t& value_type, const immer::map<std::string, b
 #endif
 
 	bc_value_t temp;
-	temp._type = typeid_t::make_dict(value_type);
-	temp._pod._external = new bc_external_value_t{typeid_t::make_dict(value_type), entries};
+	temp._typeid = dict_type;
+	temp._pod._external = new bc_external_dict_w_external_values_t{lookup_bc_type(dict_type), entries};
 	QUARK_ASSERT(temp.check_invariant());
 	return temp;
 }
 
-bc_value_t make_dict(const typeid_t& value_type, const immer::map<std::string, bc_inplace_value_t>& entries){
-	QUARK_ASSERT(value_type.check_invariant());
+bc_value_t make_dict(bc_typeid_t dict_type, const bc_immer_map_t<std::string, bc_inplace_value_t>& entries){
+	QUARK_ASSERT(lookup_bc_type(dict_type).is_dict());
 
 	bc_value_t temp;
-	temp._type = typeid_t::make_dict(value_type);
-	temp._pod._external = new bc_external_value_t{typeid_t::make_dict(value_type), entries};
+	temp._typeid = dict_type;
+	temp._pod._external = new bc_external_dict_w_inplace_values_t{lookup_bc_type(dict_type), entries};
 	QUARK_ASSERT(temp.check_invariant());
 	return temp;
 }
@@ -951,8 +1383,14 @@ QUARK_UNIT_TEST("", "", "", ""){
 	const auto value_object_size = sizeof(bc_external_value_t);
 	QUARK_ASSERT(value_object_size >= 8);
 
+	//	Each kind of external value only pays for its own data.
+	QUARK_ASSERT(sizeof(bc_external_string_t) == value_object_size + sizeof(std::string));
+	QUARK_ASSERT(sizeof(bc_external_rope_t) == value_object_size + sizeof(bc_immer_flex_vector_t<char>));
+	QUARK_ASSERT(sizeof(bc_external_vector_w_inplace_elements_t) == value_object_size + sizeof(bc_immer_vector_t<bc_inplace_value_t>));
+	QUARK_ASSERT(sizeof(bc_external_dict_w_external_values_t) == value_object_size + sizeof(bc_immer_map_t<std::string, bc_external_handle_t>));
+
 	const auto bcvalue_size = sizeof(bc_value_t);
-	QUARK_ASSERT(bcvalue_size == 56);
+	QUARK_ASSERT(bcvalue_size == 16);
 
 	struct mockup_value_t {
 		private: bool _is_ext;
@@ -993,12 +1431,12 @@ QUARK_UNIT_TEST("", "", "", ""){
 //??? The update mechanism uses strings == slow.
 bc_value_t update_struct_member_shallow(interpreter_t& vm, const bc_value_t& obj, const std::string& member_name, const bc_value_t& new_value){
 	QUARK_ASSERT(obj.check_invariant());
-	QUARK_ASSERT(obj._type.is_struct());
+	QUARK_ASSERT(obj.get_type().is_struct());
 	QUARK_ASSERT(member_name.empty() == false);
 	QUARK_ASSERT(new_value.check_invariant());
 
 	const auto& values = obj.get_struct_value();
-	const auto& struct_def = obj._type.get_struct();
+	const auto& struct_def = obj.get_type().get_struct();
 
 	int member_index = find_struct_member_index(struct_def, member_name);
 	if(member_index == -1){
@@ -1006,7 +1444,7 @@ bc_value_t update_struct_member_shallow(interpreter_t& vm, const bc_value_t& obj
 	}
 
 #if DEBUG
-	QUARK_TRACE(typeid_to_compact_string(new_value._type));
+	QUARK_TRACE(typeid_to_compact_string(new_value.get_type()));
 	QUARK_TRACE(typeid_to_compact_string(struct_def._members[member_index]._type));
 
 	const auto dest_member_entry = struct_def._members[member_index];
@@ -1015,7 +1453,7 @@ bc_value_t update_struct_member_shallow(interpreter_t& vm, const bc_value_t& obj
 	auto values2 = values;
 	values2[member_index] = new_value;
 
-	auto s2 = bc_value_t::make_struct_value(obj._type, values2);
+	auto s2 = bc_value_t::make_struct_value(obj._typeid, values2);
 	return s2;
 }
 
@@ -1032,7 +1470,7 @@ bc_value_t update_struct_member_deep(interpreter_t& vm, const bc_value_t& obj, c
 		subpath.erase(subpath.begin());
 
 		const auto& values = obj.get_struct_value();
-		const auto& struct_def = obj._type.get_struct();
+		const auto& struct_def = obj.get_type().get_struct();
 		int member_index = find_struct_member_index(struct_def, path[0]);
 		if(member_index == -1){
 			quark::throw_runtime_error("Unknown member.");
@@ -1052,43 +1490,38 @@ bc_value_t update_struct_member_deep(interpreter_t& vm, const bc_value_t& obj, c
 
 bc_value_t update_string_char(interpreter_t& vm, const bc_value_t s, int64_t lookup_index, int64_t ch){
 	QUARK_ASSERT(vm.check_invariant());
-	QUARK_ASSERT(s._type.is_string());
-	QUARK_ASSERT(lookup_index >= 0 && lookup_index < s.get_string_value().size());
+	QUARK_ASSERT(s.get_type().is_string());
+	QUARK_ASSERT(lookup_index >= 0 && lookup_index < get_pod_string_size(s._pod));
 
 	QUARK_TRACE(json_to_pretty_string(interpreter_to_json(vm)));
 
-	std::string s2 = s.get_string_value();
-	if(lookup_index < 0 || lookup_index >= s2.size()){
+	if(lookup_index < 0 || lookup_index >= get_pod_string_size(s._pod)){
 		quark::throw_runtime_error("String lookup out of bounds.");
 	}
 	else{
-		s2[lookup_index] = static_cast<char>(ch);
-//		const auto s3 = value_t::make_string(s2);
-//		return value_to_bc(s3);
-		return bc_value_t::make_string(s2);
+		return bc_value_t::adopt_string(update_pod_string_char(s._pod, lookup_index, static_cast<char>(ch)));
 	}
 }
 
 bc_value_t update_vector_element(interpreter_t& vm, const bc_value_t vec, int64_t lookup_index, const bc_value_t& value){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(vec.check_invariant());
-	QUARK_ASSERT(vec._type.is_vector());
+	QUARK_ASSERT(vec.get_type().is_vector());
 	QUARK_ASSERT(lookup_index >= 0);
 	QUARK_ASSERT(value.check_invariant());
-	QUARK_ASSERT(vec._type.get_vector_element_type() == value._type);
+	QUARK_ASSERT(vec.get_type().get_vector_element_type() == value.get_type());
 
 //	QUARK_TRACE(json_to_pretty_string(interpreter_to_json(vm)));
 
-	const auto element_type = vec._type.get_vector_element_type();
-	if(encode_as_vector_w_inplace_elements(vec._type)){
-		auto v2 = vec._pod._external->_vector_w_inplace_elements;
+	if(encode_as_vector_w_inplace_elements(vec.get_type())){
+		auto v2 = vec._pod._external->get_vector_w_inplace_elements();
 
 		if(lookup_index < 0 || lookup_index >= v2.size()){
 			quark::throw_runtime_error("Vector lookup out of bounds.");
 		}
 		else{
 			v2 = v2.set(lookup_index, value._pod._inplace);
-			const auto s2 = make_vector(element_type, v2);
+			const auto s2 = make_vector(vec._typeid, v2);
 			return s2;
 		}
 	}
@@ -1101,10 +1534,10 @@ bc_value_t update_vector_element(interpreter_t& vm, const bc_value_t vec, int64_
 		else{
 //			QUARK_TRACE_SS("bc1:  " << json_to_pretty_string(bcvalue_to_json(obj)));
 
-			QUARK_ASSERT(encode_as_external(value._type));
+			QUARK_ASSERT(encode_as_external(value.get_type()));
 			const auto e = bc_external_handle_t(value);
 			v2 = v2.set(lookup_index, e);
-			const auto s2 = make_vector(element_type, v2);
+			const auto s2 = make_vector(vec._typeid, v2);
 
 //			QUARK_TRACE_SS("bc2:  " << json_to_pretty_string(bcvalue_to_json(s2)));
 			return s2;
@@ -1115,24 +1548,22 @@ bc_value_t update_vector_element(interpreter_t& vm, const bc_value_t vec, int64_
 bc_value_t update_dict_entry(interpreter_t& vm, const bc_value_t dict, const std::string& key, const bc_value_t& value){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(dict.check_invariant());
-	QUARK_ASSERT(dict._type.is_dict());
+	QUARK_ASSERT(dict.get_type().is_dict());
 	QUARK_ASSERT(key.empty() == false);
 	QUARK_ASSERT(value.check_invariant());
-	QUARK_ASSERT(dict._type.get_dict_value_type() == value._type);
+	QUARK_ASSERT(dict.get_type().get_dict_value_type() == value.get_type());
 
 //	QUARK_TRACE(json_to_pretty_string(interpreter_to_json(vm)));
 
-	const auto value_type = dict._type.get_dict_value_type();
-
-	if(encode_as_dict_w_inplace_values(dict._type)){
-		auto entries2 = dict._pod._external->_dict_w_inplace_values.set(key, value._pod._inplace);
-		const auto value2 = make_dict(value_type, entries2);
+	if(encode_as_dict_w_inplace_values(dict.get_type())){
+		auto entries2 = dict._pod._external->get_dict_w_inplace_values().set(key, value._pod._inplace);
+		const auto value2 = make_dict(dict._typeid, entries2);
 		return value2;
 	}
 	else{
 		const auto entries = get_dict_value(dict);
 		auto entries2 = entries.set(key, bc_external_handle_t(value));
-		const auto value2 = make_dict(value_type, entries2);
+		const auto value2 = make_dict(dict._typeid, entries2);
 		return value2;
 	}
 }
@@ -1140,10 +1571,10 @@ bc_value_t update_dict_entry(interpreter_t& vm, const bc_value_t dict, const std
 bc_value_t update_struct_member(interpreter_t& vm, const bc_value_t str, const std::vector<std::string>& path, const bc_value_t& value){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(str.check_invariant());
-	QUARK_ASSERT(str._type.is_struct());
+	QUARK_ASSERT(str.get_type().is_struct());
 	QUARK_ASSERT(path.empty() == false);
 	QUARK_ASSERT(value.check_invariant());
-//	QUARK_ASSERT(str._type.get_struct_ref()->_members[member_index]._type == value._type);
+//	QUARK_ASSERT(str.get_type().get_struct_ref()->_members[member_index]._type == value.get_type());
 
 //	QUARK_TRACE(json_to_pretty_string(interpreter_to_json(vm)));
 
@@ -1155,13 +1586,13 @@ bc_value_t update_element(interpreter_t& vm, const bc_value_t& obj1, const bc_va
 
 //	QUARK_TRACE(json_to_pretty_string(interpreter_to_json(vm)));
 
-	if(obj1._type.is_string()){
-		if(lookup_key._type.is_int() == false){
+	if(obj1.get_type().is_string()){
+		if(lookup_key.get_type().is_int() == false){
 			quark::throw_runtime_error("String lookup using integer index only.");
 		}
 		else{
 			const auto v = obj1.get_string_value();
-			if(new_value._type.is_int() == false){
+			if(new_value.get_type().is_int() == false){
 				quark::throw_runtime_error("Update element must be a character in an int.");
 			}
 			else{
@@ -1170,7 +1601,7 @@ bc_value_t update_element(interpreter_t& vm, const bc_value_t& obj1, const bc_va
 			}
 		}
 	}
-	else if(obj1._type.is_json_value()){
+	else if(obj1.get_type().is_json_value()){
 		const auto json_value0 = obj1.get_json_value();
 		if(json_value0.is_array()){
 			QUARK_ASSERT(false);
@@ -1184,12 +1615,12 @@ bc_value_t update_element(interpreter_t& vm, const bc_value_t& obj1, const bc_va
 			quark::throw_runtime_error("Can only update string, vector, dict or struct.");
 		}
 	}
-	else if(obj1._type.is_vector()){
-		const auto element_type = obj1._type.get_vector_element_type();
-		if(lookup_key._type.is_int() == false){
+	else if(obj1.get_type().is_vector()){
+		const auto element_type = obj1.get_type().get_vector_element_type();
+		if(lookup_key.get_type().is_int() == false){
 			quark::throw_runtime_error("Vector lookup using integer index only.");
 		}
-		else if(element_type != new_value._type){
+		else if(element_type != new_value.get_type()){
 			quark::throw_runtime_error("Update element must match vector type.");
 		}
 		else{
@@ -1197,14 +1628,14 @@ bc_value_t update_element(interpreter_t& vm, const bc_value_t& obj1, const bc_va
 			return update_vector_element(vm, obj1, lookup_index, new_value);
 		}
 	}
-	else if(obj1._type.is_dict()){
-		if(lookup_key._type.is_string() == false){
+	else if(obj1.get_type().is_dict()){
+		if(lookup_key.get_type().is_string() == false){
 			quark::throw_runtime_error("Dict lookup using string key only.");
 		}
 		else{
 			const auto obj = obj1;
-			const auto value_type = obj._type.get_dict_value_type();
-			if(value_type != new_value._type){
+			const auto value_type = obj.get_type().get_dict_value_type();
+			if(value_type != new_value.get_type()){
 				quark::throw_runtime_error("Update element must match dict value type.");
 			}
 			else{
@@ -1213,8 +1644,8 @@ bc_value_t update_element(interpreter_t& vm, const bc_value_t& obj1, const bc_va
 			}
 		}
 	}
-	else if(obj1._type.is_struct()){
-		if(lookup_key._type.is_string() == false){
+	else if(obj1.get_type().is_struct()){
+		if(lookup_key.get_type().is_string() == false){
 			quark::throw_runtime_error("You must specify structure member using string.");
 		}
 		else{
@@ -1253,6 +1684,60 @@ int bc_compare_string(const std::string& left, const std::string& right){
 	return compare(std::strcmp(left.c_str(), right.c_str()));
 }
 
+//	Orders the bytes like bc_compare_string(), a prefix first. Ropes are compared chunk by chunk, never flattened:
+//	each chunk of left is compared with the chunks of right that cover the same characters.
+static int bc_compare_pod_strings(const bc_pod_value_t& left, const bc_pod_value_t& right){
+	const auto left_size = get_pod_string_size(left);
+	const auto right_size = get_pod_string_size(right);
+
+	int diff = 0;
+	std::size_t pos = 0;
+	for_each_pod_string_chunk_p(
+		left,
+		0,
+		std::min(left_size, right_size),
+		[&](const char* left_first, const char* left_last){
+			const auto count = static_cast<std::size_t>(left_last - left_first);
+			for_each_pod_string_chunk_p(
+				right,
+				pos,
+				pos + count,
+				[&](const char* right_first, const char* right_last){
+					const auto right_count = static_cast<std::size_t>(right_last - right_first);
+					diff = std::memcmp(left_first, right_first, right_count);
+					left_first += right_count;
+					return diff == 0;
+				}
+			);
+			pos += count;
+			return diff == 0;
+		}
+	);
+	if(diff != 0){
+		return compare(diff);
+	}
+	else{
+		return compare(static_cast<int64_t>(left_size) - static_cast<int64_t>(right_size));
+	}
+}
+
+//	Strings that fit are always inline, so an inline string can only equal another inline string with the same bits.
+//	The same goes for ropes: a flat string is shorter than any rope.
+static bool bc_equal_pod_strings(const bc_pod_value_t& left, const bc_pod_value_t& right){
+	if(is_inline_string(left) || is_inline_string(right)){
+		return left._external == right._external;
+	}
+	else if(left._external->_kind != right._external->_kind){
+		return false;
+	}
+	else if(left._external->_kind == bc_external_kind::k_rope){
+		return left._external->get_rope() == right._external->get_rope();
+	}
+	else{
+		return left._external->get_string() == right._external->get_string();
+	}
+}
+
 QUARK_UNIT_TEST("bc_compare_string()", "", "", ""){
 	ut_verify_auto(QUARK_POS, bc_compare_string("", ""), 0);
 }
@@ -1263,9 +1748,37 @@ QUARK_UNIT_TEST("bc_compare_string()", "", "", ""){
 	ut_verify_auto(QUARK_POS, bc_compare_string("b", "a"), 1);
 }
 
+QUARK_UNIT_TEST("bc_compare_pod_strings()", "ropes", "chunk boundaries don't matter", ""){
+	std::string text;
+	for(int i = 0 ; i < 3000 ; i++){
+		text.push_back(static_cast<char>('a' + i % 26));
+	}
+	auto a = make_pod_string(text.data(), text.size());
+	auto a0 = subset_pod_string(a, 0, 1777);
+	auto a1 = subset_pod_string(a, 1777, 3000);
+	auto b = concat_pod_strings(a0, a1);
+	auto c = update_pod_string_char(a, 2500, 'A');
+	auto d = subset_pod_string(a, 0, 2000);
+	auto e = make_pod_string(text.data(), 500);
 
-int bc_compare_struct_true_deep(const std::vector<bc_value_t>& left, const std::vector<bc_value_t>& right, const typeid_t& type){
-	const auto& struct_def = type.get_struct();
+	QUARK_UT_VERIFY(bc_compare_pod_strings(a, b) == 0);
+	QUARK_UT_VERIFY(bc_compare_pod_strings(c, a) == -1);
+	QUARK_UT_VERIFY(bc_compare_pod_strings(b, c) == 1);
+	QUARK_UT_VERIFY(bc_compare_pod_strings(d, a) == -1);
+	QUARK_UT_VERIFY(bc_compare_pod_strings(a, e) == 1);
+	QUARK_UT_VERIFY(bc_compare_pod_strings(e, e) == 0);
+
+	QUARK_UT_VERIFY(hash_pod_string(a) == hash_pod_string(b));
+	QUARK_UT_VERIFY(hash_pod_string(a) != hash_pod_string(c));
+
+	for(auto value: { &a, &a0, &a1, &b, &c, &d, &e }){
+		release_pod_external(*value);
+	}
+}
+
+
+int bc_compare_struct_true_deep(const std::vector<bc_value_t>& left, const std::vector<bc_value_t>& right, const typeid_t& type){
+	const auto& struct_def = type.get_struct();
 
 	for(int i = 0 ; i < struct_def._members.size() ; i++){
 		const auto& member_type = struct_def._members[i]._type;
@@ -1277,13 +1790,12 @@ int bc_compare_struct_true_deep(const std::vector<bc_value_t>& left, const std::
 	return 0;
 }
 
-int bc_compare_vectors_obj(const immer::vector<bc_external_handle_t>& left, const immer::vector<bc_external_handle_t>& right, const typeid_t& type){
-	QUARK_ASSERT(type.is_vector());
-
+int bc_compare_vectors_obj(const bc_immer_vector_t<bc_external_handle_t>& left, const bc_immer_vector_t<bc_external_handle_t>& right, bc_typeid_t type){
 	const auto& shared_count = std::min(left.size(), right.size());
-	const auto& element_type = typeid_t(type.get_vector_element_type());
+	const auto element_typeid = lookup_bc_vector_element_type(type);
+	const auto& element_type = lookup_bc_type(element_typeid);
 	for(int i = 0 ; i < shared_count ; i++){
-		const auto element_result = bc_compare_value_true_deep(bc_value_t(element_type, left[i]), bc_value_t(element_type, right[i]), element_type);
+		const auto element_result = bc_compare_value_true_deep(bc_value_t(element_typeid, left[i]), bc_value_t(element_typeid, right[i]), element_type);
 		if(element_result != 0){
 			return element_result;
 		}
@@ -1336,7 +1848,7 @@ int compare_doubles(const bc_inplace_value_t& left, const bc_inplace_value_t& ri
 	}
 }
 
-int bc_compare_vectors_bool(const immer::vector<bc_inplace_value_t>& left, const immer::vector<bc_inplace_value_t>& right){
+int bc_compare_vectors_bool(const bc_immer_vector_t<bc_inplace_value_t>& left, const bc_immer_vector_t<bc_inplace_value_t>& right){
 	const auto& shared_count = std::min(left.size(), right.size());
 	for(int i = 0 ; i < shared_count ; i++){
 		int result = compare_bools(left[i], right[i]);
@@ -1354,7 +1866,7 @@ int bc_compare_vectors_bool(const immer::vector<bc_inplace_value_t>& left, const
 		return +1;
 	}
 }
-int bc_compare_vectors_int(const immer::vector<bc_inplace_value_t>& left, const immer::vector<bc_inplace_value_t>& right){
+int bc_compare_vectors_int(const bc_immer_vector_t<bc_inplace_value_t>& left, const bc_immer_vector_t<bc_inplace_value_t>& right){
 	const auto& shared_count = std::min(left.size(), right.size());
 	for(int i = 0 ; i < shared_count ; i++){
 		int result = compare_ints(left[i], right[i]);
@@ -1372,7 +1884,7 @@ int bc_compare_vectors_int(const immer::vector<bc_inplace_value_t>& left, const
 		return +1;
 	}
 }
-int bc_compare_vectors_double(const immer::vector<bc_inplace_value_t>& left, const immer::vector<bc_inplace_value_t>& right){
+int bc_compare_vectors_double(const bc_immer_vector_t<bc_inplace_value_t>& left, const bc_immer_vector_t<bc_inplace_value_t>& right){
 	const auto& shared_count = std::min(left.size(), right.size());
 	for(int i = 0 ; i < shared_count ; i++){
 		int result = compare_doubles(left[i], right[i]);
@@ -1398,8 +1910,9 @@ template <typename Map> bool bc_map_compare(Map const &lhs, Map const &rhs) {
 	return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin());
 }
 
-int bc_compare_dicts_obj(const immer::map<std::string, bc_external_handle_t>& left, const immer::map<std::string, bc_external_handle_t>& right, const typeid_t& type){
-	const auto& element_type = typeid_t(type.get_dict_value_type());
+int bc_compare_dicts_obj(const bc_immer_map_t<std::string, bc_external_handle_t>& left, const bc_immer_map_t<std::string, bc_external_handle_t>& right, bc_typeid_t type){
+	const auto element_typeid = lookup_bc_dict_value_type(type);
+	const auto& element_type = lookup_bc_type(element_typeid);
 
 	auto left_it = left.begin();
 	auto left_end_it = left.end();
@@ -1416,7 +1929,7 @@ int bc_compare_dicts_obj(const immer::map<std::string, bc_external_handle_t>& le
 			return key_result;
 		}
 
-		const auto element_result = bc_compare_value_true_deep(bc_value_t(element_type, (*left_it).second), bc_value_t(element_type, (*right_it).second), element_type);
+		const auto element_result = bc_compare_value_true_deep(bc_value_t(element_typeid, (*left_it).second), bc_value_t(element_typeid, (*right_it).second), element_type);
 		if(element_result != 0){
 			return element_result;
 		}
@@ -1439,7 +1952,7 @@ int bc_compare_dicts_obj(const immer::map<std::string, bc_external_handle_t>& le
 }
 
 //??? make template.
-int bc_compare_dicts_bool(const immer::map<std::string, bc_inplace_value_t>& left, const immer::map<std::string, bc_inplace_value_t>& right){
+int bc_compare_dicts_bool(const bc_immer_map_t<std::string, bc_inplace_value_t>& left, const bc_immer_map_t<std::string, bc_inplace_value_t>& right){
 	auto left_it = left.begin();
 	auto left_end_it = left.end();
 
@@ -1477,7 +1990,7 @@ int bc_compare_dicts_bool(const immer::map<std::string, bc_inplace_value_t>& lef
 	quark::throw_exception();
 }
 
-int bc_compare_dicts_int(const immer::map<std::string, bc_inplace_value_t>& left, const immer::map<std::string, bc_inplace_value_t>& right){
+int bc_compare_dicts_int(const bc_immer_map_t<std::string, bc_inplace_value_t>& left, const bc_immer_map_t<std::string, bc_inplace_value_t>& right){
 	auto left_it = left.begin();
 	auto left_end_it = left.end();
 
@@ -1515,7 +2028,7 @@ int bc_compare_dicts_int(const immer::map<std::string, bc_inplace_value_t>& left
 	quark::throw_exception();
 }
 
-int bc_compare_dicts_double(const immer::map<std::string, bc_inplace_value_t>& left, const immer::map<std::string, bc_inplace_value_t>& right){
+int bc_compare_dicts_double(const bc_immer_map_t<std::string, bc_inplace_value_t>& left, const bc_immer_map_t<std::string, bc_inplace_value_t>& right){
 	auto left_it = left.begin();
 	auto left_end_it = left.end();
 
@@ -1633,12 +2146,12 @@ int bc_compare_json_values(const json_t& lhs, const json_t& rhs){
 	}
 }
 
-int bc_compare_value_exts(const bc_external_handle_t& left, const bc_external_handle_t& right, const typeid_t& type){
-	return bc_compare_value_true_deep(bc_value_t(type, left), bc_value_t(type, right), type);
+int bc_compare_value_exts(const bc_external_handle_t& left, const bc_external_handle_t& right, bc_typeid_t type){
+	return bc_compare_value_true_deep(bc_value_t(type, left), bc_value_t(type, right), lookup_bc_type(type));
 }
 
 int bc_compare_value_true_deep(const bc_value_t& left, const bc_value_t& right, const typeid_t& type0){
-	QUARK_ASSERT(left._type == right._type);
+	QUARK_ASSERT(left.get_type() == right.get_type());
 	QUARK_ASSERT(left.check_invariant());
 	QUARK_ASSERT(right.check_invariant());
 
@@ -1666,7 +2179,7 @@ int bc_compare_value_true_deep(const bc_value_t& left, const bc_value_t& right,
 		}
 	}
 	else if(type.is_string()){
-		return bc_compare_string(left.get_string_value(), right.get_string_value());
+		return bc_compare_pod_strings(left._pod, right._pod);
 	}
 	else if(type.is_json_value()){
 		return bc_compare_json_values(left.get_json_value(), right.get_json_value());
@@ -1687,36 +2200,36 @@ int bc_compare_value_true_deep(const bc_value_t& left, const bc_value_t& right,
 		if(false){
 		}
 		else if(type.get_vector_element_type().is_bool()){
-			return bc_compare_vectors_bool(left._pod._external->_vector_w_inplace_elements, right._pod._external->_vector_w_inplace_elements);
+			return bc_compare_vectors_bool(left._pod._external->get_vector_w_inplace_elements(), right._pod._external->get_vector_w_inplace_elements());
 		}
 		else if(type.get_vector_element_type().is_int()){
-			return bc_compare_vectors_int(left._pod._external->_vector_w_inplace_elements, right._pod._external->_vector_w_inplace_elements);
+			return bc_compare_vectors_int(left._pod._external->get_vector_w_inplace_elements(), right._pod._external->get_vector_w_inplace_elements());
 		}
 		else if(type.get_vector_element_type().is_double()){
-			return bc_compare_vectors_double(left._pod._external->_vector_w_inplace_elements, right._pod._external->_vector_w_inplace_elements);
+			return bc_compare_vectors_double(left._pod._external->get_vector_w_inplace_elements(), right._pod._external->get_vector_w_inplace_elements());
 		}
 		else{
 			const auto& left_vec = get_vector_external_elements(left);
 			const auto& right_vec = get_vector_external_elements(right);
-			return bc_compare_vectors_obj(*left_vec, *right_vec, type0);
+			return bc_compare_vectors_obj(*left_vec, *right_vec, left._typeid);
 		}
 	}
 	else if(type.is_dict()){
 		if(false){
 		}
 		else if(type.get_dict_value_type().is_bool()){
-			return bc_compare_dicts_bool(left._pod._external->_dict_w_inplace_values, right._pod._external->_dict_w_inplace_values);
+			return bc_compare_dicts_bool(left._pod._external->get_dict_w_inplace_values(), right._pod._external->get_dict_w_inplace_values());
 		}
 		else if(type.get_dict_value_type().is_int()){
-			return bc_compare_dicts_int(left._pod._external->_dict_w_inplace_values, right._pod._external->_dict_w_inplace_values);
+			return bc_compare_dicts_int(left._pod._external->get_dict_w_inplace_values(), right._pod._external->get_dict_w_inplace_values());
 		}
 		else if(type.get_dict_value_type().is_double()){
-			return bc_compare_dicts_double(left._pod._external->_dict_w_inplace_values, right._pod._external->_dict_w_inplace_values);
+			return bc_compare_dicts_double(left._pod._external->get_dict_w_inplace_values(), right._pod._external->get_dict_w_inplace_values());
 		}
 		else  {
 			const auto& left2 = get_dict_value(left);
 			const auto& right2 = get_dict_value(right);
-			return bc_compare_dicts_obj(left2, right2, type0);
+			return bc_compare_dicts_obj(left2, right2, left._typeid);
 		}
 	}
 	else if(type.is_function()){
@@ -1731,6 +2244,7 @@ int bc_compare_value_true_deep(const bc_value_t& left, const bc_value_t& right,
 
 extern const std::map<bc_opcode, opcode_info_t> k_opcode_info = {
 	{ bc_opcode::k_nop, { "nop", opcode_info_t::encoding::k_e_0000 }},
+	{ bc_opcode::k_wide, { "wide", opcode_info_t::encoding::k_u_0iii }},
 
 	{ bc_opcode::k_load_global_external_value, { "load_global_external_value", opcode_info_t::encoding::k_k_0ri0 } },
 	{ bc_opcode::k_load_global_inplace_value, { "load_global_inplace_value", opcode_info_t::encoding::k_k_0ri0 } },
@@ -1740,6 +2254,7 @@ extern const std::map<bc_opcode, opcode_info_t> k_opcode_info = {
 
 	{ bc_opcode::k_copy_reg_inplace_value, { "copy_reg_inplace_value", opcode_info_t::encoding::k_q_0rr0 } },
 	{ bc_opcode::k_copy_reg_external_value, { "copy_reg_external_value", opcode_info_t::encoding::k_q_0rr0 } },
+	{ bc_opcode::k_release_external_value, { "release_external_value", opcode_info_t::encoding::k_p_0r00 } },
 
 	{ bc_opcode::k_get_struct_member, { "get_struct_member", opcode_info_t::encoding::k_s_0rri } },
 
@@ -1747,6 +2262,8 @@ extern const std::map<bc_opcode, opcode_info_t> k_opcode_info = {
 	{ bc_opcode::k_lookup_element_json_value, { "lookup_element_jsonvalue", opcode_info_t::encoding::k_o_0rrr } },
 	{ bc_opcode::k_lookup_element_vector_w_external_elements, { "lookup_element_vector_w_external_elements", opcode_info_t::encoding::k_o_0rrr } },
 	{ bc_opcode::k_lookup_element_vector_w_inplace_elements, { "lookup_element_vector_w_inplace_elements", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_lookup_element_vector_w_external_elements_unchecked, { "lookup_element_vector_w_external_elements_unchecked", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_lookup_element_vector_w_inplace_elements_unchecked, { "lookup_element_vector_w_inplace_elements_unchecked", opcode_info_t::encoding::k_o_0rrr } },
 	{ bc_opcode::k_lookup_element_dict_w_external_values, { "lookup_element_dict_w_external_values", opcode_info_t::encoding::k_o_0rrr } },
 	{ bc_opcode::k_lookup_element_dict_w_inplace_values, { "lookup_element_dict_w_inplace_values", opcode_info_t::encoding::k_o_0rrr } },
 
@@ -1761,7 +2278,26 @@ extern const std::map<bc_opcode, opcode_info_t> k_opcode_info = {
 	{ bc_opcode::k_pushback_vector_w_inplace_elements, { "pushback_vector_w_inplace_elements", opcode_info_t::encoding::k_o_0rrr } },
 	{ bc_opcode::k_pushback_string, { "pushback_string", opcode_info_t::encoding::k_o_0rrr } },
 
+	{ bc_opcode::k_find_string, { "find_string", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_find_vector_w_external_elements, { "find_vector_w_external_elements", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_find_vector_w_inplace_elements, { "find_vector_w_inplace_elements", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_exists_dict_w_external_values, { "exists_dict_w_external_values", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_exists_dict_w_inplace_values, { "exists_dict_w_inplace_values", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_erase_dict_w_external_values, { "erase_dict_w_external_values", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_erase_dict_w_inplace_values, { "erase_dict_w_inplace_values", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_subset_string, { "subset_string", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_subset_vector_w_external_elements, { "subset_vector_w_external_elements", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_subset_vector_w_inplace_elements, { "subset_vector_w_inplace_elements", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_replace_string, { "replace_string", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_replace_vector_w_external_elements, { "replace_vector_w_external_elements", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_replace_vector_w_inplace_elements, { "replace_vector_w_inplace_elements", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_update_vector_w_external_elements, { "update_vector_w_external_elements", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_update_vector_w_inplace_elements, { "update_vector_w_inplace_elements", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_update_dict_w_external_values, { "update_dict_w_external_values", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_update_dict_w_inplace_values, { "update_dict_w_inplace_values", opcode_info_t::encoding::k_o_0rrr } },
+
 	{ bc_opcode::k_call, { "call", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_tail_call, { "tail_call", opcode_info_t::encoding::k_k_0ri0 } },
 
 	{ bc_opcode::k_add_bool, { "add_bool", opcode_info_t::encoding::k_o_0rrr } },
 	{ bc_opcode::k_add_int, { "add_int", opcode_info_t::encoding::k_o_0rrr } },
@@ -1784,6 +2320,14 @@ extern const std::map<bc_opcode, opcode_info_t> k_opcode_info = {
 	{ bc_opcode::k_logical_or_int, { "logical_or_int", opcode_info_t::encoding::k_o_0rrr } },
 	{ bc_opcode::k_logical_or_double, { "logical_or_double", opcode_info_t::encoding::k_o_0rrr } },
 
+	{ bc_opcode::k_add_int_imm, { "add_int_imm", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_subtract_int_imm, { "subtract_int_imm", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_multiply_int_imm, { "multiply_int_imm", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_add_double_const, { "add_double_const", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_subtract_double_const, { "subtract_double_const", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_multiply_double_const, { "multiply_double_const", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_divide_double_const, { "divide_double_const", opcode_info_t::encoding::k_s_0rri } },
+
 
 	{ bc_opcode::k_comparison_smaller_or_equal, { "comparison_smaller_or_equal", opcode_info_t::encoding::k_o_0rrr } },
 	{ bc_opcode::k_comparison_smaller_or_equal_int, { "comparison_smaller_or_equal_int", opcode_info_t::encoding::k_o_0rrr } },
@@ -1797,6 +2341,26 @@ extern const std::map<bc_opcode, opcode_info_t> k_opcode_info = {
 	{ bc_opcode::k_logical_nonequal, { "logical_nonequal", opcode_info_t::encoding::k_o_0rrr } },
 	{ bc_opcode::k_logical_nonequal_int, { "logical_nonequal_int", opcode_info_t::encoding::k_o_0rrr } },
 
+	{ bc_opcode::k_comparison_smaller_or_equal_double, { "comparison_smaller_or_equal_double", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_comparison_smaller_double, { "comparison_smaller_double", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_logical_equal_double, { "logical_equal_double", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_logical_nonequal_double, { "logical_nonequal_double", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_comparison_smaller_or_equal_string, { "comparison_smaller_or_equal_string", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_comparison_smaller_string, { "comparison_smaller_string", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_logical_equal_string, { "logical_equal_string", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_logical_nonequal_string, { "logical_nonequal_string", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_comparison_smaller_or_equal_bool, { "comparison_smaller_or_equal_bool", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_comparison_smaller_bool, { "comparison_smaller_bool", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_logical_equal_bool, { "logical_equal_bool", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_logical_nonequal_bool, { "logical_nonequal_bool", opcode_info_t::encoding::k_o_0rrr } },
+
+	{ bc_opcode::k_comparison_smaller_int_imm, { "comparison_smaller_int_imm", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_comparison_smaller_or_equal_int_imm, { "comparison_smaller_or_equal_int_imm", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_comparison_larger_int_imm, { "comparison_larger_int_imm", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_comparison_larger_or_equal_int_imm, { "comparison_larger_or_equal_int_imm", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_logical_equal_int_imm, { "logical_equal_int_imm", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_logical_nonequal_int_imm, { "logical_nonequal_int_imm", opcode_info_t::encoding::k_s_0rri } },
+
 
 	{ bc_opcode::k_new_1, { "new_1", opcode_info_t::encoding::k_t_0rii } },
 	{ bc_opcode::k_new_vector_w_external_elements, { "new_vector_w_external_elements", opcode_info_t::encoding::k_t_0rii } },
@@ -1821,6 +2385,26 @@ extern const std::map<bc_opcode, opcode_info_t> k_opcode_info = {
 
 	{ bc_opcode::k_branch_smaller_int, { "branch_smaller_int", opcode_info_t::encoding::k_s_0rri } },
 	{ bc_opcode::k_branch_smaller_or_equal_int, { "branch_smaller_or_equal_int", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_branch_equal_int, { "branch_equal_int", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_branch_nonequal_int, { "branch_nonequal_int", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_branch_smaller_double, { "branch_smaller_double", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_branch_smaller_or_equal_double, { "branch_smaller_or_equal_double", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_branch_equal_double, { "branch_equal_double", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_branch_nonequal_double, { "branch_nonequal_double", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_branch_smaller_string, { "branch_smaller_string", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_branch_smaller_or_equal_string, { "branch_smaller_or_equal_string", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_branch_equal_string, { "branch_equal_string", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_branch_nonequal_string, { "branch_nonequal_string", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_branch_smaller_bool, { "branch_smaller_bool", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_branch_smaller_or_equal_bool, { "branch_smaller_or_equal_bool", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_branch_equal_bool, { "branch_equal_bool", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_branch_nonequal_bool, { "branch_nonequal_bool", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_branch_smaller_int_imm, { "branch_smaller_int_imm", opcode_info_t::encoding::k_t_0rii } },
+	{ bc_opcode::k_branch_smaller_or_equal_int_imm, { "branch_smaller_or_equal_int_imm", opcode_info_t::encoding::k_t_0rii } },
+	{ bc_opcode::k_branch_larger_int_imm, { "branch_larger_int_imm", opcode_info_t::encoding::k_t_0rii } },
+	{ bc_opcode::k_branch_larger_or_equal_int_imm, { "branch_larger_or_equal_int_imm", opcode_info_t::encoding::k_t_0rii } },
+	{ bc_opcode::k_branch_equal_int_imm, { "branch_equal_int_imm", opcode_info_t::encoding::k_t_0rii } },
+	{ bc_opcode::k_branch_nonequal_int_imm, { "branch_nonequal_int_imm", opcode_info_t::encoding::k_t_0rii } },
 
 	{ bc_opcode::k_branch_always, { "branch_always", opcode_info_t::encoding::k_l_00i0 } }
 
@@ -1861,6 +2445,9 @@ reg_flags_t encoding_to_reg_flags(opcode_info_t::encoding e){
 	else if(e == opcode_info_t::encoding::k_t_0rii){
 		return { true, false, false };
 	}
+	else if(e == opcode_info_t::encoding::k_u_0iii){
+		return { false, false, false };
+	}
 
 	else{
 		QUARK_ASSERT(false);
@@ -1911,6 +2498,10 @@ bc_static_frame_t::bc_static_frame_t(const std::vector<bc_instruction_t>& instrs
 		const auto type = _symbols[i].second._value_type;
 		const bool ext = encode_as_external(type);
 		_exts.push_back(ext);
+		_symbol_types.push_back(intern_bc_type(type));
+		if(ext && i < parameter_count){
+			_args_ext_indexes.push_back(i);
+		}
 	}
 
 	//	Process the locals & temps. They go after any parameters, which already sits on stack.
@@ -1918,13 +2509,15 @@ bc_static_frame_t::bc_static_frame_t(const std::vector<bc_instruction_t>& instrs
 		const auto& symbol = _symbols[i];
 		bool is_ext = _exts[i];
 
-		_locals_exts.push_back(is_ext);
+		if(is_ext){
+			_locals_ext_indexes.push_back(static_cast<int>(i - parameter_count));
+		}
 
 		//	Variable slot.
 		//	This is just a variable slot without constant. We need to put something there, but that don't confuse RC.
 		//	Problem is that IF this is an RC_object, it WILL be decremented when written to.
 		//	Use a placeholder object of correct type.
-		if(symbol.second._const_value._type.get_base_type() == base_type::k_internal_undefined){
+		if(symbol.second._const_value.get_type().get_base_type() == base_type::k_internal_undefined){
 			if(is_ext){
 				const auto value = bc_value_t(symbol.second._value_type, bc_value_t::mode::k_unwritten_ext_value);
 				_locals.push_back(value);
@@ -1942,12 +2535,19 @@ bc_static_frame_t::bc_static_frame_t(const std::vector<bc_instruction_t>& instrs
 		}
 	}
 
+	for(const auto& e: _locals){
+		_locals_image.push_back(e._pod);
+	}
+
 	QUARK_ASSERT(check_invariant());
 }
 
 bool bc_static_frame_t::check_invariant() const {
 //	QUARK_ASSERT(_body.check_invariant());
 	QUARK_ASSERT(_symbols.size() == _exts.size());
+	QUARK_ASSERT(_symbols.size() == _symbol_types.size());
+	QUARK_ASSERT(_locals_image.size() == _locals.size());
+	QUARK_ASSERT(_args.size() + _locals.size() == _symbols.size());
 
 /*
 	for(const auto& e: _instructions){
@@ -1981,6 +2581,20 @@ bc_function_definition_t::bc_function_definition_t(
 	_return_is_ext(encode_as_external(_function_type.get_function_return()))
 {
 	_dyn_arg_count = count_function_dynamic_args(function_type);
+
+	int offset = 0;
+	for(const auto& arg: _args){
+		if(arg._type.is_internal_dynamic()){
+			_arg_stack_offsets.push_back(offset + 1);
+			offset += k_frame_overhead;
+		}
+		else{
+			_arg_stack_offsets.push_back(offset);
+			offset++;
+		}
+		_arg_types.push_back(intern_bc_type(arg._type));
+	}
+	_return_type = intern_bc_type(_function_type.get_function_return());
 }
 
 #if DEBUG
@@ -1995,6 +2609,29 @@ bool bc_function_definition_t::check_invariant() const {
 
 
 
+void interpreter_stack_t::grow(size_t required_count){
+	QUARK_ASSERT(check_invariant());
+	QUARK_ASSERT(required_count > _allocated_count);
+
+	if(required_count > _max_size){
+		quark::throw_runtime_error("Stack overflow.");
+	}
+
+	const auto new_count = std::min(std::max(required_count, _allocated_count * 2), _max_size);
+	auto new_entries = new bc_pod_value_t[new_count];
+
+	//	Entries are pods, we move the RCs along with them.
+	std::copy(&_entries[0], &_entries[_stack_size], new_entries);
+
+	const auto frame_pos = _current_frame_entry_ptr - &_entries[0];
+	delete[] _entries;
+	_entries = new_entries;
+	_allocated_count = new_count;
+	_current_frame_entry_ptr = &_entries[frame_pos];
+
+	QUARK_ASSERT(check_invariant());
+}
+
 frame_pos_t interpreter_stack_t::read_prev_frame(int frame_pos) const{
 //	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(frame_pos >= k_frame_overhead);
@@ -2090,9 +2727,9 @@ json_t interpreter_stack_t::stack_to_json() const{
 		const auto debug_type = _debug_types[i];
 		const auto ext = encode_as_external(debug_type);
 		const auto bc_pod = _entries[i];
-		const auto bc = bc_value_t(debug_type, bc_pod);
+		const auto bc = bc_value_t(intern_bc_type(debug_type), bc_pod);
 
-		bool unwritten = ext && bc._pod._external->_debug__is_unwritten_external_value;
+		bool unwritten = ext && is_inline_string(bc._pod) == false && bc._pod._external->_debug__is_unwritten_external_value;
 
 		auto a = json_t::make_array({
 			json_t(i),
@@ -2124,13 +2761,85 @@ const bc_function_definition_t& get_function_def(const interpreter_t& vm, int fu
 }
 
 
+bc_value_t bc_host_args_t::get_value(int index) const{
+	return bc_value_t(get_typeid(index), get_pod(index));
+}
+
+//	Adapter: host functions with the old calling convention get their arguments as bc_value_t:s.
+bc_value_t call_host_function(interpreter_t& vm, const bc_host_function_t& host_function, const bc_host_args_t& args){
+	if(host_function._fast_f != nullptr){
+		return (host_function._fast_f)(vm, args);
+	}
+	else if(args._values != nullptr){
+		return (host_function._f)(vm, args._values, args._count);
+	}
+	else{
+		QUARK_ASSERT(host_function._f != nullptr);
+
+		std::vector<bc_value_t> arg_values;
+		arg_values.reserve(args._count);
+		for(int a = 0 ; a < args._count ; a++){
+			arg_values.push_back(args.get_value(a));
+		}
+		return (host_function._f)(vm, &arg_values[0], args._count);
+	}
+}
+
+//	Loop iterations and Floyd calls are steps, see interpreter_config_t::_step_limit. Only call when vm._count_steps is set.
+static inline void count_step(interpreter_t& vm){
+	QUARK_ASSERT(vm._count_steps);
+
+	if(--vm._steps_left == 0){
+		quark::throw_runtime_error("Step limit reached.");
+	}
+}
+
+//	The profile of the function running frame_ptr. Global instructions, and any frame that isn't a function's, share the last profile.
+static bc_function_profile_t* find_profile(interpreter_t& vm, const bc_static_frame_t* frame_ptr){
+	const auto it = vm._tiering._frame_function_ids.find(frame_ptr);
+	const auto index = it == vm._tiering._frame_function_ids.end() ? vm._tiering._profiles.size() - 1 : it->second;
+	return &vm._tiering._profiles[index];
+}
+
+//	Hands a hot function to the JIT. Calls already running in the interpreter finish there.
+static void tier_up(interpreter_t& vm, bc_function_profile_t& profile){
+	QUARK_ASSERT(vm._tiering._jit);
+
+	if(profile._tiered_up == false){
+		profile._tiered_up = true;
+
+		const auto function_id = static_cast<int>(&profile - &vm._tiering._profiles[0]);
+		if(function_id < static_cast<int>(vm._imm->_program._function_defs.size())){
+			jit_compile_function(*vm._tiering._jit, vm._imm->_program, function_id);
+		}
+	}
+}
+
+//	k_call of a memoized function, arguments on the stack from arg0_pos. On a hit writes the result to dest_reg and returns true.
+static bool memo_lookup_call(interpreter_t& vm, int function_id, int arg0_pos, int arg_count, int dest_reg){
+	const auto& function_def = vm._imm->_program._function_defs[function_id];
+	std::vector<bc_value_t> arg_values;
+	arg_values.reserve(arg_count);
+	for(int a = 0 ; a < arg_count ; a++){
+		arg_values.push_back(bc_value_t(function_def._arg_types[a], vm._stack._entries[arg0_pos + a]));
+	}
+	const auto cached = memo_lookup(vm, function_id, std::move(arg_values));
+	if(cached != nullptr){
+		vm._stack.write_register(dest_reg, *cached);
+		return true;
+	}
+	else{
+		return false;
+	}
+}
+
 //??? Use bc_value_t:s instead of bc_value_t -- types are known via function-signature.
 bc_value_t call_function_bc(interpreter_t& vm, const bc_value_t& f, const bc_value_t args[], int arg_count){
 #if DEBUG
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(f.check_invariant());
 	for(int i = 0 ; i < arg_count ; i++){ QUARK_ASSERT(args[i].check_invariant()); };
-	QUARK_ASSERT(f._type.is_function());
+	QUARK_ASSERT(f.get_type().is_function());
 #endif
 
 	const auto& function_def = get_function_def(vm, f.get_function_value());
@@ -2143,32 +2852,52 @@ bc_value_t call_function_bc(interpreter_t& vm, const bc_value_t& f, const bc_val
 		//	arity
 	//	QUARK_ASSERT(args.size() == host_function._function_type.get_function_args().size());
 
-		const auto& result = (host_function)(vm, &args[0], arg_count);
+		const auto host_args = bc_host_args_t{ nullptr, &function_def, &vm._imm->_program._types, &vm._imm->_interned_types, &args[0], arg_count };
+		const auto& result = call_host_function(vm, host_function, host_args);
 		return result;
 	}
 	else{
 #if DEBUG
-		const auto& arg_types = f._type.get_function_args();
+		const auto& arg_types = f.get_type().get_function_args();
 
 		//	arity
 		QUARK_ASSERT(arg_count == arg_types.size());
 
 		for(int i = 0 ; i < arg_count; i++){
-			if(args[i]._type != arg_types[i]){
+			if(args[i].get_type() != arg_types[i]){
 				QUARK_ASSERT(false);
 			}
 		}
 #endif
 
-		vm._stack.save_frame();
+		const auto function_id = f.get_function_value();
+		if(vm._tiering._jit){
+			auto& profile = vm._tiering._profiles[function_id];
+			if(++profile._call_count == vm._tiering._tier_up_calls){
+				tier_up(vm, profile);
+			}
+		}
+		if(vm._count_steps){
+			count_step(vm);
+		}
+
+		const bc_memo_pending_guard_t memo_guard(vm._memo);
+		int memo_pending = -1;
+		if(vm._memo._caches[function_id] != nullptr){
+			const auto cached = memo_lookup(vm, function_id, std::vector<bc_value_t>(args, args + arg_count));
+			if(cached != nullptr){
+				return *cached;
+			}
+			memo_pending = static_cast<int>(vm._memo._pending.size()) - 1;
+		}
 
-		//??? use exts-info inside function_def.
 		//	We push the values to the stack = the stack will take RC ownership of the values.
-		std::vector<bool> exts;
+		vm._stack.save_frame();
+		const auto& frame = *function_def._frame_ptr;
 		for(int i = 0 ; i < arg_count ; i++){
 			const auto& bc = args[i];
-			bool is_ext = encode_as_external(args[i]._type);
-			exts.push_back(is_ext);
+			bool is_ext = frame._exts[i];
+			QUARK_ASSERT(is_ext == encode_as_external(args[i].get_type()));
 			if(is_ext){
 				vm._stack.push_external_value(bc);
 			}
@@ -2177,96 +2906,113 @@ bc_value_t call_function_bc(interpreter_t& vm, const bc_value_t& f, const bc_val
 			}
 		}
 
-		vm._stack.open_frame(*function_def._frame_ptr, arg_count);
-		const auto& result = execute_instructions(vm, function_def._frame_ptr->_instructions);
-		vm._stack.close_frame(*function_def._frame_ptr);
-		vm._stack.pop_batch(exts);
-		vm._stack.restore_frame();
+		vm._stack.open_frame(frame, arg_count);
 
-		if(vm._imm->_program._types[result.first].is_void() == false){
-			return result.second;
+		bc_value_t result = bc_value_t::make_undefined();
+		const auto jit = vm._tiering._jit.get();
+		if(jit != nullptr && jit->_functions[function_id] != nullptr){
+			bc_pod_value_t result_pod;
+			result_pod._inplace._int64 = jit->_functions[function_id](vm._stack._current_frame_entry_ptr, &vm._stack._entries[k_frame_overhead]);
+			vm._stack.close_frame(frame);
+			if(function_def._return_type != k_bc_typeid_void){
+				result = bc_value_t(function_def._return_type, result_pod);
+			}
 		}
 		else{
-			return bc_value_t::make_undefined();
+			const auto& r = execute_instructions(vm, frame._instructions);
+
+			//	A k_tail_call may have replaced the frame with the frame of another function.
+			vm._stack.close_frame(*vm._stack._current_frame_ptr);
+			if(vm._imm->_program._types[r.first].is_void() == false){
+				result = r.second;
+			}
+		}
+		vm._stack.pop_batch(arg_count, frame._args_ext_indexes);
+		vm._stack.restore_frame();
+
+		if(memo_pending >= 0){
+			memo_store(vm, memo_pending, result);
 		}
+		return result;
 	}
 }
 
 json_t bcvalue_to_json(const bc_value_t& v){
-	if(v._type.is_undefined()){
+	if(v.get_type().is_undefined()){
 		return json_t();
 	}
-	else if(v._type.is_internal_dynamic()){
+	else if(v.get_type().is_internal_dynamic()){
 		return json_t();
 	}
-	else if(v._type.is_void()){
+	else if(v.get_type().is_void()){
 		return json_t();
 	}
-	else if(v._type.is_bool()){
+	else if(v.get_type().is_bool()){
 		return json_t(v.get_bool_value());
 	}
-	else if(v._type.is_int()){
+	else if(v.get_type().is_int()){
 		return json_t(static_cast<double>(v.get_int_value()));
 	}
-	else if(v._type.is_double()){
+	else if(v.get_type().is_double()){
 		return json_t(static_cast<double>(v.get_double_value()));
 	}
-	else if(v._type.is_string()){
+	else if(v.get_type().is_string()){
 		return json_t(v.get_string_value());
 	}
-	else if(v._type.is_json_value()){
+	else if(v.get_type().is_json_value()){
 		return v.get_json_value();
 	}
-	else if(v._type.is_typeid()){
+	else if(v.get_type().is_typeid()){
 		return typeid_to_ast_json(v.get_typeid_value(), json_tags::k_plain)._value;
 	}
-	else if(v._type.is_struct()){
+	else if(v.get_type().is_struct()){
 		const auto& struct_value = v.get_struct_value();
 		std::map<std::string, json_t> obj2;
-		const auto& struct_def = v._type.get_struct();
+		const auto& struct_def = v.get_type().get_struct();
 		for(int i = 0 ; i < struct_def._members.size() ; i++){
 			const auto& member = struct_def._members[i];
 			const auto& key = member._name;
-//			const auto& type = member._type;
+//			const auto& type = member.get_type();
 			const auto& value = struct_value[i];
 			const auto& value2 = bcvalue_to_json(value);
 			obj2[key] = value2;
 		}
 		return json_t::make_object(obj2);
 	}
-	else if(v._type.is_vector()){
-		const auto element_type = v._type.get_vector_element_type();
+	else if(v.get_type().is_vector()){
+		const auto element_type = v.get_type().get_vector_element_type();
 
 		std::vector<json_t> result;
 		if(element_type.is_bool()){
-			for(int i = 0 ; i < v._pod._external->_vector_w_inplace_elements.size() ; i++){
-				const auto element_value2 = v._pod._external->_vector_w_inplace_elements[i]._bool;
+			for(int i = 0 ; i < v._pod._external->get_vector_w_inplace_elements().size() ; i++){
+				const auto element_value2 = v._pod._external->get_vector_w_inplace_elements()[i]._bool;
 				result.push_back(json_t(element_value2));
 			}
 		}
 		else if(element_type.is_int()){
-			for(int i = 0 ; i < v._pod._external->_vector_w_inplace_elements.size() ; i++){
-				const auto element_value2 = v._pod._external->_vector_w_inplace_elements[i]._int64;
+			for(int i = 0 ; i < v._pod._external->get_vector_w_inplace_elements().size() ; i++){
+				const auto element_value2 = v._pod._external->get_vector_w_inplace_elements()[i]._int64;
 				result.push_back(json_t(element_value2));
 			}
 		}
 		else if(element_type.is_double()){
-			for(int i = 0 ; i < v._pod._external->_vector_w_inplace_elements.size() ; i++){
-				const auto element_value2 = v._pod._external->_vector_w_inplace_elements[i]._double;
+			for(int i = 0 ; i < v._pod._external->get_vector_w_inplace_elements().size() ; i++){
+				const auto element_value2 = v._pod._external->get_vector_w_inplace_elements()[i]._double;
 				result.push_back(json_t(element_value2));
 			}
 		}
 		else{
 			const auto vec = get_vector_external_elements(v);
+			const auto element_typeid = lookup_bc_vector_element_type(v._typeid);
 			for(int i = 0 ; i < vec->size() ; i++){
 				const auto element_value2 = vec->operator[](i);
-				result.push_back(bcvalue_to_json(bc_value_t(element_type, element_value2)));
+				result.push_back(bcvalue_to_json(bc_value_t(element_typeid, element_value2)));
 			}
 		}
 		return result;
 	}
-	else if(v._type.is_dict()){
-		const auto value_type = v._type.get_dict_value_type();
+	else if(v.get_type().is_dict()){
+		const auto value_type = lookup_bc_dict_value_type(v._typeid);
 		const auto entries = get_dict_value(v);
 		std::map<std::string, json_t> result;
 		for(const auto& e: entries){
@@ -2276,10 +3022,10 @@ json_t bcvalue_to_json(const bc_value_t& v){
 		}
 		return result;
 	}
-	else if(v._type.is_function()){
+	else if(v.get_type().is_function()){
 		return json_t::make_object(
 			{
-				{ "funtyp", typeid_to_ast_json(v._type, json_tags::k_plain)._value }
+				{ "funtyp", typeid_to_ast_json(v.get_type(), json_tags::k_plain)._value }
 			}
 		);
 	}
@@ -2291,7 +3037,7 @@ json_t bcvalue_to_json(const bc_value_t& v){
 
 json_t bcvalue_and_type_to_json(const bc_value_t& v){
 	return json_t::make_array({
-		typeid_to_ast_json(v._type, json_tags::k_plain)._value,
+		typeid_to_ast_json(v.get_type(), json_tags::k_plain)._value,
 		bcvalue_to_json(v)
 	});
 }
@@ -2302,33 +3048,72 @@ json_t bcvalue_and_type_to_json(const bc_value_t& v){
 
 
 
-interpreter_t::interpreter_t(const bc_program_t& program, interpreter_handler_i* handler) :
-	_stack(nullptr),
+interpreter_config_t make_interpreter_config(const container_t& container_def){
+	const size_t max_size = container_def._max_stack_size > 0 ? static_cast<size_t>(container_def._max_stack_size) : k_default_stack_max_size;
+	const size_t initial_size = container_def._stack_size > 0 ? static_cast<size_t>(container_def._stack_size) : k_default_stack_initial_size;
+	interpreter_config_t result;
+	result._stack_initial_size = std::min(initial_size, max_size);
+	result._stack_max_size = max_size;
+	result._jit = container_def._jit;
+	result._memoize = container_def._memoize;
+	if(container_def._memoize_capacity > 0){
+		result._memo_capacity = static_cast<size_t>(container_def._memoize_capacity);
+	}
+	return result;
+}
+
+interpreter_t::interpreter_t(const bc_program_t& program, interpreter_handler_i* handler, const interpreter_config_t& config) :
+	_stack(nullptr, 0, 0),
 	_handler(handler)
 {
 	QUARK_ASSERT(program.check_invariant());
 
 	//	Make lookup table from host-function ID to an implementation of that host function in the interpreter.
 	const auto& host_functions = get_host_functions();
-	std::map<int, HOST_FUNCTION_PTR> host_functions2;
+	std::map<int, bc_host_function_t> host_functions2;
 	for(auto& hf_kv: host_functions){
 		const auto& function_id = hf_kv.second._signature._function_id;
-		const auto& function_ptr = hf_kv.second._f;
-		host_functions2.insert({ function_id, function_ptr });
+		host_functions2.insert({ function_id, bc_host_function_t{ hf_kv.second._f, hf_kv.second._fast_f } });
 	}
 
 	const auto start_time = std::chrono::high_resolution_clock::now();
-	_imm = std::make_shared<interpreter_imm_t>(interpreter_imm_t{start_time, program, host_functions2});
+	_imm = std::make_shared<interpreter_imm_t>(interpreter_imm_t{start_time, program, host_functions2, intern_bc_types(program._types)});
 
-	interpreter_stack_t temp(&_imm->_program._globals);
+	QUARK_ASSERT(config._tier_up_calls >= 1 && config._tier_up_backedges >= 1);
+	const auto function_count = _imm->_program._function_defs.size();
+	_tiering._tier_up_calls = config._tier_up_calls;
+	_tiering._tier_up_backedges = config._tier_up_backedges;
+	_tiering._profiles.resize(function_count + 1, bc_function_profile_t{ 0, 0, false });
+	for(int function_id = 0 ; function_id < static_cast<int>(function_count) ; function_id++){
+		const auto& frame = _imm->_program._function_defs[function_id]._frame_ptr;
+		if(frame){
+			_tiering._frame_function_ids.insert({ frame.get(), function_id });
+		}
+	}
+	_tiering._jit = config._jit ? std::make_shared<bc_jit_t>(function_count) : nullptr;
+	_memo._caches.resize(function_count);
+	_count_steps = config._step_limit > 0;
+	_steps_left = config._step_limit;
+
+	interpreter_stack_t temp(&_imm->_program._globals, config._stack_initial_size, config._stack_max_size);
 	temp.swap(_stack);
 	_stack.save_frame();
 	_stack.open_frame(_imm->_program._globals, 0);
 
 	//	Run static intialization (basically run global instructions before calling main()).
-	/*const auto& r =*/ execute_instructions(*this, _imm->_program._globals._instructions);
+	if(config._run_global_instructions){
+		/*const auto& r =*/ execute_instructions(*this, _imm->_program._globals._instructions);
+	}
+
+	//	Function values are in the globals now.
+	setup_memo(*this, config);
 	QUARK_ASSERT(check_invariant());
 }
+interpreter_t::interpreter_t(const bc_program_t& program, interpreter_handler_i* handler) :
+	interpreter_t(program, handler, make_interpreter_config(program._container_def))
+{
+}
+
 interpreter_t::interpreter_t(const bc_program_t& program) : interpreter_t(program, nullptr) {}
 
 void interpreter_t::swap(interpreter_t& other) throw(){
@@ -2336,6 +3121,10 @@ void interpreter_t::swap(interpreter_t& other) throw(){
 	std::swap(other._handler, this->_handler);
 	other._stack.swap(this->_stack);
 	other._print_output.swap(this->_print_output);
+	std::swap(other._tiering, this->_tiering);
+	std::swap(other._memo, this->_memo);
+	std::swap(other._count_steps, this->_count_steps);
+	std::swap(other._steps_left, this->_steps_left);
 }
 
 #if DEBUG
@@ -2372,12 +3161,12 @@ QUARK_UNIT_TEST("", "", "", ""){
 QUARK_UNIT_TEST("", "", "", ""){
 	const auto s = sizeof(bc_value_t);
 	QUARK_UT_VERIFY(s >= 8);
-//	QUARK_UT_VERIFY(s == 16);
+	QUARK_UT_VERIFY(s == 16);
 }
 
 
 //	IMPORTANT: NO arguments are passed as DYN arguments.
-void execute_new_1(interpreter_t& vm, int16_t dest_reg, int16_t target_itype, int16_t source_itype){
+void execute_new_1(interpreter_t& vm, int dest_reg, int target_itype, int source_itype){
 	QUARK_ASSERT(vm.check_invariant());
 
 	const auto& target_type = lookup_full_type(vm, target_itype);
@@ -2385,7 +3174,7 @@ void execute_new_1(interpreter_t& vm, int16_t dest_reg, int16_t target_itype, in
 
 	const int arg0_stack_pos = vm._stack.size() - 1;
 	const auto input_value_type = lookup_full_type(vm, source_itype);
-	const auto input_value = vm._stack.load_value(arg0_stack_pos + 0, input_value_type);
+	const auto input_value = vm._stack.load_value(arg0_stack_pos + 0, vm._imm->_interned_types[source_itype]);
 
 	const bc_value_t result = [&]{
 		if(target_type.is_bool() || target_type.is_int() || target_type.is_double() || target_type.is_typeid()){
@@ -2413,7 +3202,7 @@ void execute_new_1(interpreter_t& vm, int16_t dest_reg, int16_t target_itype, in
 
 
 //	IMPORTANT: NO arguments are passed as DYN arguments.
-void execute_new_vector_obj(interpreter_t& vm, int16_t dest_reg, int16_t target_itype, int16_t arg_count){
+void execute_new_vector_obj(interpreter_t& vm, int dest_reg, int target_itype, int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 
 	const auto& target_type = lookup_full_type(vm, target_itype);
@@ -2427,7 +3216,7 @@ void execute_new_vector_obj(interpreter_t& vm, int16_t dest_reg, int16_t target_
 	const int arg0_stack_pos = vm._stack.size() - arg_count;
 //	bool is_element_ext = encode_as_external(element_type);
 
-	immer::vector<bc_external_handle_t> elements2;
+	bc_immer_vector_t<bc_external_handle_t> elements2;
 	for(int i = 0 ; i < arg_count ; i++){
 		const auto pos = arg0_stack_pos + i;
 		QUARK_ASSERT(vm._stack._debug_types[pos] == element_type);
@@ -2435,11 +3224,11 @@ void execute_new_vector_obj(interpreter_t& vm, int16_t dest_reg, int16_t target_
 		elements2 = elements2.push_back(e);
 	}
 
-	const auto result = make_vector(element_type, elements2);
+	const auto result = make_vector(vm._imm->_interned_types[target_itype], elements2);
 	vm._stack.write_register__external_value(dest_reg, result);
 }
 
-void execute_new_dict_obj(interpreter_t& vm, int16_t dest_reg, int16_t target_itype, int16_t arg_count){
+void execute_new_dict_obj(interpreter_t& vm, int dest_reg, int target_itype, int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 
 	const auto& target_type = lookup_full_type(vm, target_itype);
@@ -2451,21 +3240,21 @@ void execute_new_dict_obj(interpreter_t& vm, int16_t dest_reg, int16_t target_it
 	QUARK_ASSERT(target_type.is_undefined() == false);
 	QUARK_ASSERT(element_type.is_undefined() == false);
 
-	const auto string_type = typeid_t::make_string();
+	const auto element_typeid = lookup_bc_dict_value_type(vm._imm->_interned_types[target_itype]);
 
-	immer::map<std::string, bc_external_handle_t> elements2;
+	bc_immer_map_t<std::string, bc_external_handle_t> elements2;
 	int dict_element_count = arg_count / 2;
 	for(auto i = 0 ; i < dict_element_count ; i++){
-		const auto key = vm._stack.load_value(arg0_stack_pos + i * 2 + 0, string_type);
-		const auto value = vm._stack.load_value(arg0_stack_pos + i * 2 + 1, element_type);
+		const auto key = vm._stack.load_value(arg0_stack_pos + i * 2 + 0, k_bc_typeid_string);
+		const auto value = vm._stack.load_value(arg0_stack_pos + i * 2 + 1, element_typeid);
 		const auto key2 = key.get_string_value();
 		elements2 = elements2.insert({ key2, bc_external_handle_t(value) });
 	}
 
-	const auto result = make_dict(element_type, elements2);
+	const auto result = make_dict(vm._imm->_interned_types[target_itype], elements2);
 	vm._stack.write_register__external_value(dest_reg, result);
 }
-void execute_new_dict_pod64(interpreter_t& vm, int16_t dest_reg, int16_t target_itype, int16_t arg_count){
+void execute_new_dict_pod64(interpreter_t& vm, int dest_reg, int target_itype, int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 
 	const auto& target_type = lookup_full_type(vm, target_itype);
@@ -2477,22 +3266,22 @@ void execute_new_dict_pod64(interpreter_t& vm, int16_t dest_reg, int16_t target_
 	QUARK_ASSERT(target_type.is_undefined() == false);
 	QUARK_ASSERT(element_type.is_undefined() == false);
 
-	const auto string_type = typeid_t::make_string();
+	const auto element_typeid = lookup_bc_dict_value_type(vm._imm->_interned_types[target_itype]);
 
-	immer::map<std::string, bc_inplace_value_t> elements2;
+	bc_immer_map_t<std::string, bc_inplace_value_t> elements2;
 	int dict_element_count = arg_count / 2;
 	for(auto i = 0 ; i < dict_element_count ; i++){
-		const auto key = vm._stack.load_value(arg0_stack_pos + i * 2 + 0, string_type);
-		const auto value = vm._stack.load_value(arg0_stack_pos + i * 2 + 1, element_type);
+		const auto key = vm._stack.load_value(arg0_stack_pos + i * 2 + 0, k_bc_typeid_string);
+		const auto value = vm._stack.load_value(arg0_stack_pos + i * 2 + 1, element_typeid);
 		const auto key2 = key.get_string_value();
 		elements2 = elements2.insert({ key2, value._pod._inplace });
 	}
 
-	const auto result = make_dict(element_type, elements2);
+	const auto result = make_dict(vm._imm->_interned_types[target_itype], elements2);
 	vm._stack.write_register__external_value(dest_reg, result);
 }
 
-void execute_new_struct(interpreter_t& vm, int16_t dest_reg, int16_t target_itype, int16_t arg_count){
+void execute_new_struct(interpreter_t& vm, int dest_reg, int target_itype, int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 
 	const auto& target_type = lookup_full_type(vm, target_itype);
@@ -2500,137 +3289,483 @@ void execute_new_struct(interpreter_t& vm, int16_t dest_reg, int16_t target_ityp
 
 	const int arg0_stack_pos = vm._stack.size() - arg_count;
 
-	const auto& struct_def = target_type.get_struct();
+	const auto target_typeid = vm._imm->_interned_types[target_itype];
+	const auto& member_types = lookup_bc_struct_member_types(target_typeid);
 	std::vector<bc_value_t> elements2;
 	for(int i = 0 ; i < arg_count ; i++){
-		const auto member_type = struct_def._members[i]._type;
-		const auto value = vm._stack.load_value(arg0_stack_pos + i, member_type);
+		const auto value = vm._stack.load_value(arg0_stack_pos + i, member_types[i]);
 		elements2.push_back(value);
 	}
 
-	const auto result = bc_value_t::make_struct_value(target_type, elements2);
+	const auto result = bc_value_t::make_struct_value(target_typeid, elements2);
 //	QUARK_TRACE(to_compact_string2(instance));
 
 	vm._stack.write_register__external_value(dest_reg, result);
 }
 
 
+/*
+	Opcode dispatch for execute_instructions().
+
+	FLOYD_BC_THREADED_DISPATCH 1: threaded code. Each opcode handler fetches the next instruction and jumps
+	directly to its handler via a label table indexed by bc_opcode. This gives one indirect branch per handler
+	instead of one shared indirect branch, which the CPU predicts much better. Uses "labels as values",
+	supported by GCC and clang.
+
+	FLOYD_BC_THREADED_DISPATCH 0: portable while(true) + switch dispatch.
+
+	Handlers are written once, using BC_CASE() and BC_NEXT(), and work with both modes.
+*/
+#ifndef FLOYD_BC_THREADED_DISPATCH
+	#if defined(__GNUC__) || defined(__clang__)
+		#define FLOYD_BC_THREADED_DISPATCH 1
+	#else
+		#define FLOYD_BC_THREADED_DISPATCH 0
+	#endif
+#endif
+
+#if FLOYD_BC_THREADED_DISPATCH
+typedef std::array<const void*, 256> bc_dispatch_table_t;
+
+//	Opcodes without a handler jump to unknown_opcode_label.
+static bc_dispatch_table_t make_dispatch_table(const std::vector<std::pair<bc_opcode, const void*>>& handlers, const void* unknown_opcode_label){
+	bc_dispatch_table_t result;
+	result.fill(unknown_opcode_label);
+	for(const auto& e: handlers){
+		QUARK_ASSERT(result[static_cast<uint8_t>(e.first)] == unknown_opcode_label);
+		result[static_cast<uint8_t>(e.first)] = e.second;
+	}
+	return result;
+}
+
+	#define BC_CASE(opcode) case bc_opcode::opcode: op_##opcode
+	#define BC_NEXT() { \
+			pc++; \
+			QUARK_ASSERT(pc >= 0 && static_cast<size_t>(pc) < code->size()); \
+			QUARK_ASSERT((*code)[pc].check_invariant()); \
+			i = decode_instruction((*code)[pc]); \
+			QUARK_ASSERT(vm.check_invariant()); \
+			QUARK_ASSERT(frame_ptr == stack._current_frame_ptr); \
+			QUARK_ASSERT(regs == stack._current_frame_entry_ptr); \
+			goto *k_dispatch_table[static_cast<uint8_t>(i._opcode)]; \
+		}
+
+	//	Runs the handler for i as it is, without fetching.
+	#define BC_DISPATCH_DECODED() goto *k_dispatch_table[static_cast<uint8_t>(i._opcode)]
+#else
+	#define BC_CASE(opcode) case bc_opcode::opcode
+	#define BC_NEXT() break
+	#define BC_DISPATCH_DECODED() goto dispatch_decoded
+#endif
+
+//	Takes a branch. A backward branch closes a loop: count it in the running function's profile, if the JIT is on.
+#define BC_BRANCH(offset) { \
+		const auto branch_offset = (offset); \
+		pc += branch_offset - 1; \
+		if(branch_offset < 0){ \
+			if(jit != nullptr && ++profile->_backedge_count == tier_up_backedges){ \
+				tier_up(vm, *profile); \
+			} \
+			if(count_steps){ \
+				count_step(vm); \
+			} \
+		} \
+	}
+
+
+//	Returns index of first element equal to wanted, or -1.
+static int64_t find_inplace_element(const bc_immer_vector_t<bc_inplace_value_t>& vec, const bc_inplace_value_t& wanted, const typeid_t& element_type){
+	const auto size = static_cast<int64_t>(vec.size());
+	int64_t index = 0;
+	if(element_type.is_bool()){
+		while(index < size && vec[index]._bool != wanted._bool){
+			index++;
+		}
+	}
+	else if(element_type.is_double()){
+		while(index < size && vec[index]._double != wanted._double){
+			index++;
+		}
+	}
+	else if(element_type.is_int()){
+		while(index < size && vec[index]._int64 != wanted._int64){
+			index++;
+		}
+	}
+	else{
+		quark::throw_runtime_error("Calling find() on unsupported type of value.");
+	}
+	return index == size ? -1 : index;
+}
+
+//	Clips [start, end) to [0, size) the way subset() and replace() do.
+static std::pair<size_t, size_t> clamp_subrange(int64_t start, int64_t end, size_t size, const char function_name[]){
+	if(start < 0 || end < 0){
+		quark::throw_runtime_error(std::string(function_name) + "() requires start and end to be non-negative.");
+	}
+	const auto start2 = std::min(static_cast<size_t>(start), size);
+	const auto end2 = std::min(static_cast<size_t>(end), size);
+	return { start2, end2 };
+}
+
 std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const std::vector<bc_instruction_t>& instructions){
 	QUARK_ASSERT(vm.check_invariant());
-	QUARK_ASSERT(instructions.empty() == true || (instructions.back()._opcode == bc_opcode::k_return || instructions.back()._opcode == bc_opcode::k_stop));
+	QUARK_ASSERT(instructions.empty() == true || (instructions.back()._opcode == bc_opcode::k_return || instructions.back()._opcode == bc_opcode::k_stop || instructions.back()._opcode == bc_opcode::k_tail_call));
 
 	interpreter_stack_t& stack = vm._stack;
 	const bc_static_frame_t* frame_ptr = stack._current_frame_ptr;
 	bc_pod_value_t* regs = stack._current_frame_entry_ptr;
 	bc_pod_value_t* globals = &stack._entries[k_frame_overhead];
+	const double* double_constants = vm._imm->_program._double_constants.data();
+	const bc_jit_t* jit = vm._tiering._jit.get();
+	bc_function_profile_t* profile = find_profile(vm, frame_ptr);
+	bc_function_profile_t* profiles = &vm._tiering._profiles[0];
+	const auto tier_up_calls = vm._tiering._tier_up_calls;
+	const auto tier_up_backedges = vm._tiering._tier_up_backedges;
+	const bool count_steps = vm._count_steps;
+
+	//	Floyd-to-Floyd calls don't recurse into execute_instructions(), they switch code + frame and push a
+	//	bc_call_record_t. Records below call_records_base belong to someone further up the C++ stack.
+	const std::vector<bc_instruction_t>* code = &instructions;
+	const auto call_records_base = stack._call_records.size();
+	const bc_memo_pending_guard_t memo_guard(vm._memo);
 
 //	const typeid_t* type_lookup = &vm._imm->_program._types[0];
 //	const auto type_count = vm._imm->_program._types.size();
 
 //	QUARK_TRACE_SS("STACK:  " << json_to_pretty_string(stack.stack_to_json()));
 
+#if FLOYD_BC_THREADED_DISPATCH
+	//	Built once, the first time we run. Label addresses are only valid inside this function.
+	static const bc_dispatch_table_t k_dispatch_table = make_dispatch_table({
+		{ bc_opcode::k_nop, &&op_k_nop },
+		{ bc_opcode::k_wide, &&op_k_wide },
+		{ bc_opcode::k_load_global_external_value, &&op_k_load_global_external_value },
+		{ bc_opcode::k_load_global_inplace_value, &&op_k_load_global_inplace_value },
+		{ bc_opcode::k_store_global_external_value, &&op_k_store_global_external_value },
+		{ bc_opcode::k_store_global_inplace_value, &&op_k_store_global_inplace_value },
+		{ bc_opcode::k_copy_reg_inplace_value, &&op_k_copy_reg_inplace_value },
+		{ bc_opcode::k_copy_reg_external_value, &&op_k_copy_reg_external_value },
+		{ bc_opcode::k_release_external_value, &&op_k_release_external_value },
+		{ bc_opcode::k_return, &&op_k_return },
+		{ bc_opcode::k_stop, &&op_k_stop },
+		{ bc_opcode::k_push_frame_ptr, &&op_k_push_frame_ptr },
+		{ bc_opcode::k_pop_frame_ptr, &&op_k_pop_frame_ptr },
+		{ bc_opcode::k_push_inplace_value, &&op_k_push_inplace_value },
+		{ bc_opcode::k_push_external_value, &&op_k_push_external_value },
+		{ bc_opcode::k_popn, &&op_k_popn },
+		{ bc_opcode::k_branch_false_bool, &&op_k_branch_false_bool },
+		{ bc_opcode::k_branch_true_bool, &&op_k_branch_true_bool },
+		{ bc_opcode::k_branch_zero_int, &&op_k_branch_zero_int },
+		{ bc_opcode::k_branch_notzero_int, &&op_k_branch_notzero_int },
+		{ bc_opcode::k_branch_smaller_int, &&op_k_branch_smaller_int },
+		{ bc_opcode::k_branch_smaller_or_equal_int, &&op_k_branch_smaller_or_equal_int },
+		{ bc_opcode::k_branch_equal_int, &&op_k_branch_equal_int },
+		{ bc_opcode::k_branch_nonequal_int, &&op_k_branch_nonequal_int },
+		{ bc_opcode::k_branch_smaller_double, &&op_k_branch_smaller_double },
+		{ bc_opcode::k_branch_smaller_or_equal_double, &&op_k_branch_smaller_or_equal_double },
+		{ bc_opcode::k_branch_equal_double, &&op_k_branch_equal_double },
+		{ bc_opcode::k_branch_nonequal_double, &&op_k_branch_nonequal_double },
+		{ bc_opcode::k_branch_smaller_string, &&op_k_branch_smaller_string },
+		{ bc_opcode::k_branch_smaller_or_equal_string, &&op_k_branch_smaller_or_equal_string },
+		{ bc_opcode::k_branch_equal_string, &&op_k_branch_equal_string },
+		{ bc_opcode::k_branch_nonequal_string, &&op_k_branch_nonequal_string },
+		{ bc_opcode::k_branch_smaller_bool, &&op_k_branch_smaller_bool },
+		{ bc_opcode::k_branch_smaller_or_equal_bool, &&op_k_branch_smaller_or_equal_bool },
+		{ bc_opcode::k_branch_equal_bool, &&op_k_branch_equal_bool },
+		{ bc_opcode::k_branch_nonequal_bool, &&op_k_branch_nonequal_bool },
+		{ bc_opcode::k_branch_always, &&op_k_branch_always },
+		{ bc_opcode::k_get_struct_member, &&op_k_get_struct_member },
+		{ bc_opcode::k_lookup_element_string, &&op_k_lookup_element_string },
+		{ bc_opcode::k_lookup_element_json_value, &&op_k_lookup_element_json_value },
+		{ bc_opcode::k_lookup_element_vector_w_external_elements, &&op_k_lookup_element_vector_w_external_elements },
+		{ bc_opcode::k_lookup_element_vector_w_inplace_elements, &&op_k_lookup_element_vector_w_inplace_elements },
+		{ bc_opcode::k_lookup_element_vector_w_external_elements_unchecked, &&op_k_lookup_element_vector_w_external_elements_unchecked },
+		{ bc_opcode::k_lookup_element_vector_w_inplace_elements_unchecked, &&op_k_lookup_element_vector_w_inplace_elements_unchecked },
+		{ bc_opcode::k_lookup_element_dict_w_external_values, &&op_k_lookup_element_dict_w_external_values },
+		{ bc_opcode::k_lookup_element_dict_w_inplace_values, &&op_k_lookup_element_dict_w_inplace_values },
+		{ bc_opcode::k_get_size_vector_w_external_elements, &&op_k_get_size_vector_w_external_elements },
+		{ bc_opcode::k_get_size_vector_w_inplace_elements, &&op_k_get_size_vector_w_inplace_elements },
+		{ bc_opcode::k_get_size_dict_w_external_values, &&op_k_get_size_dict_w_external_values },
+		{ bc_opcode::k_get_size_dict_w_inplace_values, &&op_k_get_size_dict_w_inplace_values },
+		{ bc_opcode::k_get_size_string, &&op_k_get_size_string },
+		{ bc_opcode::k_get_size_jsonvalue, &&op_k_get_size_jsonvalue },
+		{ bc_opcode::k_pushback_vector_w_external_elements, &&op_k_pushback_vector_w_external_elements },
+		{ bc_opcode::k_pushback_vector_w_inplace_elements, &&op_k_pushback_vector_w_inplace_elements },
+		{ bc_opcode::k_pushback_string, &&op_k_pushback_string },
+		{ bc_opcode::k_find_string, &&op_k_find_string },
+		{ bc_opcode::k_find_vector_w_external_elements, &&op_k_find_vector_w_external_elements },
+		{ bc_opcode::k_find_vector_w_inplace_elements, &&op_k_find_vector_w_inplace_elements },
+		{ bc_opcode::k_exists_dict_w_external_values, &&op_k_exists_dict_w_external_values },
+		{ bc_opcode::k_exists_dict_w_inplace_values, &&op_k_exists_dict_w_inplace_values },
+		{ bc_opcode::k_erase_dict_w_external_values, &&op_k_erase_dict_w_external_values },
+		{ bc_opcode::k_erase_dict_w_inplace_values, &&op_k_erase_dict_w_inplace_values },
+		{ bc_opcode::k_subset_string, &&op_k_subset_string },
+		{ bc_opcode::k_subset_vector_w_external_elements, &&op_k_subset_vector_w_external_elements },
+		{ bc_opcode::k_subset_vector_w_inplace_elements, &&op_k_subset_vector_w_inplace_elements },
+		{ bc_opcode::k_replace_string, &&op_k_replace_string },
+		{ bc_opcode::k_replace_vector_w_external_elements, &&op_k_replace_vector_w_external_elements },
+		{ bc_opcode::k_replace_vector_w_inplace_elements, &&op_k_replace_vector_w_inplace_elements },
+		{ bc_opcode::k_update_vector_w_external_elements, &&op_k_update_vector_w_external_elements },
+		{ bc_opcode::k_update_vector_w_inplace_elements, &&op_k_update_vector_w_inplace_elements },
+		{ bc_opcode::k_update_dict_w_external_values, &&op_k_update_dict_w_external_values },
+		{ bc_opcode::k_update_dict_w_inplace_values, &&op_k_update_dict_w_inplace_values },
+		{ bc_opcode::k_call, &&op_k_call },
+		{ bc_opcode::k_tail_call, &&op_k_tail_call },
+		{ bc_opcode::k_new_1, &&op_k_new_1 },
+		{ bc_opcode::k_new_vector_w_external_elements, &&op_k_new_vector_w_external_elements },
+		{ bc_opcode::k_new_vector_w_inplace_elements, &&op_k_new_vector_w_inplace_elements },
+		{ bc_opcode::k_new_dict_w_external_values, &&op_k_new_dict_w_external_values },
+		{ bc_opcode::k_new_dict_w_inplace_values, &&op_k_new_dict_w_inplace_values },
+		{ bc_opcode::k_new_struct, &&op_k_new_struct },
+		{ bc_opcode::k_comparison_smaller_or_equal, &&op_k_comparison_smaller_or_equal },
+		{ bc_opcode::k_comparison_smaller_or_equal_int, &&op_k_comparison_smaller_or_equal_int },
+		{ bc_opcode::k_comparison_smaller, &&op_k_comparison_smaller },
+		{ bc_opcode::k_comparison_smaller_int, &&op_k_comparison_smaller_int },
+		{ bc_opcode::k_logical_equal, &&op_k_logical_equal },
+		{ bc_opcode::k_logical_equal_int, &&op_k_logical_equal_int },
+		{ bc_opcode::k_logical_nonequal, &&op_k_logical_nonequal },
+		{ bc_opcode::k_logical_nonequal_int, &&op_k_logical_nonequal_int },
+		{ bc_opcode::k_comparison_smaller_or_equal_double, &&op_k_comparison_smaller_or_equal_double },
+		{ bc_opcode::k_comparison_smaller_double, &&op_k_comparison_smaller_double },
+		{ bc_opcode::k_logical_equal_double, &&op_k_logical_equal_double },
+		{ bc_opcode::k_logical_nonequal_double, &&op_k_logical_nonequal_double },
+		{ bc_opcode::k_comparison_smaller_or_equal_string, &&op_k_comparison_smaller_or_equal_string },
+		{ bc_opcode::k_comparison_smaller_string, &&op_k_comparison_smaller_string },
+		{ bc_opcode::k_logical_equal_string, &&op_k_logical_equal_string },
+		{ bc_opcode::k_logical_nonequal_string, &&op_k_logical_nonequal_string },
+		{ bc_opcode::k_comparison_smaller_or_equal_bool, &&op_k_comparison_smaller_or_equal_bool },
+		{ bc_opcode::k_comparison_smaller_bool, &&op_k_comparison_smaller_bool },
+		{ bc_opcode::k_logical_equal_bool, &&op_k_logical_equal_bool },
+		{ bc_opcode::k_logical_nonequal_bool, &&op_k_logical_nonequal_bool },
+		{ bc_opcode::k_add_bool, &&op_k_add_bool },
+		{ bc_opcode::k_add_int, &&op_k_add_int },
+		{ bc_opcode::k_add_double, &&op_k_add_double },
+		{ bc_opcode::k_concat_strings, &&op_k_concat_strings },
+		{ bc_opcode::k_concat_vectors_w_external_elements, &&op_k_concat_vectors_w_external_elements },
+		{ bc_opcode::k_concat_vectors_w_inplace_elements, &&op_k_concat_vectors_w_inplace_elements },
+		{ bc_opcode::k_subtract_double, &&op_k_subtract_double },
+		{ bc_opcode::k_subtract_int, &&op_k_subtract_int },
+		{ bc_opcode::k_multiply_double, &&op_k_multiply_double },
+		{ bc_opcode::k_multiply_int, &&op_k_multiply_int },
+		{ bc_opcode::k_divide_double, &&op_k_divide_double },
+		{ bc_opcode::k_divide_int, &&op_k_divide_int },
+		{ bc_opcode::k_remainder_int, &&op_k_remainder_int },
+		{ bc_opcode::k_logical_and_bool, &&op_k_logical_and_bool },
+		{ bc_opcode::k_logical_and_int, &&op_k_logical_and_int },
+		{ bc_opcode::k_logical_and_double, &&op_k_logical_and_double },
+		{ bc_opcode::k_logical_or_bool, &&op_k_logical_or_bool },
+		{ bc_opcode::k_logical_or_int, &&op_k_logical_or_int },
+		{ bc_opcode::k_logical_or_double, &&op_k_logical_or_double },
+		{ bc_opcode::k_add_int_imm, &&op_k_add_int_imm },
+		{ bc_opcode::k_subtract_int_imm, &&op_k_subtract_int_imm },
+		{ bc_opcode::k_multiply_int_imm, &&op_k_multiply_int_imm },
+		{ bc_opcode::k_add_double_const, &&op_k_add_double_const },
+		{ bc_opcode::k_subtract_double_const, &&op_k_subtract_double_const },
+		{ bc_opcode::k_multiply_double_const, &&op_k_multiply_double_const },
+		{ bc_opcode::k_divide_double_const, &&op_k_divide_double_const },
+		{ bc_opcode::k_comparison_smaller_int_imm, &&op_k_comparison_smaller_int_imm },
+		{ bc_opcode::k_comparison_smaller_or_equal_int_imm, &&op_k_comparison_smaller_or_equal_int_imm },
+		{ bc_opcode::k_comparison_larger_int_imm, &&op_k_comparison_larger_int_imm },
+		{ bc_opcode::k_comparison_larger_or_equal_int_imm, &&op_k_comparison_larger_or_equal_int_imm },
+		{ bc_opcode::k_logical_equal_int_imm, &&op_k_logical_equal_int_imm },
+		{ bc_opcode::k_logical_nonequal_int_imm, &&op_k_logical_nonequal_int_imm },
+		{ bc_opcode::k_branch_smaller_int_imm, &&op_k_branch_smaller_int_imm },
+		{ bc_opcode::k_branch_smaller_or_equal_int_imm, &&op_k_branch_smaller_or_equal_int_imm },
+		{ bc_opcode::k_branch_larger_int_imm, &&op_k_branch_larger_int_imm },
+		{ bc_opcode::k_branch_larger_or_equal_int_imm, &&op_k_branch_larger_or_equal_int_imm },
+		{ bc_opcode::k_branch_equal_int_imm, &&op_k_branch_equal_int_imm },
+		{ bc_opcode::k_branch_nonequal_int_imm, &&op_k_branch_nonequal_int_imm }
+	}, &&op_unknown_opcode);
+#endif
+
 	int pc = 0;
+	bc_decoded_instruction_t i = decode_instruction((*code)[pc]);
+
+	//	With threaded dispatch, this loop only runs the first instruction -- after that each handler jumps straight to the next.
 	while(true){
 		QUARK_ASSERT(pc >= 0);
-		QUARK_ASSERT(pc < instructions.size());
-		const auto i = instructions[pc];
+		QUARK_ASSERT(pc < code->size());
+		QUARK_ASSERT((*code)[pc].check_invariant());
+		i = decode_instruction((*code)[pc]);
 
 		QUARK_ASSERT(vm.check_invariant());
-		QUARK_ASSERT(i.check_invariant());
 
 		QUARK_ASSERT(frame_ptr == stack._current_frame_ptr);
 		QUARK_ASSERT(regs == stack._current_frame_entry_ptr);
 
-
+#if FLOYD_BC_THREADED_DISPATCH == 0
+		dispatch_decoded:
+#endif
 		const auto opcode = i._opcode;
 		switch(opcode){
 
-		case bc_opcode::k_nop:
-			break;
+		BC_CASE(k_nop):
+			BC_NEXT();
+
+		BC_CASE(k_wide): {
+			//	Widen the next instruction's operands, then run it. pc ends up on it, so branches are relative to it.
+			pc++;
+			QUARK_ASSERT(static_cast<size_t>(pc) < code->size());
+			const auto& next = (*code)[pc];
+			QUARK_ASSERT(next._opcode != bc_opcode::k_wide);
+			i = bc_decoded_instruction_t{
+				next._opcode,
+				make_wide_operand(i._a, next._a),
+				make_wide_operand(i._b, next._b),
+				make_wide_operand(i._c, next._c)
+			};
+			BC_DISPATCH_DECODED();
+		}
 
 
 		//////////////////////////////////////////		ACCESS GLOBALS
 
 
-		case bc_opcode::k_load_global_external_value: {
+		BC_CASE(k_load_global_external_value): {
 			QUARK_ASSERT(stack.check_reg__external_value(i._a));
 			QUARK_ASSERT(stack.check_global_access_obj(i._b));
 
 			release_pod_external(regs[i._a]);
 			const auto& new_value_pod = globals[i._b];
 			regs[i._a] = new_value_pod;
-			new_value_pod._external->_rc++;
-			break;
+			retain_external(new_value_pod._external);
+			BC_NEXT();
+		}
+		BC_CASE(k_release_external_value): {
+			QUARK_ASSERT(stack.check_reg__external_value(i._a));
+			QUARK_ASSERT(i._a >= static_cast<int>(frame_ptr->_args.size()));
+
+			const auto& initial_pod = frame_ptr->_locals_image[i._a - frame_ptr->_args.size()];
+			retain_external(initial_pod._external);
+			release_pod_external(regs[i._a]);
+			regs[i._a] = initial_pod;
+			BC_NEXT();
 		}
-		case bc_opcode::k_load_global_inplace_value: {
+		BC_CASE(k_load_global_inplace_value): {
 			QUARK_ASSERT(stack.check_reg__inplace_value(i._a));
 
 			regs[i._a] = globals[i._b];
-			break;
+			BC_NEXT();
 		}
 
 
-		case bc_opcode::k_store_global_external_value: {
+		BC_CASE(k_store_global_external_value): {
 			QUARK_ASSERT(stack.check_global_access_obj(i._a));
 			QUARK_ASSERT(stack.check_reg__external_value(i._b));
 
 			release_pod_external(globals[i._a]);
 			const auto& new_value_pod = regs[i._b];
 			globals[i._a] = new_value_pod;
-			new_value_pod._external->_rc++;
-			break;
+			retain_external(new_value_pod._external);
+			BC_NEXT();
 		}
-		case bc_opcode::k_store_global_inplace_value: {
+		BC_CASE(k_store_global_inplace_value): {
 			QUARK_ASSERT(stack.check_global_access_intern(i._a));
 			QUARK_ASSERT(stack.check_reg__inplace_value(i._b));
 
 			globals[i._a] = regs[i._b];
-			break;
+			BC_NEXT();
 		}
 
 
 		//////////////////////////////////////////		ACCESS LOCALS
 
 
-		case bc_opcode::k_copy_reg_inplace_value: {
+		BC_CASE(k_copy_reg_inplace_value): {
 			QUARK_ASSERT(stack.check_reg__inplace_value(i._a));
 			QUARK_ASSERT(stack.check_reg__inplace_value(i._b));
 
 			regs[i._a] = regs[i._b];
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_copy_reg_external_value: {
+		BC_CASE(k_copy_reg_external_value): {
 			QUARK_ASSERT(stack.check_reg__external_value(i._a));
 			QUARK_ASSERT(stack.check_reg__external_value(i._b));
 
 			release_pod_external(regs[i._a]);
 			const auto& new_value_pod = regs[i._b];
 			regs[i._a] = new_value_pod;
-			new_value_pod._external->_rc++;
-			break;
+			retain_external(new_value_pod._external);
+			BC_NEXT();
 		}
 
 
 		//////////////////////////////////////////		STACK
 
 
-		case bc_opcode::k_return: {
+		BC_CASE(k_return): {
 			bool is_ext = frame_ptr->_exts[i._a];
 			QUARK_ASSERT(
 				(is_ext && stack.check_reg__external_value(i._a))
 				|| (!is_ext && stack.check_reg__inplace_value(i._a))
 			);
 
-			return { true, bc_value_t(frame_ptr->_symbols[i._a].second._value_type, regs[i._a]) };
+			if(stack._call_records.size() == call_records_base){
+				return { true, bc_value_t(frame_ptr->_symbol_types[i._a], regs[i._a]) };
+			}
+
+			//	Return to the caller, inside this same loop.
+			else{
+				const auto record = stack._call_records.back();
+				stack._call_records.pop_back();
+
+				//	Keep the return value alive while the callee's frame is closed.
+				const auto result_pod = regs[i._a];
+				if(is_ext){
+					retain_external(result_pod._external);
+				}
+				if(record._memo_pending >= 0){
+					memo_store(vm, record._memo_pending, bc_value_t(frame_ptr->_symbol_types[i._a], result_pod));
+				}
+				stack.close_frame(*frame_ptr);
+
+				//	Cannot store via register, caller has not yet executed k_pop_frame_ptr that restores its frame.
+				if(record._result_pos >= 0){
+					if(is_ext){
+						release_pod_external(stack._entries[record._result_pos]);
+					}
+					stack._entries[record._result_pos] = result_pod;
+				}
+				else if(is_ext){
+					auto temp = result_pod;
+					release_pod_external(temp);
+				}
+
+				code = record._return_instructions;
+				pc = record._return_pc;
+				profile = record._return_profile;
+				BC_NEXT();
+			}
 		}
 
-		case bc_opcode::k_stop: {
-			return { false, bc_value_t::make_undefined() };
+		BC_CASE(k_stop): {
+			if(stack._call_records.size() == call_records_base){
+				return { false, bc_value_t::make_undefined() };
+			}
+
+			//	Callee returning void: return to the caller, inside this same loop.
+			else{
+				const auto record = stack._call_records.back();
+				stack._call_records.pop_back();
+				QUARK_ASSERT(record._result_pos == -1);
+
+				stack.close_frame(*frame_ptr);
+
+				code = record._return_instructions;
+				pc = record._return_pc;
+				profile = record._return_profile;
+				BC_NEXT();
+			}
 		}
 
-		case bc_opcode::k_push_frame_ptr: {
+		BC_CASE(k_push_frame_ptr): {
 			QUARK_ASSERT(vm.check_invariant());
-			QUARK_ASSERT((stack._stack_size + k_frame_overhead) < stack._allocated_count)
+
+			if(stack.ensure_capacity(k_frame_overhead)){
+				regs = stack._current_frame_entry_ptr;
+				globals = &stack._entries[k_frame_overhead];
+			}
 
 			stack._entries[stack._stack_size + 0]._inplace._int64 = static_cast<int64_t>(stack._current_frame_entry_ptr - &stack._entries[0]);
 			stack._entries[stack._stack_size + 1]._inplace._frame_ptr = frame_ptr;
@@ -2640,10 +3775,10 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			stack._debug_types.push_back(typeid_t::make_void());
 #endif
 			QUARK_ASSERT(vm.check_invariant());
-			break;
+			BC_NEXT();
 		}
 
-		case bc_opcode::k_pop_frame_ptr: {
+		BC_CASE(k_pop_frame_ptr): {
 			QUARK_ASSERT(vm.check_invariant());
 			QUARK_ASSERT(stack._stack_size >= k_frame_overhead);
 
@@ -2665,41 +3800,49 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			QUARK_ASSERT(frame_ptr == stack._current_frame_ptr);
 			QUARK_ASSERT(regs == stack._current_frame_entry_ptr);
 			QUARK_ASSERT(vm.check_invariant());
-			break;
+			BC_NEXT();
 		}
 
-		case bc_opcode::k_push_inplace_value: {
+		BC_CASE(k_push_inplace_value): {
 			QUARK_ASSERT(stack.check_reg__inplace_value(i._a));
 #if DEBUG
 			const auto debug_type = stack._debug_types[stack.get_current_frame_start() + i._a];
 #endif
 
+			if(stack.ensure_capacity(1)){
+				regs = stack._current_frame_entry_ptr;
+				globals = &stack._entries[k_frame_overhead];
+			}
 			stack._entries[stack._stack_size] = regs[i._a];
 			stack._stack_size++;
 #if DEBUG
 			stack._debug_types.push_back(debug_type);
 #endif
 			QUARK_ASSERT(stack.check_invariant());
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_push_external_value: {
+		BC_CASE(k_push_external_value): {
 			QUARK_ASSERT(stack.check_reg__external_value(i._a));
 
 #if DEBUG
 			const auto debug_type = stack._debug_types[stack.get_current_frame_start() + i._a];
 #endif
 
+			if(stack.ensure_capacity(1)){
+				regs = stack._current_frame_entry_ptr;
+				globals = &stack._entries[k_frame_overhead];
+			}
 			const auto& new_value_pod = regs[i._a];
-			new_value_pod._external->_rc++;
+			retain_external(new_value_pod._external);
 			stack._entries[stack._stack_size] = new_value_pod;
 			stack._stack_size++;
 #if DEBUG
 			stack._debug_types.push_back(debug_type);
 #endif
-			break;
+			BC_NEXT();
 		}
 
-		case bc_opcode::k_popn: {
+		BC_CASE(k_popn): {
 			QUARK_ASSERT(vm.check_invariant());
 
 			const uint32_t n = i._a;
@@ -2727,61 +3870,215 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			stack._stack_size -= n;
 
 			QUARK_ASSERT(vm.check_invariant());
-			break;
+			BC_NEXT();
 		}
 
 
 		//////////////////////////////////////////		BRANCHING
 
 
-		case bc_opcode::k_branch_false_bool: {
+		BC_CASE(k_branch_false_bool): {
 			QUARK_ASSERT(stack.check_reg_bool(i._a));
 
 			//	Notice that pc will be incremented too, hence the - 1.
-			pc = regs[i._a]._inplace._bool ? pc : pc + i._b - 1;
-			break;
+			if(regs[i._a]._inplace._bool == false){ BC_BRANCH(i._b); }
+			BC_NEXT();
 		}
-		case bc_opcode::k_branch_true_bool: {
+		BC_CASE(k_branch_true_bool): {
 			QUARK_ASSERT(stack.check_reg_bool(i._a));
 
 			//	Notice that pc will be incremented too, hence the - 1.
-			pc = regs[i._a]._inplace._bool ? pc + i._b - 1: pc;
-			break;
+			if(regs[i._a]._inplace._bool){ BC_BRANCH(i._b); }
+			BC_NEXT();
 		}
-		case bc_opcode::k_branch_zero_int: {
+		BC_CASE(k_branch_zero_int): {
 			QUARK_ASSERT(stack.check_reg_int(i._a));
 
 			//	Notice that pc will be incremented too, hence the - 1.
-			pc = regs[i._a]._inplace._int64 == 0 ? pc + i._b - 1 : pc;
-			break;
+			if(regs[i._a]._inplace._int64 == 0){ BC_BRANCH(i._b); }
+			BC_NEXT();
 		}
-		case bc_opcode::k_branch_notzero_int: {
+		BC_CASE(k_branch_notzero_int): {
 			QUARK_ASSERT(stack.check_reg_int(i._a));
 
 			//	Notice that pc will be incremented too, hence the - 1.
-			pc = regs[i._a]._inplace._int64 == 0 ? pc : pc + i._b - 1;
-			break;
+			if(regs[i._a]._inplace._int64 != 0){ BC_BRANCH(i._b); }
+			BC_NEXT();
 		}
-		case bc_opcode::k_branch_smaller_int: {
+		BC_CASE(k_branch_smaller_int): {
 			QUARK_ASSERT(stack.check_reg_int(i._a));
 			QUARK_ASSERT(stack.check_reg_int(i._b));
 
 			//	Notice that pc will be incremented too, hence the - 1.
-			pc = regs[i._a]._inplace._int64 < regs[i._b]._inplace._int64 ? pc + i._c - 1 : pc;
-			break;
+			if(regs[i._a]._inplace._int64 < regs[i._b]._inplace._int64){ BC_BRANCH(i._c); }
+			BC_NEXT();
 		}
-		case bc_opcode::k_branch_smaller_or_equal_int: {
+		BC_CASE(k_branch_smaller_or_equal_int): {
 			QUARK_ASSERT(stack.check_reg_int(i._a));
 			QUARK_ASSERT(stack.check_reg_int(i._b));
 
 			//	Notice that pc will be incremented too, hence the - 1.
-			pc = regs[i._a]._inplace._int64 <= regs[i._b]._inplace._int64 ? pc + i._c - 1 : pc;
-			break;
+			if(regs[i._a]._inplace._int64 <= regs[i._b]._inplace._int64){ BC_BRANCH(i._c); }
+			BC_NEXT();
+		}
+		BC_CASE(k_branch_equal_int): {
+			QUARK_ASSERT(stack.check_reg_int(i._a));
+			QUARK_ASSERT(stack.check_reg_int(i._b));
+
+			//	Notice that pc will be incremented too, hence the - 1.
+			if(regs[i._a]._inplace._int64 == regs[i._b]._inplace._int64){ BC_BRANCH(i._c); }
+			BC_NEXT();
+		}
+		BC_CASE(k_branch_nonequal_int): {
+			QUARK_ASSERT(stack.check_reg_int(i._a));
+			QUARK_ASSERT(stack.check_reg_int(i._b));
+
+			//	Notice that pc will be incremented too, hence the - 1.
+			if(regs[i._a]._inplace._int64 != regs[i._b]._inplace._int64){ BC_BRANCH(i._c); }
+			BC_NEXT();
+		}
+		BC_CASE(k_branch_smaller_double): {
+			QUARK_ASSERT(stack.check_reg_double(i._a));
+			QUARK_ASSERT(stack.check_reg_double(i._b));
+
+			//	Notice that pc will be incremented too, hence the - 1.
+			if(compare_doubles(regs[i._a]._inplace, regs[i._b]._inplace) < 0){ BC_BRANCH(i._c); }
+			BC_NEXT();
+		}
+		BC_CASE(k_branch_smaller_or_equal_double): {
+			QUARK_ASSERT(stack.check_reg_double(i._a));
+			QUARK_ASSERT(stack.check_reg_double(i._b));
+
+			//	Notice that pc will be incremented too, hence the - 1.
+			if(compare_doubles(regs[i._a]._inplace, regs[i._b]._inplace) <= 0){ BC_BRANCH(i._c); }
+			BC_NEXT();
+		}
+		BC_CASE(k_branch_equal_double): {
+			QUARK_ASSERT(stack.check_reg_double(i._a));
+			QUARK_ASSERT(stack.check_reg_double(i._b));
+
+			//	Notice that pc will be incremented too, hence the - 1.
+			if(compare_doubles(regs[i._a]._inplace, regs[i._b]._inplace) == 0){ BC_BRANCH(i._c); }
+			BC_NEXT();
+		}
+		BC_CASE(k_branch_nonequal_double): {
+			QUARK_ASSERT(stack.check_reg_double(i._a));
+			QUARK_ASSERT(stack.check_reg_double(i._b));
+
+			//	Notice that pc will be incremented too, hence the - 1.
+			if(compare_doubles(regs[i._a]._inplace, regs[i._b]._inplace) != 0){ BC_BRANCH(i._c); }
+			BC_NEXT();
+		}
+		BC_CASE(k_branch_smaller_string): {
+			QUARK_ASSERT(stack.check_reg_string(i._a));
+			QUARK_ASSERT(stack.check_reg_string(i._b));
+
+			//	Notice that pc will be incremented too, hence the - 1.
+			if(bc_compare_pod_strings(regs[i._a], regs[i._b]) < 0){ BC_BRANCH(i._c); }
+			BC_NEXT();
+		}
+		BC_CASE(k_branch_smaller_or_equal_string): {
+			QUARK_ASSERT(stack.check_reg_string(i._a));
+			QUARK_ASSERT(stack.check_reg_string(i._b));
+
+			//	Notice that pc will be incremented too, hence the - 1.
+			if(bc_compare_pod_strings(regs[i._a], regs[i._b]) <= 0){ BC_BRANCH(i._c); }
+			BC_NEXT();
+		}
+		BC_CASE(k_branch_equal_string): {
+			QUARK_ASSERT(stack.check_reg_string(i._a));
+			QUARK_ASSERT(stack.check_reg_string(i._b));
+
+			//	Notice that pc will be incremented too, hence the - 1.
+			if(bc_equal_pod_strings(regs[i._a], regs[i._b])){ BC_BRANCH(i._c); }
+			BC_NEXT();
+		}
+		BC_CASE(k_branch_nonequal_string): {
+			QUARK_ASSERT(stack.check_reg_string(i._a));
+			QUARK_ASSERT(stack.check_reg_string(i._b));
+
+			//	Notice that pc will be incremented too, hence the - 1.
+			if(bc_equal_pod_strings(regs[i._a], regs[i._b]) == false){ BC_BRANCH(i._c); }
+			BC_NEXT();
+		}
+		BC_CASE(k_branch_smaller_bool): {
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_bool(i._b));
+
+			//	Notice that pc will be incremented too, hence the - 1.
+			if(compare_bools(regs[i._a]._inplace, regs[i._b]._inplace) < 0){ BC_BRANCH(i._c); }
+			BC_NEXT();
+		}
+		BC_CASE(k_branch_smaller_or_equal_bool): {
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_bool(i._b));
+
+			//	Notice that pc will be incremented too, hence the - 1.
+			if(compare_bools(regs[i._a]._inplace, regs[i._b]._inplace) <= 0){ BC_BRANCH(i._c); }
+			BC_NEXT();
+		}
+		BC_CASE(k_branch_equal_bool): {
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_bool(i._b));
+
+			//	Notice that pc will be incremented too, hence the - 1.
+			if(compare_bools(regs[i._a]._inplace, regs[i._b]._inplace) == 0){ BC_BRANCH(i._c); }
+			BC_NEXT();
+		}
+		BC_CASE(k_branch_nonequal_bool): {
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_bool(i._b));
+
+			//	Notice that pc will be incremented too, hence the - 1.
+			if(compare_bools(regs[i._a]._inplace, regs[i._b]._inplace) != 0){ BC_BRANCH(i._c); }
+			BC_NEXT();
+		}
+		BC_CASE(k_branch_smaller_int_imm): {
+			QUARK_ASSERT(stack.check_reg_int(i._a));
+
+			//	Notice that pc will be incremented too, hence the - 1.
+			if(regs[i._a]._inplace._int64 < i._b){ BC_BRANCH(i._c); }
+			BC_NEXT();
+		}
+		BC_CASE(k_branch_smaller_or_equal_int_imm): {
+			QUARK_ASSERT(stack.check_reg_int(i._a));
+
+			//	Notice that pc will be incremented too, hence the - 1.
+			if(regs[i._a]._inplace._int64 <= i._b){ BC_BRANCH(i._c); }
+			BC_NEXT();
+		}
+		BC_CASE(k_branch_larger_int_imm): {
+			QUARK_ASSERT(stack.check_reg_int(i._a));
+
+			//	Notice that pc will be incremented too, hence the - 1.
+			if(regs[i._a]._inplace._int64 > i._b){ BC_BRANCH(i._c); }
+			BC_NEXT();
+		}
+		BC_CASE(k_branch_larger_or_equal_int_imm): {
+			QUARK_ASSERT(stack.check_reg_int(i._a));
+
+			//	Notice that pc will be incremented too, hence the - 1.
+			if(regs[i._a]._inplace._int64 >= i._b){ BC_BRANCH(i._c); }
+			BC_NEXT();
+		}
+		BC_CASE(k_branch_equal_int_imm): {
+			QUARK_ASSERT(stack.check_reg_int(i._a));
+
+			//	Notice that pc will be incremented too, hence the - 1.
+			if(regs[i._a]._inplace._int64 == i._b){ BC_BRANCH(i._c); }
+			BC_NEXT();
+		}
+		BC_CASE(k_branch_nonequal_int_imm): {
+			QUARK_ASSERT(stack.check_reg_int(i._a));
+
+			//	Notice that pc will be incremented too, hence the - 1.
+			if(regs[i._a]._inplace._int64 != i._b){ BC_BRANCH(i._c); }
+			BC_NEXT();
 		}
-		case bc_opcode::k_branch_always: {
+		BC_CASE(k_branch_always): {
 			//	Notice that pc will be incremented too, hence the - 1.
-			pc = pc + i._a - 1;
-			break;
+			BC_BRANCH(i._a);
+			BC_NEXT();
 		}
 
 
@@ -2789,42 +4086,41 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 
 
 		//??? Make obj/intern version.
-		case bc_opcode::k_get_struct_member: {
+		BC_CASE(k_get_struct_member): {
 			QUARK_ASSERT(vm.check_invariant());
 			QUARK_ASSERT(stack.check_reg_any(i._a));
 			QUARK_ASSERT(stack.check_reg_struct(i._b));
 
-			const auto& value_pod = regs[i._b]._external->_struct_members[i._c]._pod;
+			const auto& value_pod = regs[i._b]._external->get_struct_members()[i._c]._pod;
 			bool ext = frame_ptr->_exts[i._a];
 			if(ext){
 				release_pod_external(regs[i._a]);
-				value_pod._external->_rc++;
+				retain_external(value_pod._external);
 			}
 			regs[i._a] = value_pod;
 			QUARK_ASSERT(vm.check_invariant());
-			break;
+			BC_NEXT();
 		}
 
-		case bc_opcode::k_lookup_element_string: {
+		BC_CASE(k_lookup_element_string): {
 			QUARK_ASSERT(vm.check_invariant());
 			QUARK_ASSERT(stack.check_reg_int(i._a));
 			QUARK_ASSERT(stack.check_reg_string(i._b));
 			QUARK_ASSERT(stack.check_reg_int(i._c));
 
-			const auto& s = regs[i._b]._external->_string;
 			const auto lookup_index = regs[i._c]._inplace._int64;
-			if(lookup_index < 0 || lookup_index >= s.size()){
+			if(lookup_index < 0 || lookup_index >= get_pod_string_size(regs[i._b])){
 				quark::throw_runtime_error("Lookup in string: out of bounds.");
 			}
 			else{
-				regs[i._a]._inplace._int64 = s[lookup_index];
+				regs[i._a]._inplace._int64 = get_pod_string_char(regs[i._b], lookup_index);
 			}
 			QUARK_ASSERT(vm.check_invariant());
-			break;
+			BC_NEXT();
 		}
 
 		//	??? Simple JSON-values should not require ext. null, int, bool, empty object, empty array.
-		case bc_opcode::k_lookup_element_json_value: {
+		BC_CASE(k_lookup_element_json_value): {
 			QUARK_ASSERT(vm.check_invariant());
 			QUARK_ASSERT(stack.check_reg_json(i._a));
 			QUARK_ASSERT(stack.check_reg_json(i._b));
@@ -2832,12 +4128,13 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			// reg c points to different types depending on the runtime-type of the json_value.
 			QUARK_ASSERT(stack.check_reg_any(i._c));
 
-			const auto& parent_json_value = regs[i._b]._external->_json_value;
+			const auto& parent_json_value = regs[i._b]._external->get_json_value();
 
 			if(parent_json_value->is_object()){
 				QUARK_ASSERT(stack.check_reg_string(i._c));
 
-				const auto& lookup_key = regs[i._c]._external->_string;
+				std::string lookup_key_storage;
+				const auto& lookup_key = get_pod_string(regs[i._c], lookup_key_storage);
 
 				//	get_object_element() throws if key can't be found.
 				const auto& value = parent_json_value->get_object_element(lookup_key);
@@ -2845,7 +4142,7 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 				//??? no need to create full bc_value_t here! We only need pod.
 				const auto value2 = bc_value_t::make_json_value(value);
 
-				value2._pod._external->_rc++;
+				retain_external(value2._pod._external);
 				release_pod_external(regs[i._a]);
 				regs[i._a] = value2._pod;
 			}
@@ -2863,7 +4160,7 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 					//??? no need to create full bc_value_t here! We only need pod.
 					const auto value2 = bc_value_t::make_json_value(value);
 
-					value2._pod._external->_rc++;
+					retain_external(value2._pod._external);
 					release_pod_external(regs[i._a]);
 					regs[i._a] = value2._pod;
 				}
@@ -2872,36 +4169,36 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 				quark::throw_runtime_error("Lookup using [] on json_value only works on objects and arrays.");
 			}
 			QUARK_ASSERT(vm.check_invariant());
-			break;
+			BC_NEXT();
 		}
 
-		case bc_opcode::k_lookup_element_vector_w_external_elements: {
+		BC_CASE(k_lookup_element_vector_w_external_elements): {
 			QUARK_ASSERT(vm.check_invariant());
 			QUARK_ASSERT(stack.check_reg__external_value(i._a));
 			QUARK_ASSERT(stack.check_reg_vector_w_external_elements(i._b));
 			QUARK_ASSERT(stack.check_reg_int(i._c));
 
-			const auto& vec = regs[i._b]._external->_vector_w_external_elements;
+			const auto& vec = regs[i._b]._external->get_vector_w_external_elements();
 			const auto lookup_index = regs[i._c]._inplace._int64;
 			if(lookup_index < 0 || lookup_index >= vec.size()){
 				quark::throw_runtime_error("Lookup in vector: out of bounds.");
 			}
 			else{
 				auto handle = vec[lookup_index];
-				handle._external->_rc++;
+				retain_external(handle._external);
 				release_pod_external(regs[i._a]);
 				regs[i._a]._external = handle._external;
 			}
 			QUARK_ASSERT(vm.check_invariant());
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_lookup_element_vector_w_inplace_elements: {
+		BC_CASE(k_lookup_element_vector_w_inplace_elements): {
 			QUARK_ASSERT(vm.check_invariant());
 			QUARK_ASSERT(stack.check_reg_int(i._a));
 			QUARK_ASSERT(stack.check_reg_vector_w_inplace_elements(i._b));
 			QUARK_ASSERT(stack.check_reg_int(i._c));
 
-			const auto& vec = regs[i._b]._external->_vector_w_inplace_elements;
+			const auto& vec = regs[i._b]._external->get_vector_w_inplace_elements();
 			const auto lookup_index = regs[i._c]._inplace._int64;
 			if(lookup_index < 0 || lookup_index >= vec.size()){
 				quark::throw_runtime_error("Lookup in vector: out of bounds.");
@@ -2910,35 +4207,68 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 				regs[i._a]._inplace = vec[lookup_index];
 			}
 			QUARK_ASSERT(vm.check_invariant());
-			break;
+			BC_NEXT();
 		}
-
-		case bc_opcode::k_lookup_element_dict_w_external_values: {
+		BC_CASE(k_lookup_element_vector_w_external_elements_unchecked): {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg__external_value(i._a));
+			QUARK_ASSERT(stack.check_reg_vector_w_external_elements(i._b));
+			QUARK_ASSERT(stack.check_reg_int(i._c));
+
+			const auto& vec = regs[i._b]._external->get_vector_w_external_elements();
+			const auto lookup_index = regs[i._c]._inplace._int64;
+			QUARK_ASSERT(lookup_index >= 0 && static_cast<size_t>(lookup_index) < vec.size());
+
+			auto handle = vec[lookup_index];
+			retain_external(handle._external);
+			release_pod_external(regs[i._a]);
+			regs[i._a]._external = handle._external;
+			QUARK_ASSERT(vm.check_invariant());
+			BC_NEXT();
+		}
+		BC_CASE(k_lookup_element_vector_w_inplace_elements_unchecked): {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg_int(i._a));
+			QUARK_ASSERT(stack.check_reg_vector_w_inplace_elements(i._b));
+			QUARK_ASSERT(stack.check_reg_int(i._c));
+
+			const auto& vec = regs[i._b]._external->get_vector_w_inplace_elements();
+			const auto lookup_index = regs[i._c]._inplace._int64;
+			QUARK_ASSERT(lookup_index >= 0 && static_cast<size_t>(lookup_index) < vec.size());
+
+			regs[i._a]._inplace = vec[lookup_index];
+			QUARK_ASSERT(vm.check_invariant());
+			BC_NEXT();
+		}
+
+		BC_CASE(k_lookup_element_dict_w_external_values): {
 			QUARK_ASSERT(stack.check_reg__external_value(i._a));
 			QUARK_ASSERT(stack.check_reg_dict_w_external_values(i._b));
 			QUARK_ASSERT(stack.check_reg_string(i._c));
 
-			const auto& entries = regs[i._b]._external->_dict_w_external_values;
-			const auto& lookup_key = regs[i._c]._external->_string;
+			const auto& entries = regs[i._b]._external->get_dict_w_external_values();
+			std::string lookup_key_storage;
+			const auto& lookup_key = get_pod_string(regs[i._c], lookup_key_storage);
 			const auto found_ptr = entries.find(lookup_key);
 			if(found_ptr == nullptr){
 				quark::throw_runtime_error("Lookup in dict: key not found.");
 			}
 			else{
 				const auto& handle = *found_ptr;
-				handle._external->_rc++;
+				retain_external(handle._external);
 				release_pod_external(regs[i._a]);
 				regs[i._a]._external = handle._external;
 			}
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_lookup_element_dict_w_inplace_values: {
+		BC_CASE(k_lookup_element_dict_w_inplace_values): {
 			QUARK_ASSERT(stack.check_reg_any(i._a));
 			QUARK_ASSERT(stack.check_reg_dict_w_inplace_values(i._b));
 			QUARK_ASSERT(stack.check_reg_string(i._c));
 
-			const auto& entries = regs[i._b]._external->_dict_w_inplace_values;
-			const auto& lookup_key = regs[i._c]._external->_string;
+			const auto& entries = regs[i._b]._external->get_dict_w_inplace_values();
+			std::string lookup_key_storage;
+			const auto& lookup_key = get_pod_string(regs[i._c], lookup_key_storage);
 			const auto found_ptr = entries.find(lookup_key);
 			if(found_ptr == nullptr){
 				quark::throw_runtime_error("Lookup in dict: key not found.");
@@ -2946,71 +4276,71 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			else{
 				regs[i._a]._inplace = *found_ptr;
 			}
-			break;
+			BC_NEXT();
 		}
 
 
-		case bc_opcode::k_get_size_vector_w_external_elements: {
+		BC_CASE(k_get_size_vector_w_external_elements): {
 			QUARK_ASSERT(vm.check_invariant());
 			QUARK_ASSERT(stack.check_reg_int(i._a));
 			QUARK_ASSERT(stack.check_reg_vector_w_external_elements(i._b));
 			QUARK_ASSERT(i._c == 0);
 
-			regs[i._a]._inplace._int64 = regs[i._b]._external->_vector_w_external_elements.size();
+			regs[i._a]._inplace._int64 = regs[i._b]._external->get_vector_w_external_elements().size();
 			QUARK_ASSERT(vm.check_invariant());
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_get_size_vector_w_inplace_elements: {
+		BC_CASE(k_get_size_vector_w_inplace_elements): {
 			QUARK_ASSERT(vm.check_invariant());
 			QUARK_ASSERT(stack.check_reg_int(i._a));
 			QUARK_ASSERT(stack.check_reg_vector_w_inplace_elements(i._b));
 			QUARK_ASSERT(i._c == 0);
 
-			regs[i._a]._inplace._int64 = regs[i._b]._external->_vector_w_inplace_elements.size();
+			regs[i._a]._inplace._int64 = regs[i._b]._external->get_vector_w_inplace_elements().size();
 			QUARK_ASSERT(vm.check_invariant());
-			break;
+			BC_NEXT();
 		}
 
 
-		case bc_opcode::k_get_size_dict_w_external_values: {
+		BC_CASE(k_get_size_dict_w_external_values): {
 			QUARK_ASSERT(vm.check_invariant());
 			QUARK_ASSERT(stack.check_reg_int(i._a));
 			QUARK_ASSERT(stack.check_reg_dict_w_external_values(i._b));
 			QUARK_ASSERT(i._c == 0);
 
-			regs[i._a]._inplace._int64 = regs[i._b]._external->_dict_w_external_values.size();
+			regs[i._a]._inplace._int64 = regs[i._b]._external->get_dict_w_external_values().size();
 			QUARK_ASSERT(vm.check_invariant());
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_get_size_dict_w_inplace_values: {
+		BC_CASE(k_get_size_dict_w_inplace_values): {
 			QUARK_ASSERT(vm.check_invariant());
 			QUARK_ASSERT(stack.check_reg_int(i._a));
 			QUARK_ASSERT(stack.check_reg_dict_w_inplace_values(i._b));
 			QUARK_ASSERT(i._c == 0);
 
-			regs[i._a]._inplace._int64 = regs[i._b]._external->_dict_w_inplace_values.size();
+			regs[i._a]._inplace._int64 = regs[i._b]._external->get_dict_w_inplace_values().size();
 			QUARK_ASSERT(vm.check_invariant());
-			break;
+			BC_NEXT();
 		}
 
 
-		case bc_opcode::k_get_size_string: {
+		BC_CASE(k_get_size_string): {
 			QUARK_ASSERT(vm.check_invariant());
 			QUARK_ASSERT(stack.check_reg_int(i._a));
 			QUARK_ASSERT(stack.check_reg_string(i._b));
 			QUARK_ASSERT(i._c == 0);
 
-			regs[i._a]._inplace._int64 = regs[i._b]._external->_string.size();
+			regs[i._a]._inplace._int64 = get_pod_string_size(regs[i._b]);
 			QUARK_ASSERT(vm.check_invariant());
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_get_size_jsonvalue: {
+		BC_CASE(k_get_size_jsonvalue): {
 			QUARK_ASSERT(vm.check_invariant());
 			QUARK_ASSERT(stack.check_reg_int(i._a));
 			QUARK_ASSERT(stack.check_reg_json(i._b));
 			QUARK_ASSERT(i._c == 0);
 
-			const auto& json_value = *regs[i._b]._external->_json_value;
+			const auto& json_value = *regs[i._b]._external->get_json_value();
 			if(json_value.is_object()){
 				regs[i._a]._inplace._int64 = json_value.get_object_size();
 			}
@@ -3024,60 +4354,379 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 				quark::throw_runtime_error("Calling size() on unsupported type of value.");
 			}
 			QUARK_ASSERT(vm.check_invariant());
-			break;
+			BC_NEXT();
 		}
 
 
-		case bc_opcode::k_pushback_vector_w_external_elements: {
+		BC_CASE(k_pushback_vector_w_external_elements): {
 			QUARK_ASSERT(vm.check_invariant());
 			QUARK_ASSERT(stack.check_reg_vector_w_external_elements(i._a));
 			QUARK_ASSERT(stack.check_reg_vector_w_external_elements(i._b));
 			QUARK_ASSERT(stack.check_reg__external_value(i._c));
 
-			const auto& type = frame_ptr->_symbols[i._a].second._value_type;
-			const auto& element_type = type.get_vector_element_type();
-
-			auto elements2 = regs[i._b]._external->_vector_w_external_elements.push_back(bc_external_handle_t(regs[i._c]._external));
-			//??? always allocates a new bc_external_value_t!
-			const auto vec2 = make_vector(element_type, elements2);
-			vm._stack.write_register__external_value(i._a, vec2);
+			//	a = push_back(a, x) on the only reference: append in place, immer reuses its unshared nodes.
+			if(i._a == i._b && is_unique_external(regs[i._a])){
+				auto& vec = get_unique_external<bc_external_vector_w_external_elements_t>(regs[i._a]);
+				vec._elements = std::move(vec._elements).push_back(bc_external_handle_t(regs[i._c]._external));
+			}
+			else{
+				auto elements2 = regs[i._b]._external->get_vector_w_external_elements().push_back(bc_external_handle_t(regs[i._c]._external));
+				const auto vec2 = make_vector(frame_ptr->_symbol_types[i._a], elements2);
+				vm._stack.write_register__external_value(i._a, vec2);
+			}
 			QUARK_ASSERT(vm.check_invariant());
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_pushback_vector_w_inplace_elements: {
+		BC_CASE(k_pushback_vector_w_inplace_elements): {
 			QUARK_ASSERT(vm.check_invariant());
 			QUARK_ASSERT(stack.check_reg_vector_w_inplace_elements(i._a));
 			QUARK_ASSERT(stack.check_reg_vector_w_inplace_elements(i._b));
 			QUARK_ASSERT(stack.check_reg(i._c));
 
-			const auto& type = frame_ptr->_symbols[i._a].second._value_type;
-			const auto& element_type = type.get_vector_element_type();
+			if(i._a == i._b && is_unique_external(regs[i._a])){
+				auto& vec = get_unique_external<bc_external_vector_w_inplace_elements_t>(regs[i._a]);
+				vec._elements = std::move(vec._elements).push_back(regs[i._c]._inplace);
+			}
+			else{
+				auto elements2 = regs[i._b]._external->get_vector_w_inplace_elements().push_back(regs[i._c]._inplace);
+				const auto vec = make_vector(frame_ptr->_symbol_types[i._a], elements2);
+				vm._stack.write_register__external_value(i._a, vec);
+			}
+			QUARK_ASSERT(vm.check_invariant());
+			BC_NEXT();
+		}
+
+		BC_CASE(k_pushback_string): {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg_string(i._a));
+			QUARK_ASSERT(stack.check_reg_string(i._b));
+			QUARK_ASSERT(stack.check_reg_int(i._c));
+
+			const auto ch = static_cast<char>(regs[i._c]._inplace._int64);
+			const auto in_place = i._a == i._b && is_unique_external(regs[i._a]);
+			if(in_place && regs[i._a]._external->_kind == bc_external_kind::k_rope){
+				auto& chars = get_unique_external<bc_external_rope_t>(regs[i._a])._chars;
+				chars = std::move(chars).push_back(ch);
+			}
+			else if(in_place && get_pod_string_size(regs[i._a]) + 1 < k_rope_min_size){
+				get_unique_external<bc_external_string_t>(regs[i._a])._string.push_back(ch);
+			}
+			else{
+				//	Short results are inline and don't allocate.
+				const auto result = concat_pod_strings(regs[i._b], make_pod_string(&ch, 1));
+				release_pod_external(regs[i._a]);
+				regs[i._a] = result;
+			}
+			QUARK_ASSERT(vm.check_invariant());
+			BC_NEXT();
+		}
+
+
+		BC_CASE(k_find_string): {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg_int(i._a));
+			QUARK_ASSERT(stack.check_reg_string(i._b));
+			QUARK_ASSERT(stack.check_reg_string(i._c));
+
+			std::string str_storage;
+			std::string wanted_storage;
+			const auto r = get_pod_string(regs[i._b], str_storage).find(get_pod_string(regs[i._c], wanted_storage));
+			regs[i._a]._inplace._int64 = r == std::string::npos ? -1 : static_cast<int64_t>(r);
+			QUARK_ASSERT(vm.check_invariant());
+			BC_NEXT();
+		}
+		BC_CASE(k_find_vector_w_external_elements): {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg_int(i._a));
+			QUARK_ASSERT(stack.check_reg_vector_w_external_elements(i._b));
+			QUARK_ASSERT(stack.check_reg__external_value(i._c));
+
+			const auto element_type = lookup_bc_vector_element_type(frame_ptr->_symbol_types[i._b]);
+			const auto& vec = regs[i._b]._external->get_vector_w_external_elements();
+			const auto wanted = bc_external_handle_t(regs[i._c]._external);
+			const auto size = static_cast<int64_t>(vec.size());
+			int64_t index = 0;
+			while(index < size && bc_compare_value_exts(vec[index], wanted, element_type) != 0){
+				index++;
+			}
+			regs[i._a]._inplace._int64 = index == size ? -1 : index;
+			QUARK_ASSERT(vm.check_invariant());
+			BC_NEXT();
+		}
+		BC_CASE(k_find_vector_w_inplace_elements): {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg_int(i._a));
+			QUARK_ASSERT(stack.check_reg_vector_w_inplace_elements(i._b));
+			QUARK_ASSERT(stack.check_reg__inplace_value(i._c));
+
+			const auto& element_type = frame_ptr->_symbols[i._b].second._value_type.get_vector_element_type();
+			const auto& vec = regs[i._b]._external->get_vector_w_inplace_elements();
+			const auto wanted = regs[i._c]._inplace;
+			regs[i._a]._inplace._int64 = find_inplace_element(vec, wanted, element_type);
+			QUARK_ASSERT(vm.check_invariant());
+			BC_NEXT();
+		}
+
+
+		BC_CASE(k_exists_dict_w_external_values): {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_dict_w_external_values(i._b));
+			QUARK_ASSERT(stack.check_reg_string(i._c));
+
+			std::string key_storage;
+			const auto found_ptr = regs[i._b]._external->get_dict_w_external_values().find(get_pod_string(regs[i._c], key_storage));
+			regs[i._a]._inplace._bool = found_ptr != nullptr;
+			QUARK_ASSERT(vm.check_invariant());
+			BC_NEXT();
+		}
+		BC_CASE(k_exists_dict_w_inplace_values): {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_dict_w_inplace_values(i._b));
+			QUARK_ASSERT(stack.check_reg_string(i._c));
+
+			std::string key_storage;
+			const auto found_ptr = regs[i._b]._external->get_dict_w_inplace_values().find(get_pod_string(regs[i._c], key_storage));
+			regs[i._a]._inplace._bool = found_ptr != nullptr;
+			QUARK_ASSERT(vm.check_invariant());
+			BC_NEXT();
+		}
+
+
+		BC_CASE(k_erase_dict_w_external_values): {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg_dict_w_external_values(i._a));
+			QUARK_ASSERT(stack.check_reg_dict_w_external_values(i._b));
+			QUARK_ASSERT(stack.check_reg_string(i._c));
+
+			std::string key_storage;
+			const auto entries2 = regs[i._b]._external->get_dict_w_external_values().erase(get_pod_string(regs[i._c], key_storage));
+			const auto dict2 = make_dict(frame_ptr->_symbol_types[i._b], entries2);
+			vm._stack.write_register__external_value(i._a, dict2);
+			QUARK_ASSERT(vm.check_invariant());
+			BC_NEXT();
+		}
+		BC_CASE(k_erase_dict_w_inplace_values): {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg_dict_w_inplace_values(i._a));
+			QUARK_ASSERT(stack.check_reg_dict_w_inplace_values(i._b));
+			QUARK_ASSERT(stack.check_reg_string(i._c));
+
+			std::string key_storage;
+			const auto entries2 = regs[i._b]._external->get_dict_w_inplace_values().erase(get_pod_string(regs[i._c], key_storage));
+			const auto dict2 = make_dict(frame_ptr->_symbol_types[i._b], entries2);
+			vm._stack.write_register__external_value(i._a, dict2);
+			QUARK_ASSERT(vm.check_invariant());
+			BC_NEXT();
+		}
+
+
+		BC_CASE(k_subset_string): {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg_string(i._a));
+			QUARK_ASSERT(stack.check_reg_string(i._b));
+			QUARK_ASSERT(stack.check_reg_int(i._c));
+			QUARK_ASSERT(stack.check_reg_int(i._c + 1));
+
+			const auto size = get_pod_string_size(regs[i._b]);
+			const auto range = clamp_subrange(regs[i._c]._inplace._int64, regs[i._c + 1]._inplace._int64, size, "subset");
+			const auto result = subset_pod_string(regs[i._b], range.first, std::max(range.first, range.second));
+			release_pod_external(regs[i._a]);
+			regs[i._a] = result;
+			QUARK_ASSERT(vm.check_invariant());
+			BC_NEXT();
+		}
+		BC_CASE(k_subset_vector_w_external_elements): {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg_vector_w_external_elements(i._a));
+			QUARK_ASSERT(stack.check_reg_vector_w_external_elements(i._b));
+			QUARK_ASSERT(stack.check_reg_int(i._c));
+			QUARK_ASSERT(stack.check_reg_int(i._c + 1));
+
+			const auto& vec = regs[i._b]._external->get_vector_w_external_elements();
+			const auto range = clamp_subrange(regs[i._c]._inplace._int64, regs[i._c + 1]._inplace._int64, vec.size(), "subset");
+			bc_immer_vector_t<bc_external_handle_t> elements2;
+			for(auto index = range.first ; index < range.second ; index++){
+				elements2 = elements2.push_back(vec[index]);
+			}
+			vm._stack.write_register__external_value(i._a, make_vector(frame_ptr->_symbol_types[i._b], elements2));
+			QUARK_ASSERT(vm.check_invariant());
+			BC_NEXT();
+		}
+		BC_CASE(k_subset_vector_w_inplace_elements): {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg_vector_w_inplace_elements(i._a));
+			QUARK_ASSERT(stack.check_reg_vector_w_inplace_elements(i._b));
+			QUARK_ASSERT(stack.check_reg_int(i._c));
+			QUARK_ASSERT(stack.check_reg_int(i._c + 1));
 
-			//??? optimize - bypass bc_value_t
-			//??? always allocates a new bc_external_value_t!
-			auto elements2 = regs[i._b]._external->_vector_w_inplace_elements.push_back(regs[i._c]._inplace);
-			const auto vec = make_vector(element_type, elements2);
-			vm._stack.write_register__external_value(i._a, vec);
+			const auto& vec = regs[i._b]._external->get_vector_w_inplace_elements();
+			const auto range = clamp_subrange(regs[i._c]._inplace._int64, regs[i._c + 1]._inplace._int64, vec.size(), "subset");
+			bc_immer_vector_t<bc_inplace_value_t> elements2;
+			for(auto index = range.first ; index < range.second ; index++){
+				elements2 = elements2.push_back(vec[index]);
+			}
+			vm._stack.write_register__external_value(i._a, make_vector(frame_ptr->_symbol_types[i._b], elements2));
 			QUARK_ASSERT(vm.check_invariant());
-			break;
+			BC_NEXT();
 		}
 
-		case bc_opcode::k_pushback_string: {
+
+		BC_CASE(k_replace_string): {
 			QUARK_ASSERT(vm.check_invariant());
 			QUARK_ASSERT(stack.check_reg_string(i._a));
 			QUARK_ASSERT(stack.check_reg_string(i._b));
 			QUARK_ASSERT(stack.check_reg_int(i._c));
+			QUARK_ASSERT(stack.check_reg_int(i._c + 1));
+			QUARK_ASSERT(stack.check_reg_string(i._c + 2));
+
+			const auto size = get_pod_string_size(regs[i._b]);
+			const auto range = clamp_subrange(regs[i._c]._inplace._int64, regs[i._c + 1]._inplace._int64, size, "replace");
+			const auto result = replace_pod_string(regs[i._b], range.first, range.second, regs[i._c + 2]);
+			release_pod_external(regs[i._a]);
+			regs[i._a] = result;
+			QUARK_ASSERT(vm.check_invariant());
+			BC_NEXT();
+		}
+		BC_CASE(k_replace_vector_w_external_elements): {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg_vector_w_external_elements(i._a));
+			QUARK_ASSERT(stack.check_reg_vector_w_external_elements(i._b));
+			QUARK_ASSERT(stack.check_reg_int(i._c));
+			QUARK_ASSERT(stack.check_reg_int(i._c + 1));
+			QUARK_ASSERT(stack.check_reg_vector_w_external_elements(i._c + 2));
+
+			const auto& vec = regs[i._b]._external->get_vector_w_external_elements();
+			const auto range = clamp_subrange(regs[i._c]._inplace._int64, regs[i._c + 1]._inplace._int64, vec.size(), "replace");
+			const auto& new_bits = regs[i._c + 2]._external->get_vector_w_external_elements();
+			auto elements2 = bc_immer_vector_t<bc_external_handle_t>(vec.begin(), vec.begin() + range.first);
+			for(const auto& e: new_bits){
+				elements2 = elements2.push_back(e);
+			}
+			for(auto index = range.second ; index < vec.size() ; index++){
+				elements2 = elements2.push_back(vec[index]);
+			}
+			vm._stack.write_register__external_value(i._a, make_vector(frame_ptr->_symbol_types[i._b], elements2));
+			QUARK_ASSERT(vm.check_invariant());
+			BC_NEXT();
+		}
+		BC_CASE(k_replace_vector_w_inplace_elements): {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg_vector_w_inplace_elements(i._a));
+			QUARK_ASSERT(stack.check_reg_vector_w_inplace_elements(i._b));
+			QUARK_ASSERT(stack.check_reg_int(i._c));
+			QUARK_ASSERT(stack.check_reg_int(i._c + 1));
+			QUARK_ASSERT(stack.check_reg_vector_w_inplace_elements(i._c + 2));
+
+			const auto& vec = regs[i._b]._external->get_vector_w_inplace_elements();
+			const auto range = clamp_subrange(regs[i._c]._inplace._int64, regs[i._c + 1]._inplace._int64, vec.size(), "replace");
+			const auto& new_bits = regs[i._c + 2]._external->get_vector_w_inplace_elements();
+			auto elements2 = bc_immer_vector_t<bc_inplace_value_t>(vec.begin(), vec.begin() + range.first);
+			for(const auto& e: new_bits){
+				elements2 = elements2.push_back(e);
+			}
+			for(auto index = range.second ; index < vec.size() ; index++){
+				elements2 = elements2.push_back(vec[index]);
+			}
+			vm._stack.write_register__external_value(i._a, make_vector(frame_ptr->_symbol_types[i._b], elements2));
+			QUARK_ASSERT(vm.check_invariant());
+			BC_NEXT();
+		}
+
+
+		BC_CASE(k_update_vector_w_external_elements): {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg_vector_w_external_elements(i._a));
+			QUARK_ASSERT(stack.check_reg_vector_w_external_elements(i._b));
+			QUARK_ASSERT(stack.check_reg_int(i._c));
+			QUARK_ASSERT(stack.check_reg__external_value(i._c + 1));
+
+			const auto index = regs[i._c]._inplace._int64;
+			const auto& vec = regs[i._b]._external->get_vector_w_external_elements();
+			if(index < 0 || index >= static_cast<int64_t>(vec.size())){
+				quark::throw_runtime_error("Vector lookup out of bounds.");
+			}
+
+			//	a = update(a, i, x) on the only reference: immer reuses its unshared nodes.
+			if(i._a == i._b && is_unique_external(regs[i._a])){
+				auto& vec2 = get_unique_external<bc_external_vector_w_external_elements_t>(regs[i._a]);
+				vec2._elements = std::move(vec2._elements).set(index, bc_external_handle_t(regs[i._c + 1]._external));
+			}
+			else{
+				const auto elements2 = vec.set(index, bc_external_handle_t(regs[i._c + 1]._external));
+				vm._stack.write_register__external_value(i._a, make_vector(frame_ptr->_symbol_types[i._b], elements2));
+			}
+			QUARK_ASSERT(vm.check_invariant());
+			BC_NEXT();
+		}
+		BC_CASE(k_update_vector_w_inplace_elements): {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg_vector_w_inplace_elements(i._a));
+			QUARK_ASSERT(stack.check_reg_vector_w_inplace_elements(i._b));
+			QUARK_ASSERT(stack.check_reg_int(i._c));
+			QUARK_ASSERT(stack.check_reg(i._c + 1));
+
+			const auto index = regs[i._c]._inplace._int64;
+			const auto& vec = regs[i._b]._external->get_vector_w_inplace_elements();
+			if(index < 0 || index >= static_cast<int64_t>(vec.size())){
+				quark::throw_runtime_error("Vector lookup out of bounds.");
+			}
+
+			if(i._a == i._b && is_unique_external(regs[i._a])){
+				auto& vec2 = get_unique_external<bc_external_vector_w_inplace_elements_t>(regs[i._a]);
+				vec2._elements = std::move(vec2._elements).set(index, regs[i._c + 1]._inplace);
+			}
+			else{
+				const auto elements2 = vec.set(index, regs[i._c + 1]._inplace);
+				vm._stack.write_register__external_value(i._a, make_vector(frame_ptr->_symbol_types[i._b], elements2));
+			}
+			QUARK_ASSERT(vm.check_invariant());
+			BC_NEXT();
+		}
 
-			std::string str2 = regs[i._b]._external->_string;
-			const auto ch = regs[i._c]._inplace._int64;
-			str2.push_back(static_cast<char>(ch));
+		//	immer's map has no transients: set() still copies the path to the entry, but on the only reference
+		//	the dict is changed in place instead of allocating a new external value.
+		BC_CASE(k_update_dict_w_external_values): {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg_dict_w_external_values(i._a));
+			QUARK_ASSERT(stack.check_reg_dict_w_external_values(i._b));
+			QUARK_ASSERT(stack.check_reg_string(i._c));
+			QUARK_ASSERT(stack.check_reg__external_value(i._c + 1));
+
+			std::string key_storage;
+			const auto& key = get_pod_string(regs[i._c], key_storage);
+			const auto value = bc_external_handle_t(regs[i._c + 1]._external);
+			if(i._a == i._b && is_unique_external(regs[i._a])){
+				auto& dict = get_unique_external<bc_external_dict_w_external_values_t>(regs[i._a]);
+				dict._entries = dict._entries.set(key, value);
+			}
+			else{
+				const auto entries2 = regs[i._b]._external->get_dict_w_external_values().set(key, value);
+				vm._stack.write_register__external_value(i._a, make_dict(frame_ptr->_symbol_types[i._b], entries2));
+			}
+			QUARK_ASSERT(vm.check_invariant());
+			BC_NEXT();
+		}
+		BC_CASE(k_update_dict_w_inplace_values): {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg_dict_w_inplace_values(i._a));
+			QUARK_ASSERT(stack.check_reg_dict_w_inplace_values(i._b));
+			QUARK_ASSERT(stack.check_reg_string(i._c));
+			QUARK_ASSERT(stack.check_reg(i._c + 1));
 
-			//??? optimize - bypass bc_value_t
-			//??? always allocates a new bc_external_value_t!
-			const auto str3 = bc_value_t::make_string(str2);
-			vm._stack.write_register__external_value(i._a, str3);
+			std::string key_storage;
+			const auto& key = get_pod_string(regs[i._c], key_storage);
+			if(i._a == i._b && is_unique_external(regs[i._a])){
+				auto& dict = get_unique_external<bc_external_dict_w_inplace_values_t>(regs[i._a]);
+				dict._entries = dict._entries.set(key, regs[i._c + 1]._inplace);
+			}
+			else{
+				const auto entries2 = regs[i._b]._external->get_dict_w_inplace_values().set(key, regs[i._c + 1]._inplace);
+				vm._stack.write_register__external_value(i._a, make_dict(frame_ptr->_symbol_types[i._b], entries2));
+			}
 			QUARK_ASSERT(vm.check_invariant());
-			break;
+			BC_NEXT();
 		}
 
 
@@ -3086,7 +4735,7 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 		*/
 
 		//	Notice: host calls and floyd calls have the same type -- we cannot detect host calls until we have a callee value.
-		case bc_opcode::k_call: {
+		BC_CASE(k_call): {
 			QUARK_ASSERT(vm.check_invariant());
 			QUARK_ASSERT(stack.check_reg_function(i._b));
 
@@ -3103,33 +4752,26 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 
 			QUARK_ASSERT(function_def._args.size() == callee_arg_count);
 
+			auto& callee_profile = profiles[function_id];
+			if(jit != nullptr && ++callee_profile._call_count == tier_up_calls){
+				tier_up(vm, callee_profile);
+			}
+			if(count_steps && function_def._host_function_id == 0){
+				count_step(vm);
+			}
+
 			if(function_def._host_function_id != 0){
 				const auto& host_function = vm._imm->_host_functions.at(function_def._host_function_id);
 
+				//	Notice that dynamic functions will have each DYN argument with a leading itype as an extra argument.
 				const int arg0_stack_pos = stack.size() - (function_def_dynamic_arg_count + callee_arg_count);
-				int stack_pos = arg0_stack_pos;
+				const auto host_args = bc_host_args_t{ &stack._entries[arg0_stack_pos], &function_def, &vm._imm->_program._types, &vm._imm->_interned_types, nullptr, callee_arg_count };
 
-				//	Notice that dynamic functions will have each DYN argument with a leading itype as an extra argument.
-				const auto function_def_arg_count = function_def._args.size();
-				std::vector<bc_value_t> arg_values;
-				for(int a = 0 ; a < function_def_arg_count ; a++){
-					const auto& func_arg_type = function_def._args[a]._type;
-					if(func_arg_type.is_internal_dynamic()){
-						const auto arg_itype = stack.load_intq(stack_pos);
-						const auto& arg_type = lookup_full_type(vm, static_cast<int16_t>(arg_itype));
-						const auto arg_value = stack.load_value(stack_pos + 1, arg_type);
-						arg_values.push_back(arg_value);
-						stack_pos += k_frame_overhead;
-					}
-					else{
-						const auto arg_value = stack.load_value(stack_pos + 0, func_arg_type);
-						arg_values.push_back(arg_value);
-						stack_pos++;
-					}
-				}
+				const auto& bc_result = call_host_function(vm, host_function, host_args);
 
-				const auto& result = (host_function)(vm, &arg_values[0], static_cast<int>(arg_values.size()));
-				const auto bc_result = result;
+				//	Host function may have called Floyd functions, which can have grown (moved) the stack.
+				regs = stack._current_frame_entry_ptr;
+				globals = &stack._entries[k_frame_overhead];
 
 				if(function_return_type.is_void() == true){
 				}
@@ -3140,39 +4782,114 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 					stack.write_register(i._a, bc_result);
 				}
 			}
-			else{
+			else if(
+				vm._memo._caches[function_id] != nullptr
+				&& memo_lookup_call(vm, function_id, stack.size() - callee_arg_count, callee_arg_count, i._a)
+			){
+				//	Cached, the result is already in our register.
+			}
+			else if(jit != nullptr && jit->_functions[function_id] != nullptr){
 				QUARK_ASSERT(function_def_dynamic_arg_count == 0);
 
-				//	We need to remember the global pos where to store return value, since we're switching frame to call function.
-				int result_reg_pos = static_cast<int>(stack._current_frame_entry_ptr - &stack._entries[0]) + i._a;
-
+				//	Run the native code on the callee's frame, then leave the stack like k_return does.
+				const int result_pos = static_cast<int>(stack._current_frame_entry_ptr - &stack._entries[0]) + i._a;
 				stack.open_frame(*function_def._frame_ptr, callee_arg_count);
-				const auto& result = execute_instructions(vm, function_def._frame_ptr->_instructions);
+				bc_pod_value_t result_pod;
+				result_pod._inplace._int64 = jit->_functions[function_id](stack._current_frame_entry_ptr, &stack._entries[k_frame_overhead]);
 				stack.close_frame(*function_def._frame_ptr);
+				if(function_return_type.is_void() == false){
+					stack._entries[result_pos] = result_pod;
+				}
+				if(vm._memo._caches[function_id] != nullptr){
+					memo_store(vm, static_cast<int>(vm._memo._pending.size()) - 1, bc_value_t(function_def._return_type, result_pod));
+				}
 
-				//	Update our cached pointers.
+				//	open_frame() can have grown (moved) the stack.
 				frame_ptr = stack._current_frame_ptr;
 				regs = stack._current_frame_entry_ptr;
+				globals = &stack._entries[k_frame_overhead];
+			}
+			else{
+				QUARK_ASSERT(function_def_dynamic_arg_count == 0);
 
-				if(function_return_type.is_void() == false){
+				//	We need to remember the global pos where to store return value, since we're switching frame to call function.
+				const int result_pos = function_return_type.is_void()
+					? -1
+					: static_cast<int>(stack._current_frame_entry_ptr - &stack._entries[0]) + i._a;
+				const int memo_pending = vm._memo._caches[function_id] != nullptr ? static_cast<int>(vm._memo._pending.size()) - 1 : -1;
+				stack._call_records.push_back(bc_call_record_t{ code, pc, result_pos, profile, memo_pending });
+				profile = &callee_profile;
 
-					//	Cannot store via register, we have not yet executed k_pop_frame_ptr that restores our frame.
-					if(function_def._return_is_ext){
-						stack.replace_external_value(result_reg_pos, result.second);
-					}
-					else{
-						stack.replace_inplace_value(result_reg_pos, result.second);
-					}
-				}
+				stack.open_frame(*function_def._frame_ptr, callee_arg_count);
+
+				//	Continue executing in the callee. Its k_return / k_stop brings us back to pc + 1.
+				//	open_frame() can have grown (moved) the stack.
+				frame_ptr = stack._current_frame_ptr;
+				regs = stack._current_frame_entry_ptr;
+				globals = &stack._entries[k_frame_overhead];
+				code = &function_def._frame_ptr->_instructions;
+				pc = -1;
 			}
 
 			QUARK_ASSERT(frame_ptr == stack._current_frame_ptr);
 			QUARK_ASSERT(regs == stack._current_frame_entry_ptr);
 			QUARK_ASSERT(vm.check_invariant());
-			break;
+			BC_NEXT();
 		}
 
-		case bc_opcode::k_new_1: {
+		BC_CASE(k_tail_call): {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg_function(i._a));
+
+			const int function_id = regs[i._a]._inplace._function_id;
+			const int arg_count = i._b;
+			QUARK_ASSERT(function_id >= 0 && function_id < static_cast<int>(vm._imm->_program._function_defs.size()));
+
+			const auto& function_def = vm._imm->_program._function_defs[function_id];
+			QUARK_ASSERT(function_def._host_function_id == 0 && function_def._dyn_arg_count == 0);
+			QUARK_ASSERT(static_cast<int>(function_def._args.size()) == arg_count && static_cast<int>(frame_ptr->_args.size()) == arg_count);
+
+			//	Stack holds our arguments, our locals, then the callee's arguments. Drop ours and slide the callee's down.
+			const int frame_pos = static_cast<int>(regs - &stack._entries[0]);
+			const int new_args_pos = stack._stack_size - arg_count;
+			QUARK_ASSERT(new_args_pos == frame_pos + static_cast<int>(frame_ptr->_symbols.size()));
+
+			for(const auto index: frame_ptr->_locals_ext_indexes){
+				release_pod_external(regs[arg_count + index]);
+			}
+			for(const auto index: frame_ptr->_args_ext_indexes){
+				release_pod_external(regs[index]);
+			}
+			if(arg_count > 0){
+				std::memmove(regs, &stack._entries[new_args_pos], sizeof(bc_pod_value_t) * arg_count);
+			}
+			stack._stack_size = frame_pos + arg_count;
+#if DEBUG
+			std::copy(stack._debug_types.begin() + new_args_pos, stack._debug_types.end(), stack._debug_types.begin() + frame_pos);
+			stack._debug_types.erase(stack._debug_types.begin() + frame_pos + arg_count, stack._debug_types.end());
+#endif
+
+			profile = &profiles[function_id];
+			if(jit != nullptr && ++profile->_call_count == tier_up_calls){
+				tier_up(vm, *profile);
+			}
+			if(count_steps){
+				count_step(vm);
+			}
+
+			//	Same position, so call records and the caller's result register are still valid.
+			stack.open_frame(*function_def._frame_ptr, arg_count);
+			frame_ptr = stack._current_frame_ptr;
+			regs = stack._current_frame_entry_ptr;
+			globals = &stack._entries[k_frame_overhead];
+			code = &function_def._frame_ptr->_instructions;
+			pc = -1;
+
+			QUARK_ASSERT(vm.check_invariant());
+			BC_NEXT();
+		}
+
+		BC_CASE(k_new_1): {
 			QUARK_ASSERT(stack.check_reg(i._a));
 
 			const auto dest_reg = i._a;
@@ -3181,10 +4898,10 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			const auto& target_type = lookup_full_type(vm, target_itype);
 			QUARK_ASSERT(target_type.is_vector() == false && target_type.is_dict() == false && target_type.is_struct() == false);
 			execute_new_1(vm, dest_reg, target_itype, source_itype);
-			break;
+			BC_NEXT();
 		}
 
-		case bc_opcode::k_new_vector_w_external_elements: {
+		BC_CASE(k_new_vector_w_external_elements): {
 			QUARK_ASSERT(stack.check_reg_vector_w_external_elements(i._a));
 			QUARK_ASSERT(i._b >= 0);
 			QUARK_ASSERT(i._c >= 0);
@@ -3197,10 +4914,10 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			QUARK_ASSERT(encode_as_vector_w_inplace_elements(vector_type) == false);
 
 			execute_new_vector_obj(vm, dest_reg, target_itype, arg_count);
-			break;
+			BC_NEXT();
 		}
 
-		case bc_opcode::k_new_vector_w_inplace_elements: {
+		BC_CASE(k_new_vector_w_inplace_elements): {
 			QUARK_ASSERT(vm.check_invariant());
 			QUARK_ASSERT(stack.check_reg_vector_w_inplace_elements(i._a));
 			QUARK_ASSERT(i._b == 0);
@@ -3210,55 +4927,52 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			const auto arg_count = i._c;
 
 			const int arg0_stack_pos = vm._stack.size() - arg_count;
-			immer::vector<bc_inplace_value_t> elements2;
+			bc_immer_vector_t<bc_inplace_value_t> elements2;
 			for(int a = 0 ; a < arg_count ; a++){
 				const auto pos = arg0_stack_pos + a;
 				elements2 = elements2.push_back(stack._entries[pos]._inplace);
 			}
 
-			const auto& type = frame_ptr->_symbols[i._a].second._value_type;
-			const auto& element_type = type.get_vector_element_type();
-
-			const auto result = make_vector(element_type, elements2);
+			const auto result = make_vector(frame_ptr->_symbol_types[i._a], elements2);
 			vm._stack.write_register__external_value(dest_reg, result);
 
 			QUARK_ASSERT(vm.check_invariant());
-			break;
+			BC_NEXT();
 		}
 
-		case bc_opcode::k_new_dict_w_external_values: {
+		BC_CASE(k_new_dict_w_external_values): {
 			const auto dest_reg = i._a;
 			const auto target_itype = i._b;
 			const auto arg_count = i._c;
 			const auto& target_type = lookup_full_type(vm, target_itype);
 			QUARK_ASSERT(target_type.is_dict());
 			execute_new_dict_obj(vm, dest_reg, target_itype, arg_count);
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_new_dict_w_inplace_values: {
+		BC_CASE(k_new_dict_w_inplace_values): {
 			const auto dest_reg = i._a;
 			const auto target_itype = i._b;
 			const auto arg_count = i._c;
 			const auto& target_type = lookup_full_type(vm, target_itype);
 			QUARK_ASSERT(target_type.is_dict());
 			execute_new_dict_pod64(vm, dest_reg, target_itype, arg_count);
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_new_struct: {
+		BC_CASE(k_new_struct): {
 			const auto dest_reg = i._a;
 			const auto target_itype = i._b;
 			const auto arg_count = i._c;
 			const auto& target_type = lookup_full_type(vm, target_itype);
 			QUARK_ASSERT(target_type.is_struct());
 			execute_new_struct(vm, dest_reg, target_itype, arg_count);
-			break;
+			BC_NEXT();
 		}
 
 
 		//////////////////////////////		COMPARISON
 
 
-		case bc_opcode::k_comparison_smaller_or_equal: {
+		BC_CASE(k_comparison_smaller_or_equal): {
 			QUARK_ASSERT(stack.check_reg_bool(i._a));
 			QUARK_ASSERT(stack.check_reg_any(i._b));
 			QUARK_ASSERT(stack.check_reg_any(i._c));
@@ -3271,18 +4985,18 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			long diff = bc_compare_value_true_deep(left, right, type);
 
 			regs[i._a]._inplace._bool = diff <= 0;
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_comparison_smaller_or_equal_int: {
+		BC_CASE(k_comparison_smaller_or_equal_int): {
 			QUARK_ASSERT(stack.check_reg_bool(i._a));
 			QUARK_ASSERT(stack.check_reg_int(i._b));
 			QUARK_ASSERT(stack.check_reg_int(i._c));
 
 			regs[i._a]._inplace._bool = regs[i._b]._inplace._int64 <= regs[i._c]._inplace._int64;
-			break;
+			BC_NEXT();
 		}
 
-		case bc_opcode::k_comparison_smaller: {
+		BC_CASE(k_comparison_smaller): {
 			QUARK_ASSERT(stack.check_reg_bool(i._a));
 			QUARK_ASSERT(stack.check_reg_any(i._b));
 			QUARK_ASSERT(stack.check_reg_any(i._c));
@@ -3294,17 +5008,17 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			long diff = bc_compare_value_true_deep(left, right, type);
 
 			regs[i._a]._inplace._bool = diff < 0;
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_comparison_smaller_int:
+		BC_CASE(k_comparison_smaller_int):
 			QUARK_ASSERT(stack.check_reg_bool(i._a));
 			QUARK_ASSERT(stack.check_reg_int(i._b));
 			QUARK_ASSERT(stack.check_reg_int(i._c));
 
 			regs[i._a]._inplace._bool = regs[i._b]._inplace._int64 < regs[i._c]._inplace._int64;
-			break;
+			BC_NEXT();
 
-		case bc_opcode::k_logical_equal: {
+		BC_CASE(k_logical_equal): {
 			QUARK_ASSERT(stack.check_reg_bool(i._a));
 			QUARK_ASSERT(stack.check_reg_any(i._b));
 			QUARK_ASSERT(stack.check_reg_any(i._c));
@@ -3316,18 +5030,18 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			long diff = bc_compare_value_true_deep(left, right, type);
 
 			regs[i._a]._inplace._bool = diff == 0;
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_logical_equal_int: {
+		BC_CASE(k_logical_equal_int): {
 			QUARK_ASSERT(stack.check_reg_bool(i._a));
 			QUARK_ASSERT(stack.check_reg_int(i._b));
 			QUARK_ASSERT(stack.check_reg_int(i._c));
 
 			regs[i._a]._inplace._bool = regs[i._b]._inplace._int64 == regs[i._c]._inplace._int64;
-			break;
+			BC_NEXT();
 		}
 
-		case bc_opcode::k_logical_nonequal: {
+		BC_CASE(k_logical_nonequal): {
 			QUARK_ASSERT(stack.check_reg_bool(i._a));
 			QUARK_ASSERT(stack.check_reg_any(i._b));
 			QUARK_ASSERT(stack.check_reg_any(i._c));
@@ -3339,15 +5053,157 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			long diff = bc_compare_value_true_deep(left, right, type);
 
 			regs[i._a]._inplace._bool = diff != 0;
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_logical_nonequal_int: {
+		BC_CASE(k_logical_nonequal_int): {
 			QUARK_ASSERT(stack.check_reg_bool(i._a));
 			QUARK_ASSERT(stack.check_reg_int(i._b));
 			QUARK_ASSERT(stack.check_reg_int(i._c));
 
 			regs[i._a]._inplace._bool = regs[i._b]._inplace._int64 != regs[i._c]._inplace._int64;
-			break;
+			BC_NEXT();
+		}
+
+		BC_CASE(k_comparison_smaller_or_equal_double): {
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_double(i._b));
+			QUARK_ASSERT(stack.check_reg_double(i._c));
+
+			regs[i._a]._inplace._bool = compare_doubles(regs[i._b]._inplace, regs[i._c]._inplace) <= 0;
+			BC_NEXT();
+		}
+		BC_CASE(k_comparison_smaller_double): {
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_double(i._b));
+			QUARK_ASSERT(stack.check_reg_double(i._c));
+
+			regs[i._a]._inplace._bool = compare_doubles(regs[i._b]._inplace, regs[i._c]._inplace) < 0;
+			BC_NEXT();
+		}
+		BC_CASE(k_logical_equal_double): {
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_double(i._b));
+			QUARK_ASSERT(stack.check_reg_double(i._c));
+
+			regs[i._a]._inplace._bool = compare_doubles(regs[i._b]._inplace, regs[i._c]._inplace) == 0;
+			BC_NEXT();
+		}
+		BC_CASE(k_logical_nonequal_double): {
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_double(i._b));
+			QUARK_ASSERT(stack.check_reg_double(i._c));
+
+			regs[i._a]._inplace._bool = compare_doubles(regs[i._b]._inplace, regs[i._c]._inplace) != 0;
+			BC_NEXT();
+		}
+
+		BC_CASE(k_comparison_smaller_or_equal_string): {
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_string(i._b));
+			QUARK_ASSERT(stack.check_reg_string(i._c));
+
+			regs[i._a]._inplace._bool = bc_compare_pod_strings(regs[i._b], regs[i._c]) <= 0;
+			BC_NEXT();
+		}
+		BC_CASE(k_comparison_smaller_string): {
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_string(i._b));
+			QUARK_ASSERT(stack.check_reg_string(i._c));
+
+			regs[i._a]._inplace._bool = bc_compare_pod_strings(regs[i._b], regs[i._c]) < 0;
+			BC_NEXT();
+		}
+		BC_CASE(k_logical_equal_string): {
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_string(i._b));
+			QUARK_ASSERT(stack.check_reg_string(i._c));
+
+			regs[i._a]._inplace._bool = bc_equal_pod_strings(regs[i._b], regs[i._c]);
+			BC_NEXT();
+		}
+		BC_CASE(k_logical_nonequal_string): {
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_string(i._b));
+			QUARK_ASSERT(stack.check_reg_string(i._c));
+
+			regs[i._a]._inplace._bool = bc_equal_pod_strings(regs[i._b], regs[i._c]) == false;
+			BC_NEXT();
+		}
+
+		BC_CASE(k_comparison_smaller_or_equal_bool): {
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_bool(i._b));
+			QUARK_ASSERT(stack.check_reg_bool(i._c));
+
+			regs[i._a]._inplace._bool = compare_bools(regs[i._b]._inplace, regs[i._c]._inplace) <= 0;
+			BC_NEXT();
+		}
+		BC_CASE(k_comparison_smaller_bool): {
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_bool(i._b));
+			QUARK_ASSERT(stack.check_reg_bool(i._c));
+
+			regs[i._a]._inplace._bool = compare_bools(regs[i._b]._inplace, regs[i._c]._inplace) < 0;
+			BC_NEXT();
+		}
+		BC_CASE(k_logical_equal_bool): {
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_bool(i._b));
+			QUARK_ASSERT(stack.check_reg_bool(i._c));
+
+			regs[i._a]._inplace._bool = compare_bools(regs[i._b]._inplace, regs[i._c]._inplace) == 0;
+			BC_NEXT();
+		}
+		BC_CASE(k_logical_nonequal_bool): {
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_bool(i._b));
+			QUARK_ASSERT(stack.check_reg_bool(i._c));
+
+			regs[i._a]._inplace._bool = compare_bools(regs[i._b]._inplace, regs[i._c]._inplace) != 0;
+			BC_NEXT();
+		}
+
+		BC_CASE(k_comparison_smaller_int_imm): {
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_int(i._b));
+
+			regs[i._a]._inplace._bool = regs[i._b]._inplace._int64 < i._c;
+			BC_NEXT();
+		}
+		BC_CASE(k_comparison_smaller_or_equal_int_imm): {
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_int(i._b));
+
+			regs[i._a]._inplace._bool = regs[i._b]._inplace._int64 <= i._c;
+			BC_NEXT();
+		}
+		BC_CASE(k_comparison_larger_int_imm): {
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_int(i._b));
+
+			regs[i._a]._inplace._bool = regs[i._b]._inplace._int64 > i._c;
+			BC_NEXT();
+		}
+		BC_CASE(k_comparison_larger_or_equal_int_imm): {
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_int(i._b));
+
+			regs[i._a]._inplace._bool = regs[i._b]._inplace._int64 >= i._c;
+			BC_NEXT();
+		}
+		BC_CASE(k_logical_equal_int_imm): {
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_int(i._b));
+
+			regs[i._a]._inplace._bool = regs[i._b]._inplace._int64 == i._c;
+			BC_NEXT();
+		}
+		BC_CASE(k_logical_nonequal_int_imm): {
+			QUARK_ASSERT(stack.check_reg_bool(i._a));
+			QUARK_ASSERT(stack.check_reg_int(i._b));
+
+			regs[i._a]._inplace._bool = regs[i._b]._inplace._int64 != i._c;
+			BC_NEXT();
 		}
 
 
@@ -3355,119 +5211,157 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 
 
 		//??? Replace by a | b opcode.
-		case bc_opcode::k_add_bool: {
+		BC_CASE(k_add_bool): {
 			QUARK_ASSERT(stack.check_reg_bool(i._a));
 			QUARK_ASSERT(stack.check_reg_bool(i._b));
 			QUARK_ASSERT(stack.check_reg_bool(i._c));
 
 			regs[i._a]._inplace._bool = regs[i._b]._inplace._bool + regs[i._c]._inplace._bool;
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_add_int: {
+		BC_CASE(k_add_int): {
 			QUARK_ASSERT(stack.check_reg_int(i._a));
 			QUARK_ASSERT(stack.check_reg_int(i._b));
 			QUARK_ASSERT(stack.check_reg_int(i._c));
 
 			regs[i._a]._inplace._int64 = regs[i._b]._inplace._int64 + regs[i._c]._inplace._int64;
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_add_double: {
+		BC_CASE(k_add_double): {
 			QUARK_ASSERT(stack.check_reg_double(i._a));
 			QUARK_ASSERT(stack.check_reg_double(i._b));
 			QUARK_ASSERT(stack.check_reg_double(i._c));
 
 			regs[i._a]._inplace._double = regs[i._b]._inplace._double + regs[i._c]._inplace._double;
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_concat_strings: {
+		BC_CASE(k_concat_strings): {
 			QUARK_ASSERT(stack.check_reg_string(i._a));
 			QUARK_ASSERT(stack.check_reg_string(i._b));
 			QUARK_ASSERT(stack.check_reg_string(i._c));
 
-			//	??? No need to create bc_value_t here.
-			const auto s = regs[i._b]._external->_string + regs[i._c]._external->_string;
-			const auto value = bc_value_t::make_string(s);
-			auto prev_copy = regs[i._a];
-			value._pod._external->_rc++;
-			regs[i._a] = value._pod;
-			release_pod_external(prev_copy);
-			break;
+			//	s = s + x on the only reference: append in place.
+			const auto right_size = get_pod_string_size(regs[i._c]);
+			const auto in_place = i._a == i._b && i._a != i._c && is_unique_external(regs[i._a]);
+			if(in_place && regs[i._a]._external->_kind == bc_external_kind::k_rope){
+				auto& chars = get_unique_external<bc_external_rope_t>(regs[i._a])._chars;
+
+				//	Pushing a few characters is cheaper than joining trees.
+				if(right_size <= k_inline_string_max_size){
+					for(std::size_t index = 0 ; index < right_size ; index++){
+						chars = std::move(chars).push_back(get_pod_string_char(regs[i._c], index));
+					}
+				}
+				else{
+					chars = std::move(chars) + get_pod_string_chars(regs[i._c]);
+				}
+				BC_NEXT();
+			}
+			else if(in_place && get_pod_string_size(regs[i._a]) + right_size < k_rope_min_size){
+				std::string right_storage;
+				get_unique_external<bc_external_string_t>(regs[i._a])._string.append(get_pod_string(regs[i._c], right_storage));
+				BC_NEXT();
+			}
+
+			//	Short results are inline and don't allocate.
+			const auto result = concat_pod_strings(regs[i._b], regs[i._c]);
+			release_pod_external(regs[i._a]);
+			regs[i._a] = result;
+			BC_NEXT();
 		}
 
-		case bc_opcode::k_concat_vectors_w_external_elements: {
+		BC_CASE(k_concat_vectors_w_external_elements): {
 			QUARK_ASSERT(stack.check_reg_vector_w_external_elements(i._a));
 			QUARK_ASSERT(stack.check_reg_vector_w_external_elements(i._b));
 			QUARK_ASSERT(stack.check_reg_vector_w_external_elements(i._c));
 
 			const auto& vector_type = frame_ptr->_symbols[i._a].second._value_type;
-			const auto& element_type = vector_type.get_vector_element_type();
 			QUARK_ASSERT(encode_as_vector_w_inplace_elements(vector_type) == false);
 
-			//	Copy left into new vector.
-			immer::vector<bc_external_handle_t> elements2 = regs[i._b]._external->_vector_w_external_elements;
+			const auto& right_elements = regs[i._c]._external->get_vector_w_external_elements();
 
-			const auto& right_elements = regs[i._c]._external->_vector_w_external_elements;
-			for(const auto& e: right_elements){
-				elements2 = elements2.push_back(e);
+			//	v = v + x on the only reference: append to v in place.
+			if(i._a == i._b && i._a != i._c && is_unique_external(regs[i._a])){
+				auto& vec = get_unique_external<bc_external_vector_w_external_elements_t>(regs[i._a]);
+				auto elements2 = std::move(vec._elements).transient();
+				for(const auto& e: right_elements){
+					elements2.push_back(e);
+				}
+				vec._elements = elements2.persistent();
+			}
+			else{
+				auto elements2 = regs[i._b]._external->get_vector_w_external_elements().transient();
+				for(const auto& e: right_elements){
+					elements2.push_back(e);
+				}
+				const auto& value2 = make_vector(frame_ptr->_symbol_types[i._a], elements2.persistent());
+				stack.write_register__external_value(i._a, value2);
 			}
-			const auto& value2 = make_vector(element_type, elements2);
-			stack.write_register__external_value(i._a, value2);
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_concat_vectors_w_inplace_elements: {
+		BC_CASE(k_concat_vectors_w_inplace_elements): {
 			QUARK_ASSERT(stack.check_reg_vector_w_inplace_elements(i._a));
 			QUARK_ASSERT(stack.check_reg_vector_w_inplace_elements(i._b));
 			QUARK_ASSERT(stack.check_reg_vector_w_inplace_elements(i._c));
 
 			const auto& vector_type = frame_ptr->_symbols[i._a].second._value_type;
-			const auto& element_type = vector_type.get_vector_element_type();
 			QUARK_ASSERT(encode_as_vector_w_inplace_elements(vector_type) == true);
 
-			//	Copy left into new vector.
-			auto elements2 = regs[i._b]._external->_vector_w_inplace_elements;
+			const auto& right_elements = regs[i._c]._external->get_vector_w_inplace_elements();
 
-			const auto& right_elements = regs[i._c]._external->_vector_w_inplace_elements;
-			for(const auto& e: right_elements){
-				elements2 = elements2.push_back(e);
+			//	v = v + x on the only reference: append to v in place.
+			if(i._a == i._b && i._a != i._c && is_unique_external(regs[i._a])){
+				auto& vec = get_unique_external<bc_external_vector_w_inplace_elements_t>(regs[i._a]);
+				auto elements2 = std::move(vec._elements).transient();
+				for(const auto& e: right_elements){
+					elements2.push_back(e);
+				}
+				vec._elements = elements2.persistent();
 			}
-			const auto& value2 = make_vector(element_type, elements2);
-			stack.write_register__external_value(i._a, value2);
-			break;
+			else{
+				auto elements2 = regs[i._b]._external->get_vector_w_inplace_elements().transient();
+				for(const auto& e: right_elements){
+					elements2.push_back(e);
+				}
+				const auto& value2 = make_vector(frame_ptr->_symbol_types[i._a], elements2.persistent());
+				stack.write_register__external_value(i._a, value2);
+			}
+			BC_NEXT();
 		}
 
-		case bc_opcode::k_subtract_double: {
+		BC_CASE(k_subtract_double): {
 			QUARK_ASSERT(stack.check_reg_double(i._a));
 			QUARK_ASSERT(stack.check_reg_double(i._b));
 			QUARK_ASSERT(stack.check_reg_double(i._c));
 
 			regs[i._a]._inplace._double = regs[i._b]._inplace._double - regs[i._c]._inplace._double;
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_subtract_int: {
+		BC_CASE(k_subtract_int): {
 			QUARK_ASSERT(stack.check_reg_int(i._a));
 			QUARK_ASSERT(stack.check_reg_int(i._b));
 			QUARK_ASSERT(stack.check_reg_int(i._c));
 
 			regs[i._a]._inplace._int64 = regs[i._b]._inplace._int64 - regs[i._c]._inplace._int64;
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_multiply_double: {
+		BC_CASE(k_multiply_double): {
 			QUARK_ASSERT(stack.check_reg_double(i._a));
 			QUARK_ASSERT(stack.check_reg_double(i._c));
 			QUARK_ASSERT(stack.check_reg_double(i._c));
 
 			regs[i._a]._inplace._double = regs[i._b]._inplace._double * regs[i._c]._inplace._double;
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_multiply_int: {
+		BC_CASE(k_multiply_int): {
 			QUARK_ASSERT(stack.check_reg_int(i._a));
 			QUARK_ASSERT(stack.check_reg_int(i._c));
 			QUARK_ASSERT(stack.check_reg_int(i._c));
 
 			regs[i._a]._inplace._int64 = regs[i._b]._inplace._int64 * regs[i._c]._inplace._int64;
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_divide_double: {
+		BC_CASE(k_divide_double): {
 			QUARK_ASSERT(stack.check_reg_double(i._a));
 			QUARK_ASSERT(stack.check_reg_double(i._b));
 			QUARK_ASSERT(stack.check_reg_double(i._c));
@@ -3477,9 +5371,9 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 				quark::throw_runtime_error("EEE_DIVIDE_BY_ZERO");
 			}
 			regs[i._a]._inplace._double = regs[i._b]._inplace._double / right;
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_divide_int: {
+		BC_CASE(k_divide_int): {
 			QUARK_ASSERT(stack.check_reg_int(i._a));
 			QUARK_ASSERT(stack.check_reg_int(i._b));
 			QUARK_ASSERT(stack.check_reg_int(i._c));
@@ -3489,9 +5383,9 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 				quark::throw_runtime_error("EEE_DIVIDE_BY_ZERO");
 			}
 			regs[i._a]._inplace._int64 = regs[i._b]._inplace._int64 / right;
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_remainder_int: {
+		BC_CASE(k_remainder_int): {
 			QUARK_ASSERT(stack.check_reg_int(i._a));
 			QUARK_ASSERT(stack.check_reg_int(i._b));
 			QUARK_ASSERT(stack.check_reg_int(i._c));
@@ -3501,58 +5395,114 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 				quark::throw_runtime_error("EEE_DIVIDE_BY_ZERO");
 			}
 			regs[i._a]._inplace._int64 = regs[i._b]._inplace._int64 % right;
-			break;
+			BC_NEXT();
 		}
 
 
-		case bc_opcode::k_logical_and_bool: {
+		BC_CASE(k_logical_and_bool): {
 			QUARK_ASSERT(stack.check_reg_bool(i._a));
 			QUARK_ASSERT(stack.check_reg_bool(i._b));
 			QUARK_ASSERT(stack.check_reg_bool(i._c));
 
 			regs[i._a]._inplace._bool = regs[i._b]._inplace._bool  && regs[i._c]._inplace._bool;
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_logical_and_int: {
+		BC_CASE(k_logical_and_int): {
 			QUARK_ASSERT(stack.check_reg_bool(i._a));
 			QUARK_ASSERT(stack.check_reg_int(i._b));
 			QUARK_ASSERT(stack.check_reg_int(i._c));
 
 			regs[i._a]._inplace._bool = (regs[i._b]._inplace._int64 != 0) && (regs[i._c]._inplace._int64 != 0);
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_logical_and_double: {
+		BC_CASE(k_logical_and_double): {
 			QUARK_ASSERT(stack.check_reg_bool(i._a));
 			QUARK_ASSERT(stack.check_reg_double(i._b));
 			QUARK_ASSERT(stack.check_reg_double(i._c));
 
 			regs[i._a]._inplace._bool = (regs[i._b]._inplace._double != 0) && (regs[i._c]._inplace._double != 0);
-			break;
+			BC_NEXT();
 		}
 
-		case bc_opcode::k_logical_or_bool: {
+		BC_CASE(k_logical_or_bool): {
 			QUARK_ASSERT(stack.check_reg_bool(i._a));
 			QUARK_ASSERT(stack.check_reg_bool(i._b));
 			QUARK_ASSERT(stack.check_reg_bool(i._c));
 
 			regs[i._a]._inplace._bool = regs[i._b]._inplace._bool || regs[i._c]._inplace._bool;
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_logical_or_int: {
+		BC_CASE(k_logical_or_int): {
 			QUARK_ASSERT(stack.check_reg_bool(i._a));
 			QUARK_ASSERT(stack.check_reg_int(i._b));
 			QUARK_ASSERT(stack.check_reg_int(i._c));
 
 			regs[i._a]._inplace._bool = (regs[i._b]._inplace._int64 != 0) || (regs[i._c]._inplace._int64 != 0);
-			break;
+			BC_NEXT();
 		}
-		case bc_opcode::k_logical_or_double: {
+		BC_CASE(k_logical_or_double): {
 			QUARK_ASSERT(stack.check_reg_bool(i._a));
 			QUARK_ASSERT(stack.check_reg_double(i._b));
 			QUARK_ASSERT(stack.check_reg_double(i._c));
 
 			regs[i._a]._inplace._bool = (regs[i._b]._inplace._double != 0.0f) || (regs[i._c]._inplace._double != 0.0f);
-			break;
+			BC_NEXT();
+		}
+
+
+		BC_CASE(k_add_int_imm): {
+			QUARK_ASSERT(stack.check_reg_int(i._a));
+			QUARK_ASSERT(stack.check_reg_int(i._b));
+
+			regs[i._a]._inplace._int64 = regs[i._b]._inplace._int64 + i._c;
+			BC_NEXT();
+		}
+		BC_CASE(k_subtract_int_imm): {
+			QUARK_ASSERT(stack.check_reg_int(i._a));
+			QUARK_ASSERT(stack.check_reg_int(i._b));
+
+			regs[i._a]._inplace._int64 = regs[i._b]._inplace._int64 - i._c;
+			BC_NEXT();
+		}
+		BC_CASE(k_multiply_int_imm): {
+			QUARK_ASSERT(stack.check_reg_int(i._a));
+			QUARK_ASSERT(stack.check_reg_int(i._b));
+
+			regs[i._a]._inplace._int64 = regs[i._b]._inplace._int64 * i._c;
+			BC_NEXT();
+		}
+		BC_CASE(k_add_double_const): {
+			QUARK_ASSERT(stack.check_reg_double(i._a));
+			QUARK_ASSERT(stack.check_reg_double(i._b));
+			QUARK_ASSERT(i._c >= 0 && static_cast<size_t>(i._c) < vm._imm->_program._double_constants.size());
+
+			regs[i._a]._inplace._double = regs[i._b]._inplace._double + double_constants[i._c];
+			BC_NEXT();
+		}
+		BC_CASE(k_subtract_double_const): {
+			QUARK_ASSERT(stack.check_reg_double(i._a));
+			QUARK_ASSERT(stack.check_reg_double(i._b));
+			QUARK_ASSERT(i._c >= 0 && static_cast<size_t>(i._c) < vm._imm->_program._double_constants.size());
+
+			regs[i._a]._inplace._double = regs[i._b]._inplace._double - double_constants[i._c];
+			BC_NEXT();
+		}
+		BC_CASE(k_multiply_double_const): {
+			QUARK_ASSERT(stack.check_reg_double(i._a));
+			QUARK_ASSERT(stack.check_reg_double(i._b));
+			QUARK_ASSERT(i._c >= 0 && static_cast<size_t>(i._c) < vm._imm->_program._double_constants.size());
+
+			regs[i._a]._inplace._double = regs[i._b]._inplace._double * double_constants[i._c];
+			BC_NEXT();
+		}
+		BC_CASE(k_divide_double_const): {
+			QUARK_ASSERT(stack.check_reg_double(i._a));
+			QUARK_ASSERT(stack.check_reg_double(i._b));
+			QUARK_ASSERT(i._c >= 0 && static_cast<size_t>(i._c) < vm._imm->_program._double_constants.size());
+			QUARK_ASSERT(double_constants[i._c] != 0.0);
+
+			regs[i._a]._inplace._double = regs[i._b]._inplace._double / double_constants[i._c];
+			BC_NEXT();
 		}
 
 
@@ -3560,6 +5510,9 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 
 
 		default:
+#if FLOYD_BC_THREADED_DISPATCH
+		op_unknown_opcode:
+#endif
 			QUARK_ASSERT(false);
 			quark::throw_exception();
 		}
@@ -3568,6 +5521,10 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 	return { false, bc_value_t::make_undefined() };
 }
 
+#undef BC_CASE
+#undef BC_NEXT
+#undef BC_DISPATCH_DECODED
+
 
 //////////////////////////////////////////		FUNCTIONS
 
@@ -3589,7 +5546,7 @@ std::shared_ptr<value_entry_t> find_global_symbol2(const interpreter_t& vm, cons
 		QUARK_ASSERT(pos >= 0 && pos < vm._stack.size());
 
 		const auto value_entry = value_entry_t{
-			vm._stack.load_value(pos, it->second._value_type),
+			vm._stack.load_value(pos, vm._imm->_program._globals._symbol_types[index]),
 			it->first,
 			it->second,
 			static_cast<int>(index)
@@ -3625,7 +5582,7 @@ std::vector<json_t> bc_symbols_to_json(const std::vector<std::pair<std::string,
 		const auto& symbol = e.second;
 		const auto symbol_type_str = symbol._symbol_type == bc_symbol_t::immutable_local ? "immutable_local" : "mutable_local";
 
-		if(symbol._const_value._type.is_undefined() == false){
+		if(symbol._const_value.get_type().is_undefined() == false){
 			const auto e2 = json_t::make_array({
 				symbol_index,
 				e.first,
@@ -3720,7 +5677,14 @@ json_t bcprogram_to_json(const bc_program_t& program){
 	return json_t::make_object({
 		{ "globals", frame_to_json(program._globals) },
 		{ "types", types_to_json(program._types) },
-		{ "function_defs", json_t::make_array(function_defs) }
+		{ "function_defs", json_t::make_array(function_defs) },
+		{ "peephole", json_t::make_object({
+			{ "instruction_count_before", json_t(program._peephole_stats._instruction_count_before) },
+			{ "instruction_count_after", json_t(program._peephole_stats._instruction_count_after) },
+			{ "register_count_before", json_t(program._peephole_stats._register_count_before) },
+			{ "register_count_after", json_t(program._peephole_stats._register_count_after) },
+			{ "hoisted_count", json_t(program._peephole_stats._hoisted_count) }
+		}) }
 //		{ "callstack", json_t::make_array(callstack) }
 	});
 }
@@ -17,7 +17,6 @@
 
 
 
-??? remove usage of typeid_t. Use itype & types[]?
 ??? All functions should be the same type of function-values: host-functions and Floyd functions: _host_function_id should be in the VALUE not function definition!
 ??? Less code + faster to generate increc, decref instructions instead of make *_external_value, *_internal_value opcodes.
 */
@@ -25,13 +24,17 @@
 #include "ast_typeid.h"
 #include "json_support.h"
 #include "software_system.h"
+#include "bytecode_heap.h"
 #include "quark.h"
 
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <atomic>
 #include <chrono>
+#include <cstring>
+#include <exception>
 #include "immer/vector.hpp"
 #include "immer/map.hpp"
 
@@ -46,10 +49,15 @@ struct bc_value_t;
 union bc_pod_value_t;
 struct bc_external_value_t;
 struct bc_external_handle_t;
+struct bc_host_args_t;
+struct bc_jit_t;
 
 
 typedef bc_value_t (*HOST_FUNCTION_PTR)(interpreter_t& vm, const bc_value_t args[], int arg_count);
-typedef int16_t bc_typeid_t;
+
+//	Zero-allocation host calling convention: the arguments are a view straight onto the interpreter stack.
+typedef bc_value_t (*HOST_FUNCTION_FAST_PTR)(interpreter_t& vm, const bc_host_args_t& args);
+typedef int32_t bc_typeid_t;
 
 
 //////////////////////////////////////		bc_inplace_value_t
@@ -76,11 +84,78 @@ union bc_inplace_value_t {
 union bc_pod_value_t {
 	const bc_external_value_t* _external;
 	bc_inplace_value_t _inplace;
+
+	//	Short strings, see "inline strings" below.
+	char _inline_string[8];
 };
 
 void release_pod_external(bc_pod_value_t& value);
 
 
+//////////////////////////////////////		inline strings
+
+/*
+	A string of up to k_inline_string_max_size bytes is kept inside its bc_pod_value_t instead of in a heap object:
+	_inline_string[0] holds (size << 1) | 1, then come the characters and the unused bytes are 0.
+	External values are at least 8-byte aligned so the lowest bit of a real _external pointer is always 0. On our
+	little-endian CPUs that bit is the lowest bit of _inline_string[0], which tells the two apart.
+
+	A string that fits is always stored inline, so two string pods with the same bits hold the same string.
+	Inline strings are not reference counted: retain_external() and release_pod_external() skip them.
+*/
+
+const std::size_t k_inline_string_max_size = 7;
+
+inline bool is_inline_string(const bc_external_value_t* ext){
+	return (reinterpret_cast<std::uintptr_t>(ext) & 1) != 0;
+}
+
+inline bool is_inline_string(const bc_pod_value_t& value){
+	return is_inline_string(value._external);
+}
+
+//	Inline if it fits, else a new bc_external_string_t or bc_external_rope_t with _rc 1 that the caller owns.
+bc_pod_value_t make_pod_string(const char s[], std::size_t size);
+
+//	Returns the string. Inline strings are copied to storage -- they fit in std::string's own buffer, so it doesn't allocate.
+//	Ropes are flattened into storage, which is O(n).
+const std::string& get_pod_string(const bc_pod_value_t& value, std::string& storage);
+
+std::size_t get_pod_string_size(const bc_pod_value_t& value);
+
+//	Walks ropes chunk by chunk instead of flattening them. Every representation of a string hashes the same.
+std::size_t hash_pod_string(const bc_pod_value_t& value);
+
+
+//////////////////////////////////////		rope strings
+
+/*
+	A string of k_rope_min_size bytes or more is a bc_external_rope_t: its characters live in an immer flex_vector, in
+	chunks of a few hundred bytes. Versions share chunks, so concatenating, taking a subset, replacing a range or
+	changing a character is O(log n) instead of copying the whole string. Reading one character is O(log n).
+
+	A string between the inline size and k_rope_min_size is a flat bc_external_string_t. Which one a string uses only
+	depends on its size, so a flat string never equals a rope.
+
+	The functions below return a new pod with _rc 1 that the caller owns, using the representation that fits the
+	result's size.
+*/
+
+const std::size_t k_rope_min_size = 1024;
+
+char get_pod_string_char(const bc_pod_value_t& value, std::size_t index);
+
+//	Characters [0, start) of value, then new_bits, then [end, size) of value.
+bc_pod_value_t replace_pod_string(const bc_pod_value_t& value, std::size_t start, std::size_t end, const bc_pod_value_t& new_bits);
+
+bc_pod_value_t concat_pod_strings(const bc_pod_value_t& left, const bc_pod_value_t& right);
+
+//	Characters [start, end) of value.
+bc_pod_value_t subset_pod_string(const bc_pod_value_t& value, std::size_t start, std::size_t end);
+
+bc_pod_value_t update_pod_string_char(const bc_pod_value_t& value, std::size_t index, char ch);
+
+
 //////////////////////////////////////		value_encoding
 
 //	Tells how a specific type of value needs to be store in the interpreter.
@@ -115,12 +190,60 @@ bool encode_as_external(value_encoding encoding);
 bool encode_as_external(const typeid_t& type);
 
 
+//////////////////////////////////////		bc_typeid_t interning
+
+/*
+	Runtime values keep their type as a bc_typeid_t: an index into one process-wide, append-only table of typeid_t:s.
+	Copying a value then never touches the shared_ptr inside typeid_t.
+
+	The types without parts -- undefined, dynamic, void, bool, int, double, string, json and typeid -- have fixed ids,
+	the same number as their base_type. Other types get the next free id the first time they are interned.
+	Ids are never reused, so values can move between programs and interpreters. Looking up an id never locks.
+
+	Interning builds a string key and takes a lock: do it when loading a program, not while executing. The
+	interpreter uses bc_static_frame_t::_symbol_types and interpreter_imm_t::_interned_types, and the parts of a
+	composite type are interned together with it, see lookup_bc_vector_element_type() etc.
+*/
+
+const bc_typeid_t k_bc_typeid_undefined = static_cast<bc_typeid_t>(base_type::k_internal_undefined);
+const bc_typeid_t k_bc_typeid_void = static_cast<bc_typeid_t>(base_type::k_void);
+const bc_typeid_t k_bc_typeid_bool = static_cast<bc_typeid_t>(base_type::k_bool);
+const bc_typeid_t k_bc_typeid_int = static_cast<bc_typeid_t>(base_type::k_int);
+const bc_typeid_t k_bc_typeid_double = static_cast<bc_typeid_t>(base_type::k_double);
+const bc_typeid_t k_bc_typeid_string = static_cast<bc_typeid_t>(base_type::k_string);
+const bc_typeid_t k_bc_typeid_json_value = static_cast<bc_typeid_t>(base_type::k_json_value);
+const bc_typeid_t k_bc_typeid_typeid = static_cast<bc_typeid_t>(base_type::k_typeid);
+
+bc_typeid_t intern_bc_type(const typeid_t& type);
+std::vector<bc_typeid_t> intern_bc_types(const std::vector<typeid_t>& types);
+const typeid_t& lookup_bc_type(bc_typeid_t type);
+
+//	The interned type of each member of a struct type.
+const std::vector<bc_typeid_t>& lookup_bc_struct_member_types(bc_typeid_t struct_type);
+
+//	The interned element type of a vector type / value type of a dict type.
+bc_typeid_t lookup_bc_vector_element_type(bc_typeid_t vector_type);
+bc_typeid_t lookup_bc_dict_value_type(bc_typeid_t dict_type);
+
+//	Same as encode_as_external(lookup_bc_type(type)), but cached.
+bool is_bc_type_external_slow(bc_typeid_t type);
+inline bool is_bc_type_external(bc_typeid_t type){
+	if(type <= k_bc_typeid_typeid){
+		return type >= k_bc_typeid_string;
+	}
+	else{
+		return is_bc_type_external_slow(type);
+	}
+}
+
+
 //////////////////////////////////////		bc_value_t
 
 /*
 	Efficent representation of any value supported by the interpreter.
 	It's immutable and uses value-semantics.
 	Holds either and inplace value or an external value. Handles reference counting automatically when required.
+	16 bytes: the interned type + the pod.
 	??? replace my variant<>
 */
 
@@ -171,6 +294,9 @@ struct bc_value_t {
 
 	//////////////////////////////////////		string
 	public: static bc_value_t make_string(const std::string& v);
+
+	//	Takes over the caller's reference, like the one returned by concat_pod_strings().
+	public: static bc_value_t adopt_string(const bc_pod_value_t& owned_string);
 	public: std::string get_string_value() const;
 	private: explicit bc_value_t(const std::string& value);
 
@@ -189,8 +315,9 @@ struct bc_value_t {
 
 	//////////////////////////////////////		struct
 	public: static bc_value_t make_struct_value(const typeid_t& struct_type, const std::vector<bc_value_t>& values);
+	public: static bc_value_t make_struct_value(bc_typeid_t struct_type, const std::vector<bc_value_t>& values);
 	public: const std::vector<bc_value_t>& get_struct_value() const;
-	private: explicit bc_value_t(const typeid_t& struct_type, const std::vector<bc_value_t>& values, bool struct_tag);
+	private: explicit bc_value_t(bc_typeid_t struct_type, const std::vector<bc_value_t>& values, bool struct_tag);
 
 
 	//////////////////////////////////////		function
@@ -200,18 +327,22 @@ struct bc_value_t {
 
 
 	//	Bumps RC if needed.
-	public: explicit bc_value_t(const typeid_t& type, const bc_pod_value_t& internals);
+	public: explicit bc_value_t(bc_typeid_t type, const bc_pod_value_t& internals);
 
 	//	Won't bump RC.
-	public: bc_value_t(const typeid_t& type, const bc_inplace_value_t& pod64);
+	public: bc_value_t(bc_typeid_t type, const bc_inplace_value_t& pod64);
 
 	//	Bumps RC.
-	public: explicit bc_value_t(const typeid_t& type, const bc_external_handle_t& handle);
+	public: explicit bc_value_t(bc_typeid_t type, const bc_external_handle_t& handle);
+
+	public: inline const typeid_t& get_type() const {
+		return lookup_bc_type(_typeid);
+	}
 
 
 	//////////////////////////////////////		STATE
 	//??? make private, also check other classes.
-	public: typeid_t _type;
+	public: bc_typeid_t _typeid;
 	public: bc_pod_value_t _pod;
 };
 
@@ -237,6 +368,7 @@ struct bc_external_handle_t {
 
 	//////////////////////////////////////		STATE
 	//	Uses intrusive reference counting, that's why this isn't just a shared_ptr<>
+	//	Can also be an inline string, see is_inline_string().
 	public: const bc_external_value_t* _external;
 };
 
@@ -250,62 +382,201 @@ bool check_external_deep(const typeid_t& type, const bc_external_value_t* ext);
 	This object contains the internals of values too big to be stored inplace inside bc_value_t / bc_pod_value_t.
 	The bc_external_value_t:s are allocated on the heap and are reference counted.
 
-	TODO: Right now wastes resouces by containing *all* types of external values! Should use std::variant.
+	bc_external_value_t is only the header: the reference count and a tag telling which kind of object it is.
+	Each kind is its own struct, deriving from the header and holding only the data for that kind.
+	There is no vtable -- delete_external_value() switches on the tag. Use the get_*() accessors to read the data.
+
+	Values are immutable, with one exception: an instruction that holds the only reference to an external value and
+	writes its result back to the same register may change the value in place, see is_unique_external().
 */
 
+enum class bc_external_kind : uint8_t {
+	k_string,
+	k_rope,
+	k_json_value,
+	k_typeid,
+	k_struct,
+	k_vector_w_inplace_elements,
+	k_vector_w_external_elements,
+	k_dict_w_inplace_values,
+	k_dict_w_external_values
+};
+
 struct bc_external_value_t {
-	public: bc_external_value_t(const std::string& s);
-	public: bc_external_value_t(const std::shared_ptr<json_t>& s);
-	public: bc_external_value_t(const typeid_t& s);
-	public: bc_external_value_t(const typeid_t& type, const std::vector<bc_value_t>& s, bool struct_tag);
-	public: bc_external_value_t(const typeid_t& type, const immer::vector<bc_external_handle_t>& s);
-	public: bc_external_value_t(const typeid_t& type, const immer::vector<bc_inplace_value_t>& s);
-	public: bc_external_value_t(const typeid_t& type, const immer::map<std::string, bc_external_handle_t>& s);
-	public: bc_external_value_t(const typeid_t& type, const immer::map<std::string, bc_inplace_value_t>& s);
+	protected: bc_external_value_t(bc_external_kind kind, const typeid_t& debug_type);
+	public: bc_external_value_t(const bc_external_value_t& other) = delete;
+	public: bc_external_value_t& operator=(const bc_external_value_t& other) = delete;
 
 #if DEBUG
 	public: bool check_invariant() const;
 #endif
-	public: bool operator==(const bc_external_value_t& other) const;
+
+	public: const std::string& get_string() const;
+	public: const bc_immer_flex_vector_t<char>& get_rope() const;
+	public: const std::shared_ptr<json_t>& get_json_value() const;
+	public: const typeid_t& get_typeid_value() const;
+	public: const std::vector<bc_value_t>& get_struct_members() const;
+	public: const bc_immer_vector_t<bc_external_handle_t>& get_vector_w_external_elements() const;
+	public: const bc_immer_vector_t<bc_inplace_value_t>& get_vector_w_inplace_elements() const;
+	public: const bc_immer_map_t<std::string, bc_external_handle_t>& get_dict_w_external_values() const;
+	public: const bc_immer_map_t<std::string, bc_inplace_value_t>& get_dict_w_inplace_values() const;
+
+	//	External values come from the pooled heap, see bytecode_heap.h.
+	public: static void* operator new(std::size_t size){
+		return bc_heap_allocate(size);
+	}
+	public: static void operator delete(void* data, std::size_t size){
+		bc_heap_deallocate(size, data);
+	}
 
 
 	//////////////////////////////////////		STATE
 	public: mutable std::atomic<int> _rc;
+	public: const bc_external_kind _kind;
 #if DEBUG
 	public: bool _debug__is_unwritten_external_value = false;
 #endif
 #if DEBUG
 	public: typeid_t _debug_type;
 #endif
+};
+
+//	Deletes the object as its real kind. Call when _rc reaches 0.
+void delete_external_value(const bc_external_value_t* ext);
+
+//	Counts one more reference to the external value, unless it's an inline string.
+inline void retain_external(const bc_external_value_t* ext){
+	if(is_inline_string(ext) == false){
+		ext->_rc++;
+	}
+}
+
+//	True if value is the only reference to its external value. Nobody else can then observe a change to it.
+inline bool is_unique_external(const bc_pod_value_t& value){
+	return is_inline_string(value) == false && value._external->_rc == 1;
+}
+
+//	The object behind a unique external value, for changing it in place.
+template <typename T>
+T& get_unique_external(const bc_pod_value_t& value){
+	QUARK_ASSERT(is_unique_external(value));
+	return *const_cast<T*>(static_cast<const T*>(value._external));
+}
+
+
+struct bc_external_string_t : public bc_external_value_t {
+	public: explicit bc_external_string_t(const std::string& s);
+
 	public: std::string _string;
-	public: std::shared_ptr<json_t> _json_value;
-	public: typeid_t _typeid_value = typeid_t::make_undefined();
-	public: std::vector<bc_value_t> _struct_members;
-	public: immer::vector<bc_external_handle_t> _vector_w_external_elements;
-	public: immer::vector<bc_inplace_value_t> _vector_w_inplace_elements;
-	public: immer::map<std::string, bc_external_handle_t> _dict_w_external_values;
-	public: immer::map<std::string, bc_inplace_value_t> _dict_w_inplace_values;
 };
 
+struct bc_external_rope_t : public bc_external_value_t {
+	public: explicit bc_external_rope_t(const bc_immer_flex_vector_t<char>& chars);
+
+	public: bc_immer_flex_vector_t<char> _chars;
+};
+
+struct bc_external_json_value_t : public bc_external_value_t {
+	public: explicit bc_external_json_value_t(const std::shared_ptr<json_t>& s);
+
+	public: const std::shared_ptr<json_t> _json_value;
+};
+
+struct bc_external_typeid_t : public bc_external_value_t {
+	public: explicit bc_external_typeid_t(const typeid_t& s);
+
+	public: const typeid_t _typeid_value;
+};
+
+struct bc_external_struct_t : public bc_external_value_t {
+	public: bc_external_struct_t(const typeid_t& type, const std::vector<bc_value_t>& s);
+
+	public: const std::vector<bc_value_t> _struct_members;
+};
+
+struct bc_external_vector_w_external_elements_t : public bc_external_value_t {
+	public: bc_external_vector_w_external_elements_t(const typeid_t& type, const bc_immer_vector_t<bc_external_handle_t>& s);
+
+	public: bc_immer_vector_t<bc_external_handle_t> _elements;
+};
+
+struct bc_external_vector_w_inplace_elements_t : public bc_external_value_t {
+	public: bc_external_vector_w_inplace_elements_t(const typeid_t& type, const bc_immer_vector_t<bc_inplace_value_t>& s);
+
+	public: bc_immer_vector_t<bc_inplace_value_t> _elements;
+};
+
+struct bc_external_dict_w_external_values_t : public bc_external_value_t {
+	public: bc_external_dict_w_external_values_t(const typeid_t& type, const bc_immer_map_t<std::string, bc_external_handle_t>& s);
+
+	public: bc_immer_map_t<std::string, bc_external_handle_t> _entries;
+};
+
+struct bc_external_dict_w_inplace_values_t : public bc_external_value_t {
+	public: bc_external_dict_w_inplace_values_t(const typeid_t& type, const bc_immer_map_t<std::string, bc_inplace_value_t>& s);
+
+	public: bc_immer_map_t<std::string, bc_inplace_value_t> _entries;
+};
+
+
+inline const std::string& bc_external_value_t::get_string() const {
+	QUARK_ASSERT(_kind == bc_external_kind::k_string);
+	return static_cast<const bc_external_string_t*>(this)->_string;
+}
+inline const bc_immer_flex_vector_t<char>& bc_external_value_t::get_rope() const {
+	QUARK_ASSERT(_kind == bc_external_kind::k_rope);
+	return static_cast<const bc_external_rope_t*>(this)->_chars;
+}
+inline const std::shared_ptr<json_t>& bc_external_value_t::get_json_value() const {
+	QUARK_ASSERT(_kind == bc_external_kind::k_json_value);
+	return static_cast<const bc_external_json_value_t*>(this)->_json_value;
+}
+inline const typeid_t& bc_external_value_t::get_typeid_value() const {
+	QUARK_ASSERT(_kind == bc_external_kind::k_typeid);
+	return static_cast<const bc_external_typeid_t*>(this)->_typeid_value;
+}
+inline const std::vector<bc_value_t>& bc_external_value_t::get_struct_members() const {
+	QUARK_ASSERT(_kind == bc_external_kind::k_struct);
+	return static_cast<const bc_external_struct_t*>(this)->_struct_members;
+}
+inline const bc_immer_vector_t<bc_external_handle_t>& bc_external_value_t::get_vector_w_external_elements() const {
+	QUARK_ASSERT(_kind == bc_external_kind::k_vector_w_external_elements);
+	return static_cast<const bc_external_vector_w_external_elements_t*>(this)->_elements;
+}
+inline const bc_immer_vector_t<bc_inplace_value_t>& bc_external_value_t::get_vector_w_inplace_elements() const {
+	QUARK_ASSERT(_kind == bc_external_kind::k_vector_w_inplace_elements);
+	return static_cast<const bc_external_vector_w_inplace_elements_t*>(this)->_elements;
+}
+inline const bc_immer_map_t<std::string, bc_external_handle_t>& bc_external_value_t::get_dict_w_external_values() const {
+	QUARK_ASSERT(_kind == bc_external_kind::k_dict_w_external_values);
+	return static_cast<const bc_external_dict_w_external_values_t*>(this)->_entries;
+}
+inline const bc_immer_map_t<std::string, bc_inplace_value_t>& bc_external_value_t::get_dict_w_inplace_values() const {
+	QUARK_ASSERT(_kind == bc_external_kind::k_dict_w_inplace_values);
+	return static_cast<const bc_external_dict_w_inplace_values_t*>(this)->_entries;
+}
+
 
 ////////////////////////////////////////////			FREE
 
 
 const immer::vector<bc_value_t> get_vector(const bc_value_t& value);
-const immer::vector<bc_external_handle_t>* get_vector_external_elements(const bc_value_t& value);
-const immer::vector<bc_inplace_value_t>* get_vector_inplace_elements(const bc_value_t& value);
+const bc_immer_vector_t<bc_external_handle_t>* get_vector_external_elements(const bc_value_t& value);
+const bc_immer_vector_t<bc_inplace_value_t>* get_vector_inplace_elements(const bc_value_t& value);
 
-bc_value_t make_vector(const typeid_t& element_type, const immer::vector<bc_value_t>& elements);
-bc_value_t make_vector(const typeid_t& element_type, const immer::vector<bc_external_handle_t>& elements);
-bc_value_t make_vector(const typeid_t& element_type, const immer::vector<bc_inplace_value_t>& elements);
+//	vector_type is the interned type of the vector, not its element type.
+bc_value_t make_vector(bc_typeid_t vector_type, const immer::vector<bc_value_t>& elements);
+bc_value_t make_vector(bc_typeid_t vector_type, const bc_immer_vector_t<bc_external_handle_t>& elements);
+bc_value_t make_vector(bc_typeid_t vector_type, const bc_immer_vector_t<bc_inplace_value_t>& elements);
 
-const immer::map<std::string, bc_external_handle_t>& get_dict_value(const bc_value_t& value);
-bc_value_t make_dict(const typeid_t& value_type, const immer::map<std::string, bc_external_handle_t>& entries);
-bc_value_t make_dict(const typeid_t& value_type, const immer::map<std::string, bc_inplace_value_t>& entries);
+const bc_immer_map_t<std::string, bc_external_handle_t>& get_dict_value(const bc_value_t& value);
+//	dict_type is the interned type of the dict, not its value type.
+bc_value_t make_dict(bc_typeid_t dict_type, const bc_immer_map_t<std::string, bc_external_handle_t>& entries);
+bc_value_t make_dict(bc_typeid_t dict_type, const bc_immer_map_t<std::string, bc_inplace_value_t>& entries);
 
 json_t bcvalue_to_json(const bc_value_t& v);
 int bc_compare_value_true_deep(const bc_value_t& left, const bc_value_t& right, const typeid_t& type);
-int bc_compare_value_exts(const bc_external_handle_t& left, const bc_external_handle_t& right, const typeid_t& type);
+int bc_compare_value_exts(const bc_external_handle_t& left, const bc_external_handle_t& right, bc_typeid_t type);
 
 
 
@@ -322,7 +593,7 @@ struct bc_symbol_t {
 	};
 
 	public: bool check_invariant() const {
-		QUARK_ASSERT(_const_value._type.is_undefined() || _const_value._type == _value_type);
+		QUARK_ASSERT(_const_value.get_type().is_undefined() || _const_value.get_type() == _value_type);
 		return true;
 	}
 
@@ -343,6 +614,16 @@ struct bc_symbol_t {
 enum class bc_opcode: uint8_t {
 	k_nop = 0,
 
+	/*
+		Prefix for an instruction with operands that don't fit in 16 bits.
+		A: IMMEDIATE: high 16 bits of the next instruction's A
+		B: IMMEDIATE: high 16 bits of the next instruction's B
+		C: IMMEDIATE: high 16 bits of the next instruction's C
+
+		The next instruction holds the low 16 bits. Branch offsets are relative the next instruction, not the prefix.
+	*/
+	k_wide,
+
 	/*
 		A: Register: where to put result
 		B: IMMEDIATE: global index
@@ -384,6 +665,14 @@ enum class bc_opcode: uint8_t {
 	*/
 	k_copy_reg_external_value,
 
+	/*
+		Drops the value of a dead temporary early: puts the frame's initial value back into the register.
+		A: Register: local holding an external value
+		B: ---
+		C: ---
+	*/
+	k_release_external_value,
+
 
 	/*
 		A: Register: where to put result
@@ -404,6 +693,16 @@ enum class bc_opcode: uint8_t {
 	k_lookup_element_dict_w_external_values,
 	k_lookup_element_dict_w_inplace_values,
 
+	/*
+		Vector lookup without the bounds check. Only emitted when the index is the iterator of
+		"for(i in 0 ..< size(v))" and v isn't changed by the loop body.
+		A: Register: where to put result
+		B: Register: vector object
+		C: Register: index (int)
+	*/
+	k_lookup_element_vector_w_external_elements_unchecked,
+	k_lookup_element_vector_w_inplace_elements_unchecked,
+
 	/*
 		A: Register: where to put result: integer
 		B: Register: object
@@ -425,6 +724,59 @@ enum class bc_opcode: uint8_t {
 	k_pushback_vector_w_inplace_elements,
 	k_pushback_string,
 
+	/*
+		A: Register: where to put result: integer
+		B: Register: string object/vector object
+		C: Register: value to find
+	*/
+	k_find_string,
+	k_find_vector_w_external_elements,
+	k_find_vector_w_inplace_elements,
+
+	/*
+		A: Register: where to put result: bool
+		B: Register: dict object
+		C: Register: key (string)
+	*/
+	k_exists_dict_w_external_values,
+	k_exists_dict_w_inplace_values,
+
+	/*
+		A: Register: where to put result: dict
+		B: Register: dict object
+		C: Register: key (string)
+	*/
+	k_erase_dict_w_external_values,
+	k_erase_dict_w_inplace_values,
+
+	/*
+		A: Register: where to put result: same type as B
+		B: Register: string object/vector object
+		C: Register: start (int). Register C + 1 holds end (int).
+	*/
+	k_subset_string,
+	k_subset_vector_w_external_elements,
+	k_subset_vector_w_inplace_elements,
+
+	/*
+		A: Register: where to put result: same type as B
+		B: Register: string object/vector object
+		C: Register: start (int). Register C + 1 holds end (int), C + 2 the replacement, same type as B.
+	*/
+	k_replace_string,
+	k_replace_vector_w_external_elements,
+	k_replace_vector_w_inplace_elements,
+
+	/*
+		A: Register: where to put result: same type as B
+		B: Register: vector object/dict object
+		C: Register: index (int) or key (string). Register C + 1 holds the new element / value.
+	*/
+	k_update_vector_w_external_elements,
+	k_update_vector_w_inplace_elements,
+	k_update_dict_w_external_values,
+	k_update_dict_w_inplace_values,
+
 	/*
 		A: Register: tells where to put function return
 		B: Register: function value to call
@@ -435,6 +787,17 @@ enum class bc_opcode: uint8_t {
 	*/
 	k_call,
 
+	/*
+		"return f(...)": the Floyd function f takes over the current frame instead of opening a new one.
+		A: Register: function value to call
+		B: IMMEDIATE: argument count. Values are put on stack, like k_call. No DYN arguments.
+		C: ---
+
+		The bytecode generator only emits this when f stores its arguments exactly like the current function,
+		so the caller's k_popn still matches.
+	*/
+	k_tail_call,
+
 	/*
 		A: Register: where to put result
 		B: Register: lhs
@@ -464,6 +827,25 @@ enum class bc_opcode: uint8_t {
 	k_logical_or_int,
 	k_logical_or_double,
 
+	/*
+		A: Register: where to put result
+		B: Register: lhs
+		C: IMMEDIATE: rhs, a small int
+	*/
+	k_add_int_imm,
+	k_subtract_int_imm,
+	k_multiply_int_imm,
+
+	/*
+		A: Register: where to put result
+		B: Register: lhs
+		C: IMMEDIATE: rhs, index into bc_program_t::_double_constants
+	*/
+	k_add_double_const,
+	k_subtract_double_const,
+	k_multiply_double_const,
+	k_divide_double_const,
+
 
 	//////////////////////////////////////		COMPARISON
 
@@ -488,6 +870,37 @@ enum class bc_opcode: uint8_t {
 	k_logical_nonequal,
 	k_logical_nonequal_int,
 
+	/*
+		Typed versions. Doubles, strings and bools order the same way as bc_compare_value_true_deep().
+		A: Register: where to put result BOOL
+		B: Register: lhs
+		C: Register: rhs
+	*/
+	k_comparison_smaller_or_equal_double,
+	k_comparison_smaller_double,
+	k_logical_equal_double,
+	k_logical_nonequal_double,
+	k_comparison_smaller_or_equal_string,
+	k_comparison_smaller_string,
+	k_logical_equal_string,
+	k_logical_nonequal_string,
+	k_comparison_smaller_or_equal_bool,
+	k_comparison_smaller_bool,
+	k_logical_equal_bool,
+	k_logical_nonequal_bool,
+
+	/*
+		A: Register: where to put result BOOL
+		B: Register: lhs, int
+		C: IMMEDIATE: rhs, a small int
+	*/
+	k_comparison_smaller_int_imm,
+	k_comparison_smaller_or_equal_int_imm,
+	k_comparison_larger_int_imm,
+	k_comparison_larger_or_equal_int_imm,
+	k_logical_equal_int_imm,
+	k_logical_nonequal_int_imm,
+
 
 	/*
 		A: Register: where to put resulting value
@@ -646,6 +1059,32 @@ enum class bc_opcode: uint8_t {
 	*/
 	k_branch_smaller_int,
 	k_branch_smaller_or_equal_int,
+	k_branch_equal_int,
+	k_branch_nonequal_int,
+	k_branch_smaller_double,
+	k_branch_smaller_or_equal_double,
+	k_branch_equal_double,
+	k_branch_nonequal_double,
+	k_branch_smaller_string,
+	k_branch_smaller_or_equal_string,
+	k_branch_equal_string,
+	k_branch_nonequal_string,
+	k_branch_smaller_bool,
+	k_branch_smaller_or_equal_bool,
+	k_branch_equal_bool,
+	k_branch_nonequal_bool,
+
+	/*
+		A: Register: lhs, int
+		B: IMMEDIATE: rhs, a small int
+		C: IMMEDIATE: branch offset (added to PC) on branch.
+	*/
+	k_branch_smaller_int_imm,
+	k_branch_smaller_or_equal_int_imm,
+	k_branch_larger_int_imm,
+	k_branch_larger_or_equal_int_imm,
+	k_branch_equal_int_imm,
+	k_branch_nonequal_int_imm,
 
 	/*
 		A: ---
@@ -679,7 +1118,8 @@ struct opcode_info_t {
 		k_q_0rr0,
 		k_r_0ir0,
 		k_s_0rri,
-		k_t_0rii
+		k_t_0rii,
+		k_u_0iii
 	};
 	encoding _encoding;
 };
@@ -705,6 +1145,7 @@ reg_flags_t encoding_to_reg_flags(opcode_info_t::encoding e);
 
 //	The byte code instruction itself, as executed by the interpreter.
 //	It's 64-bits big, has an opcode and 3 operands, A-B-C.
+//	Operands that don't fit in 16 bits use a k_wide prefix instruction for their high halves.
 
 struct bc_instruction_t {
 	bc_instruction_t(bc_opcode opcode, int16_t a, int16_t b, int16_t c);
@@ -721,6 +1162,23 @@ struct bc_instruction_t {
 	int16_t _c;
 };
 
+//	An instruction the way execute_instructions() dispatches it, operands sign-extended to 32 bits.
+struct bc_decoded_instruction_t {
+	bc_opcode _opcode;
+	int32_t _a;
+	int32_t _b;
+	int32_t _c;
+};
+
+inline bc_decoded_instruction_t decode_instruction(const bc_instruction_t& instruction){
+	return { instruction._opcode, instruction._a, instruction._b, instruction._c };
+}
+
+//	Combines the high half from a k_wide prefix with the low half from the instruction after it.
+inline int32_t make_wide_operand(int32_t high, int16_t low){
+	return static_cast<int32_t>((static_cast<uint32_t>(high) << 16) | static_cast<uint16_t>(low));
+}
+
 
 //////////////////////////////////////		bc_static_frame_t
 
@@ -747,14 +1205,24 @@ struct bc_static_frame_t {
 	std::vector<typeid_t> _args;
 
 	//	True if equivalent symbol is an external value.
-	//??? unify with _locals_exts.
 	//??? also redundant with _symbols._value_type
 	std::vector<bool> _exts;
 
-	//	Is the local value external values?
-	//	This doesn't count arguments.
-	std::vector<bool> _locals_exts;
+	//	Interned _value_type of each symbol.
+	std::vector<bc_typeid_t> _symbol_types;
+
+	//	Index of each argument that is an external value, ascending.
+	std::vector<int> _args_ext_indexes;
+
+	//	Initial values of the locals. This doesn't count arguments.
 	std::vector<bc_value_t> _locals;
+
+	//	Template for the locals: open_frame() copies it straight into the stack, then bumps the RC of the
+	//	external values only. The external values are owned by _locals.
+	std::vector<bc_pod_value_t> _locals_image;
+
+	//	Index into _locals of each local that is an external value, ascending.
+	std::vector<int> _locals_ext_indexes;
 };
 
 
@@ -785,6 +1253,96 @@ struct bc_function_definition_t {
 
 	int _dyn_arg_count;
 	bool _return_is_ext;
+
+	//	Where each argument's value sits on the stack, relative to the first argument.
+	//	DYN arguments take two entries: the itype, then the value.
+	std::vector<int> _arg_stack_offsets;
+
+	//	Interned types of the arguments and the return value.
+	std::vector<bc_typeid_t> _arg_types;
+	bc_typeid_t _return_type;
+};
+
+
+//////////////////////////////////////		bc_host_args_t
+
+/*
+	The arguments of a host function call.
+	Normally a view straight onto the interpreter stack: pods + the types of the function signature. DYN arguments use
+	the itype the caller pushed before the value. No bc_value_t:s are made = no RC, no typeid_t copies, no allocations.
+	The stack owns the values during the call. Read the arguments before calling Floyd functions: they can grow (move) the stack.
+
+	When a host function calls another host function (see call_function_bc()) the arguments are bc_value_t:s instead.
+*/
+
+struct bc_host_args_t {
+	public: inline int size() const {
+		return _count;
+	}
+
+	public: inline const bc_pod_value_t& get_pod(int index) const {
+		QUARK_ASSERT(index >= 0 && index < _count);
+
+		if(_values != nullptr){
+			return _values[index]._pod;
+		}
+		else{
+			return _stack_args[_function_def->_arg_stack_offsets[index]];
+		}
+	}
+
+	public: inline const typeid_t& get_type(int index) const {
+		QUARK_ASSERT(index >= 0 && index < _count);
+
+		if(_values != nullptr){
+			return _values[index].get_type();
+		}
+		else{
+			const auto& arg_type = _function_def->_args[index]._type;
+			if(arg_type.is_internal_dynamic()){
+				const auto itype = _stack_args[_function_def->_arg_stack_offsets[index] - 1]._inplace._int64;
+				QUARK_ASSERT(itype >= 0 && itype < _types->size());
+				return (*_types)[itype];
+			}
+			else{
+				return arg_type;
+			}
+		}
+	}
+
+	public: inline bc_typeid_t get_typeid(int index) const {
+		QUARK_ASSERT(index >= 0 && index < _count);
+
+		if(_values != nullptr){
+			return _values[index]._typeid;
+		}
+		else{
+			const auto arg_type = _function_def->_arg_types[index];
+			if(arg_type == static_cast<bc_typeid_t>(base_type::k_internal_dynamic)){
+				const auto itype = _stack_args[_function_def->_arg_stack_offsets[index] - 1]._inplace._int64;
+				QUARK_ASSERT(itype >= 0 && itype < _interned_types->size());
+				return (*_interned_types)[itype];
+			}
+			else{
+				return arg_type;
+			}
+		}
+	}
+
+	//	Makes a bc_value_t, with RC. Only use when you need to pass the value on.
+	public: bc_value_t get_value(int index) const;
+
+
+	//////////////////////////////////////		STATE
+	public: const bc_pod_value_t* _stack_args;
+	public: const bc_function_definition_t* _function_def;
+	public: const std::vector<typeid_t>* _types;
+
+	//	Interned id of each of *_types.
+	public: const std::vector<bc_typeid_t>* _interned_types;
+
+	public: const bc_value_t* _values;
+	public: int _count;
 };
 
 
@@ -794,6 +1352,17 @@ struct bc_function_definition_t {
 	A complete, stand-alone, Floyd byte code executable, ready to be executed by interpreter.
 */
 
+//	Instruction and register counts of all frames in a program, before and after the bytecode generator's peephole pass.
+struct bc_peephole_stats_t {
+	int _instruction_count_before;
+	int _instruction_count_after;
+	int _register_count_before;
+	int _register_count_after;
+
+	//	Loop-invariant instructions moved out of loops.
+	int _hoisted_count;
+};
+
 struct bc_program_t {
 #if DEBUG
 	public: bool check_invariant() const {
@@ -809,6 +1378,11 @@ struct bc_program_t {
 	public: std::vector<typeid_t> _types;
 	public: software_system_t _software_system;
 	public: container_t _container_def;
+
+	//	Double operands of the k_*_double_const opcodes.
+	public: std::vector<double> _double_constants;
+
+	public: bc_peephole_stats_t _peephole_stats;
 };
 
 json_t bcprogram_to_json(const bc_program_t& program);
@@ -828,6 +1402,50 @@ inline bool operator==(const frame_pos_t& lhs, const frame_pos_t& rhs){
 }
 
 
+//////////////////////////////////////		bc_function_profile_t
+
+/*
+	How much a Floyd function runs: calls, and taken back-edges = loop iterations. Each interpreter keeps one
+	per function -- a process runs on one thread so plain counters are enough. Only counted when the JIT is on.
+
+	When a counter reaches its threshold the function tiers up: it's handed to the JIT and later calls run the
+	native code. Calls already running in the interpreter finish there.
+*/
+struct bc_function_profile_t {
+	int64_t _call_count;
+	int64_t _backedge_count;
+
+	//	Set when the function has been handed to the JIT, also if the JIT couldn't compile it. We only try once.
+	bool _tiered_up;
+};
+
+//	When a function counts as hot.
+const int64_t k_default_tier_up_calls = 1000;
+const int64_t k_default_tier_up_backedges = 10000;
+
+
+//////////////////////////////////////		bc_call_record_t
+
+/*
+	Return address for a Floyd-to-Floyd call made by k_call. execute_instructions() pushes one when it
+	enters a callee and pops it on k_return / k_stop, then continues in the caller -- no C++ recursion.
+*/
+struct bc_call_record_t {
+	//	Instructions and pc of the k_call instruction to continue after.
+	const std::vector<bc_instruction_t>* _return_instructions;
+	int _return_pc;
+
+	//	Absolute stack position where to store the return value, -1 = callee returns void.
+	int _result_pos;
+
+	//	The caller's profile, counting continues there.
+	bc_function_profile_t* _return_profile;
+
+	//	Index in bc_memo_t::_pending, -1 = the result isn't cached.
+	int _memo_pending;
+};
+
+
 //////////////////////////////////////		interpreter_stack_t
 
 /*
@@ -837,12 +1455,20 @@ inline bool operator==(const frame_pos_t& lhs, const frame_pos_t& rhs){
 
 	Each stack frame will be mapped to a range of the interpreter stack.
 	The stack frame's registers are really mapped to entries in the stack.
+
+	The stack starts small and grows (reallocates) when needed, up to a max size. Growing moves all entries,
+	so never keep pointers into the stack across operations that can push -- use stack positions.
+	Going past the max size throws a "Stack overflow." runtime error.
 */
 enum {
 	//	We store prev-frame-pos & symbol-ptr.
 	k_frame_overhead = 2
 };
 
+//	Stack sizes are counted in entries, each entry is one bc_pod_value_t.
+const size_t k_default_stack_initial_size = 1024;
+const size_t k_default_stack_max_size = 1024 * 1024;
+
 
 /*
 	0	[int = 0] 		previous stack frame pos, 0 = global
@@ -859,16 +1485,19 @@ enum {
 */
 
 struct interpreter_stack_t {
-	public: interpreter_stack_t(const bc_static_frame_t* global_frame) :
+	public: interpreter_stack_t(const bc_static_frame_t* global_frame, size_t initial_size, size_t max_size) :
 		_current_frame_ptr(nullptr),
 		_current_frame_entry_ptr(nullptr),
 		_global_frame(global_frame),
 		_entries(nullptr),
 		_allocated_count(0),
+		_max_size(max_size),
 		_stack_size(0)
 	{
-		_entries = new bc_pod_value_t[8192];
-		_allocated_count = 8192;
+		QUARK_ASSERT(initial_size <= max_size);
+
+		_entries = new bc_pod_value_t[initial_size];
+		_allocated_count = initial_size;
 		_current_frame_entry_ptr = &_entries[0];
 
 		QUARK_ASSERT(check_invariant());
@@ -884,6 +1513,7 @@ struct interpreter_stack_t {
 	public: bool check_invariant() const {
 		QUARK_ASSERT(_entries != nullptr);
 		QUARK_ASSERT(_stack_size >= 0 && _stack_size <= _allocated_count);
+		QUARK_ASSERT(_allocated_count <= _max_size);
 
 		QUARK_ASSERT(_current_frame_entry_ptr >= &_entries[0]);
 
@@ -905,12 +1535,14 @@ struct interpreter_stack_t {
 
 		std::swap(other._entries, _entries);
 		std::swap(other._allocated_count, _allocated_count);
+		std::swap(other._max_size, _max_size);
 		std::swap(other._stack_size, _stack_size);
 #if DEBUG
 		other._debug_types.swap(_debug_types);
 #endif
 		std::swap(_current_frame_ptr, other._current_frame_ptr);
 		std::swap(_current_frame_entry_ptr, other._current_frame_entry_ptr);
+		other._call_records.swap(_call_records);
 
 		std::swap(_global_frame, other._global_frame);
 
@@ -924,6 +1556,20 @@ struct interpreter_stack_t {
 		return static_cast<int>(_stack_size);
 	}
 
+	//	Makes sure there is room to push count more entries. Returns true if the stack had to move, which
+	//	invalidates all pointers into the stack. Throws "Stack overflow." if the stack would exceed its max size.
+	public: inline bool ensure_capacity(size_t count){
+		if(_stack_size + count <= _allocated_count){
+			return false;
+		}
+		else{
+			grow(_stack_size + count);
+			return true;
+		}
+	}
+
+	private: void grow(size_t required_count);
+
 
 	//////////////////////////////////////		GLOBAL VARIABLES
 
@@ -950,8 +1596,7 @@ struct interpreter_stack_t {
 	public: bool check_stack_frame(const frame_pos_t& in_frame) const;
 #endif
 
-	//	??? This function should just allocate a block for frame, then have a list of writes.
-	//	???	ALTERNATIVELY: generate instructions to do this in the VM? Nah, that's always slower.
+	//	Copies the frame's locals template to the stack in one go, then bumps RC for the external values.
 	public: void open_frame(const bc_static_frame_t& frame, int values_already_on_stack){
 		QUARK_ASSERT(check_invariant());
 		QUARK_ASSERT(frame.check_invariant());
@@ -964,18 +1609,27 @@ struct interpreter_stack_t {
 		//	The stack frame already has symbols/registers mapped for those parameters.
 		const auto new_frame_pos = stack_end - parameter_count;
 
-		for(int i = 0 ; i < frame._locals.size() ; i++){
-			bool ext = frame._locals_exts[i];
-			const auto& local = frame._locals[i];
-			if(ext){
-				push_external_value(local);
-			}
-			else{
-				push_inplace_value(local);
-			}
+		const auto local_count = frame._locals_image.size();
+		ensure_capacity(local_count);
+
+		auto locals = &_entries[_stack_size];
+		if(local_count > 0){
+			std::memcpy(locals, &frame._locals_image[0], sizeof(bc_pod_value_t) * local_count);
+		}
+		for(const auto index: frame._locals_ext_indexes){
+			retain_external(locals[index]._external);
 		}
+		_stack_size += local_count;
+#if DEBUG
+		for(const auto& e: frame._locals){
+			_debug_types.push_back(e.get_type());
+		}
+#endif
+
 		_current_frame_ptr = &frame;
 		_current_frame_entry_ptr = &_entries[new_frame_pos];
+
+		QUARK_ASSERT(check_invariant());
 	}
 
 
@@ -986,8 +1640,7 @@ struct interpreter_stack_t {
 		QUARK_ASSERT(check_invariant());
 		QUARK_ASSERT(frame.check_invariant());
 
-		//	Using symbol table to figure out which stack-frame values needs RC. Decrement them all.
-		pop_batch(frame._locals_exts);
+		pop_batch(frame._locals_image.size(), frame._locals_ext_indexes);
 	}
 
 	public: std::vector<std::pair<int, int>> get_stack_frames(int frame_pos) const;
@@ -1008,10 +1661,10 @@ struct interpreter_stack_t {
 
 //			bool is_ext = _current_frame_ptr->_exts[reg];
 #if DEBUG
-		const auto result = bc_value_t(_current_frame_ptr->_symbols[reg].second._value_type, _current_frame_entry_ptr[reg]);
+		const auto result = bc_value_t(_current_frame_ptr->_symbol_types[reg], _current_frame_entry_ptr[reg]);
 #else
 //			const auto result = bc_value_t(_current_frame_entry_ptr[reg], is_ext);
-		const auto result = bc_value_t(_current_frame_ptr->_symbols[reg].second._value_type, _current_frame_entry_ptr[reg]);
+		const auto result = bc_value_t(_current_frame_ptr->_symbol_types[reg], _current_frame_entry_ptr[reg]);
 #endif
 		QUARK_ASSERT(result.check_invariant());
 		return result;
@@ -1025,7 +1678,7 @@ struct interpreter_stack_t {
 		bool is_ext = _current_frame_ptr->_exts[reg];
 		if(is_ext){
 			auto prev_copy = _current_frame_entry_ptr[reg];
-			value._pod._external->_rc++;
+			retain_external(value._pod._external);
 			_current_frame_entry_ptr[reg] = value._pod;
 			release_pod_external(prev_copy);
 		}
@@ -1038,13 +1691,13 @@ struct interpreter_stack_t {
 
 	public: void write_register__external_value(const int reg, const bc_value_t& value){
 		QUARK_ASSERT(check_invariant());
-		QUARK_ASSERT(encode_as_external(value._type));
+		QUARK_ASSERT(encode_as_external(value.get_type()));
 		QUARK_ASSERT(check_reg__external_value(reg));
 		QUARK_ASSERT(value.check_invariant());
-		QUARK_ASSERT(_current_frame_ptr->_symbols[reg].second._value_type == value._type);
+		QUARK_ASSERT(_current_frame_ptr->_symbols[reg].second._value_type == value.get_type());
 
 		auto prev_copy = _current_frame_entry_ptr[reg];
-		value._pod._external->_rc++;
+		retain_external(value._pod._external);
 		_current_frame_entry_ptr[reg] = value._pod;
 		release_pod_external(prev_copy);
 
@@ -1185,14 +1838,15 @@ struct interpreter_stack_t {
 		QUARK_ASSERT(check_invariant());
 		QUARK_ASSERT(value.check_invariant());
 #if DEBUG
-		QUARK_ASSERT(encode_as_external(value._type) == true);
+		QUARK_ASSERT(encode_as_external(value.get_type()) == true);
 #endif
 
-		value._pod._external->_rc++;
+		ensure_capacity(1);
+		retain_external(value._pod._external);
 		_entries[_stack_size] = value._pod;
 		_stack_size++;
 #if DEBUG
-		_debug_types.push_back(value._type);
+		_debug_types.push_back(value.get_type());
 #endif
 
 		QUARK_ASSERT(check_invariant());
@@ -1202,24 +1856,24 @@ struct interpreter_stack_t {
 		QUARK_ASSERT(check_invariant());
 		QUARK_ASSERT(value.check_invariant());
 #if DEBUG
-		QUARK_ASSERT(encode_as_external(value._type) == false);
+		QUARK_ASSERT(encode_as_external(value.get_type()) == false);
 #endif
 
+		ensure_capacity(1);
 		_entries[_stack_size] = value._pod;
 		_stack_size++;
 #if DEBUG
-		_debug_types.push_back(value._type);
+		_debug_types.push_back(value.get_type());
 #endif
 
 		QUARK_ASSERT(check_invariant());
 	}
 
 	//	returned value will have ownership of obj, if it's an obj.
-	public: inline bc_value_t load_value(int pos, const typeid_t& type) const{
+	public: inline bc_value_t load_value(int pos, bc_typeid_t type) const{
 		QUARK_ASSERT(check_invariant());
 		QUARK_ASSERT(pos >= 0 && pos < _stack_size);
-		QUARK_ASSERT(type.check_invariant());
-		QUARK_ASSERT(type == _debug_types[pos]);
+		QUARK_ASSERT(lookup_bc_type(type) == _debug_types[pos]);
 
 		const auto& e = _entries[pos];
 		const auto result = bc_value_t(type, e);
@@ -1239,9 +1893,9 @@ struct interpreter_stack_t {
 		QUARK_ASSERT(value.check_invariant());
 		QUARK_ASSERT(pos >= 0 && pos < _stack_size);
 #if FLOYD_BC_VALUE_DEBUG_TYPE
-		QUARK_ASSERT(encode_as_external(value._type.get_base_type()) == false);
+		QUARK_ASSERT(encode_as_external(value.get_type().get_base_type()) == false);
 #endif
-		QUARK_ASSERT(_debug_types[pos] == value._type);
+		QUARK_ASSERT(_debug_types[pos] == value.get_type());
 
 		_entries[pos] = value._pod;
 
@@ -1253,45 +1907,35 @@ struct interpreter_stack_t {
 		QUARK_ASSERT(value.check_invariant());
 		QUARK_ASSERT(pos >= 0 && pos < _stack_size);
 #if FLOYD_BC_VALUE_DEBUG_TYPE
-		QUARK_ASSERT(encode_as_external(value._type.get_base_type()) == true);
+		QUARK_ASSERT(encode_as_external(value.get_type().get_base_type()) == true);
 #endif
-		QUARK_ASSERT(_debug_types[pos] == value._type);
+		QUARK_ASSERT(_debug_types[pos] == value.get_type());
 
 		auto prev_copy = _entries[pos];
-		value._pod._external->_rc++;
+		retain_external(value._pod._external);
 		_entries[pos] = value._pod;
 		release_pod_external(prev_copy);
 
 		QUARK_ASSERT(check_invariant());
 	}
 
-	//	exts[exts.size() - 1] maps to the closed value on stack, the next to be popped.
-	public: inline void pop_batch(const std::vector<bool>& exts){
+	//	Pops the top count values. ext_indexes lists which of them are external values, index 0 is the
+	//	deepest of the popped values.
+	public: inline void pop_batch(size_t count, const std::vector<int>& ext_indexes){
 		QUARK_ASSERT(check_invariant());
-		QUARK_ASSERT(_stack_size >= exts.size());
-
-		auto flag_index = exts.size() - 1;
-		for(int i = 0 ; i < exts.size() ; i++){
-			pop(exts[flag_index]);
-			flag_index--;
-		}
-		QUARK_ASSERT(check_invariant());
-	}
+		QUARK_ASSERT(_stack_size >= count);
 
-	private: inline void pop(bool ext){
-		QUARK_ASSERT(check_invariant());
-		QUARK_ASSERT(_stack_size > 0);
-		QUARK_ASSERT(encode_as_external(_debug_types.back()) == ext);
+		const auto first_pos = _stack_size - count;
+		for(const auto index: ext_indexes){
+			QUARK_ASSERT(index >= 0 && index < count);
+			QUARK_ASSERT(encode_as_external(_debug_types[first_pos + index]));
 
-		auto copy = _entries[_stack_size - 1];
-		_stack_size--;
+			release_pod_external(_entries[first_pos + index]);
+		}
+		_stack_size = first_pos;
 #if DEBUG
-		_debug_types.pop_back();
+		_debug_types.erase(_debug_types.begin() + first_pos, _debug_types.end());
 #endif
-		if(ext){
-			release_pod_external(copy);
-		}
-
 		QUARK_ASSERT(check_invariant());
 	}
 
@@ -1317,6 +1961,7 @@ struct interpreter_stack_t {
 
 	public: bc_pod_value_t* _entries;
 	public: size_t _allocated_count;
+	public: size_t _max_size;
 	public: size_t _stack_size;
 
 	//	These are DEEP copies = do not share RC with non-debug values.
@@ -1328,6 +1973,9 @@ struct interpreter_stack_t {
 	public: bc_pod_value_t* _current_frame_entry_ptr;
 
 	public: const bc_static_frame_t* _global_frame;
+
+	//	One record per active Floyd-to-Floyd call, innermost last.
+	public: std::vector<bc_call_record_t> _call_records;
 };
 
 
@@ -1344,6 +1992,18 @@ struct interpreter_handler_i {
 };
 
 
+//////////////////////////////////////		bc_host_function_t
+
+//	An implementation of a host function. Uses either the fast calling convention or the old one via an adapter.
+
+struct bc_host_function_t {
+	HOST_FUNCTION_PTR _f;
+	HOST_FUNCTION_FAST_PTR _fast_f;
+};
+
+bc_value_t call_host_function(interpreter_t& vm, const bc_host_function_t& host_function, const bc_host_args_t& args);
+
+
 //////////////////////////////////////		interpreter_imm_t
 
 //	Holds static = immutable state the interpreter wants to keep around.
@@ -1351,7 +2011,78 @@ struct interpreter_handler_i {
 struct interpreter_imm_t {
 	public: const std::chrono::time_point<std::chrono::high_resolution_clock> _start_time;
 	public: const bc_program_t _program;
-	public: const std::map<int, HOST_FUNCTION_PTR> _host_functions;
+	public: const std::map<int, bc_host_function_t> _host_functions;
+
+	//	Interned id of each of _program._types, see intern_bc_types().
+	public: const std::vector<bc_typeid_t> _interned_types;
+};
+
+
+//////////////////////////////////////		bc_tiering_t
+
+//	Per-interpreter profiles and the JIT:ed code hot functions tier up to.
+
+struct bc_tiering_t {
+	int64_t _tier_up_calls;
+	int64_t _tier_up_backedges;
+
+	//	One per bc_program_t::_function_defs, then one for the global instructions. Never resized.
+	std::vector<bc_function_profile_t> _profiles;
+
+	//	Finds the function running a frame, when execute_instructions() is entered from C++.
+	std::unordered_map<const bc_static_frame_t*, int> _frame_function_ids;
+
+	//	Native code, nullptr = JIT is off. A function's entry is filled in once, when it tiers up.
+	std::shared_ptr<bc_jit_t> _jit;
+};
+
+
+//////////////////////////////////////		bc_memo_t
+
+struct bc_memo_cache_t;
+
+//	Max results cached per memoized function.
+const size_t k_default_memo_capacity = 1024;
+
+//	A call to a memoized function that missed the cache, waiting for its result.
+struct bc_memo_pending_t {
+	int _function_id;
+	size_t _hash;
+	std::vector<bc_value_t> _args;
+};
+
+//	Per-interpreter memoization state, see bytecode_memo.h.
+struct bc_memo_t {
+	//	One per bc_program_t::_function_defs, nullptr = not memoized.
+	std::vector<std::shared_ptr<bc_memo_cache_t>> _caches;
+
+	//	Innermost call last.
+	std::vector<bc_memo_pending_t> _pending;
+};
+
+/*
+	If an exception unwinds past it, drops the records added to bc_memo_t::_pending while it lived.
+	Their calls never return, so nothing else would ever pop them.
+*/
+struct bc_memo_pending_guard_t {
+	bc_memo_pending_guard_t(bc_memo_t& memo) :
+		_memo(memo),
+		_pending_count(memo._pending.size()),
+		_uncaught_count(std::uncaught_exceptions())
+	{
+	}
+	bc_memo_pending_guard_t(const bc_memo_pending_guard_t& other) = delete;
+	bc_memo_pending_guard_t& operator=(const bc_memo_pending_guard_t& other) = delete;
+
+	~bc_memo_pending_guard_t(){
+		if(std::uncaught_exceptions() > _uncaught_count && _memo._pending.size() > _pending_count){
+			_memo._pending.erase(_memo._pending.begin() + _pending_count, _memo._pending.end());
+		}
+	}
+
+	bc_memo_t& _memo;
+	const size_t _pending_count;
+	const int _uncaught_count;
 };
 
 
@@ -1367,6 +2098,37 @@ struct value_entry_t {
 };
 
 
+//////////////////////////////////////		interpreter_config_t
+
+//	Per-interpreter settings.
+struct interpreter_config_t {
+	//	Counted in stack entries.
+	size_t _stack_initial_size = k_default_stack_initial_size;
+	size_t _stack_max_size = k_default_stack_max_size;
+
+	//	Compile hot Floyd functions to native code, see bytecode_jit.h.
+	bool _jit = false;
+
+	//	A function is hot after this many calls or loop iterations, see bc_function_profile_t. At least 1.
+	int64_t _tier_up_calls = k_default_tier_up_calls;
+	int64_t _tier_up_backedges = k_default_tier_up_backedges;
+
+	//	Names of pure functions whose results are cached, see bytecode_memo.h.
+	std::vector<std::string> _memoize;
+	size_t _memo_capacity = k_default_memo_capacity;
+
+	//	Max loop iterations + Floyd calls before throwing "Step limit reached.". 0 = no limit.
+	int64_t _step_limit = 0;
+
+	//	False: don't run the global instructions, only constant globals get their values. For compile-time
+	//	evaluation, see bytecode_const_eval.h.
+	bool _run_global_instructions = true;
+};
+
+//	Uses the container-def's stack, JIT and memoization settings, where specified.
+interpreter_config_t make_interpreter_config(const container_t& container_def);
+
+
 //////////////////////////////////////		interpreter_t
 
 /*
@@ -1378,6 +2140,7 @@ struct value_entry_t {
 struct interpreter_t {
 	public: explicit interpreter_t(const bc_program_t& program);
 	public: explicit interpreter_t(const bc_program_t& program, interpreter_handler_i* handler);
+	public: explicit interpreter_t(const bc_program_t& program, interpreter_handler_i* handler, const interpreter_config_t& config);
 	public: interpreter_t(const interpreter_t& other) = delete;
 	public: const interpreter_t& operator=(const interpreter_t& other)= delete;
 #if DEBUG
@@ -1394,6 +2157,13 @@ struct interpreter_t {
 	//	Notice: stack holds refs to RC-counted objects!
 	public: interpreter_stack_t _stack;
 	public: std::vector<std::string> _print_output;
+	public: bc_tiering_t _tiering;
+	public: bc_memo_t _memo;
+
+	//	Counts down on each loop iteration and Floyd call, see interpreter_config_t::_step_limit.
+	//	Only when _count_steps is true -- there is a step limit.
+	public: bool _count_steps;
+	public: int64_t _steps_left;
 };
 
 
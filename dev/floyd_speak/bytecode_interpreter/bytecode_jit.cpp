@@ -0,0 +1,682 @@
+//
+//  bytecode_jit.cpp
+//  FloydSpeak
+//
+
+#include "bytecode_jit.h"
+
+#include "floyd_interpreter.h"
+#include "ast_value.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__linux__)
+	#define FLOYD_BC_JIT 1
+	#include <sys/mman.h>
+#else
+	#define FLOYD_BC_JIT 0
+#endif
+
+
+namespace floyd {
+
+
+//////////////////////////////////////		jit_emitter_t
+
+/*
+	Appends x86-64 machine code. The generated code follows the System V calling convention:
+	rdi = regs, rsi = globals. It only uses rax, rcx, xmm0 and xmm1, which are all caller-saved, and never touches the stack.
+	Every register operand is addressed as [rdi + reg * 8], every global as [rsi + index * 8].
+*/
+
+struct jit_emitter_t {
+	void emit(std::initializer_list<uint8_t> bytes){
+		_code.insert(_code.end(), bytes.begin(), bytes.end());
+	}
+
+	void emit_int32(int32_t value){
+		const auto u = static_cast<uint32_t>(value);
+		emit({ static_cast<uint8_t>(u), static_cast<uint8_t>(u >> 8), static_cast<uint8_t>(u >> 16), static_cast<uint8_t>(u >> 24) });
+	}
+
+	void emit_int64(int64_t value){
+		emit_int32(static_cast<int32_t>(value & 0xffffffff));
+		emit_int32(static_cast<int32_t>(value >> 32));
+	}
+
+	//	opcode bytes + ModRM with mod = 10 (disp32), then the displacement of the register.
+	void emit_reg_operand(std::initializer_list<uint8_t> opcode, uint8_t modrm, int reg){
+		emit(opcode);
+		emit({ modrm });
+		emit_int32(reg * static_cast<int32_t>(sizeof(bc_pod_value_t)));
+	}
+
+	//	rel32 to patch once all instructions have their native position.
+	void emit_branch_target(int target_pc){
+		_branch_patches.push_back({ static_cast<int>(_code.size()), target_pc });
+		emit_int32(0);
+	}
+
+
+	//////////////////////////////////////		STATE
+	std::vector<uint8_t> _code;
+
+	//	Position of the rel32, pc of the target instruction.
+	std::vector<std::pair<int, int>> _branch_patches;
+};
+
+
+//	mov rax, [rdi + reg]
+static void emit_load_rax(jit_emitter_t& e, int reg){ e.emit_reg_operand({ 0x48, 0x8b }, 0x87, reg); }
+
+//	mov [rdi + reg], rax
+static void emit_store_rax(jit_emitter_t& e, int reg){ e.emit_reg_operand({ 0x48, 0x89 }, 0x87, reg); }
+
+//	movsd xmm0, [rdi + reg]
+static void emit_load_xmm0(jit_emitter_t& e, int reg){ e.emit_reg_operand({ 0xf2, 0x0f, 0x10 }, 0x87, reg); }
+
+//	movsd [rdi + reg], xmm0
+static void emit_store_xmm0(jit_emitter_t& e, int reg){ e.emit_reg_operand({ 0xf2, 0x0f, 0x11 }, 0x87, reg); }
+
+//	cmp byte [rdi + reg], 0
+static void emit_test_bool(jit_emitter_t& e, int reg){
+	e.emit_reg_operand({ 0x80 }, 0xbf, reg);
+	e.emit({ 0x00 });
+}
+
+//	setcc al, movzx eax, al, then store all 64 bits. The interpreter only reads the low byte of a bool.
+static void emit_store_condition(jit_emitter_t& e, uint8_t setcc, int reg){
+	e.emit({ 0x0f, setcc, 0xc0 });
+	e.emit({ 0x0f, 0xb6, 0xc0 });
+	emit_store_rax(e, reg);
+}
+
+//	jcc rel32
+static void emit_jcc(jit_emitter_t& e, uint8_t jcc, int target_pc){
+	e.emit({ 0x0f, jcc });
+	e.emit_branch_target(target_pc);
+}
+
+//	op rax, [rdi + c]
+static void emit_int_arithmetic(jit_emitter_t& e, std::initializer_list<uint8_t> opcode, int a, int b, int c){
+	emit_load_rax(e, b);
+	e.emit_reg_operand(opcode, 0x87, c);
+	emit_store_rax(e, a);
+}
+
+//	op xmm0, [rdi + c]
+static void emit_double_arithmetic(jit_emitter_t& e, uint8_t opcode, int a, int b, int c){
+	emit_load_xmm0(e, b);
+	e.emit_reg_operand({ 0xf2, 0x0f, opcode }, 0x87, c);
+	emit_store_xmm0(e, a);
+}
+
+//	mov rax, imm64 + movq xmm1, rax + op xmm0, xmm1
+static void emit_double_const_arithmetic(jit_emitter_t& e, uint8_t opcode, int a, int b, double constant){
+	int64_t bits = 0;
+	std::memcpy(&bits, &constant, sizeof(bits));
+	emit_load_xmm0(e, b);
+	e.emit({ 0x48, 0xb8 });
+	e.emit_int64(bits);
+	e.emit({ 0x66, 0x48, 0x0f, 0x6e, 0xc8 });
+	e.emit({ 0xf2, 0x0f, opcode, 0xc1 });
+	emit_store_xmm0(e, a);
+}
+
+//	cmp rax, [rdi + c]
+static void emit_compare_regs(jit_emitter_t& e, int b, int c){
+	emit_load_rax(e, b);
+	e.emit_reg_operand({ 0x48, 0x3b }, 0x87, c);
+}
+
+//	cmp rax, imm32
+static void emit_compare_imm(jit_emitter_t& e, int b, int32_t imm){
+	emit_load_rax(e, b);
+	e.emit({ 0x48, 0x3d });
+	e.emit_int32(imm);
+}
+
+
+//	Condition codes. setcc is 0x0f 0x90 + cc, jcc rel32 is 0x0f 0x80 + cc.
+enum {
+	k_cc_e = 0x4,
+	k_cc_ne = 0x5,
+	k_cc_l = 0xc,
+	k_cc_ge = 0xd,
+	k_cc_le = 0xe,
+	k_cc_g = 0xf
+};
+
+
+//////////////////////////////////////		jit_compile_frame()
+
+
+static bool is_inplace_reg(const bc_static_frame_t& frame, int reg){
+	return reg >= 0 && reg < static_cast<int>(frame._symbols.size()) && frame._exts[reg] == false;
+}
+
+std::vector<uint8_t> jit_compile_frame(const bc_static_frame_t& frame, const std::vector<double>& double_constants){
+	QUARK_ASSERT(frame.check_invariant());
+
+	const auto& instrs = frame._instructions;
+	const auto count = static_cast<int>(instrs.size());
+
+	jit_emitter_t e;
+	std::vector<int> native_pos(count, 0);
+	for(int pc = 0 ; pc < count ; pc++){
+		native_pos[pc] = static_cast<int>(e._code.size());
+
+		auto i = decode_instruction(instrs[pc]);
+
+		//	A branch to a k_wide lands on the instruction it widens. Offsets are relative to the widened instruction.
+		if(i._opcode == bc_opcode::k_wide){
+			if(pc + 1 >= count){
+				return {};
+			}
+			pc++;
+			native_pos[pc] = native_pos[pc - 1];
+			const auto& next = instrs[pc];
+			i = bc_decoded_instruction_t{ next._opcode, make_wide_operand(i._a, next._a), make_wide_operand(i._b, next._b), make_wide_operand(i._c, next._c) };
+		}
+
+		const auto regs_ok = [&](bool a, bool b, bool c){
+			return (a == false || is_inplace_reg(frame, i._a))
+				&& (b == false || is_inplace_reg(frame, i._b))
+				&& (c == false || is_inplace_reg(frame, i._c));
+		};
+		const auto branch_ok = [&](int offset){
+			return pc + offset >= 0 && pc + offset < count;
+		};
+		const auto double_constant_ok = [&](int index){
+			return index >= 0 && index < static_cast<int>(double_constants.size());
+		};
+
+		const auto opcode = i._opcode;
+		if(opcode == bc_opcode::k_nop){
+		}
+		else if(opcode == bc_opcode::k_copy_reg_inplace_value && regs_ok(true, true, false)){
+			emit_load_rax(e, i._b);
+			emit_store_rax(e, i._a);
+		}
+		else if(opcode == bc_opcode::k_load_global_inplace_value && regs_ok(true, false, false) && i._b >= 0){
+			//	mov rax, [rsi + global]
+			e.emit_reg_operand({ 0x48, 0x8b }, 0x86, i._b);
+			emit_store_rax(e, i._a);
+		}
+
+		//	Int arithmetic wraps, like in the interpreter. Division is left to the interpreter: it throws on 0.
+		else if(opcode == bc_opcode::k_add_int && regs_ok(true, true, true)){
+			emit_int_arithmetic(e, { 0x48, 0x03 }, i._a, i._b, i._c);
+		}
+		else if(opcode == bc_opcode::k_subtract_int && regs_ok(true, true, true)){
+			emit_int_arithmetic(e, { 0x48, 0x2b }, i._a, i._b, i._c);
+		}
+		else if(opcode == bc_opcode::k_multiply_int && regs_ok(true, true, true)){
+			emit_int_arithmetic(e, { 0x48, 0x0f, 0xaf }, i._a, i._b, i._c);
+		}
+		else if(opcode == bc_opcode::k_add_int_imm && regs_ok(true, true, false)){
+			emit_load_rax(e, i._b);
+			e.emit({ 0x48, 0x05 });
+			e.emit_int32(i._c);
+			emit_store_rax(e, i._a);
+		}
+		else if(opcode == bc_opcode::k_subtract_int_imm && regs_ok(true, true, false)){
+			emit_load_rax(e, i._b);
+			e.emit({ 0x48, 0x2d });
+			e.emit_int32(i._c);
+			emit_store_rax(e, i._a);
+		}
+		else if(opcode == bc_opcode::k_multiply_int_imm && regs_ok(true, true, false)){
+			emit_load_rax(e, i._b);
+			e.emit({ 0x48, 0x69, 0xc0 });
+			e.emit_int32(i._c);
+			emit_store_rax(e, i._a);
+		}
+
+		else if(opcode == bc_opcode::k_add_double && regs_ok(true, true, true)){
+			emit_double_arithmetic(e, 0x58, i._a, i._b, i._c);
+		}
+		else if(opcode == bc_opcode::k_subtract_double && regs_ok(true, true, true)){
+			emit_double_arithmetic(e, 0x5c, i._a, i._b, i._c);
+		}
+		else if(opcode == bc_opcode::k_multiply_double && regs_ok(true, true, true)){
+			emit_double_arithmetic(e, 0x59, i._a, i._b, i._c);
+		}
+		else if(opcode == bc_opcode::k_add_double_const && regs_ok(true, true, false) && double_constant_ok(i._c)){
+			emit_double_const_arithmetic(e, 0x58, i._a, i._b, double_constants[i._c]);
+		}
+		else if(opcode == bc_opcode::k_subtract_double_const && regs_ok(true, true, false) && double_constant_ok(i._c)){
+			emit_double_const_arithmetic(e, 0x5c, i._a, i._b, double_constants[i._c]);
+		}
+		else if(opcode == bc_opcode::k_multiply_double_const && regs_ok(true, true, false) && double_constant_ok(i._c)){
+			emit_double_const_arithmetic(e, 0x59, i._a, i._b, double_constants[i._c]);
+		}
+
+		else if(opcode == bc_opcode::k_logical_and_bool && regs_ok(true, true, true)){
+			//	movzx eax, byte [b], movzx ecx, byte [c], and eax, ecx
+			e.emit_reg_operand({ 0x0f, 0xb6 }, 0x87, i._b);
+			e.emit_reg_operand({ 0x0f, 0xb6 }, 0x8f, i._c);
+			e.emit({ 0x21, 0xc8 });
+			emit_store_rax(e, i._a);
+		}
+		else if(opcode == bc_opcode::k_logical_or_bool && regs_ok(true, true, true)){
+			e.emit_reg_operand({ 0x0f, 0xb6 }, 0x87, i._b);
+			e.emit_reg_operand({ 0x0f, 0xb6 }, 0x8f, i._c);
+			e.emit({ 0x09, 0xc8 });
+			emit_store_rax(e, i._a);
+		}
+
+		else if(opcode == bc_opcode::k_comparison_smaller_int && regs_ok(true, true, true)){
+			emit_compare_regs(e, i._b, i._c);
+			emit_store_condition(e, 0x90 + k_cc_l, i._a);
+		}
+		else if(opcode == bc_opcode::k_comparison_smaller_or_equal_int && regs_ok(true, true, true)){
+			emit_compare_regs(e, i._b, i._c);
+			emit_store_condition(e, 0x90 + k_cc_le, i._a);
+		}
+		else if(opcode == bc_opcode::k_logical_equal_int && regs_ok(true, true, true)){
+			emit_compare_regs(e, i._b, i._c);
+			emit_store_condition(e, 0x90 + k_cc_e, i._a);
+		}
+		else if(opcode == bc_opcode::k_logical_nonequal_int && regs_ok(true, true, true)){
+			emit_compare_regs(e, i._b, i._c);
+			emit_store_condition(e, 0x90 + k_cc_ne, i._a);
+		}
+		else if(opcode == bc_opcode::k_comparison_smaller_int_imm && regs_ok(true, true, false)){
+			emit_compare_imm(e, i._b, i._c);
+			emit_store_condition(e, 0x90 + k_cc_l, i._a);
+		}
+		else if(opcode == bc_opcode::k_comparison_smaller_or_equal_int_imm && regs_ok(true, true, false)){
+			emit_compare_imm(e, i._b, i._c);
+			emit_store_condition(e, 0x90 + k_cc_le, i._a);
+		}
+		else if(opcode == bc_opcode::k_comparison_larger_int_imm && regs_ok(true, true, false)){
+			emit_compare_imm(e, i._b, i._c);
+			emit_store_condition(e, 0x90 + k_cc_g, i._a);
+		}
+		else if(opcode == bc_opcode::k_comparison_larger_or_equal_int_imm && regs_ok(true, true, false)){
+			emit_compare_imm(e, i._b, i._c);
+			emit_store_condition(e, 0x90 + k_cc_ge, i._a);
+		}
+		else if(opcode == bc_opcode::k_logical_equal_int_imm && regs_ok(true, true, false)){
+			emit_compare_imm(e, i._b, i._c);
+			emit_store_condition(e, 0x90 + k_cc_e, i._a);
+		}
+		else if(opcode == bc_opcode::k_logical_nonequal_int_imm && regs_ok(true, true, false)){
+			emit_compare_imm(e, i._b, i._c);
+			emit_store_condition(e, 0x90 + k_cc_ne, i._a);
+		}
+
+		else if(opcode == bc_opcode::k_branch_always && branch_ok(i._a)){
+			e.emit({ 0xe9 });
+			e.emit_branch_target(pc + i._a);
+		}
+		else if(opcode == bc_opcode::k_branch_false_bool && regs_ok(true, false, false) && branch_ok(i._b)){
+			emit_test_bool(e, i._a);
+			emit_jcc(e, 0x80 + k_cc_e, pc + i._b);
+		}
+		else if(opcode == bc_opcode::k_branch_true_bool && regs_ok(true, false, false) && branch_ok(i._b)){
+			emit_test_bool(e, i._a);
+			emit_jcc(e, 0x80 + k_cc_ne, pc + i._b);
+		}
+		else if(opcode == bc_opcode::k_branch_zero_int && regs_ok(true, false, false) && branch_ok(i._b)){
+			emit_compare_imm(e, i._a, 0);
+			emit_jcc(e, 0x80 + k_cc_e, pc + i._b);
+		}
+		else if(opcode == bc_opcode::k_branch_notzero_int && regs_ok(true, false, false) && branch_ok(i._b)){
+			emit_compare_imm(e, i._a, 0);
+			emit_jcc(e, 0x80 + k_cc_ne, pc + i._b);
+		}
+		else if(opcode == bc_opcode::k_branch_smaller_int && regs_ok(true, true, false) && branch_ok(i._c)){
+			emit_compare_regs(e, i._a, i._b);
+			emit_jcc(e, 0x80 + k_cc_l, pc + i._c);
+		}
+		else if(opcode == bc_opcode::k_branch_smaller_or_equal_int && regs_ok(true, true, false) && branch_ok(i._c)){
+			emit_compare_regs(e, i._a, i._b);
+			emit_jcc(e, 0x80 + k_cc_le, pc + i._c);
+		}
+		else if(opcode == bc_opcode::k_branch_equal_int && regs_ok(true, true, false) && branch_ok(i._c)){
+			emit_compare_regs(e, i._a, i._b);
+			emit_jcc(e, 0x80 + k_cc_e, pc + i._c);
+		}
+		else if(opcode == bc_opcode::k_branch_nonequal_int && regs_ok(true, true, false) && branch_ok(i._c)){
+			emit_compare_regs(e, i._a, i._b);
+			emit_jcc(e, 0x80 + k_cc_ne, pc + i._c);
+		}
+		else if(opcode == bc_opcode::k_branch_smaller_int_imm && regs_ok(true, false, false) && branch_ok(i._c)){
+			emit_compare_imm(e, i._a, i._b);
+			emit_jcc(e, 0x80 + k_cc_l, pc + i._c);
+		}
+		else if(opcode == bc_opcode::k_branch_smaller_or_equal_int_imm && regs_ok(true, false, false) && branch_ok(i._c)){
+			emit_compare_imm(e, i._a, i._b);
+			emit_jcc(e, 0x80 + k_cc_le, pc + i._c);
+		}
+		else if(opcode == bc_opcode::k_branch_larger_int_imm && regs_ok(true, false, false) && branch_ok(i._c)){
+			emit_compare_imm(e, i._a, i._b);
+			emit_jcc(e, 0x80 + k_cc_g, pc + i._c);
+		}
+		else if(opcode == bc_opcode::k_branch_larger_or_equal_int_imm && regs_ok(true, false, false) && branch_ok(i._c)){
+			emit_compare_imm(e, i._a, i._b);
+			emit_jcc(e, 0x80 + k_cc_ge, pc + i._c);
+		}
+		else if(opcode == bc_opcode::k_branch_equal_int_imm && regs_ok(true, false, false) && branch_ok(i._c)){
+			emit_compare_imm(e, i._a, i._b);
+			emit_jcc(e, 0x80 + k_cc_e, pc + i._c);
+		}
+		else if(opcode == bc_opcode::k_branch_nonequal_int_imm && regs_ok(true, false, false) && branch_ok(i._c)){
+			emit_compare_imm(e, i._a, i._b);
+			emit_jcc(e, 0x80 + k_cc_ne, pc + i._c);
+		}
+
+		else if(opcode == bc_opcode::k_return && regs_ok(true, false, false)){
+			emit_load_rax(e, i._a);
+			e.emit({ 0xc3 });
+		}
+		else if(opcode == bc_opcode::k_stop){
+			//	xor eax, eax + ret
+			e.emit({ 0x31, 0xc0, 0xc3 });
+		}
+		else{
+			return {};
+		}
+	}
+
+	for(const auto& patch: e._branch_patches){
+		const auto rel = native_pos[patch.second] - (patch.first + 4);
+		const auto u = static_cast<uint32_t>(rel);
+		for(int byte = 0 ; byte < 4 ; byte++){
+			e._code[patch.first + byte] = static_cast<uint8_t>(u >> (byte * 8));
+		}
+	}
+	return e._code;
+}
+
+
+//////////////////////////////////////		bc_jit_t
+
+
+bc_jit_t::~bc_jit_t(){
+#if FLOYD_BC_JIT
+	for(const auto& e: _mappings){
+		munmap(e.first, e.second);
+	}
+#endif
+}
+
+bool is_jit_available(){
+	return FLOYD_BC_JIT == 1;
+}
+
+bool jit_compile_function(bc_jit_t& jit, const bc_program_t& program, int function_id){
+	QUARK_ASSERT(function_id >= 0 && function_id < static_cast<int>(jit._functions.size()));
+
+#if FLOYD_BC_JIT
+	if(jit._functions[function_id] != nullptr){
+		return true;
+	}
+	const auto& function_def = program._function_defs[function_id];
+	if(function_def._host_function_id != 0 || !function_def._frame_ptr || function_def._return_is_ext){
+		return false;
+	}
+	const auto code = jit_compile_frame(*function_def._frame_ptr, program._double_constants);
+	if(code.empty()){
+		return false;
+	}
+
+	//	Write, then flip to read + execute. The memory is never writable and executable at the same time.
+	const auto size = code.size();
+	void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(memory == MAP_FAILED){
+		return false;
+	}
+	std::memcpy(memory, &code[0], size);
+	if(mprotect(memory, size, PROT_READ | PROT_EXEC) != 0){
+		munmap(memory, size);
+		return false;
+	}
+	jit._mappings.push_back({ memory, size });
+	jit._functions[function_id] = reinterpret_cast<bc_jit_function_t>(memory);
+	return true;
+#else
+	return false;
+#endif
+}
+
+std::shared_ptr<bc_jit_t> make_jit(const bc_program_t& program){
+	auto result = std::make_shared<bc_jit_t>(program._function_defs.size());
+	for(int function_id = 0 ; function_id < static_cast<int>(program._function_defs.size()) ; function_id++){
+		jit_compile_function(*result, program, function_id);
+	}
+	return result;
+}
+
+
+//////////////////////////////////////		TESTS
+
+
+static int get_function_id(interpreter_t& vm, const std::string& name){
+	const auto symbol = find_global_symbol2(vm, name);
+	QUARK_ASSERT(symbol != nullptr);
+	return symbol->_value.get_function_value();
+}
+
+const std::string k_jit_test_program = R"(
+
+	container-def {
+		"name": "", "tech": "", "desc": "", "clocks": {},
+		"inline_budget": 0,
+		"jit": true
+	}
+
+	func int sum_to(int n){
+		mutable acc = 0
+		for(i in 0 ..< n){
+			acc = acc + i * 3 - 1
+		}
+		return acc
+	}
+	func double scale(double x, double y){
+		return x * y + 0.5
+	}
+	func bool in_range(int x, int lo, int hi){
+		return x >= lo && x < hi
+	}
+	func int collatz_steps(int n){
+		mutable x = n
+		mutable steps = 0
+		while(x != 1){
+			if(x % 2 == 0){
+				x = x / 2
+			}
+			else{
+				x = x * 3 + 1
+			}
+			steps = steps + 1
+		}
+		return steps
+	}
+	func string greet(string s){
+		return "hi " + s
+	}
+
+	assert(sum_to(10) == 125)
+	assert(sum_to(0) == 0)
+	assert(scale(3.0, 2.0) == 6.5)
+	assert(in_range(5, 0, 10) == true)
+	assert(in_range(10, 0, 10) == false)
+	assert(collatz_steps(27) == 111)
+	assert(greet("x") == "hi x")
+
+)";
+
+QUARK_UNIT_TEST("bytecode_jit", "make_jit()", "compiles leaf functions on inplace values only", ""){
+	const auto program = compile_to_bytecode(k_jit_test_program, "");
+	QUARK_UT_VERIFY(program._container_def._jit == true);
+
+	interpreter_t vm(program);
+	QUARK_UT_VERIFY(vm._tiering._jit != nullptr);
+
+	const auto jit_ptr = make_jit(program);
+	const auto& jit = *jit_ptr;
+	const auto compiled = [&](const std::string& name){ return jit._functions[get_function_id(vm, name)] != nullptr; };
+	QUARK_UT_VERIFY(compiled("sum_to") == is_jit_available());
+	QUARK_UT_VERIFY(compiled("scale") == is_jit_available());
+	QUARK_UT_VERIFY(compiled("in_range") == is_jit_available());
+
+	//	% and / can throw, strings are external values.
+	QUARK_UT_VERIFY(compiled("collatz_steps") == false);
+	QUARK_UT_VERIFY(compiled("greet") == false);
+}
+
+QUARK_UNIT_TEST("bytecode_jit", "bc_jit_function_t", "runs directly on a frame", ""){
+	if(is_jit_available() == false){
+		return;
+	}
+	const auto program = compile_to_bytecode(k_jit_test_program, "");
+	interpreter_t vm(program);
+	const auto function_id = get_function_id(vm, "sum_to");
+	const auto jit = make_jit(program);
+	const auto f = jit->_functions[function_id];
+	const auto& frame = *program._function_defs[function_id]._frame_ptr;
+
+	std::vector<bc_pod_value_t> regs(frame._symbols.size());
+	regs[0]._inplace._int64 = 1000;
+	std::copy(frame._locals_image.begin(), frame._locals_image.end(), regs.begin() + 1);
+	QUARK_UT_VERIFY(f(&regs[0], nullptr) == 1000 * 999 / 2 * 3 - 1000);
+}
+
+QUARK_UNIT_TEST("bytecode_jit", "jit_compile_frame()", "same results as the interpreter", ""){
+	const auto program = compile_to_bytecode(R"(
+
+		container-def {
+			"name": "", "tech": "", "desc": "", "clocks": {},
+			"inline_budget": 0
+		}
+
+		func int f(int a, int b){
+			mutable r = 0
+			if(a < b){
+				r = b - a
+			}
+			else{
+				r = (a - b) * 7 + 4000000000 - 3999999000
+			}
+			while(r > 100){
+				r = r - 100
+			}
+			return r + (a == b ? 1000 : 0) + (a != 3 ? 10 : 20)
+		}
+		func double g(double x){
+			mutable acc = 0.0
+			for(i in 0 ... 3){
+				acc = acc * 1.5 + x - 0.25
+			}
+			return acc
+		}
+
+		//	Calls from Floyd code run the JIT:ed functions.
+		func int f_caller(int a, int b){
+			let r = f(a, b)
+			return r
+		}
+		func double g_caller(double x){
+			let r = g(x)
+			return r
+		}
+
+	)", "");
+
+	const auto run = [&](bool jit){
+		auto config = make_interpreter_config(program._container_def);
+		config._jit = jit;
+		config._tier_up_calls = 1;
+		interpreter_t vm(program, nullptr, config);
+		std::vector<value_t> results;
+		for(const auto& args: std::vector<std::pair<int, int>>{ { 1, 2 }, { 3, 3 }, { 50, 2 }, { -4, 9 } }){
+			results.push_back(call_function(vm, find_global_symbol(vm, "f_caller"), { value_t::make_int(args.first), value_t::make_int(args.second) }));
+		}
+		results.push_back(call_function(vm, find_global_symbol(vm, "g_caller"), { value_t::make_double(2.0) }));
+		results.push_back(call_function(vm, find_global_symbol(vm, "g_caller"), { value_t::make_double(-1.0) }));
+		return results;
+	};
+	QUARK_UT_VERIFY(run(true) == run(false));
+}
+
+
+QUARK_UNIT_TEST("bytecode_jit", "tiering", "function tiers up after enough calls", ""){
+	const auto program = compile_to_bytecode(k_jit_test_program, "");
+	auto config = make_interpreter_config(program._container_def);
+	config._tier_up_calls = 10;
+	interpreter_t vm(program, nullptr, config);
+
+	const auto function_id = get_function_id(vm, "scale");
+	const auto& profile = vm._tiering._profiles[function_id];
+	const auto f = find_global_symbol(vm, "scale");
+	QUARK_UT_VERIFY(profile._call_count == 1);
+
+	for(int i = 1 ; i < 9 ; i++){
+		QUARK_UT_VERIFY(call_function(vm, f, { value_t::make_double(i), value_t::make_double(2.0) }) == value_t::make_double(i * 2.0 + 0.5));
+	}
+	QUARK_UT_VERIFY(profile._call_count == 9);
+	QUARK_UT_VERIFY(profile._tiered_up == false);
+	QUARK_UT_VERIFY(vm._tiering._jit->_functions[function_id] == nullptr);
+
+	for(int i = 9 ; i < 20 ; i++){
+		QUARK_UT_VERIFY(call_function(vm, f, { value_t::make_double(i), value_t::make_double(2.0) }) == value_t::make_double(i * 2.0 + 0.5));
+	}
+	QUARK_UT_VERIFY(profile._call_count == 20);
+	QUARK_UT_VERIFY(profile._tiered_up == true);
+	QUARK_UT_VERIFY((vm._tiering._jit->_functions[function_id] != nullptr) == is_jit_available());
+}
+
+QUARK_UNIT_TEST("bytecode_jit", "tiering", "long loop tiers up its function, later calls run native code", ""){
+	const auto program = compile_to_bytecode(k_jit_test_program, "");
+	auto config = make_interpreter_config(program._container_def);
+	config._tier_up_backedges = 100;
+	interpreter_t vm(program, nullptr, config);
+
+	const auto function_id = get_function_id(vm, "sum_to");
+	const auto& profile = vm._tiering._profiles[function_id];
+	QUARK_UT_VERIFY(profile._tiered_up == false);
+
+	//	The running call stays in the interpreter.
+	const auto f = find_global_symbol(vm, "sum_to");
+	QUARK_UT_VERIFY(call_function(vm, f, { value_t::make_int(1000) }) == value_t::make_int(1000 * 999 / 2 * 3 - 1000));
+	QUARK_UT_VERIFY(profile._backedge_count >= 100);
+	QUARK_UT_VERIFY(profile._tiered_up == true);
+	QUARK_UT_VERIFY((vm._tiering._jit->_functions[function_id] != nullptr) == is_jit_available());
+
+	//	Native code doesn't count back-edges.
+	const auto backedges = profile._backedge_count;
+	QUARK_UT_VERIFY(call_function(vm, f, { value_t::make_int(1000) }) == value_t::make_int(1000 * 999 / 2 * 3 - 1000));
+	QUARK_UT_VERIFY(profile._backedge_count == (is_jit_available() ? backedges : backedges * 2));
+}
+
+QUARK_UNIT_TEST("bytecode_jit", "tiering", "functions the JIT can't compile stay interpreted", ""){
+	const auto program = compile_to_bytecode(k_jit_test_program, "");
+	auto config = make_interpreter_config(program._container_def);
+	config._tier_up_calls = 1;
+	interpreter_t vm(program, nullptr, config);
+
+	const auto function_id = get_function_id(vm, "collatz_steps");
+	QUARK_UT_VERIFY(vm._tiering._profiles[function_id]._tiered_up == true);
+	QUARK_UT_VERIFY(vm._tiering._jit->_functions[function_id] == nullptr);
+	QUARK_UT_VERIFY(call_function(vm, find_global_symbol(vm, "collatz_steps"), { value_t::make_int(27) }) == value_t::make_int(111));
+}
+
+QUARK_UNIT_TEST("bytecode_jit", "tiering", "JIT off: nothing is counted or compiled", ""){
+	const auto program = compile_to_bytecode(k_jit_test_program, "");
+	auto config = make_interpreter_config(program._container_def);
+	config._jit = false;
+	config._tier_up_calls = 1;
+	interpreter_t vm(program, nullptr, config);
+
+	QUARK_UT_VERIFY(vm._tiering._jit == nullptr);
+	const auto function_id = get_function_id(vm, "sum_to");
+	QUARK_UT_VERIFY(vm._tiering._profiles[function_id]._call_count == 0);
+	QUARK_UT_VERIFY(vm._tiering._profiles[function_id]._backedge_count == 0);
+	QUARK_UT_VERIFY(vm._tiering._profiles[function_id]._tiered_up == false);
+}
+
+
+}	//	floyd
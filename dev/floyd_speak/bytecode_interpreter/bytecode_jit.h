@@ -0,0 +1,78 @@
+//
+//  bytecode_jit.h
+//  FloydSpeak
+//
+
+#ifndef bytecode_jit_h
+#define bytecode_jit_h
+
+/*
+	Baseline JIT: translates the instructions of a bc_static_frame_t to x86-64 machine code, one template per opcode.
+
+	The native code works straight on the interpreter stack: it gets a pointer to the frame's first register and
+	to the first global, exactly what execute_instructions() uses. Nothing is kept in CPU registers between opcodes.
+
+	Only functions where every instruction is supported are compiled: inplace ints, doubles and bools, arithmetic
+	that can't throw, int comparisons and branches. No calls, no external values. All other functions -- and all
+	functions on other CPUs / OSes -- run in the interpreter as usual.
+
+	Turn on with "floyd run -j" or "jit": true in the container-def. The interpreter then compiles each function
+	when it gets hot, see bc_function_profile_t.
+*/
+
+#include "bytecode_interpreter.h"
+
+#include <vector>
+#include <cstdint>
+
+namespace floyd {
+
+
+//	Runs a compiled function. regs is the function's frame, with arguments and locals already in place.
+//	Returns the bits of the returned value (always an inplace value), undefined for functions returning void.
+typedef int64_t (*bc_jit_function_t)(bc_pod_value_t* regs, bc_pod_value_t* globals);
+
+
+//////////////////////////////////////		bc_jit_t
+
+//	Native code for a program. Owns the executable memory.
+
+struct bc_jit_t {
+	explicit bc_jit_t(size_t function_count) :
+		_functions(function_count, nullptr)
+	{
+	}
+	~bc_jit_t();
+	bc_jit_t(const bc_jit_t& other) = delete;
+	bc_jit_t& operator=(const bc_jit_t& other) = delete;
+
+
+	//////////////////////////////////////		STATE
+
+	//	One entry per bc_program_t::_function_defs. nullptr = not compiled, use the interpreter.
+	std::vector<bc_jit_function_t> _functions;
+
+	//	Executable memory: address and size of each mapping.
+	std::vector<std::pair<void*, size_t>> _mappings;
+};
+
+
+//	True if this build can run JIT:ed code: x86-64 Linux.
+bool is_jit_available();
+
+//	Returns the machine code for the frame, or an empty vector if the frame uses something the JIT doesn't support.
+std::vector<uint8_t> jit_compile_frame(const bc_static_frame_t& frame, const std::vector<double>& double_constants);
+
+/*
+	Compiles one function of the program and installs it in jit._functions. The entry is set only after the code
+	is executable. Returns false if the function can't be compiled -- it then stays interpreted.
+*/
+bool jit_compile_function(bc_jit_t& jit, const bc_program_t& program, int function_id);
+
+//	Compiles all Floyd functions of the program it can. Never fails: when the JIT is not available no function is compiled.
+std::shared_ptr<bc_jit_t> make_jit(const bc_program_t& program);
+
+
+} //	floyd
+
+#endif /* bytecode_jit_h */
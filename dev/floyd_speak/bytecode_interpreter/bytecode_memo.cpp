@@ -0,0 +1,465 @@
+//
+//  bytecode_memo.cpp
+//  FloydSpeak
+//
+
+#include "bytecode_memo.h"
+
+#include "floyd_interpreter.h"
+#include "ast_value.h"
+
+#include <functional>
+
+namespace floyd {
+
+
+//////////////////////////////////////		bc_hash_value()
+
+
+static size_t hash_combine(size_t seed, size_t value){
+	return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+//	0.0 == -0.0 and NaNs compare equal to each other, see bc_compare_value_true_deep().
+static size_t hash_double(double value){
+	if(value == 0.0){
+		return 0;
+	}
+	else if(value != value){
+		return 1;
+	}
+	else{
+		return std::hash<double>()(value);
+	}
+}
+
+static size_t hash_inplace(const bc_inplace_value_t& value, const typeid_t& type){
+	if(type.is_bool()){
+		return value._bool ? 1 : 0;
+	}
+	else if(type.is_int()){
+		return std::hash<int64_t>()(value._int64);
+	}
+	else if(type.is_double()){
+		return hash_double(value._double);
+	}
+	else{
+		QUARK_ASSERT(false);
+		throw std::exception();
+	}
+}
+
+static bool is_inplace_element(const typeid_t& type){
+	return type.is_bool() || type.is_int() || type.is_double();
+}
+
+size_t bc_hash_value(const bc_value_t& value, const typeid_t& type){
+	QUARK_ASSERT(value.check_invariant());
+
+	if(type.is_undefined() || type.is_void() || type.is_internal_dynamic()){
+		return 0;
+	}
+	else if(type.is_bool()){
+		return value.get_bool_value() ? 1 : 0;
+	}
+	else if(type.is_int()){
+		return std::hash<int64_t>()(value.get_int_value());
+	}
+	else if(type.is_double()){
+		return hash_double(value.get_double_value());
+	}
+	else if(type.is_string()){
+		return hash_pod_string(value._pod);
+	}
+	else if(type.is_json_value()){
+		return std::hash<std::string>()(json_to_compact_string(value.get_json_value()));
+	}
+	else if(type.is_typeid()){
+		return std::hash<std::string>()(typeid_to_compact_string(value.get_typeid_value()));
+	}
+	else if(type.is_function()){
+		return std::hash<int>()(value.get_function_value());
+	}
+	else if(type.is_struct()){
+		const auto& members = type.get_struct()._members;
+		const auto& values = value.get_struct_value();
+		size_t result = members.size();
+		for(size_t i = 0 ; i < members.size() ; i++){
+			result = hash_combine(result, bc_hash_value(values[i], members[i]._type));
+		}
+		return result;
+	}
+	else if(type.is_vector()){
+		const auto& element_type = type.get_vector_element_type();
+		if(is_inplace_element(element_type)){
+			const auto& elements = value._pod._external->get_vector_w_inplace_elements();
+			size_t result = elements.size();
+			for(const auto& e: elements){
+				result = hash_combine(result, hash_inplace(e, element_type));
+			}
+			return result;
+		}
+		else{
+			const auto& elements = *get_vector_external_elements(value);
+			size_t result = elements.size();
+			const auto element_typeid = lookup_bc_vector_element_type(value._typeid);
+			for(const auto& e: elements){
+				result = hash_combine(result, bc_hash_value(bc_value_t(element_typeid, e), element_type));
+			}
+			return result;
+		}
+	}
+
+	//	Entries are summed: the same entries hash the same in any order.
+	else if(type.is_dict()){
+		const auto& value_type = type.get_dict_value_type();
+		if(is_inplace_element(value_type)){
+			const auto& entries = value._pod._external->get_dict_w_inplace_values();
+			size_t result = entries.size();
+			for(const auto& e: entries){
+				result += hash_combine(std::hash<std::string>()(e.first), hash_inplace(e.second, value_type));
+			}
+			return result;
+		}
+		else{
+			const auto& entries = get_dict_value(value);
+			size_t result = entries.size();
+			const auto value_typeid = lookup_bc_dict_value_type(value._typeid);
+			for(const auto& e: entries){
+				result += hash_combine(std::hash<std::string>()(e.first), bc_hash_value(bc_value_t(value_typeid, e.second), value_type));
+			}
+			return result;
+		}
+	}
+	else{
+		QUARK_ASSERT(false);
+		throw std::exception();
+	}
+}
+
+
+//////////////////////////////////////		bc_memo_cache_t
+
+
+bc_memo_cache_t::bc_memo_cache_t(const std::string& name, const typeid_t& function_type, size_t capacity) :
+	_name(name),
+	_function_type(function_type),
+	_capacity(std::max(capacity, size_t(1))),
+	_hit_count(0),
+	_miss_count(0),
+	_eviction_count(0)
+{
+	QUARK_ASSERT(check_invariant());
+}
+
+#if DEBUG
+bool bc_memo_cache_t::check_invariant() const {
+	QUARK_ASSERT(_function_type.is_function());
+	QUARK_ASSERT(_capacity >= 1);
+	QUARK_ASSERT(_entries.size() <= _capacity);
+	QUARK_ASSERT(_index.size() == _entries.size());
+	return true;
+}
+#endif
+
+size_t bc_memo_cache_t::hash_args(const bc_value_t args[], int arg_count) const {
+	const auto& arg_types = _function_type.get_function_args();
+	QUARK_ASSERT(arg_count == static_cast<int>(arg_types.size()));
+
+	size_t result = arg_count;
+	for(int i = 0 ; i < arg_count ; i++){
+		result = hash_combine(result, bc_hash_value(args[i], arg_types[i]));
+	}
+	return result;
+}
+
+static bool are_args_equal(const std::vector<typeid_t>& arg_types, const std::vector<bc_value_t>& a, const bc_value_t b[]){
+	for(size_t i = 0 ; i < a.size() ; i++){
+		if(bc_compare_value_true_deep(a[i], b[i], arg_types[i]) != 0){
+			return false;
+		}
+	}
+	return true;
+}
+
+const bc_value_t* bc_memo_cache_t::find(size_t hash, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(check_invariant());
+
+	const auto& arg_types = _function_type.get_function_args();
+	QUARK_ASSERT(arg_count == static_cast<int>(arg_types.size()));
+
+	const auto range = _index.equal_range(hash);
+	for(auto it = range.first ; it != range.second ; it++){
+		const auto entry_it = it->second;
+		if(are_args_equal(arg_types, entry_it->_args, args)){
+			_entries.splice(_entries.begin(), _entries, entry_it);
+			_hit_count++;
+			return &entry_it->_result;
+		}
+	}
+	_miss_count++;
+	return nullptr;
+}
+
+void bc_memo_cache_t::insert(size_t hash, const std::vector<bc_value_t>& args, const bc_value_t& result){
+	QUARK_ASSERT(check_invariant());
+
+	//	A recursive function can compute the same call more than once before the first result is in.
+	const auto& arg_types = _function_type.get_function_args();
+	const auto range = _index.equal_range(hash);
+	for(auto it = range.first ; it != range.second ; it++){
+		if(are_args_equal(arg_types, it->second->_args, args.data())){
+			return;
+		}
+	}
+
+	if(_entries.size() == _capacity){
+		const auto last_it = std::prev(_entries.end());
+		const auto last_range = _index.equal_range(last_it->_hash);
+		for(auto it = last_range.first ; it != last_range.second ; it++){
+			if(it->second == last_it){
+				_index.erase(it);
+				break;
+			}
+		}
+		_entries.pop_back();
+		_eviction_count++;
+	}
+
+	_entries.push_front(bc_memo_entry_t{ hash, args, result });
+	_index.insert({ hash, _entries.begin() });
+
+	QUARK_ASSERT(check_invariant());
+}
+
+
+//////////////////////////////////////		bc_memo_t
+
+
+void setup_memo(interpreter_t& vm, const interpreter_config_t& config){
+	const auto& function_defs = vm._imm->_program._function_defs;
+	QUARK_ASSERT(vm._memo._caches.size() == function_defs.size());
+
+	for(const auto& name: config._memoize){
+		const auto symbol = find_global_symbol2(vm, name);
+		if(symbol == nullptr || symbol->_value.get_type().is_function() == false){
+			quark::throw_runtime_error("Cannot memoize \"" + name + "\": there is no function with that name.");
+		}
+		const auto function_id = symbol->_value.get_function_value();
+		const auto& function_def = function_defs[function_id];
+		if(
+			function_def._host_function_id != 0
+			|| function_def._function_type.get_function_pure() != epure::pure
+			|| function_def._function_type.get_function_return().is_void()
+		){
+			quark::throw_runtime_error("Cannot memoize \"" + name + "\": only pure Floyd functions that return a value can be memoized.");
+		}
+		vm._memo._caches[function_id] = std::make_shared<bc_memo_cache_t>(name, function_def._function_type, config._memo_capacity);
+	}
+}
+
+const bc_value_t* memo_lookup(interpreter_t& vm, int function_id, std::vector<bc_value_t> args){
+	QUARK_ASSERT(vm._memo._caches[function_id] != nullptr);
+
+	auto& cache = *vm._memo._caches[function_id];
+	const auto hash = cache.hash_args(args.data(), static_cast<int>(args.size()));
+	const auto result = cache.find(hash, args.data(), static_cast<int>(args.size()));
+	if(result == nullptr){
+		vm._memo._pending.push_back(bc_memo_pending_t{ function_id, hash, std::move(args) });
+	}
+	return result;
+}
+
+void memo_store(interpreter_t& vm, int pending_index, const bc_value_t& result){
+	QUARK_ASSERT(pending_index >= 0 && static_cast<size_t>(pending_index) < vm._memo._pending.size());
+
+	const auto& pending = vm._memo._pending[pending_index];
+	vm._memo._caches[pending._function_id]->insert(pending._hash, pending._args, result);
+	vm._memo._pending.erase(vm._memo._pending.begin() + pending_index, vm._memo._pending.end());
+}
+
+json_t memo_stats_to_json(const bc_memo_t& memo){
+	std::map<std::string, json_t> result;
+	for(const auto& cache: memo._caches){
+		if(cache){
+			result.insert({
+				cache->_name,
+				json_t::make_object({
+					{ "hits", json_t(static_cast<double>(cache->_hit_count)) },
+					{ "misses", json_t(static_cast<double>(cache->_miss_count)) },
+					{ "evictions", json_t(static_cast<double>(cache->_eviction_count)) },
+					{ "size", json_t(static_cast<double>(cache->_entries.size())) }
+				})
+			});
+		}
+	}
+	return json_t::make_object(result);
+}
+
+
+//////////////////////////////////////		TESTS
+
+
+QUARK_UNIT_TEST("bytecode_memo", "bc_hash_value()", "equal values hash the same", ""){
+	const auto int_vec_type = typeid_t::make_vector(typeid_t::make_int());
+	const auto a = value_to_bc(value_t::make_vector_value(typeid_t::make_int(), { value_t::make_int(1), value_t::make_int(2) }));
+	const auto b = value_to_bc(value_t::make_vector_value(typeid_t::make_int(), { value_t::make_int(1), value_t::make_int(2) }));
+	const auto c = value_to_bc(value_t::make_vector_value(typeid_t::make_int(), { value_t::make_int(2), value_t::make_int(1) }));
+	QUARK_UT_VERIFY(bc_hash_value(a, int_vec_type) == bc_hash_value(b, int_vec_type));
+	QUARK_UT_VERIFY(bc_hash_value(a, int_vec_type) != bc_hash_value(c, int_vec_type));
+
+	const auto d = typeid_t::make_double();
+	QUARK_UT_VERIFY(bc_hash_value(value_to_bc(value_t::make_double(0.0)), d) == bc_hash_value(value_to_bc(value_t::make_double(-0.0)), d));
+
+	const auto s = typeid_t::make_string();
+	QUARK_UT_VERIFY(bc_hash_value(value_to_bc(value_t::make_string("abc")), s) == bc_hash_value(value_to_bc(value_t::make_string("abc")), s));
+}
+
+QUARK_UNIT_TEST("bytecode_memo", "bc_memo_cache_t", "evicts the least recently used entry", ""){
+	const auto int_type = typeid_t::make_int();
+	bc_memo_cache_t cache("f", typeid_t::make_function(int_type, { int_type }, epure::pure), 2);
+	const auto add = [&](int64_t arg){
+		const auto args = std::vector<bc_value_t>{ bc_value_t::make_int(arg) };
+		cache.insert(cache.hash_args(args.data(), 1), args, bc_value_t::make_int(arg * 10));
+	};
+	const auto find = [&](int64_t arg){
+		const auto args = std::vector<bc_value_t>{ bc_value_t::make_int(arg) };
+		const auto result = cache.find(cache.hash_args(args.data(), 1), args.data(), 1);
+		return result != nullptr ? result->get_int_value() : -1;
+	};
+
+	add(1);
+	add(2);
+	QUARK_UT_VERIFY(find(1) == 10);
+	add(3);
+	QUARK_UT_VERIFY(find(2) == -1);
+	QUARK_UT_VERIFY(find(1) == 10);
+	QUARK_UT_VERIFY(find(3) == 30);
+	QUARK_UT_VERIFY(cache._hit_count == 3);
+	QUARK_UT_VERIFY(cache._miss_count == 1);
+	QUARK_UT_VERIFY(cache._eviction_count == 1);
+}
+
+QUARK_UNIT_TEST("bytecode_memo", "memoize", "repeated calls hit the cache", ""){
+	const auto program = compile_to_bytecode(R"(
+
+		container-def {
+			"name": "", "tech": "", "desc": "", "clocks": {},
+			"memoize": [ "fib", "layout" ]
+		}
+
+		func int fib(int n){
+			if(n < 2){
+				return n
+			}
+			else{
+				return fib(n - 1) + fib(n - 2)
+			}
+		}
+
+		struct box_t { int w int h }
+		func [box_t] layout([int] widths, string title){
+			mutable [box_t] result = []
+			for(i in 0 ..< size(widths)){
+				result = push_back(result, box_t(widths[i], size(title)))
+			}
+			return result
+		}
+
+		func int use_layout(int w){
+			let a = layout([w, 2], "abc")
+			let b = layout([w, 2], "abc")
+			return size(a) + size(b) + a[0].w
+		}
+
+	)", "");
+
+	interpreter_t vm(program);
+	QUARK_UT_VERIFY(call_function(vm, find_global_symbol(vm, "fib"), { value_t::make_int(80) }) == value_t::make_int(23416728348467685));
+
+	QUARK_UT_VERIFY(call_function(vm, find_global_symbol(vm, "use_layout"), { value_t::make_int(7) }) == value_t::make_int(11));
+	QUARK_UT_VERIFY(call_function(vm, find_global_symbol(vm, "use_layout"), { value_t::make_int(7) }) == value_t::make_int(11));
+	QUARK_UT_VERIFY(call_function(vm, find_global_symbol(vm, "use_layout"), { value_t::make_int(8) }) == value_t::make_int(12));
+
+	const auto stats = memo_stats_to_json(vm._memo);
+	QUARK_UT_VERIFY(stats.get_object_element("layout").get_object_element("misses").get_number() == 2);
+	QUARK_UT_VERIFY(stats.get_object_element("layout").get_object_element("hits").get_number() == 4);
+	QUARK_UT_VERIFY(stats.get_object_element("fib").get_object_element("size").get_number() == 81);
+	QUARK_UT_VERIFY(vm._memo._pending.empty());
+}
+
+QUARK_UNIT_TEST("bytecode_memo", "memoize", "functions memoized from the command line aren't inlined", ""){
+	const auto program = compile_to_bytecode(R"(
+
+		func int sq(int n){ return n * n }
+		func int f(int n){ return sq(n) + sq(n + 1) }
+
+	)", "", { "sq" });
+
+	interpreter_t vm(program);
+	QUARK_UT_VERIFY(call_function(vm, find_global_symbol(vm, "f"), { value_t::make_int(3) }) == value_t::make_int(25));
+	QUARK_UT_VERIFY(call_function(vm, find_global_symbol(vm, "f"), { value_t::make_int(3) }) == value_t::make_int(25));
+
+	const auto stats = memo_stats_to_json(vm._memo);
+	QUARK_UT_VERIFY(stats.get_object_element("sq").get_object_element("misses").get_number() == 2);
+	QUARK_UT_VERIFY(stats.get_object_element("sq").get_object_element("hits").get_number() == 2);
+}
+
+QUARK_UNIT_TEST("bytecode_memo", "memoize", "calls that throw leave no pending records", ""){
+	const auto program = compile_to_bytecode(R"(
+
+		container-def {
+			"name": "", "tech": "", "desc": "", "clocks": {},
+			"memoize": [ "get" ]
+		}
+
+		func int get([int] v, int i){
+			return v[i]
+		}
+
+		func int outer(int i){
+			return get([ 1, 2, 3 ], i) + 1
+		}
+
+	)", "");
+
+	for(const auto& name: std::vector<std::string>{ "outer", "get" }){
+		interpreter_t vm(program);
+		const auto args = name == "get"
+			? std::vector<value_t>{ value_t::make_vector_value(typeid_t::make_int(), { value_t::make_int(1) }), value_t::make_int(5) }
+			: std::vector<value_t>{ value_t::make_int(5) };
+		try{
+			call_function(vm, find_global_symbol(vm, name), args);
+			QUARK_UT_VERIFY(false);
+		}
+		catch(const std::runtime_error&){
+		}
+		QUARK_UT_VERIFY(vm._memo._pending.empty());
+	}
+}
+
+QUARK_UNIT_TEST("bytecode_memo", "memoize", "impure function throws", ""){
+	const auto program = compile_to_bytecode(R"(
+
+		container-def {
+			"name": "", "tech": "", "desc": "", "clocks": {},
+			"memoize": [ "f" ]
+		}
+
+		func int f(int n) impure {
+			return n
+		}
+
+	)", "");
+
+	try{
+		interpreter_t vm(program);
+		QUARK_UT_VERIFY(false);
+	}
+	catch(const std::runtime_error& e){
+		QUARK_UT_VERIFY(std::string(e.what()) == "Cannot memoize \"f\": only pure Floyd functions that return a value can be memoized.");
+	}
+}
+
+
+} //	floyd
@@ -0,0 +1,108 @@
+//
+//  bytecode_memo.h
+//  FloydSpeak
+//
+
+#ifndef bytecode_memo_h
+#define bytecode_memo_h
+
+/*
+	Memoization: caches the results of pure Floyd functions, keyed by their argument values.
+
+	Opt-in per function with "memoize": ["layout", "find_path"] in the container-def or "floyd run -m layout,find_path".
+	Only pure functions that return a value can be memoized. Each interpreter has its own caches, no locking.
+
+	Each cache holds at most a fixed number of results and evicts the least recently used one. Arguments are compared
+	deeply, like ==, so a hit needs equal values -- not the same objects.
+
+	Tiny functions may have been inlined by the bytecode generator before "floyd run -m" is applied. Functions named
+	in the container-def are never inlined.
+*/
+
+#include "bytecode_interpreter.h"
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace floyd {
+
+
+//	Structural hash: equal values, as in bc_compare_value_true_deep(), get the same hash.
+size_t bc_hash_value(const bc_value_t& value, const typeid_t& type);
+
+
+//////////////////////////////////////		bc_memo_entry_t
+
+
+struct bc_memo_entry_t {
+	size_t _hash;
+	std::vector<bc_value_t> _args;
+	bc_value_t _result;
+};
+
+
+//////////////////////////////////////		bc_memo_cache_t
+
+/*
+	The cached results of one function. Most recently used entry first.
+	Non-copyable: _index points into _entries.
+*/
+
+struct bc_memo_cache_t {
+	bc_memo_cache_t(const std::string& name, const typeid_t& function_type, size_t capacity);
+	bc_memo_cache_t(const bc_memo_cache_t& other) = delete;
+	bc_memo_cache_t& operator=(const bc_memo_cache_t& other) = delete;
+#if DEBUG
+	public: bool check_invariant() const;
+#endif
+
+	public: size_t hash_args(const bc_value_t args[], int arg_count) const;
+
+	//	Returns the cached result, or nullptr. Counts a hit or a miss. A hit becomes the most recently used entry.
+	public: const bc_value_t* find(size_t hash, const bc_value_t args[], int arg_count);
+
+	//	Evicts the least recently used entry when full.
+	public: void insert(size_t hash, const std::vector<bc_value_t>& args, const bc_value_t& result);
+
+
+	//////////////////////////////////////		STATE
+
+	std::string _name;
+	typeid_t _function_type;
+	size_t _capacity;
+
+	std::list<bc_memo_entry_t> _entries;
+	std::unordered_multimap<size_t, std::list<bc_memo_entry_t>::iterator> _index;
+
+	int64_t _hit_count;
+	int64_t _miss_count;
+	int64_t _eviction_count;
+};
+
+
+//////////////////////////////////////		bc_memo_t
+
+
+/*
+	Sets up the caches for the functions named in config._memoize. Run after the global instructions -- the
+	function values are read from the globals. Throws if a name isn't a pure Floyd function that returns a value.
+*/
+void setup_memo(interpreter_t& vm, const interpreter_config_t& config);
+
+/*
+	Looks up a call to a memoized function. On a hit returns the result.
+	On a miss returns nullptr and records the call in vm._memo._pending -- finish it with memo_store().
+*/
+const bc_value_t* memo_lookup(interpreter_t& vm, int function_id, std::vector<bc_value_t> args);
+
+//	Caches the result of the call recorded at vm._memo._pending[pending_index], then drops it and all records after it.
+void memo_store(interpreter_t& vm, int pending_index, const bc_value_t& result);
+
+//	Hit / miss / eviction counters and sizes, per memoized function.
+json_t memo_stats_to_json(const bc_memo_t& memo);
+
+
+} //	floyd
+
+#endif /* bytecode_memo_h */
@@ -14,6 +14,7 @@
 #include "pass3.h"
 #include "host_functions.h"
 #include "bytecode_generator.h"
+#include "bytecode_const_eval.h"
 
 #include <thread>
 #include <deque>
@@ -42,8 +43,8 @@ std::vector<bc_value_t> values_to_bcs(const std::vector<value_t>& values){
 value_t bc_to_value(const bc_value_t& value){
 	QUARK_ASSERT(value.check_invariant());
 
-	const auto& type = value._type;
-	const auto basetype = value._type.get_base_type();
+	const auto& type = value.get_type();
+	const auto basetype = value.get_type().get_base_type();
 
 	if(basetype == base_type::k_internal_undefined){
 		return value_t::make_undefined();
@@ -90,24 +91,25 @@ value_t bc_to_value(const bc_value_t& value){
 		const auto& element_type  = type.get_vector_element_type();
 		std::vector<value_t> vec2;
 		if(element_type.is_bool()){
-			for(const auto e: value._pod._external->_vector_w_inplace_elements){
+			for(const auto e: value._pod._external->get_vector_w_inplace_elements()){
 				vec2.push_back(value_t::make_bool(e._bool));
 			}
 		}
 		else if(element_type.is_int()){
-			for(const auto e: value._pod._external->_vector_w_inplace_elements){
+			for(const auto e: value._pod._external->get_vector_w_inplace_elements()){
 				vec2.push_back(value_t::make_int(e._int64));
 			}
 		}
 		else if(element_type.is_double()){
-			for(const auto e: value._pod._external->_vector_w_inplace_elements){
+			for(const auto e: value._pod._external->get_vector_w_inplace_elements()){
 				vec2.push_back(value_t::make_double(e._double));
 			}
 		}
 		else{
-			for(const auto& e: value._pod._external->_vector_w_external_elements){
+			const auto element_typeid = lookup_bc_vector_element_type(value._typeid);
+			for(const auto& e: value._pod._external->get_vector_w_external_elements()){
 				QUARK_ASSERT(e.check_invariant());
-				vec2.push_back(bc_to_value(bc_value_t(element_type, e)));
+				vec2.push_back(bc_to_value(bc_value_t(element_typeid, e)));
 			}
 		}
 		return value_t::make_vector_value(element_type, vec2);
@@ -116,23 +118,24 @@ value_t bc_to_value(const bc_value_t& value){
 		const auto& value_type  = type.get_dict_value_type();
 		std::map<std::string, value_t> entries2;
 		if(value_type.is_bool()){
-			for(const auto& e: value._pod._external->_dict_w_inplace_values){
+			for(const auto& e: value._pod._external->get_dict_w_inplace_values()){
 				entries2.insert({ e.first, value_t::make_bool(e.second._bool) });
 			}
 		}
 		else if(value_type.is_int()){
-			for(const auto& e: value._pod._external->_dict_w_inplace_values){
+			for(const auto& e: value._pod._external->get_dict_w_inplace_values()){
 				entries2.insert({ e.first, value_t::make_int(e.second._int64) });
 			}
 		}
 		else if(value_type.is_double()){
-			for(const auto& e: value._pod._external->_dict_w_inplace_values){
+			for(const auto& e: value._pod._external->get_dict_w_inplace_values()){
 				entries2.insert({ e.first, value_t::make_double(e.second._double) });
 			}
 		}
 		else{
-			for(const auto& e: value._pod._external->_dict_w_external_values){
-				entries2.insert({ e.first, bc_to_value(bc_value_t(value_type, e.second)) });
+			const auto value_typeid = lookup_bc_dict_value_type(value._typeid);
+			for(const auto& e: value._pod._external->get_dict_w_external_values()){
+				entries2.insert({ e.first, bc_to_value(bc_value_t(value_typeid, e.second)) });
 			}
 		}
 		return value_t::make_dict_value(value_type, entries2);
@@ -195,45 +198,44 @@ bc_value_t value_to_bc(const value_t& value){
 
 		if(encode_as_vector_w_inplace_elements(vector_type)){
 			const auto& vec = value.get_vector_value();
-			immer::vector<bc_inplace_value_t> vec2;
+			bc_immer_vector_t<bc_inplace_value_t> vec2;
 			if(element_type.is_bool()){
 				for(const auto& e: vec){
-					vec2.push_back(bc_inplace_value_t{._bool = e.get_bool_value()});
+					vec2 = vec2.push_back(bc_inplace_value_t{._bool = e.get_bool_value()});
 				}
 			}
 			else if(element_type.is_int()){
 				for(const auto& e: vec){
-					vec2.push_back(bc_inplace_value_t{._int64 = e.get_int_value()});
+					vec2 = vec2.push_back(bc_inplace_value_t{._int64 = e.get_int_value()});
 				}
 			}
 			else if(element_type.is_double()){
 				for(const auto& e: vec){
-					vec2.push_back(bc_inplace_value_t{._double = e.get_double_value()});
+					vec2 = vec2.push_back(bc_inplace_value_t{._double = e.get_double_value()});
 				}
 			}
-			return make_vector(element_type, vec2);
+			return make_vector(intern_bc_type(vector_type), vec2);
 		}
 		else{
 			const auto& vec = value.get_vector_value();
-			immer::vector<bc_external_handle_t> vec2;
+			bc_immer_vector_t<bc_external_handle_t> vec2;
 			for(const auto& e: vec){
 				const auto bc = value_to_bc(e);
 				const auto hand = bc_external_handle_t(bc);
 				vec2 =vec2.push_back(hand);
 			}
-			return make_vector(element_type, vec2);
+			return make_vector(intern_bc_type(vector_type), vec2);
 		}
 	}
 	else if(basetype == base_type::k_dict){
 		const auto dict_type = value.get_type();
-		const auto value_type = dict_type.get_dict_value_type();
 //??? add handling for int, bool, double
 		const auto elements = value.get_dict_value();
-		immer::map<std::string, bc_external_handle_t> entries2;
+		bc_immer_map_t<std::string, bc_external_handle_t> entries2;
 		for(const auto& e: elements){
 			entries2 = entries2.insert({e.first, bc_external_handle_t(value_to_bc(e.second))});
 		}
-		return make_dict(value_type, entries2);
+		return make_dict(intern_bc_type(dict_type), entries2);
 	}
 	else if(basetype == base_type::k_function){
 		return bc_value_t::make_function_value(value.get_type(), value.get_function_value());
@@ -401,6 +403,10 @@ semantic_ast_t run_semantic_analysis__errors(const ast_t& pass2, const compilati
 
 
 bc_program_t compile_to_bytecode(const std::string& program, const std::string& file){
+	return compile_to_bytecode(program, file, {});
+}
+
+bc_program_t compile_to_bytecode(const std::string& program, const std::string& file, const std::vector<std::string>& memoize){
 	const auto pre = k_builtin_types_and_constants;
 
 	const auto cu = compilation_unit_t{
@@ -417,7 +423,11 @@ bc_program_t compile_to_bytecode(const std::string& program, const std::string&
 	const auto pass2 = json_to_ast(ast_json_t::make(parse_tree._value));
 
 	const auto pass3 = run_semantic_analysis__errors(pass2, cu);
-	const auto bc = generate_bytecode(pass3);
+	auto pass4 = evaluate_constant_calls(pass3);
+	auto& memoize2 = pass4._checked_ast._container_def._memoize;
+	memoize2.insert(memoize2.end(), memoize.begin(), memoize.end());
+
+	const auto bc = generate_bytecode(pass4);
 
 	return bc;
 }
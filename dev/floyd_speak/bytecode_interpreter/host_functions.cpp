@@ -441,13 +441,12 @@ value_t unflatten_json_to_specific_type(const json_t& v, const typeid_t& target_
 }
 
 
-bc_value_t host__assert(interpreter_t& vm, const bc_value_t args[], int arg_count){
+bc_value_t host__assert(interpreter_t& vm, const bc_host_args_t& args){
 	QUARK_ASSERT(vm.check_invariant());
-	QUARK_ASSERT(arg_count == 1);
-	QUARK_ASSERT(args[0]._type.is_bool());
+	QUARK_ASSERT(args.size() == 1);
+	QUARK_ASSERT(args.get_type(0).is_bool());
 
-	const auto& value = args[0];
-	bool ok = value.get_bool_value();
+	bool ok = args.get_pod(0)._inplace._bool;
 	if(!ok){
 		vm._print_output.push_back("Assertion failed.");
 		quark::throw_runtime_error("Floyd assertion failed.");
@@ -479,7 +478,7 @@ bc_value_t host__typeof(interpreter_t& vm, const bc_value_t args[], int arg_coun
 	QUARK_ASSERT(arg_count == 1);
 
 	const auto& value = args[0];
-	const auto type = value._type;
+	const auto type = value.get_type();
 	const auto result = value_t::make_typeid_value(type);
 	return value_to_bc(result);
 }
@@ -504,11 +503,11 @@ bc_value_t host__update(interpreter_t& vm, const bc_value_t args[], int arg_coun
 		QUARK_ASSERT(false);
 
 	const auto obj = args[0];
-	if(obj._type.is_string()){
+	if(obj.get_type().is_string()){
 		const auto size = obj.get_string_value().size();
 		return bc_value_t::make_int(static_cast<int>(size));
 	}
-	else if(obj._type.is_json_value()){
+	else if(obj.get_type().is_json_value()){
 		const auto value = obj.get_json_value();
 		if(value.is_object()){
 			const auto size = value.get_object_size();
@@ -526,9 +525,9 @@ bc_value_t host__update(interpreter_t& vm, const bc_value_t args[], int arg_coun
 			quark::throw_runtime_error("Calling size() on unsupported type of value.");
 		}
 	}
-	else if(obj._type.is_vector()){
-		if(encode_as_vector_w_inplace_elements(obj._type)){
-			const auto size = obj._pod._external->_vector_w_inplace_elements.size();
+	else if(obj.get_type().is_vector()){
+		if(encode_as_vector_w_inplace_elements(obj.get_type())){
+			const auto size = obj._pod._external->get_vector_w_inplace_elements().size();
 			return bc_value_t::make_int(static_cast<int>(size));
 		}
 		else{
@@ -536,9 +535,9 @@ bc_value_t host__update(interpreter_t& vm, const bc_value_t args[], int arg_coun
 			return bc_value_t::make_int(static_cast<int>(size));
 		}
 	}
-	else if(obj._type.is_dict()){
-		if(encode_as_dict_w_inplace_values(obj._type)){
-			const auto size = obj._pod._external->_dict_w_inplace_values.size();
+	else if(obj.get_type().is_dict()){
+		if(encode_as_dict_w_inplace_values(obj.get_type())){
+			const auto size = obj._pod._external->get_dict_w_inplace_values().size();
 			return bc_value_t::make_int(static_cast<int>(size));
 		}
 		else{
@@ -552,62 +551,67 @@ bc_value_t host__update(interpreter_t& vm, const bc_value_t args[], int arg_coun
 }
 */
 
-bc_value_t host__find(interpreter_t& vm, const bc_value_t args[], int arg_count){
+bc_value_t host__find(interpreter_t& vm, const bc_host_args_t& args){
 	QUARK_ASSERT(vm.check_invariant());
-	QUARK_ASSERT(arg_count == 2);
+	QUARK_ASSERT(args.size() == 2);
 
-	const auto obj = args[0];
-	const auto wanted = args[1];
+	const auto& obj_type = args.get_type(0);
+	const auto& obj = args.get_pod(0);
+	const auto& wanted_type = args.get_type(1);
+	const auto& wanted = args.get_pod(1);
 
-	if(obj._type.is_string()){
-		const auto str = obj.get_string_value();
-		const auto wanted2 = wanted.get_string_value();
+	if(obj_type.is_string()){
+		std::string str_storage;
+		std::string wanted_storage;
+		const auto& str = get_pod_string(obj, str_storage);
+		const auto& wanted2 = get_pod_string(wanted, wanted_storage);
 
 		const auto r = str.find(wanted2);
 		int result = r == std::string::npos ? -1 : static_cast<int>(r);
 		return bc_value_t::make_int(result);
 	}
-	else if(obj._type.is_vector()){
-		const auto element_type = obj._type.get_vector_element_type();
-		if(wanted._type != element_type){
+	else if(obj_type.is_vector()){
+		const auto& element_type = obj_type.get_vector_element_type();
+		if(wanted_type != element_type){
 			QUARK_ASSERT(false);
 			quark::throw_runtime_error("Type mismatch.");
 		}
-		else if(obj._type.get_vector_element_type().is_bool()){
-			const auto& vec = obj._pod._external->_vector_w_inplace_elements;
+		else if(element_type.is_bool()){
+			const auto& vec = obj._external->get_vector_w_inplace_elements();
 			int index = 0;
 			const auto size = vec.size();
-			while(index < size && vec[index]._bool != wanted._pod._inplace._bool){
+			while(index < size && vec[index]._bool != wanted._inplace._bool){
 				index++;
 			}
 			int result = index == size ? -1 : static_cast<int>(index);
 			return bc_value_t::make_int(result);
 		}
-		else if(obj._type.get_vector_element_type().is_int()){
-			const auto& vec = obj._pod._external->_vector_w_inplace_elements;
+		else if(element_type.is_int()){
+			const auto& vec = obj._external->get_vector_w_inplace_elements();
 			int index = 0;
 			const auto size = vec.size();
-			while(index < size && vec[index]._int64 != wanted._pod._inplace._int64){
+			while(index < size && vec[index]._int64 != wanted._inplace._int64){
 				index++;
 			}
 			int result = index == size ? -1 : static_cast<int>(index);
 			return bc_value_t::make_int(result);
 		}
-		else if(obj._type.get_vector_element_type().is_double()){
-			const auto& vec = obj._pod._external->_vector_w_inplace_elements;
+		else if(element_type.is_double()){
+			const auto& vec = obj._external->get_vector_w_inplace_elements();
 			int index = 0;
 			const auto size = vec.size();
-			while(index < size && vec[index]._double != wanted._pod._inplace._double){
+			while(index < size && vec[index]._double != wanted._inplace._double){
 				index++;
 			}
 			int result = index == size ? -1 : static_cast<int>(index);
 			return bc_value_t::make_int(result);
 		}
 		else{
-			const auto& vec = *get_vector_external_elements(obj);
+			const auto& vec = obj._external->get_vector_w_external_elements();
+			const auto wanted2 = bc_external_handle_t(wanted._external);
 			const auto size = vec.size();
 			int index = 0;
-			while(index < size && bc_compare_value_exts(vec[index], bc_external_handle_t(wanted), element_type) != 0){
+			while(index < size && bc_compare_value_exts(vec[index], wanted2, args.get_typeid(1)) != 0){
 				index++;
 			}
 			int result = index == size ? -1 : static_cast<int>(index);
@@ -622,27 +626,27 @@ bc_value_t host__find(interpreter_t& vm, const bc_value_t args[], int arg_count)
 //??? user function type overloading and create several different functions, depending on the DYN argument.
 
 
-bc_value_t host__exists(interpreter_t& vm, const bc_value_t args[], int arg_count){
+bc_value_t host__exists(interpreter_t& vm, const bc_host_args_t& args){
 	QUARK_ASSERT(vm.check_invariant());
-	QUARK_ASSERT(arg_count == 2);
+	QUARK_ASSERT(args.size() == 2);
 
-	const auto obj = args[0];
-	const auto key = args[1];
+	const auto& obj_type = args.get_type(0);
+	const auto& obj = args.get_pod(0);
 
-	if(obj._type.is_dict()){
-		if(key._type.is_string() == false){
+	if(obj_type.is_dict()){
+		if(args.get_type(1).is_string() == false){
 			quark::throw_runtime_error("Key must be string.");
 		}
 
-		const auto key_string = key.get_string_value();
+		std::string key_storage;
+		const auto& key_string = get_pod_string(args.get_pod(1), key_storage);
 
-		if(encode_as_dict_w_inplace_values(obj._type)){
-			const auto found_ptr = obj._pod._external->_dict_w_inplace_values.find(key_string);
+		if(encode_as_dict_w_inplace_values(obj_type)){
+			const auto found_ptr = obj._external->get_dict_w_inplace_values().find(key_string);
 			return bc_value_t::make_bool(found_ptr != nullptr);
 		}
 		else{
-			const auto entries = get_dict_value(obj);
-			const auto found_ptr = entries.find(key_string);
+			const auto found_ptr = obj._external->get_dict_w_external_values().find(key_string);
 			return bc_value_t::make_bool(found_ptr != nullptr);
 		}
 	}
@@ -658,22 +662,21 @@ bc_value_t host__erase(interpreter_t& vm, const bc_value_t args[], int arg_count
 	const auto obj = args[0];
 	const auto key = args[1];
 
-	if(obj._type.is_dict()){
-		if(key._type.is_string() == false){
+	if(obj.get_type().is_dict()){
+		if(key.get_type().is_string() == false){
 			quark::throw_runtime_error("Key must be string.");
 		}
 		const auto key_string = key.get_string_value();
 
-		const auto value_type = obj._type.get_dict_value_type();
-		if(encode_as_dict_w_inplace_values(obj._type)){
-			auto entries2 = obj._pod._external->_dict_w_inplace_values.erase(key_string);
-			const auto value2 = make_dict(value_type, entries2);
+		if(encode_as_dict_w_inplace_values(obj.get_type())){
+			auto entries2 = obj._pod._external->get_dict_w_inplace_values().erase(key_string);
+			const auto value2 = make_dict(obj._typeid, entries2);
 			return value2;
 		}
 		else{
 			auto entries2 = get_dict_value(obj);
 			entries2 = entries2.erase(key_string);
-			const auto value2 = make_dict(value_type, entries2);
+			const auto value2 = make_dict(obj._typeid, entries2);
 			return value2;
 		}
 	}
@@ -692,20 +695,20 @@ bc_value_t host__push_back(interpreter_t& vm, const bc_value_t args[], int arg_c
 
 	const auto obj = args[0];
 	const auto element = args[1];
-	if(obj._type.is_string()){
+	if(obj.get_type().is_string()){
 		const auto str = obj.get_string_value();
 		const auto ch = element.get_string_value();
 		auto str2 = str + ch;
 		return bc_value_t::make_string(str2);
 	}
-	else if(obj._type.is_vector()){
+	else if(obj.get_type().is_vector()){
 		QUARK_ASSERT(false);
-		const auto element_type = obj._type.get_vector_element_type();
-		if(element._type != element_type){
+		const auto element_type = obj.get_type().get_vector_element_type();
+		if(element.get_type() != element_type){
 			quark::throw_runtime_error("Type mismatch.");
 		}
-		else if(encode_as_vector_w_inplace_elements(obj._type)){
-			auto elements2 = obj._pod._external->_vector_w_inplace_elements.push_back(element._pod._pod64);
+		else if(encode_as_vector_w_inplace_elements(obj.get_type())){
+			auto elements2 = obj._pod._external->get_vector_w_inplace_elements().push_back(element._pod._pod64);
 			const auto v = make_vector(element_type, elements2);
 			return v;
 		}
@@ -726,8 +729,8 @@ bc_value_t host__push_back(interpreter_t& vm, const bc_value_t args[], int arg_c
 bc_value_t host__subset(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 3);
-	QUARK_ASSERT(args[1]._type.is_int());
-	QUARK_ASSERT(args[2]._type.is_int());
+	QUARK_ASSERT(args[1].get_type().is_int());
+	QUARK_ASSERT(args[2].get_type().is_int());
 
 	const auto obj = args[0];
 
@@ -738,41 +741,33 @@ bc_value_t host__subset(interpreter_t& vm, const bc_value_t args[], int arg_coun
 	}
 
 	//??? Move functionallity into seprate function.
-	if(obj._type.is_string()){
-		const auto str = obj.get_string_value();
-		const auto start2 = std::min(start, static_cast<int64_t>(str.size()));
-		const auto end2 = std::min(end, static_cast<int64_t>(str.size()));
-
-		string str2;
-		for(auto i = start2 ; i < end2 ; i++){
-			str2.push_back(str[i]);
-		}
-		const auto v = bc_value_t::make_string(str2);
-		return v;
-	}
-	else if(obj._type.is_vector()){
-		if(encode_as_vector_w_inplace_elements(obj._type)){
-			const auto& element_type = obj._type.get_vector_element_type();
-			const auto& vec = obj._pod._external->_vector_w_inplace_elements;
+	if(obj.get_type().is_string()){
+		const auto size = static_cast<int64_t>(get_pod_string_size(obj._pod));
+		const auto start2 = std::min(start, size);
+		const auto end2 = std::max(start2, std::min(end, size));
+		return bc_value_t::adopt_string(subset_pod_string(obj._pod, start2, end2));
+	}
+	else if(obj.get_type().is_vector()){
+		if(encode_as_vector_w_inplace_elements(obj.get_type())){
+			const auto& vec = obj._pod._external->get_vector_w_inplace_elements();
 			const auto start2 = std::min(start, static_cast<int64_t>(vec.size()));
 			const auto end2 = std::min(end, static_cast<int64_t>(vec.size()));
-			immer::vector<bc_inplace_value_t> elements2;
+			bc_immer_vector_t<bc_inplace_value_t> elements2;
 			for(auto i = start2 ; i < end2 ; i++){
 				elements2 = elements2.push_back(vec[i]);
 			}
-			const auto v = make_vector(element_type, elements2);
+			const auto v = make_vector(obj._typeid, elements2);
 			return v;
 		}
 		else{
-			const auto& vec = obj._pod._external->_vector_w_external_elements;
-			const auto element_type = obj._type.get_vector_element_type();
+			const auto& vec = obj._pod._external->get_vector_w_external_elements();
 			const auto start2 = std::min(start, static_cast<int64_t>(vec.size()));
 			const auto end2 = std::min(end, static_cast<int64_t>(vec.size()));
-			immer::vector<bc_external_handle_t> elements2;
+			bc_immer_vector_t<bc_external_handle_t> elements2;
 			for(auto i = start2 ; i < end2 ; i++){
 				elements2 = elements2.push_back(vec[i]);
 			}
-			const auto v = make_vector(element_type, elements2);
+			const auto v = make_vector(obj._typeid, elements2);
 			return v;
 		}
 	}
@@ -786,8 +781,8 @@ bc_value_t host__subset(interpreter_t& vm, const bc_value_t args[], int arg_coun
 bc_value_t host__replace(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 4);
-	QUARK_ASSERT(args[1]._type.is_int());
-	QUARK_ASSERT(args[2]._type.is_int());
+	QUARK_ASSERT(args[1].get_type().is_int());
+	QUARK_ASSERT(args[2].get_type().is_int());
 
 	const auto obj = args[0];
 
@@ -796,53 +791,47 @@ bc_value_t host__replace(interpreter_t& vm, const bc_value_t args[], int arg_cou
 	if(start < 0 || end < 0){
 		quark::throw_runtime_error("replace() requires start and end to be non-negative.");
 	}
-	if(args[3]._type != args[0]._type){
+	if(args[3].get_type() != args[0].get_type()){
 		quark::throw_runtime_error("replace() requires 4th arg to be same as argument 0.");
 	}
 
-	if(obj._type.is_string()){
-		const auto str = obj.get_string_value();
-		const auto start2 = std::min(start, static_cast<int64_t>(str.size()));
-		const auto end2 = std::min(end, static_cast<int64_t>(str.size()));
-		const auto new_bits = args[3].get_string_value();
-
-		string str2 = str.substr(0, start2) + new_bits + str.substr(end2);
-		const auto v = bc_value_t::make_string(str2);
-		return v;
-	}
-	else if(obj._type.is_vector()){
-		if(encode_as_vector_w_inplace_elements(obj._type)){
-			const auto& vec = obj._pod._external->_vector_w_inplace_elements;
-			const auto element_type = obj._type.get_vector_element_type();
+	if(obj.get_type().is_string()){
+		const auto size = static_cast<int64_t>(get_pod_string_size(obj._pod));
+		const auto start2 = std::min(start, size);
+		const auto end2 = std::min(end, size);
+		return bc_value_t::adopt_string(replace_pod_string(obj._pod, start2, end2, args[3]._pod));
+	}
+	else if(obj.get_type().is_vector()){
+		if(encode_as_vector_w_inplace_elements(obj.get_type())){
+			const auto& vec = obj._pod._external->get_vector_w_inplace_elements();
 			const auto start2 = std::min(start, static_cast<int64_t>(vec.size()));
 			const auto end2 = std::min(end, static_cast<int64_t>(vec.size()));
-			const auto& new_bits = args[3]._pod._external->_vector_w_inplace_elements;
+			const auto& new_bits = args[3]._pod._external->get_vector_w_inplace_elements();
 
-			auto result = immer::vector<bc_inplace_value_t>(vec.begin(), vec.begin() + start2);
+			auto result = bc_immer_vector_t<bc_inplace_value_t>(vec.begin(), vec.begin() + start2);
 			for(int i = 0 ; i < new_bits.size() ; i++){
 				result = result.push_back(new_bits[i]);
 			}
 			for(int i = 0 ; i < (vec.size( ) - end2) ; i++){
 				result = result.push_back(vec[end2 + i]);
 			}
-			const auto v = make_vector(element_type, result);
+			const auto v = make_vector(obj._typeid, result);
 			return v;
 		}
 		else{
-			const auto& vec = obj._pod._external->_vector_w_external_elements;
-			const auto element_type = obj._type.get_vector_element_type();
+			const auto& vec = obj._pod._external->get_vector_w_external_elements();
 			const auto start2 = std::min(start, static_cast<int64_t>(vec.size()));
 			const auto end2 = std::min(end, static_cast<int64_t>(vec.size()));
-			const auto& new_bits = args[3]._pod._external->_vector_w_external_elements;
+			const auto& new_bits = args[3]._pod._external->get_vector_w_external_elements();
 
-			auto result = immer::vector<bc_external_handle_t>(vec.begin(), vec.begin() + start2);
+			auto result = bc_immer_vector_t<bc_external_handle_t>(vec.begin(), vec.begin() + start2);
 			for(int i = 0 ; i < new_bits.size() ; i++){
 				result = result.push_back(new_bits[i]);
 			}
 			for(int i = 0 ; i < (vec.size( ) - end2) ; i++){
 				result = result.push_back(vec[end2 + i]);
 			}
-			const auto v = make_vector(element_type, result);
+			const auto v = make_vector(obj._typeid, result);
 			return v;
 		}
 	}
@@ -856,7 +845,7 @@ bc_value_t host__replace(interpreter_t& vm, const bc_value_t args[], int arg_cou
 bc_value_t host__script_to_jsonvalue(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 1);
-	QUARK_ASSERT(args[0]._type.is_string());
+	QUARK_ASSERT(args[0].get_type().is_string());
 
 	const string s = args[0].get_string_value();
 	std::pair<json_t, seq_t> result = parse_json(seq_t(s));
@@ -867,7 +856,7 @@ bc_value_t host__script_to_jsonvalue(interpreter_t& vm, const bc_value_t args[],
 bc_value_t host__jsonvalue_to_script(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 1);
-	QUARK_ASSERT(args[0]._type.is_json_value());
+	QUARK_ASSERT(args[0].get_type().is_json_value());
 
 	const auto value0 = args[0].get_json_value();
 	const string s = json_to_compact_string(value0);
@@ -888,8 +877,8 @@ bc_value_t host__value_to_jsonvalue(interpreter_t& vm, const bc_value_t args[],
 bc_value_t host__jsonvalue_to_value(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 2);
-	QUARK_ASSERT(args[0]._type.is_json_value());
-	QUARK_ASSERT(args[1]._type.is_typeid());
+	QUARK_ASSERT(args[0].get_type().is_json_value());
+	QUARK_ASSERT(args[1].get_type().is_typeid());
 
 	const auto json_value = args[0].get_json_value();
 	const auto target_type = args[1].get_typeid_value();
@@ -900,7 +889,7 @@ bc_value_t host__jsonvalue_to_value(interpreter_t& vm, const bc_value_t args[],
 bc_value_t host__get_json_type(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 1);
-	QUARK_ASSERT(args[0]._type.is_json_value());
+	QUARK_ASSERT(args[0].get_type().is_json_value());
 
 
 	const auto json_value = args[0].get_json_value();
@@ -958,7 +947,7 @@ sha1_t sha1_from_string(string s)
 bc_value_t host__calc_string_sha1(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 1);
-	QUARK_ASSERT(args[0]._type.is_string());
+	QUARK_ASSERT(args[0].get_type().is_string());
 
 	const auto& s = args[0].get_string_value();
 	const auto sha1 = CalcSHA1(s);
@@ -985,11 +974,11 @@ bc_value_t host__calc_string_sha1(interpreter_t& vm, const bc_value_t args[], in
 bc_value_t host__calc_binary_sha1(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 1);
-	QUARK_ASSERT(args[0]._type == make__binary_t__type());
+	QUARK_ASSERT(args[0].get_type() == make__binary_t__type());
 
 	const auto& sha1_struct = args[0].get_struct_value();
 	QUARK_ASSERT(sha1_struct.size() == make__binary_t__type().get_struct()._members.size());
-	QUARK_ASSERT(sha1_struct[0]._type.is_string());
+	QUARK_ASSERT(sha1_struct[0].get_type().is_string());
 
 	const auto& sha1_string = sha1_struct[0].get_string_value();
 	const auto sha1 = CalcSHA1(sha1_string);
@@ -1021,17 +1010,17 @@ bc_value_t host__map(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 2);
 
-	if(args[0]._type.is_vector() == false){
+	if(args[0].get_type().is_vector() == false){
 		quark::throw_runtime_error("map() arg 1 must be a vector.");
 	}
-	const auto e_type = args[0]._type.get_vector_element_type();
+	const auto e_type = args[0].get_type().get_vector_element_type();
 
-	if(args[1]._type.is_function() == false){
+	if(args[1].get_type().is_function() == false){
 		quark::throw_runtime_error("map() requires start and end to be integers.");
 	}
 	const auto f = args[1];
-	const auto f_arg_types = f._type.get_function_args();
-	const auto r_type = f._type.get_function_return();
+	const auto f_arg_types = f.get_type().get_function_args();
+	const auto r_type = f.get_type().get_function_return();
 
 	if(f_arg_types.size() != 1){
 		quark::throw_runtime_error("map() function f requries 1 argument.");
@@ -1049,7 +1038,7 @@ bc_value_t host__map(interpreter_t& vm, const bc_value_t args[], int arg_count){
 		vec2 = vec2.push_back(result1);
 	}
 
-	const auto result = make_vector(r_type, vec2);
+	const auto result = make_vector(intern_bc_type(typeid_t::make_vector(r_type)), vec2);
 
 #if 1
 	const auto debug = value_and_type_to_ast_json(bc_to_value(result));
@@ -1067,12 +1056,12 @@ bc_value_t host__map(interpreter_t& vm, const bc_value_t args[], int arg_count){
 bc_value_t host__map_string(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 2);
-	QUARK_ASSERT(args[0]._type.is_string());
-	QUARK_ASSERT(args[1]._type.is_function());
+	QUARK_ASSERT(args[0].get_type().is_string());
+	QUARK_ASSERT(args[1].get_type().is_function());
 
 	const auto f = args[1];
-	const auto f_arg_types = f._type.get_function_args();
-	const auto r_type = f._type.get_function_return();
+	const auto f_arg_types = f.get_type().get_function_args();
+	const auto r_type = f.get_type().get_function_return();
 
 	if(f_arg_types.size() != 1){
 		quark::throw_runtime_error("map_string() function f requries 1 argument.");
@@ -1087,7 +1076,7 @@ bc_value_t host__map_string(interpreter_t& vm, const bc_value_t args[], int arg_
 	for(const auto& e: input_vec){
 		const bc_value_t f_args[1] = { bc_value_t::make_string(std::string(1, e)) };
 		const auto result1 = call_function_bc(vm, f, f_args, 1);
-		QUARK_ASSERT(result1._type.is_string());
+		QUARK_ASSERT(result1.get_type().is_string());
 		vec2.append(result1.get_string_value());
 	}
 
@@ -1115,7 +1104,7 @@ bc_value_t host__reduce(interpreter_t& vm, const bc_value_t args[], int arg_coun
 	QUARK_ASSERT(arg_count == 3);
 
 	//	Check topology.
-	if(args[0]._type.is_vector() == false || args[2]._type.is_function() == false || args[2]._type.get_function_args().size () != 2){
+	if(args[0].get_type().is_vector() == false || args[2].get_type().is_function() == false || args[2].get_type().get_function_args().size () != 2){
 		quark::throw_runtime_error("reduce() requires 3 arguments.");
 	}
 
@@ -1124,8 +1113,8 @@ bc_value_t host__reduce(interpreter_t& vm, const bc_value_t args[], int arg_coun
 	const auto& f = args[2];
 
 	if(
-		elements._type.get_vector_element_type() != f._type.get_function_args()[1]
-		&& init._type != f._type.get_function_args()[0]
+		elements.get_type().get_vector_element_type() != f.get_type().get_function_args()[1]
+		&& init.get_type() != f.get_type().get_function_args()[0]
 	)
 	{
 		quark::throw_runtime_error("R reduce([E] elements, R init_value, R (R acc, E element) f");
@@ -1164,16 +1153,15 @@ bc_value_t host__filter(interpreter_t& vm, const bc_value_t args[], int arg_coun
 	QUARK_ASSERT(arg_count == 2);
 
 	//	Check topology.
-	if(args[0]._type.is_vector() == false || args[1]._type.is_function() == false || args[1]._type.get_function_args().size () != 1){
+	if(args[0].get_type().is_vector() == false || args[1].get_type().is_function() == false || args[1].get_type().get_function_args().size () != 1){
 		quark::throw_runtime_error("filter() requires 2 arguments.");
 	}
 
 	const auto& elements = args[0];
 	const auto& f = args[1];
-	const auto& e_type = elements._type.get_vector_element_type();
 
 	if(
-		elements._type.get_vector_element_type() != f._type.get_function_args()[0]
+		elements.get_type().get_vector_element_type() != f.get_type().get_function_args()[0]
 	)
 	{
 		quark::throw_runtime_error("[E] filter([E], bool f(E e))");
@@ -1185,14 +1173,14 @@ bc_value_t host__filter(interpreter_t& vm, const bc_value_t args[], int arg_coun
 	for(const auto& e: input_vec){
 		const bc_value_t f_args[1] = { e };
 		const auto result1 = call_function_bc(vm, f, f_args, 1);
-		QUARK_ASSERT(result1._type.is_bool());
+		QUARK_ASSERT(result1.get_type().is_bool());
 
 		if(result1.get_bool_value()){
 			vec2 = vec2.push_back(e);
 		}
 	}
 
-	const auto result = make_vector(e_type, vec2);
+	const auto result = make_vector(elements._typeid, vec2);
 
 #if 1
 	const auto debug = value_and_type_to_ast_json(bc_to_value(result));
@@ -1217,25 +1205,26 @@ bc_value_t host__supermap(interpreter_t& vm, const bc_value_t args[], int arg_co
 	QUARK_ASSERT(arg_count == 3);
 
 	//	Check topology.
-	if(args[0]._type.is_vector() && args[1]._type == typeid_t::make_vector(typeid_t::make_int()) && args[2]._type.is_function() && args[2]._type.get_function_args().size () == 2){
+	if(args[0].get_type().is_vector() && args[1].get_type() == typeid_t::make_vector(typeid_t::make_int()) && args[2].get_type().is_function() && args[2].get_type().get_function_args().size () == 2){
 	}
 	else{
 		quark::throw_runtime_error("supermap() requires 3 arguments.");
 	}
 
 	const auto& elements = args[0];
-	const auto& e_type = elements._type.get_vector_element_type();
+	const auto& e_type = elements.get_type().get_vector_element_type();
 	const auto& parents = args[1];
 	const auto& f = args[2];
-	const auto& r_type = args[2]._type.get_function_return();
+	const auto& r_type = args[2].get_type().get_function_return();
 	if(
-		e_type == f._type.get_function_args()[0]
-		&& r_type == f._type.get_function_args()[1].get_vector_element_type()
+		e_type == f.get_type().get_function_args()[0]
+		&& r_type == f.get_type().get_function_args()[1].get_vector_element_type()
 	){
 	}
 	else {
 		quark::throw_runtime_error("R supermap([E] elements, R init_value, R (R acc, E element) f");
 	}
+	const auto r_vector_type = intern_bc_type(f.get_type().get_function_args()[1]);
 
 	const auto elements2 = get_vector(elements);
 	const auto parents2 = get_vector(parents);
@@ -1287,13 +1276,13 @@ bc_value_t host__supermap(interpreter_t& vm, const bc_value_t args[], int arg_co
 					QUARK_ASSERT(element_index2 != -1);
 					QUARK_ASSERT(element_index2 >= -1 && element_index2 < elements2.size());
 					QUARK_ASSERT(rcs[element_index2] == -1);
-					QUARK_ASSERT(complete[element_index2]._type.is_undefined() == false);
+					QUARK_ASSERT(complete[element_index2].get_type().is_undefined() == false);
 					const auto& solved = complete[element_index2];
 					solved_deps = solved_deps.push_back(solved);
 				}
 			}
 
-			const bc_value_t f_args[2] = { e, make_vector(r_type, solved_deps) };
+			const bc_value_t f_args[2] = { e, make_vector(r_vector_type, solved_deps) };
 			const auto result1 = call_function_bc(vm, f, f_args, 2);
 
 			const auto parent_index = parents2[element_index].get_int_value();
@@ -1305,7 +1294,7 @@ bc_value_t host__supermap(interpreter_t& vm, const bc_value_t args[], int arg_co
 		}
 	}
 
-	const auto result = make_vector(r_type, complete);
+	const auto result = make_vector(r_vector_type, complete);
 
 #if 1
 	const auto debug = value_and_type_to_ast_json(bc_to_value(result));
@@ -1336,25 +1325,26 @@ bc_value_t host__supermap2(interpreter_t& vm, const bc_value_t args[], int arg_c
 	QUARK_ASSERT(arg_count == 3);
 
 	//	Check topology.
-	if(args[0]._type.is_vector() && args[1]._type == typeid_t::make_vector(typeid_t::make_int()) && args[2]._type.is_function() && args[2]._type.get_function_args().size () == 2){
+	if(args[0].get_type().is_vector() && args[1].get_type() == typeid_t::make_vector(typeid_t::make_int()) && args[2].get_type().is_function() && args[2].get_type().get_function_args().size () == 2){
 	}
 	else{
 		quark::throw_runtime_error("supermap() requires 3 arguments.");
 	}
 
 	const auto& elements = args[0];
-	const auto& e_type = elements._type.get_vector_element_type();
+	const auto& e_type = elements.get_type().get_vector_element_type();
 	const auto& dependencies = args[1];
 	const auto& f = args[2];
-	const auto& r_type = args[2]._type.get_function_return();
+	const auto& r_type = args[2].get_type().get_function_return();
 	if(
-		e_type == f._type.get_function_args()[0]
-		&& r_type == f._type.get_function_args()[1].get_vector_element_type()
+		e_type == f.get_type().get_function_args()[0]
+		&& r_type == f.get_type().get_function_args()[1].get_vector_element_type()
 	){
 	}
 	else {
 		quark::throw_runtime_error("R supermap([E] elements, R init_value, R (R acc, E element) f");
 	}
+	const auto r_vector_type = intern_bc_type(f.get_type().get_function_args()[1]);
 
 	const auto elements2 = get_vector(elements);
 	const auto dependencies2 = get_vector(dependencies);
@@ -1413,7 +1403,7 @@ bc_value_t host__supermap2(interpreter_t& vm, const bc_value_t args[], int arg_c
 				const auto& ready = complete[dep_e];
 				ready_elements = ready_elements.push_back(ready);
 			}
-			const auto ready_elements2 = make_vector(r_type, ready_elements);
+			const auto ready_elements2 = make_vector(r_vector_type, ready_elements);
 			const bc_value_t f_args[2] = { e, ready_elements2 };
 
 			const auto result1 = call_function_bc(vm, f, f_args, 2);
@@ -1432,7 +1422,7 @@ bc_value_t host__supermap2(interpreter_t& vm, const bc_value_t args[], int arg_c
 		}
 	}
 
-	const auto result = make_vector(r_type, complete);
+	const auto result = make_vector(r_vector_type, complete);
 
 #if 1
 	const auto debug = value_and_type_to_ast_json(bc_to_value(result));
@@ -1452,13 +1442,19 @@ bc_value_t host__supermap2(interpreter_t& vm, const bc_value_t args[], int arg_c
 
 
 //	Records all output to interpreter
-bc_value_t host__print(interpreter_t& vm, const bc_value_t args[], int arg_count){
+bc_value_t host__print(interpreter_t& vm, const bc_host_args_t& args){
 	QUARK_ASSERT(vm.check_invariant());
-	QUARK_ASSERT(arg_count == 1);
-//	QUARK_ASSERT(args[0]._type.is_string());
+	QUARK_ASSERT(args.size() == 1);
 
-	const auto& value = args[0];
-	const auto s = to_compact_string2(bc_to_value(value));
+	//	Strings print as they are, no need to go via value_t.
+	std::string s;
+	if(args.get_type(0).is_string()){
+		std::string storage;
+		s = get_pod_string(args.get_pod(0), storage);
+	}
+	else{
+		s = to_compact_string2(bc_to_value(args.get_value(0)));
+	}
 	printf("%s\n", s.c_str());
 	vm._print_output.push_back(s);
 
@@ -1467,8 +1463,8 @@ bc_value_t host__print(interpreter_t& vm, const bc_value_t args[], int arg_count
 bc_value_t host__send(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 2);
-	QUARK_ASSERT(args[0]._type.is_string());
-	QUARK_ASSERT(args[1]._type.is_json_value());
+	QUARK_ASSERT(args[0].get_type().is_string());
+	QUARK_ASSERT(args[1].get_type().is_json_value());
 
 	const auto& process_id = args[0].get_string_value();
 	const auto& message_json = args[1].get_json_value();
@@ -1521,7 +1517,7 @@ QUARK_UNIT_TEST("get_time_of_day_ms()", "", "", ""){
 bc_value_t host__read_text_file(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 1);
-	QUARK_ASSERT(args[0]._type.is_string());
+	QUARK_ASSERT(args[0].get_type().is_string());
 
 	const string source_path = args[0].get_string_value();
 	std::string file_contents = read_text_file(source_path);
@@ -1548,8 +1544,8 @@ void write_text_file(const std::string& abs_path, const std::string& data){
 bc_value_t host__write_text_file(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 2);
-	QUARK_ASSERT(args[0]._type.is_string());
-	QUARK_ASSERT(args[1]._type.is_string());
+	QUARK_ASSERT(args[0].get_type().is_string());
+	QUARK_ASSERT(args[1].get_type().is_string());
 
 	const string path = args[0].get_string_value();
 	const string file_contents = args[1].get_string_value();
@@ -1604,7 +1600,7 @@ bool is_valid_absolute_dir_path(const std::string& s){
 bc_value_t host__get_fsentries_shallow(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 1);
-	QUARK_ASSERT(args[0]._type.is_string());
+	QUARK_ASSERT(args[0].get_type().is_string());
 
 	const string path = args[0].get_string_value();
 	if(is_valid_absolute_dir_path(path) == false){
@@ -1629,7 +1625,7 @@ bc_value_t host__get_fsentries_shallow(interpreter_t& vm, const bc_value_t args[
 bc_value_t host__get_fsentries_deep(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 1);
-	QUARK_ASSERT(args[0]._type.is_string());
+	QUARK_ASSERT(args[0].get_type().is_string());
 
 	const string path = args[0].get_string_value();
 	if(is_valid_absolute_dir_path(path) == false){
@@ -1661,7 +1657,7 @@ std::string posix_timespec__to__utc(const time_t& t){
 bc_value_t host__get_fsentry_info(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 1);
-	QUARK_ASSERT(args[0]._type.is_string());
+	QUARK_ASSERT(args[0].get_type().is_string());
 
 	const string path = args[0].get_string_value();
 	if(is_valid_absolute_dir_path(path) == false){
@@ -1747,7 +1743,7 @@ bc_value_t host__get_fs_environment(interpreter_t& vm, const bc_value_t args[],
 bc_value_t host__does_fsentry_exist(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 1);
-	QUARK_ASSERT(args[0]._type.is_string());
+	QUARK_ASSERT(args[0].get_type().is_string());
 
 	const string path = args[0].get_string_value();
 	if(is_valid_absolute_dir_path(path) == false){
@@ -1769,7 +1765,7 @@ bc_value_t host__does_fsentry_exist(interpreter_t& vm, const bc_value_t args[],
 bc_value_t host__create_directory_branch(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 1);
-	QUARK_ASSERT(args[0]._type.is_string());
+	QUARK_ASSERT(args[0].get_type().is_string());
 
 	const string path = args[0].get_string_value();
 	if(is_valid_absolute_dir_path(path) == false){
@@ -1783,7 +1779,7 @@ bc_value_t host__create_directory_branch(interpreter_t& vm, const bc_value_t arg
 bc_value_t host__delete_fsentry_deep(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 1);
-	QUARK_ASSERT(args[0]._type.is_string());
+	QUARK_ASSERT(args[0].get_type().is_string());
 
 	const string path = args[0].get_string_value();
 	if(is_valid_absolute_dir_path(path) == false){
@@ -1799,8 +1795,8 @@ bc_value_t host__delete_fsentry_deep(interpreter_t& vm, const bc_value_t args[],
 bc_value_t host__rename_fsentry(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 2);
-	QUARK_ASSERT(args[0]._type.is_string());
-	QUARK_ASSERT(args[1]._type.is_string());
+	QUARK_ASSERT(args[0].get_type().is_string());
+	QUARK_ASSERT(args[1].get_type().is_string());
 
 	const string path = args[0].get_string_value();
 	if(is_valid_absolute_dir_path(path) == false){
@@ -1846,10 +1842,13 @@ There is never a file extension. You could add one if you want too.
 
 
 host_function_record_t make_rec(const std::string& name, HOST_FUNCTION_PTR f, int function_id, typeid_t function_type){
-	return host_function_record_t { name, f, function_id, function_type, nullptr };
+	return host_function_record_t { name, f, nullptr, function_id, function_type, nullptr };
 }
 host_function_record_t make_rec(const std::string& name, HOST_FUNCTION_PTR f, int function_id, typeid_t function_type, HOST_FUNCTION__CALC_RETURN_TYPE calc_return_type){
-	return host_function_record_t { name, f, function_id, function_type, calc_return_type };
+	return host_function_record_t { name, f, nullptr, function_id, function_type, calc_return_type };
+}
+host_function_record_t make_fast_rec(const std::string& name, HOST_FUNCTION_FAST_PTR f, int function_id, typeid_t function_type){
+	return host_function_record_t { name, nullptr, f, function_id, function_type, nullptr };
 }
 
 
@@ -1884,7 +1883,7 @@ std::vector<host_function_record_t> get_host_function_records(){
 	const auto k_fsentry_t__type = make__fsentry_t__type();
 
 	const std::vector<host_function_record_t> result = {
-		make_rec("assert", host__assert, 1001, typeid_t::make_function(VOID, { DYN }, epure::pure)),
+		make_fast_rec("assert", host__assert, 1001, typeid_t::make_function(VOID, { DYN }, epure::pure)),
 		make_rec("to_string", host__to_string, 1002, typeid_t::make_function(typeid_t::make_string(), { DYN }, epure::pure)),
 		make_rec("to_pretty_string", host__to_pretty_string, 1003, typeid_t::make_function(typeid_t::make_string(), { DYN }, epure::pure)),
 		make_rec("typeof", host__typeof, 1004, typeid_t::make_function(typeid_t::make_typeid(), { DYN }, epure::pure)),
@@ -1894,8 +1893,8 @@ std::vector<host_function_record_t> get_host_function_records(){
 		//	size() is translated to bc_opcode::k_get_size_vector_w_external_elements() etc.
 		make_rec("size", nullptr, 1007, typeid_t::make_function(typeid_t::make_int(), { DYN }, epure::pure)),
 
-		make_rec("find", host__find, 1008, typeid_t::make_function(typeid_t::make_int(), { DYN, DYN }, epure::pure)),
-		make_rec("exists", host__exists, 1009, typeid_t::make_function(typeid_t::make_bool(), { DYN, DYN }, epure::pure)),
+		make_fast_rec("find", host__find, 1008, typeid_t::make_function(typeid_t::make_int(), { DYN, DYN }, epure::pure)),
+		make_fast_rec("exists", host__exists, 1009, typeid_t::make_function(typeid_t::make_bool(), { DYN, DYN }, epure::pure)),
 		make_rec("erase", host__erase, 1010, typeid_t::make_function(DYN, { DYN, DYN }, epure::pure), return_type_sames_as_arg0),
 
 		//	push_back() is translated to bc_opcode::k_pushback_vector_w_inplace_elements() etc.
@@ -1933,7 +1932,7 @@ std::vector<host_function_record_t> get_host_function_records(){
 		make_rec("supermap", host__supermap, 1037, typeid_t::make_function(DYN, { DYN, DYN, DYN }, epure::pure), return_type__supermap),
 
 		//	print = impure!
-		make_rec("print", host__print, 1000, typeid_t::make_function(VOID, { DYN }, epure::pure)),
+		make_fast_rec("print", host__print, 1000, typeid_t::make_function(VOID, { DYN }, epure::pure)),
 		make_rec("send", host__send, 1022, typeid_t::make_function(VOID, { typeid_t::make_string(), typeid_t::make_json_value() }, epure::impure)),
 		make_rec("get_time_of_day", host__get_time_of_day, 1005, typeid_t::make_function(typeid_t::make_int(), {}, epure::impure)),
 
@@ -2036,7 +2035,7 @@ std::map<int,  host_function_t> get_host_functions(){
 	for(const auto& e: a){
 		const auto sign = host_function_signature_t{ e._function_id, e._function_type, e._dynamic_return_type };
 		result.insert(
-			{ e._function_id, host_function_t{ sign, e._name, e._f } }
+			{ e._function_id, host_function_t{ sign, e._name, e._f, e._fast_f } }
 		);
 	}
 	return result;
@@ -34,7 +34,10 @@ typedef typeid_t (*HOST_FUNCTION__CALC_RETURN_TYPE)(const std::vector<typeid_t>&
 
 struct host_function_record_t {
 	std::string _name;
+
+	//	Exactly one of these is used. Prefer _fast_f.
 	HOST_FUNCTION_PTR _f;
+	HOST_FUNCTION_FAST_PTR _fast_f;
 
 	int _function_id;
 
@@ -61,6 +64,7 @@ struct host_function_t {
 	host_function_signature_t _signature;
 	std::string _name;
 	HOST_FUNCTION_PTR _f;
+	HOST_FUNCTION_FAST_PTR _fast_f;
 };
 
 std::map<int, host_function_t> get_host_functions();
@@ -13,6 +13,7 @@
 #include <string>
 
 #include "floyd_interpreter.h"
+#include "bytecode_heap.h"
 #include "floyd_parser/floyd_parser.h"
 #include "ast_value.h"
 #include "json_support.h"
@@ -209,12 +210,15 @@ floyd help					- Show built in help for command line tool
 floyd runtests				- Runs Floyds internal unit tests
 floyd benchmark 			- Runs Floyd built in suite of benchmark tests and prints the results.
 floyd run -t mygame.floyd	- the -t turns on tracing, which shows Floyd compilation steps and internal states
+floyd run -j mygame.floyd	- the -j compiles hot functions of the program to native code while it runs (x86-64 Linux)
+floyd run -m layout,find_path mygame.floyd	- the -m caches the results of the named pure functions
+floyd run -s mygame.floyd	- the -s prints the interpreter heap's statistics when the program ends
 )";
 }
 
 //	Runs one of the commands, args depends on which command.
 int run_command(const std::vector<std::string>& args){
-	const auto command_line_args = parse_command_line_args_subcommands(args, "t");
+	const auto command_line_args = parse_command_line_args_subcommands(args, "tjm:s");
 	const auto path_parts = SplitPath(command_line_args.command);
 	QUARK_ASSERT(path_parts.fName == "floyd" || path_parts.fName == "floydut");
 	trace_on = command_line_args.flags.find("t") != command_line_args.flags.end() ? true : false;
@@ -255,7 +259,17 @@ int run_command(const std::vector<std::string>& args){
 
 			const auto source = read_text_file(source_path);
 
-			auto program = floyd::compile_to_bytecode(source, source_path);
+			//	The generator must see the memoized functions, it doesn't inline them.
+			std::vector<std::string> memoize;
+			const auto memoize_it = command_line_args.flags.find("m");
+			if(memoize_it != command_line_args.flags.end()){
+				memoize = split_on_chars(seq_t(memoize_it->second), ",");
+			}
+
+			auto program = floyd::compile_to_bytecode(source, source_path, memoize);
+			if(command_line_args.flags.find("j") != command_line_args.flags.end()){
+				program._container_def._jit = true;
+			}
 
 			std::vector<floyd::value_t> args3;
 			for(const auto& e: args2){
@@ -263,6 +277,10 @@ int run_command(const std::vector<std::string>& args){
 			}
 
 			const auto result = floyd::run_container(program, args3, program._container_def._name);
+			if(command_line_args.flags.find("s") != command_line_args.flags.end()){
+				const auto stats = floyd::bc_heap_stats_to_json(floyd::get_bc_heap_stats());
+				std::cout << json_to_pretty_string(stats) << std::endl;
+			}
 			if(result.size() == 1 && result.find("main()") != result.end()){
 				const auto main_return = *result.begin();
 				const auto error_code = main_return.second.is_int() ? main_return.second.get_int_value() : EXIT_SUCCESS;
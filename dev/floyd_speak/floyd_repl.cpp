@@ -189,7 +189,7 @@ int handle_repl_input(int print_pos, std::shared_ptr<floyd::interpreter_t>& vm_m
 	);
 
 	const auto program3 = floyd::bc_program_t{ globals2, program1._function_defs, program1._types };
-	auto imm2 = std::make_shared<floyd::interpreter_imm_t>(floyd::interpreter_imm_t{vm_mut->_imm->_start_time, program3, vm_mut->_imm->_host_functions});
+	auto imm2 = std::make_shared<floyd::interpreter_imm_t>(floyd::interpreter_imm_t{vm_mut->_imm->_start_time, program3, vm_mut->_imm->_host_functions, floyd::intern_bc_types(program3._types)});
 
 	vm_mut->_imm.swap(imm2);
 
@@ -1327,6 +1327,441 @@ QUARK_UNIT_TEST("run_init()", "if", "", ""){
 	);
 }
 
+QUARK_UNIT_TEST("run_init()", "if", "compare-and-branch double, string, bool", ""){
+	ut_verify_printout(
+		QUARK_POS,
+		R"(
+
+			if(1.5 < 2.5){ print("a") }
+			if(2.5 <= 2.5){ print("b") }
+			if(1.5 > 2.5){ print("-") }
+			if(2.5 >= 3.5){ print("-") }
+			if("abc" == "abc"){ print("c") }
+			if("abc" != "abd"){ print("d") }
+			if("abc" > "abd"){ print("-") }
+			if(true != false){ print("e") }
+			if(false < true){ print("f") }
+			if(1.5 == 1.5 && "x" < "y"){ print("g") }
+
+			mutable x = 0.0
+			while(x < 3.0){
+				x = x + 1.0
+			}
+			print(x)
+
+			mutable s = ""
+			while(s != "aaa"){
+				s = s + "a"
+			}
+			print(s)
+
+		)",
+		{ "a", "b", "c", "d", "e", "f", "g", "3.0", "aaa" }
+	);
+}
+
+QUARK_UNIT_TEST("", "immediate operands", "literal on either side", ""){
+	run_closed(R"(
+
+		//	Mutable so the compiler can't fold the expressions into constants.
+		mutable a = 10
+		assert(a + 5 == 15)
+		assert(5 + a == 15)
+		assert(a - 3 == 7)
+		assert(3 - a == -7)
+		assert(a * -2 == -20)
+		assert(a * 100000 == 1000000)
+		assert(3 < a)
+		assert((a <= 9) == false)
+		assert(11 > a)
+		assert(10 >= a)
+		assert(a != 11)
+
+		mutable d = 10.0
+		assert(d + 0.5 == 10.5)
+		assert(0.5 + d == 10.5)
+		assert(d - 0.5 == 9.5)
+		assert(1.0 - d == -9.0)
+		assert(d * 2.0 == 20.0)
+		assert(d / 4.0 == 2.5)
+		assert(1.0 / d == 0.1)
+
+		mutable count = 0
+		for(i in 0 ..< 5){
+			if(i > 2){
+				count = count + 1
+			}
+			if(2 >= i){
+				count = count + 10
+			}
+		}
+		assert(count == 32)
+
+	)");
+}
+
+QUARK_UNIT_TEST("", "peephole", "copies into temps, branch chains", ""){
+	const auto bc = compile_to_bytecode(R"(
+
+		func int f(int a){
+			mutable x = 0
+			x = a * 3
+			if(a > 2){
+				if(a > 4){
+					x = x + 100
+				}
+			}
+			else{
+				x = x - 1
+			}
+			return x
+		}
+		assert(f(1) == 2)
+		assert(f(3) == 9)
+		assert(f(5) == 115)
+
+	)", "");
+	QUARK_UT_VERIFY(bc._peephole_stats._instruction_count_after < bc._peephole_stats._instruction_count_before);
+
+	//	Constructing the interpreter runs the global asserts.
+	interpreter_t vm(bc);
+}
+
+QUARK_UNIT_TEST("", "peephole", "temps share registers, released after last use", ""){
+	const auto bc = compile_to_bytecode(R"(
+
+		func string f(string a, int n){
+			let b = a + "-" + a
+			let c = b + "+" + b
+			mutable s = ""
+			for(i in 0 ..< n){
+				s = s + c + a + to_string(i)
+			}
+			return s + b
+		}
+		assert(f("x", 2) == "x-x+x-xx0x-x+x-xx1x-x")
+
+	)", "");
+	QUARK_UT_VERIFY(bc._peephole_stats._register_count_after < bc._peephole_stats._register_count_before);
+
+	int release_count = 0;
+	for(const auto& e: bc._function_defs){
+		if(e._frame_ptr){
+			for(const auto& instruction: e._frame_ptr->_instructions){
+				release_count += instruction._opcode == bc_opcode::k_release_external_value ? 1 : 0;
+			}
+		}
+	}
+	QUARK_UT_VERIFY(release_count > 0);
+
+	interpreter_t vm(bc);
+}
+
+QUARK_UNIT_TEST("", "tail call", "self recursion runs in constant stack", ""){
+	ut_verify_printout(
+		QUARK_POS,
+		R"(
+
+			func string finish(int n, string acc){
+				let tail = "!"
+				return acc + tail
+			}
+
+			func int count(int n, int acc){
+				if(n == 0){
+					return acc
+				}
+				return count(n - 1, acc + 2)
+			}
+
+			func string join(int n, string acc){
+				if(n == 0){
+					return finish(n, acc)
+				}
+				else{
+					return join(n - 1, acc + "x")
+				}
+			}
+
+			print(count(300000, 0))
+			print(join(5, ">"))
+
+		)",
+		{ "600000", ">xxxxx!" }
+	);
+}
+
+QUARK_UNIT_TEST("call_function()", "tail call", "function ending with a tail call", ""){
+	auto ast = compile_to_bytecode(R"(
+
+		func int count(int n, int acc){
+			if(n == 0){
+				return acc
+			}
+			return count(n - 1, acc + 2)
+		}
+
+	)",
+	"");
+	interpreter_t vm(ast);
+	const auto f = find_global_symbol(vm, "count");
+	const auto result = call_function(vm, f, std::vector<value_t>{ value_t::make_int(1000), value_t::make_int(1) });
+	ut_verify_values(QUARK_POS, result, value_t::make_int(2001));
+}
+
+QUARK_UNIT_TEST("", "constant folding", "ints, doubles, strings, bools", ""){
+	run_closed(R"(
+
+		assert(7 / 2 == 3)
+		assert(-7 % 3 == -1)
+		assert(9223372036854775807 + 1 == -9223372036854775807 - 1)
+		assert(1.5 * 2.0 - 0.5 == 2.5)
+		assert("a" + "b" == "ab")
+		assert(("b" > "a") == true)
+		assert((true && false) == false)
+		assert((1 < 2 ? "yes" : "no") == "yes")
+
+	)");
+}
+
+QUARK_UNIT_TEST("", "constant folding", "constant globals, if(DEBUG_MODE) guards cost nothing", ""){
+	const auto bc = compile_to_bytecode(R"(
+
+		let DEBUG_MODE = false
+		let BOARD_WIDTH = 30
+
+		func int f(int x){
+			if(DEBUG_MODE){
+				print("debug " + to_string(x))
+			}
+			while(DEBUG_MODE){
+				print("never")
+			}
+			return x + BOARD_WIDTH * 2 - (BOARD_WIDTH > 10 ? 1 : 0)
+			print("unreachable")
+		}
+		assert(f(1) == 60)
+
+	)", "");
+
+	for(const auto& e: bc._function_defs){
+		if(e._frame_ptr){
+			for(const auto& instruction: e._frame_ptr->_instructions){
+				QUARK_UT_VERIFY(instruction._opcode != bc_opcode::k_call);
+				QUARK_UT_VERIFY(instruction._opcode != bc_opcode::k_branch_false_bool);
+				QUARK_UT_VERIFY(instruction._opcode != bc_opcode::k_branch_always);
+			}
+		}
+	}
+
+	interpreter_t vm(bc);
+}
+
+const std::string k_inline_test_functions = R"(
+
+	func int sq(int x){ return x * x }
+	func double area(double w, double h){ return w * h }
+	func string wrap(string s){ return "[" + s + "]" }
+	func int pick(int a, int b){
+		if(a > b){
+			return a
+		}
+		return b
+	}
+	func int sum_sq(int a, int b){ return sq(a) + sq(b) }
+	func int loop(int n){
+		mutable acc = 0
+		for(i in 0 ..< n){
+			acc = acc + sum_sq(i, pick(i, 2))
+		}
+		return acc
+	}
+
+	assert(sq(7) == 49)
+	assert(area(2.0, 3.5) == 7.0)
+	let s = "x"
+	assert(wrap(wrap(s)) == "[[x]]")
+	assert(loop(4) == 35)
+
+)";
+
+int count_function_calls(const bc_program_t& bc){
+	int count = 0;
+	for(const auto& e: bc._function_defs){
+		if(e._frame_ptr){
+			for(const auto& instruction: e._frame_ptr->_instructions){
+				count += instruction._opcode == bc_opcode::k_call ? 1 : 0;
+			}
+		}
+	}
+	return count;
+}
+
+QUARK_UNIT_TEST("", "inlining", "small pure functions are spliced into callers", ""){
+	const auto bc = compile_to_bytecode(k_inline_test_functions, "");
+	QUARK_UT_VERIFY(count_function_calls(bc) == 0);
+
+	interpreter_t vm(bc);
+}
+
+QUARK_UNIT_TEST("", "inlining", "container-def inline_budget 0 turns it off", ""){
+	const auto bc = compile_to_bytecode(R"(
+
+		container-def {
+			"name": "",
+			"tech": "",
+			"desc": "",
+			"clocks": {},
+			"inline_budget": 0
+		}
+
+	)" + k_inline_test_functions, "");
+	QUARK_UT_VERIFY(count_function_calls(bc) > 0);
+
+	interpreter_t vm(bc);
+}
+
+int count_opcode(const bc_program_t& bc, bc_opcode opcode){
+	int count = 0;
+	for(const auto& e: bc._function_defs){
+		if(e._frame_ptr){
+			for(const auto& instruction: e._frame_ptr->_instructions){
+				count += instruction._opcode == opcode ? 1 : 0;
+			}
+		}
+	}
+	return count;
+}
+
+QUARK_UNIT_TEST("", "inlining", "arguments of inlined calls are released after their last use", ""){
+	const auto bc = compile_to_bytecode(R"(
+
+		func int head([int] v){ return v[0] }
+
+		//	impure: stays a function of its own, its registers are compacted.
+		func [int] build(int n) impure {
+			mutable v = [ 7 ]
+			for(i in 0 ..< n){
+				v = push_back(v, head(v))
+			}
+			return v
+		}
+		let n = size(build(2000))
+		assert(n == 2001)
+
+	)", "");
+	QUARK_UT_VERIFY(count_function_calls(bc) == 0);
+	QUARK_UT_VERIFY(count_opcode(bc, bc_opcode::k_release_external_value) > 0);
+
+	//	The copy of v that head() got is gone when push_back() runs, so v is appended in place. Copying the vector
+	//	each time would allocate at least one node per element.
+	const auto before = get_bc_heap_stats();
+	interpreter_t vm(bc);
+	const auto after = get_bc_heap_stats();
+	QUARK_UT_VERIFY(after._alloc_count - before._alloc_count < 500);
+}
+
+QUARK_UNIT_TEST("", "inlining", "arguments of calls inlined into the global body are released after their last use", ""){
+	const auto bc = compile_to_bytecode(R"(
+
+		func int head([int] v){ return v[0] }
+
+		mutable v = [ 7, 8 ]
+		let a = head(v)
+		assert(a == 7)
+
+	)", "");
+	const auto& instrs = bc._globals._instructions;
+	QUARK_UT_VERIFY(std::count_if(instrs.begin(), instrs.end(), [](const bc_instruction_t& i){ return i._opcode == bc_opcode::k_release_external_value; }) > 0);
+	interpreter_t vm(bc);
+}
+
+QUARK_UNIT_TEST("", "loop optimizations", "for(i in 0 ..< size(v)) lookups skip bounds check, invariants are hoisted", ""){
+	const auto bc = compile_to_bytecode(R"(
+
+		struct pixel_t { int red int green int blue }
+
+		func int brightness([pixel_t] pixels, int gain){
+			mutable acc = 0
+			for(i in 0 ..< size(pixels)){
+				acc = acc + pixels[i].red * (gain + 1) + pixels[i].green
+			}
+			return acc
+		}
+		func int sum([int] v){
+			mutable acc = 0
+			for(i in 0 ..< size(v)){
+				acc = acc + v[i]
+			}
+			return acc
+		}
+
+		assert(brightness([pixel_t(1, 2, 3), pixel_t(4, 5, 6)], 2) == (1 * 3 + 2) + (4 * 3 + 5))
+		assert(sum([1, 2, 3]) == 6)
+		let [int] empty = []
+		assert(sum(empty) == 0)
+
+	)", "");
+	QUARK_UT_VERIFY(count_opcode(bc, bc_opcode::k_lookup_element_vector_w_external_elements_unchecked) == 2);
+	QUARK_UT_VERIFY(count_opcode(bc, bc_opcode::k_lookup_element_vector_w_inplace_elements_unchecked) == 1);
+	QUARK_UT_VERIFY(count_opcode(bc, bc_opcode::k_lookup_element_vector_w_external_elements) == 0);
+	QUARK_UT_VERIFY(bc._peephole_stats._hoisted_count > 0);
+
+	interpreter_t vm(bc);
+}
+
+QUARK_UNIT_TEST("", "loop optimizations", "other loops keep their bounds check", ""){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			func int f([int] v){
+				mutable acc = 0
+				for(i in 0 ... size(v)){
+					acc = acc + v[i]
+				}
+				return acc
+			}
+			let a = f([1, 2, 3])
+
+		)",
+		"Lookup in vector: out of bounds."
+	);
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			func int f([int] v){
+				mutable w = v
+				mutable acc = 0
+				for(i in 0 ..< size(w)){
+					w = [1]
+					acc = acc + w[i]
+				}
+				return acc
+			}
+			let a = f([1, 2, 3])
+
+		)",
+		"Lookup in vector: out of bounds."
+	);
+}
+
+QUARK_UNIT_TEST("", "comparison", "double, string, bool", ""){
+	run_closed(R"(
+
+		assert((1.5 < 2.5) == true)
+		assert((2.5 <= 2.5) == true)
+		assert((2.5 > 2.5) == false)
+		assert((2.5 >= 2.5) == true)
+		assert(("b" > "a") == true)
+		assert(("a" != "a") == false)
+		assert((true == true) == true)
+		assert((true > false) == true)
+
+	)");
+}
+
 
 QUARK_UNIT_TEST("", "function calling itself by name", "", ""){
 	run_closed(
@@ -1413,6 +1848,32 @@ QUARK_UNIT_TEST("run_init()", "for", "", ""){
 	);
 }
 
+QUARK_UNIT_TEST("run_init()", "for", "empty ranges run no iterations", ""){
+	ut_verify_printout(
+		QUARK_POS,
+		R"(
+
+			let a = 5
+			print("start")
+			for (i in 0..<0) {
+				print("open " + to_string(i))
+			}
+			for (i in a..<2) {
+				print("open " + to_string(i))
+			}
+			for (i in a...2) {
+				print("closed " + to_string(i))
+			}
+			for (i in a...a) {
+				print("closed " + to_string(i))
+			}
+			print("end")
+
+		)",
+		{ "start", "closed 5", "end" }
+	);
+}
+
 QUARK_UNIT_TEST("run_init()", "fibonacci", "", ""){
 	ut_verify_printout(
 		QUARK_POS,
@@ -1437,6 +1898,77 @@ QUARK_UNIT_TEST("run_init()", "fibonacci", "", ""){
 	);
 }
 
+QUARK_UNIT_TEST("run_init()", "recursion", "return string and void through nested calls", ""){
+	ut_verify_printout(
+		QUARK_POS,
+		R"(
+
+			func string repeat(string s, int n) {
+				if (n == 0){
+					return ""
+				}
+				return s + repeat(s, n - 1)
+			}
+
+			func void print_countdown(int n) {
+				if (n > 0){
+					print(n)
+					print_countdown(n - 1)
+				}
+			}
+
+			print(repeat("ab", 3))
+			print_countdown(3)
+			print(repeat("x", 2) + repeat("y", 1))
+
+		)",
+		{ "ababab", "3", "2", "1", "xxy" }
+	);
+}
+
+QUARK_UNIT_TEST("run_init()", "recursion", "deep recursion grows stack", ""){
+	ut_verify_printout(
+		QUARK_POS,
+		R"(
+
+			func int count_down(int n) {
+				if (n == 0){
+					return 0
+				}
+				return count_down(n - 1)
+			}
+			print(count_down(10000))
+
+		)",
+		{ "0" }
+	);
+}
+
+QUARK_UNIT_TEST("run_init()", "recursion", "infinite recursion, container-def max_stack_size", "Stack overflow"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			container-def {
+				"name": "",
+				"tech": "",
+				"desc": "",
+				"clocks": {},
+				"stack_size": 16,
+				"max_stack_size": 5000
+			}
+
+			//	Not a tail call: that would run forever in constant stack.
+			func int f(int n) {
+				return f(n + 1) + 1
+			}
+			let a = f(0)
+
+		)",
+		"Stack overflow."
+	);
+}
+
 
 //////////////////////////////////////////		WHILE STATEMENT
 
@@ -1525,6 +2057,66 @@ QUARK_UNIT_TEST("string", "push_back()", "string", "correct final vector"){
 	)");
 }
 
+QUARK_UNIT_TEST("string", "push_back()", "appending in place", "copies are not changed"){
+	run_closed(R"(
+
+		func bool f(){
+			mutable s = "abcdefgh"
+			mutable v = [ 1, 2 ]
+			mutable w = [ "abcdefghij" ]
+			let s0 = s
+			let v0 = v
+			let w0 = w
+			for(i in 0 ..< 3){
+				s = push_back(s, 120)
+				s = s + "yz"
+				v = push_back(v, i)
+				v = v + [ i ]
+				w = push_back(w, s)
+				w = w + w
+			}
+			assert(s0 == "abcdefgh")
+			assert(v0 == [ 1, 2 ])
+			assert(w0 == [ "abcdefghij" ])
+			assert(s == "abcdefghxyzxyzxyz")
+			assert(v == [ 1, 2, 0, 0, 1, 1, 2, 2 ])
+			assert(size(w) == 22)
+			assert(w[21] == s)
+			return true
+		}
+		assert(f())
+
+	)");
+}
+
+QUARK_UNIT_TEST("string", "subset()", "long strings", "same results as short strings"){
+	run_closed(R"(
+
+		func bool f(){
+			mutable s = ""
+			for(i in 0 ..< 3000){
+				s = push_back(s, 97 + i % 26)
+			}
+			let t = s + s
+			let u = replace(t, 10, 5990, "xyz")
+			let v = update(s, 2000, 33)
+			assert(size(t) == 6000)
+			assert(subset(t, 3000, 6000) == s)
+			assert(subset(t, 26, 52) == "abcdefghijklmnopqrstuvwxyz")
+			assert(u == "abcdefghijxyzabcdefghij")
+			assert(v != s)
+			assert(v[2000] == 33)
+			assert(s[2000] == 97 + 2000 % 26)
+			assert(replace(v, 2000, 2001, "y") == replace(s, 2000, 2001, "y"))
+			assert(find(t, "xyzabc") == 23)
+			assert(subset(t, 2990, 6000) < subset(t, 2991, 6000))
+			return true
+		}
+		assert(f())
+
+	)");
+}
+
 QUARK_UNIT_TEST("string", "update()", "string", "correct final string"){
 	run_closed(R"(
 
@@ -1886,6 +2478,17 @@ QUARK_UNIT_TEST("", "find()", "string", ""){
 	)");
 }
 
+QUARK_UNIT_TEST("", "find()", "vector of string, double, bool", ""){
+	run_closed(R"(
+
+		assert(find(["a", "bb", "ccc"], "ccc") == 2)
+		assert(find(["a", "bb", "ccc"], "x") == -1)
+		assert(find([1.5, 2.5], 2.5) == 1)
+		assert(find([false, true], true) == 1)
+
+	)");
+}
+
 
 //////////////////////////////////////////		SUBSET()
 
@@ -1930,6 +2533,29 @@ QUARK_UNIT_TEST("", "replace()", "int", ""){
 
 	)");
 }
+
+QUARK_UNIT_TEST("", "replace()", "string vector", ""){
+	run_closed(R"(
+
+		let a = [ "a", "b", "c", "d" ]
+		assert(replace(a, 1, 3, [ "x" ]) == [ "a", "x", "d" ])
+		assert(subset(a, 2, 100) == [ "c", "d" ])
+		assert(replace("abc", 1, 100, "") == "a")
+
+	)");
+}
+
+QUARK_UNIT_TEST("", "subset()", "negative start", "exception"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			let a = subset("abc", -1, 2)
+
+		)",
+		"subset() requires start and end to be non-negative."
+	);
+}
 // ### test pos limiting and edge cases.
 
 
@@ -1956,6 +2582,86 @@ QUARK_UNIT_TEST("", "update()", "mutate element", "valid vector, without side ef
 	);
 }
 
+QUARK_UNIT_TEST("", "update()", "updating in place", "copies are not changed"){
+	run_closed(R"(
+
+		func bool f(){
+			mutable v = [ 1, 2, 3 ]
+			mutable w = [ "a", "b", "c" ]
+			mutable d = { "one": 1 }
+			mutable e = { "one": "ett" }
+			let v0 = v
+			let w0 = w
+			let d0 = d
+			let e0 = e
+			for(i in 0 ..< 3){
+				v = update(v, i, i * 10)
+				w = update(w, i, w[2 - i])
+				d = update(d, "two", i)
+				e = update(e, "one", e["one"] + "!")
+			}
+			assert(v0 == [ 1, 2, 3 ])
+			assert(w0 == [ "a", "b", "c" ])
+			assert(d0 == { "one": 1 })
+			assert(e0 == { "one": "ett" })
+			assert(v == [ 0, 10, 20 ])
+			assert(w == [ "c", "b", "c" ])
+			assert(d == { "one": 1, "two": 2 })
+			assert(e == { "one": "ett!!!" })
+			return true
+		}
+		assert(f())
+
+	)");
+}
+
+QUARK_UNIT_TEST("", "update()", "index out of bounds", "exception"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			func [int] f([int] v){
+				return update(v, 3, 4)
+			}
+			let a = f([ 1, 2, 3 ])
+
+		)",
+		"Vector lookup out of bounds."
+	);
+}
+
+QUARK_UNIT_TEST("", "update()", "on the only reference", "changes the vector without allocating"){
+	const auto bc = compile_to_bytecode(R"(
+
+		//	impure: stays a function of its own, the global body isn't compacted.
+		func int fill(int n) impure {
+			mutable v = [ 0 ]
+			mutable w = [ "" ]
+			for(i in 1 ..< n){
+				v = push_back(v, 0)
+				w = push_back(w, "")
+			}
+			let s = "abcdefghijklmnop"
+			for(i in 0 ..< n){
+				v = update(v, i, i)
+				w = update(w, i, s)
+			}
+			return v[n - 1] + size(w[n - 1])
+		}
+		let n = fill(2000)
+		assert(n == 1999 + 16)
+
+	)", "");
+	QUARK_UT_VERIFY(count_opcode(bc, bc_opcode::k_update_vector_w_inplace_elements) == 1);
+	QUARK_UT_VERIFY(count_opcode(bc, bc_opcode::k_update_vector_w_external_elements) == 1);
+
+	//	Copying the vectors would allocate a new value and nodes for each update.
+	const auto before = get_bc_heap_stats();
+	interpreter_t vm(bc);
+	const auto after = get_bc_heap_stats();
+	QUARK_UT_VERIFY(after._alloc_count - before._alloc_count < 500);
+}
+
 
 
 
@@ -2186,6 +2892,17 @@ QUARK_UNIT_TEST("dict", "erase()", "", ""){
 	)");
 }
 
+QUARK_UNIT_TEST("dict", "exists() erase()", "string values", ""){
+	run_closed(R"(
+
+		let a = { "one": "1", "two": "2" }
+		assert(exists(a, "two") == true)
+		assert(exists(a, "three") == false)
+		assert(erase(a, "one") == { "two": "2" })
+
+	)");
+}
+
 
 //////////////////////////////////////////		STRUCT - TYPE
 
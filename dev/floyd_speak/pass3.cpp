@@ -137,6 +137,22 @@ const function_definition_t& function_id_to_def(const analyser_t& a, int functio
 
 
 
+//	Literals of these types are folded at compile time.
+bool is_foldable_type(const typeid_t& type){
+	return type.is_bool() || type.is_int() || type.is_double() || type.is_string();
+}
+
+//	An immutable local bound to a literal becomes a constant: loads of it fold into literals and its store is dropped.
+symbol_t make_immutable_symbol(const typeid_t& type, const expression_t& init_expr){
+	if(init_expr.is_literal() && is_foldable_type(type) && init_expr.get_output_type() == type){
+		return symbol_t::make_constant(init_expr.get_literal());
+	}
+	else{
+		return symbol_t::make_immutable_local(type);
+	}
+}
+
+
 //	Warning: returns reference to the found value-entry -- this could be in any environment in the call stack.
 std::pair<const symbol_t*, floyd::variable_address_t> resolve_env_variable_deep(const analyser_t& a, int depth, const std::string& s){
 	QUARK_ASSERT(a.check_invariant());
@@ -288,6 +304,28 @@ typeid_t resolve_type(const analyser_t& a, const location_t& loc, const typeid_t
 
 
 
+/*
+	Analysed statements that do nothing at runtime: stores to constants, which are already in place when the
+	frame opens, empty blocks and while-loops with a false condition.
+*/
+bool is_dead_statement(const analyser_t& a, const statement_t& statement){
+	if(std::holds_alternative<statement_t::store2_t>(statement._contents)){
+		const auto& dest = std::get<statement_t::store2_t>(statement._contents)._dest_variable;
+		return dest._parent_steps == 0 && a._lexical_scope_stack.back().symbols._symbols[dest._index].second._const_value.is_undefined() == false;
+	}
+	else if(std::holds_alternative<statement_t::block_statement_t>(statement._contents)){
+		return std::get<statement_t::block_statement_t>(statement._contents)._body._statements.empty();
+	}
+	else if(std::holds_alternative<statement_t::while_statement_t>(statement._contents)){
+		const auto& condition = std::get<statement_t::while_statement_t>(statement._contents)._condition;
+		return condition.is_literal() && condition.get_literal().get_bool_value() == false;
+	}
+	else{
+		return false;
+	}
+}
+
+//	Statements after a return are still analysed, for errors, but dropped.
 std::pair<analyser_t, vector<statement_t>> analyse_statements(const analyser_t& a, const vector<statement_t>& statements, const typeid_t& return_type){
 	QUARK_ASSERT(a.check_invariant());
 	for(const auto& i: statements){ QUARK_ASSERT(i.check_invariant()); };
@@ -295,15 +333,17 @@ std::pair<analyser_t, vector<statement_t>> analyse_statements(const analyser_t&
 	auto a_acc = a;
 
 	vector<statement_t> statements2;
+	bool returned = false;
 	int statement_index = 0;
 	while(statement_index < statements.size()){
 		const auto statement = statements[statement_index];
 		const auto& r = analyse_statement(a_acc, statement, return_type);
 		a_acc = r.first;
 
-		if(r.second){
+		if(r.second && returned == false && is_dead_statement(a_acc, *r.second) == false){
 			QUARK_ASSERT(r.second->check_types_resolved());
 			statements2.push_back(*r.second);
+			returned = std::holds_alternative<statement_t::return_statement_t>(r.second->_contents);
 		}
 		statement_index++;
 	}
@@ -371,7 +411,7 @@ std::pair<analyser_t, statement_t> analyse_store_statement(const analyser_t& a,
 		a_acc = rhs_expr2.first;
 		const auto rhs_expr2_type = rhs_expr2.second.get_output_type();
 
-		a_acc._lexical_scope_stack.back().symbols._symbols.push_back({local_name, symbol_t::make_immutable_local(rhs_expr2_type)});
+		a_acc._lexical_scope_stack.back().symbols._symbols.push_back({local_name, make_immutable_symbol(rhs_expr2_type, rhs_expr2.second)});
 		int variable_index = (int)(a_acc._lexical_scope_stack.back().symbols._symbols.size() - 1);
 		return { a_acc, statement_t::make__store2(s.location, floyd::variable_address_t::make_variable_address(0, variable_index), rhs_expr2.second) };
 	}
@@ -434,7 +474,7 @@ std::pair<analyser_t, statement_t> analyse_bind_local_statement(const analyser_t
 		}
 		else{
 			//	Updated the symbol with the real function defintion.
-			a_acc._lexical_scope_stack.back().symbols._symbols[local_name_index] = {new_local_name, bind_statement_mutable_tag_flag ? symbol_t::make_mutable_local(lhs_type2) : symbol_t::make_immutable_local(lhs_type2)};
+			a_acc._lexical_scope_stack.back().symbols._symbols[local_name_index] = {new_local_name, bind_statement_mutable_tag_flag ? symbol_t::make_mutable_local(lhs_type2) : make_immutable_symbol(lhs_type2, rhs_expr_pair.second)};
 			return {
 				a_acc,
 				statement_t::make__store2(s.location, floyd::variable_address_t::make_variable_address(0, (int)local_name_index), rhs_expr_pair.second)
@@ -553,7 +593,15 @@ std::pair<analyser_t, statement_t> analyse_ifelse_statement(const analyser_t& a,
 
 	const auto then2 = analyse_body(a_acc, statement._then_body, a._lexical_scope_stack.back().pure, return_type);
 	const auto else2 = analyse_body(a_acc, statement._else_body, a._lexical_scope_stack.back().pure, return_type);
-	return { a_acc, statement_t::make__ifelse_statement(s.location, condition2.second, then2.second, else2.second) };
+
+	//	Constant condition, like if(DEBUG_MODE): keep only the branch that runs.
+	if(condition2.second.is_literal()){
+		const auto& taken = condition2.second.get_literal().get_bool_value() ? then2.second : else2.second;
+		return { a_acc, statement_t::make__block_statement(s.location, taken) };
+	}
+	else{
+		return { a_acc, statement_t::make__ifelse_statement(s.location, condition2.second, then2.second, else2.second) };
+	}
 }
 
 std::pair<analyser_t, statement_t> analyse_for_statement(const analyser_t& a, const statement_t& s, const typeid_t& return_type){
@@ -799,7 +847,10 @@ std::pair<analyser_t, expression_t> analyse_load(const analyser_t& a, const stat
 
 	auto a_acc = a;
 	const auto found = find_symbol_by_name(a_acc, e._variable_name);
-	if(found.first != nullptr){
+	if(found.first != nullptr && found.first->_const_value.is_undefined() == false && is_foldable_type(found.first->_value_type)){
+		return {a_acc, expression_t::make_literal(found.first->_const_value) };
+	}
+	else if(found.first != nullptr){
 		return {a_acc, expression_t::make_load2(found.second, make_shared<typeid_t>(found.first->_value_type)) };
 	}
 	else{
@@ -1542,6 +1593,167 @@ std::pair<analyser_t, expression_t> analyse_function_definition_expression(const
 }
 
 
+/////////////////////////////////////////			CONSTANT FOLDING
+
+
+
+//	Compares two literals of the same type the way the interpreter does.
+int compare_literals(const value_t& left, const value_t& right){
+	QUARK_ASSERT(left.get_type() == right.get_type());
+
+	if(left.is_bool()){
+		return (left.get_bool_value() ? 1 : 0) - (right.get_bool_value() ? 1 : 0);
+	}
+	else if(left.is_int()){
+		return left.get_int_value() < right.get_int_value() ? -1 : (left.get_int_value() > right.get_int_value() ? 1 : 0);
+	}
+	else if(left.is_double()){
+		return left.get_double_value() < right.get_double_value() ? -1 : (left.get_double_value() > right.get_double_value() ? 1 : 0);
+	}
+	else if(left.is_string()){
+		const auto result = left.get_string_value().compare(right.get_string_value());
+		return result < 0 ? -1 : (result > 0 ? 1 : 0);
+	}
+	else{
+		QUARK_ASSERT(false);
+		quark::throw_exception();
+	}
+}
+
+expression_t fold_int_arithmetic(const expression_t& e, expression_type op, int64_t left, int64_t right){
+	//	Wraps around like the interpreter's int64 arithmetic.
+	const auto left2 = static_cast<uint64_t>(left);
+	const auto right2 = static_cast<uint64_t>(right);
+
+	if(op == expression_type::k_arithmetic_add__2){
+		return expression_t::make_literal(value_t::make_int(static_cast<int64_t>(left2 + right2)));
+	}
+	else if(op == expression_type::k_arithmetic_subtract__2){
+		return expression_t::make_literal(value_t::make_int(static_cast<int64_t>(left2 - right2)));
+	}
+	else if(op == expression_type::k_arithmetic_multiply__2){
+		return expression_t::make_literal(value_t::make_int(static_cast<int64_t>(left2 * right2)));
+	}
+	else if(right == 0 || (left == INT64_MIN && right == -1)){
+		return e;
+	}
+	else if(op == expression_type::k_arithmetic_divide__2){
+		return expression_t::make_literal(value_t::make_int(left / right));
+	}
+	else if(op == expression_type::k_arithmetic_remainder__2){
+		return expression_t::make_literal(value_t::make_int(left % right));
+	}
+	else{
+		return e;
+	}
+}
+
+expression_t fold_double_arithmetic(const expression_t& e, expression_type op, double left, double right){
+	if(op == expression_type::k_arithmetic_add__2){
+		return expression_t::make_literal_double(left + right);
+	}
+	else if(op == expression_type::k_arithmetic_subtract__2){
+		return expression_t::make_literal_double(left - right);
+	}
+	else if(op == expression_type::k_arithmetic_multiply__2){
+		return expression_t::make_literal_double(left * right);
+	}
+	else if(op == expression_type::k_arithmetic_divide__2 && right != 0.0){
+		return expression_t::make_literal_double(left / right);
+	}
+	else{
+		return e;
+	}
+}
+
+/*
+	Evaluates an analysed operation on literals at compile time and returns the result as a literal.
+	A conditional operator with a literal condition becomes the selected expression.
+
+	Anything else is returned unchanged. Operations that throw at runtime, like divide by zero, are left for
+	the interpreter so they fail the same way.
+*/
+expression_t fold_constant_expression(const expression_t& e){
+	QUARK_ASSERT(e.check_invariant());
+
+	const auto op = e.get_operation();
+	const auto& inputs = e._input_exprs;
+
+	if(op == expression_type::k_conditional_operator3){
+		if(inputs[0].is_literal()){
+			return inputs[0].get_literal().get_bool_value() ? inputs[1] : inputs[2];
+		}
+		return e;
+	}
+
+	for(const auto& input: inputs){
+		if(input.is_literal() == false || is_foldable_type(input.get_output_type()) == false){
+			return e;
+		}
+	}
+
+	if(op == expression_type::k_arithmetic_unary_minus__1){
+		const auto& value = inputs[0].get_literal();
+		if(value.is_int()){
+			return expression_t::make_literal(value_t::make_int(static_cast<int64_t>(0 - static_cast<uint64_t>(value.get_int_value()))));
+		}
+		else if(value.is_double()){
+			return expression_t::make_literal_double(-value.get_double_value());
+		}
+		return e;
+	}
+	else if(is_comparison_expression(op)){
+		const auto diff = compare_literals(inputs[0].get_literal(), inputs[1].get_literal());
+		if(op == expression_type::k_comparison_smaller_or_equal__2){
+			return expression_t::make_literal_bool(diff <= 0);
+		}
+		else if(op == expression_type::k_comparison_smaller__2){
+			return expression_t::make_literal_bool(diff < 0);
+		}
+		else if(op == expression_type::k_comparison_larger_or_equal__2){
+			return expression_t::make_literal_bool(diff >= 0);
+		}
+		else if(op == expression_type::k_comparison_larger__2){
+			return expression_t::make_literal_bool(diff > 0);
+		}
+		else if(op == expression_type::k_logical_equal__2){
+			return expression_t::make_literal_bool(diff == 0);
+		}
+		else if(op == expression_type::k_logical_nonequal__2){
+			return expression_t::make_literal_bool(diff != 0);
+		}
+		return e;
+	}
+	else if(is_arithmetic_expression(op)){
+		const auto& left = inputs[0].get_literal();
+		const auto& right = inputs[1].get_literal();
+		const auto type = e.get_output_type();
+
+		if(type.is_bool()){
+			if(op == expression_type::k_logical_and__2){
+				return expression_t::make_literal_bool(left.get_bool_value() && right.get_bool_value());
+			}
+			else if(op == expression_type::k_logical_or__2){
+				return expression_t::make_literal_bool(left.get_bool_value() || right.get_bool_value());
+			}
+		}
+		else if(type.is_int()){
+			return fold_int_arithmetic(e, op, left.get_int_value(), right.get_int_value());
+		}
+		else if(type.is_double()){
+			return fold_double_arithmetic(e, op, left.get_double_value(), right.get_double_value());
+		}
+		else if(type.is_string() && op == expression_type::k_arithmetic_add__2){
+			return expression_t::make_literal_string(left.get_string_value() + right.get_string_value());
+		}
+		return e;
+	}
+	else{
+		return e;
+	}
+}
+
+
 std::pair<analyser_t, expression_t> analyse_expression__operation_specific(const analyser_t& a, const statement_t& parent, const expression_t& e, const typeid_t& target_type){
 	QUARK_ASSERT(a.check_invariant());
 	QUARK_ASSERT(e.check_invariant());
@@ -1581,18 +1793,22 @@ std::pair<analyser_t, expression_t> analyse_expression__operation_specific(const
 	}
 
 	else if(op == expression_type::k_arithmetic_unary_minus__1){
-		return analyse_arithmetic_unary_minus_expression(a, parent, e);
+		const auto result = analyse_arithmetic_unary_minus_expression(a, parent, e);
+		return { result.first, fold_constant_expression(result.second) };
 	}
 
 	//	Special-case since it uses 3 expressions & uses shortcut evaluation.
 	else if(op == expression_type::k_conditional_operator3){
-		return analyse_conditional_operator_expression(a, parent, e);
+		const auto result = analyse_conditional_operator_expression(a, parent, e);
+		return { result.first, fold_constant_expression(result.second) };
 	}
 	else if(is_comparison_expression(op)){
-		return analyse_comparison_expression(a, parent, op, e);
+		const auto result = analyse_comparison_expression(a, parent, op, e);
+		return { result.first, fold_constant_expression(result.second) };
 	}
 	else if(is_arithmetic_expression(op)){
-		return analyse_arithmetic_expression(a, parent, op, e);
+		const auto result = analyse_arithmetic_expression(a, parent, op, e);
+		return { result.first, fold_constant_expression(result.second) };
 	}
 	else{
 		QUARK_ASSERT(false);
@@ -1721,7 +1937,7 @@ QUARK_UNIT_TEST("analyse_expression_no_target()", "1 + 2 == 3", "", "") {
 
 	ut_verify(QUARK_POS,
 		expression_to_json(e3.second)._value,
-		parse_json(seq_t(R"(   ["+", ["k", 1, "^int"], ["k", 2, "^int"], "^int"]   )")).first
+		parse_json(seq_t(R"(   ["k", 3, "^int"]   )")).first
 	);
 }
 
@@ -48,6 +48,14 @@ std::map<std::string, clock_bus_t> unpack_clock_busses(const json_t& clocks_obj)
 	}
 	return result;
 }
+std::vector<std::string> unpack_strings(const json_t& array){
+	std::vector<std::string> result;
+	for(const auto& e: array.get_array()){
+		result.push_back(e.get_string());
+	}
+	return result;
+}
+
 container_t unpack_container(const json_t& container_obj){
 	return container_obj.get_object_size() == 0 ?
 		container_t{}
@@ -58,7 +66,14 @@ container_t unpack_container(const json_t& container_obj){
 		._tech = container_obj.get_object_element("tech").get_string(),
 		._clock_busses = unpack_clock_busses(container_obj.get_object_element("clocks")),
 		._connections = {},
-		._components = {}
+		._components = {},
+		._stack_size = static_cast<int64_t>(container_obj.get_optional_object_element("stack_size", json_t(0.0)).get_number()),
+		._max_stack_size = static_cast<int64_t>(container_obj.get_optional_object_element("max_stack_size", json_t(0.0)).get_number()),
+		._inline_budget = static_cast<int64_t>(container_obj.get_optional_object_element("inline_budget", json_t(-1.0)).get_number()),
+		._jit = container_obj.get_optional_object_element("jit", json_t(false)).is_true(),
+		._memoize = unpack_strings(container_obj.get_optional_object_element("memoize", json_t::make_array())),
+		._memoize_capacity = static_cast<int64_t>(container_obj.get_optional_object_element("memoize_capacity", json_t(0.0)).get_number()),
+		._const_eval_steps = static_cast<int64_t>(container_obj.get_optional_object_element("const_eval_steps", json_t(-1.0)).get_number())
 	};
 }
 
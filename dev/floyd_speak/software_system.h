@@ -43,6 +43,28 @@ struct container_t {
 	std::map<std::string, clock_bus_t> _clock_busses;
 	std::vector<connection_t> _connections;
 	std::vector<std::string> _components;
+
+	//	Optional "stack_size" and "max_stack_size" for each process' interpreter, counted in stack entries.
+	//	0 = use the interpreter's defaults.
+	int64_t _stack_size = 0;
+	int64_t _max_stack_size = 0;
+
+	//	Optional "inline_budget": calls to pure functions with at most this many instructions are inlined.
+	//	-1 = use the bytecode generator's default, 0 = never inline.
+	int64_t _inline_budget = -1;
+
+	//	Optional "jit": run hot Floyd functions as native code. Also set by "floyd run -j".
+	bool _jit = false;
+
+	//	Optional "memoize": names of pure functions whose results are cached. Also set by "floyd run -m".
+	std::vector<std::string> _memoize;
+
+	//	Optional "memoize_capacity": max results cached per function. 0 = use the interpreter's default.
+	int64_t _memoize_capacity = 0;
+
+	//	Optional "const_eval_steps": step limit for each global call evaluated at compile time.
+	//	-1 = use the compiler's default, 0 = never evaluate calls at compile time.
+	int64_t _const_eval_steps = -1;
 };
 
 struct software_system_t {